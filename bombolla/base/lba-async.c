@@ -46,6 +46,8 @@ typedef struct _LbaAsync {
   GMutex lock;
   GCond cond;
   GSource *async_ctx;
+  /* What async_ctx calls */
+  GSourceFunc async_cmd;
 
   /* Special case: GObject constructor */
   LbaAsyncConstructorInfo *constructor_info;
@@ -150,6 +152,21 @@ lba_async_cmd_free (gpointer gobject) {
   g_mutex_unlock (&self->lock);
 }
 
+/* In the main loop. The hop from the calling thread is an arrow in the trace */
+static gboolean
+lba_async_dispatch (gpointer ptr) {
+  LbaAsync *self = (LbaAsync *) ptr;
+  const gchar *type_name = G_OBJECT_TYPE_NAME (BM_GET_GOBJECT (self));
+  gboolean ret;
+
+  LBA_TRACE_FLOW_IN ("async hop", (guintptr) self, 0);
+  LBA_TRACE_BEGIN_NAMED ("async dispatch", type_name, 0);
+  ret = self->async_cmd (self);
+  LBA_TRACE_END_NAMED ("async dispatch", type_name, 0);
+
+  return ret;
+}
+
 static void
 lba_async_call_through_main_loop (LbaAsync *self, GSourceFunc cmd) {
   g_warn_if_fail (self->async_ctx == NULL);
@@ -157,15 +174,23 @@ lba_async_call_through_main_loop (LbaAsync *self, GSourceFunc cmd) {
     LBA_LOG ("Already in the MainContext. Calling synchronously");
     cmd (self);
   } else {
+    /* Type names stay as long as the process */
+    const gchar *type_name = G_OBJECT_TYPE_NAME (BM_GET_GOBJECT (self));
+
+    self->async_cmd = cmd;
     self->async_ctx = g_idle_source_new ();
     g_source_set_priority (self->async_ctx, G_PRIORITY_HIGH);
-    g_source_set_callback (self->async_ctx, cmd, self, lba_async_cmd_free);
+    g_source_set_callback (self->async_ctx, lba_async_dispatch, self,
+                           lba_async_cmd_free);
 
     /* Attach the source and wait for it to finish */
+    LBA_TRACE_BEGIN_NAMED ("async wait", type_name, 0);
+    LBA_TRACE_FLOW_OUT ("async hop", (guintptr) self, 0);
     g_mutex_lock (&self->lock);
     g_source_attach (self->async_ctx, NULL);
     g_cond_wait (&self->cond, &self->lock);
     g_mutex_unlock (&self->lock);
+    LBA_TRACE_END_NAMED ("async wait", type_name, 0);
   }
 }
 
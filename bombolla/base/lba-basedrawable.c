@@ -77,11 +77,35 @@ base_drawable_set_property (GObject *object,
     {
       BaseDrawableClass *klass = BASE_DRAWABLE_GET_CLASS (self);
 
+      if (self->scene) {
+        if (self->retained) {
+          g_signal_emit_by_name (self->scene, "remove-drawable", self);
+        } else {
+          g_signal_handlers_disconnect_by_func (self->scene,
+                                                base_drawable_scene_on_draw_cb,
+                                                self);
+        }
+        self->retained = FALSE;
+      }
+
       self->scene = g_value_get_object (value);
 
-      if (klass->draw) {
-        g_signal_connect (self->scene, "on-draw",
-                          G_CALLBACK (base_drawable_scene_on_draw_cb), self);
+      if (klass->draw && self->scene) {
+        /* Scenes that keep a render list draw us in one go,
+         * the others will emit "on-draw" */
+        if (g_signal_lookup ("add-drawable", G_OBJECT_TYPE (self->scene))) {
+          g_signal_emit_by_name (self->scene, "add-drawable", self, &self->retained);
+        }
+
+        if (!self->retained) {
+          g_signal_connect (self->scene, "on-draw",
+                            G_CALLBACK (base_drawable_scene_on_draw_cb), self);
+        }
+      }
+
+      /* The texture uploads new pictures in the scene's "on-prepare" */
+      if (self->scene && self->texture) {
+        g_object_set (self->texture, "drawing-scene", self->scene, NULL);
       }
 
       LBA_LOG ("drawing scene set");
@@ -44,12 +44,18 @@ typedef struct _BaseDrawable {
   GObject *scene;
   GObject *texture;
   gboolean enabled;
+
+  /* Drawn by the scene itself instead of reacting to "on-draw" */
+  gboolean retained;
 } BaseDrawable;
 
 typedef struct _BaseDrawableClass {
   GObjectClass parent;
 
   void (*draw) (BaseDrawable *);
+
+  /* Optional: draws several objects of this type at once */
+  void (*draw_batch) (BaseDrawable **, guint n);
 } BaseDrawableClass;
 
 #endif
@@ -28,11 +28,14 @@
 #include "lba-basewindow.h"
 
 enum {
+  SIGNAL_ON_PREPARE,
   SIGNAL_ON_DRAW,
   SIGNAL_ON_DISPLAY,
   SIGNAL_OPEN,
   SIGNAL_CLOSE,
   SIGNAL_REQUEST_REDRAW,
+  SIGNAL_ADD_DRAWABLE,
+  SIGNAL_REMOVE_DRAWABLE,
   LAST_SIGNAL
 };
 
@@ -51,6 +54,9 @@ static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 
 void
 base_window_notify_display (BaseWindow *self) {
+  /* Resources (f.e. textures) are uploaded once per frame here,
+   * so drawing only has to use them */
+  g_signal_emit (self, base_window_signals[SIGNAL_ON_PREPARE], 0);
   g_signal_emit (self, base_window_signals[SIGNAL_ON_DISPLAY], 0);
   g_signal_emit (self, base_window_signals[SIGNAL_ON_DRAW], 0);
 }
@@ -63,6 +69,12 @@ base_window_request_redraw (BaseWindow *self) {
     klass->request_redraw (self);
 }
 
+static gboolean
+base_window_add_drawable (BaseWindow *self, GObject *drawable) {
+  /* By default drawables draw themselves on "on-draw" */
+  return FALSE;
+}
+
 static void
 base_window_set_property (GObject *object,
                           guint property_id, const GValue *value,
@@ -200,6 +212,13 @@ base_window_class_init (BaseWindowClass *klass) {
 
   g_object_class_install_properties (object_class, N_PROPERTIES, obj_properties);
 
+  klass->add_drawable = base_window_add_drawable;
+
+  base_window_signals[SIGNAL_ON_PREPARE] =
+      g_signal_new ("on-prepare", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST,
+                    0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
   base_window_signals[SIGNAL_ON_DISPLAY] =
       g_signal_new ("on-display", G_TYPE_FROM_CLASS (klass),
                     G_SIGNAL_RUN_LAST,
@@ -210,7 +229,8 @@ base_window_class_init (BaseWindowClass *klass) {
   base_window_signals[SIGNAL_ON_DRAW] =
       g_signal_new ("on-draw", G_TYPE_FROM_CLASS (klass),
                     G_SIGNAL_RUN_LAST,
-                    0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+                    G_STRUCT_OFFSET (BaseWindowClass, on_draw), NULL, NULL,
+                    g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
   base_window_signals[SIGNAL_OPEN] =
       g_signal_new ("open", G_TYPE_FROM_CLASS (klass),
@@ -229,6 +249,18 @@ base_window_class_init (BaseWindowClass *klass) {
       g_signal_new ("request-redraw", G_TYPE_FROM_CLASS (klass),
                     G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
                     0, NULL, NULL, g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+  base_window_signals[SIGNAL_ADD_DRAWABLE] =
+      g_signal_new ("add-drawable", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                    G_STRUCT_OFFSET (BaseWindowClass, add_drawable), NULL, NULL,
+                    NULL, G_TYPE_BOOLEAN, 1, G_TYPE_OBJECT);
+
+  base_window_signals[SIGNAL_REMOVE_DRAWABLE] =
+      g_signal_new ("remove-drawable", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                    G_STRUCT_OFFSET (BaseWindowClass, remove_drawable), NULL, NULL,
+                    NULL, G_TYPE_NONE, 1, G_TYPE_OBJECT);
 }
 
 G_DEFINE_TYPE (BaseWindow, base_window, G_TYPE_OBJECT)
@@ -55,12 +55,18 @@ typedef struct _BaseWindowClass {
 
   /* Events */
   void (*on_display) (BaseWindow *);
+  void (*on_draw) (BaseWindow *);
 
   /* Actions */
   void (*open) (BaseWindow *);
   void (*close) (BaseWindow *);
   void (*request_redraw) (BaseWindow *);
 
+  /* Retained drawing: returns TRUE if the window will draw the object
+   * itself, so it doesn't need to listen to "on-draw" */
+  gboolean (*add_drawable) (BaseWindow *, GObject *);
+  void (*remove_drawable) (BaseWindow *, GObject *);
+
 } BaseWindowClass;
 
 void base_window_notify_display (BaseWindow * self);
@@ -0,0 +1,397 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lba-frame-clock.h"
+#include "bombolla/lba-log.h"
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define LBA_FRAME_CLOCK_DEFAULT_BUDGET (G_USEC_PER_SEC / 60)
+
+typedef struct {
+  guint id;
+  /* NULL once removed while dispatching */
+  LbaFrameClockFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} LbaFrameClockHandler;
+
+struct _LbaFrameClock {
+  GSource source;
+
+  gint fd;
+
+  GRecMutex lock;
+  GArray *handlers[LBA_FRAME_CLOCK_N_PHASES];
+  guint next_id;
+  gboolean dispatching;
+  gboolean removed;
+
+  /* Set from any thread */
+  gint scheduled;
+  gint presenting;
+  gint64 scheduled_at;
+
+  gint64 interval;
+  gint64 budget;
+  gint64 next_deadline;
+  gint64 frame_time;
+
+  guint64 frames;
+  guint64 overruns;
+  guint64 missed;
+};
+
+static void
+lba_frame_clock_handler_clear (gpointer data) {
+  LbaFrameClockHandler *h = (LbaFrameClockHandler *) data;
+
+  if (h->notify)
+    h->notify (h->user_data);
+}
+
+/* Wakes up at @deadline, which is absolute */
+static void
+lba_frame_clock_arm (LbaFrameClock *self, gint64 deadline) {
+  struct itimerspec t = { 0 };
+
+  if (G_UNLIKELY (self->fd < 0)) {
+    g_source_set_ready_time (&self->source, deadline);
+    return;
+  }
+
+  t.it_value.tv_sec = deadline / G_USEC_PER_SEC;
+  t.it_value.tv_nsec = (deadline % G_USEC_PER_SEC) * 1000;
+
+  if (timerfd_settime (self->fd, TFD_TIMER_ABSTIME, &t, NULL) < 0) {
+    g_warning ("timerfd_settime failed: %s", g_strerror (errno));
+    /* Never leave a frame hanging */
+    g_source_set_ready_time (&self->source, deadline);
+  }
+}
+
+/* NOTE: called with the lock taken */
+static void
+lba_frame_clock_compact (LbaFrameClock *self) {
+  guint p,
+    i;
+
+  for (p = 0; p < LBA_FRAME_CLOCK_N_PHASES; p++) {
+    GArray *handlers = self->handlers[p];
+
+    for (i = 0; i < handlers->len;) {
+      if (g_array_index (handlers, LbaFrameClockHandler, i).func)
+        i++;
+      else
+        g_array_remove_index (handlers, i);
+    }
+  }
+
+  self->removed = FALSE;
+}
+
+static void
+lba_frame_clock_run (LbaFrameClock *self, gint64 now) {
+  gint64 budget,
+    end;
+  guint p,
+    i;
+
+  g_atomic_int_set (&self->scheduled, FALSE);
+
+  if (self->interval) {
+    gint64 since = MAX (self->next_deadline, self->scheduled_at);
+
+    if (now - since >= self->interval)
+      self->missed += (now - since) / self->interval;
+
+    /* Stay on the grid unless the clock has been idle */
+    if (self->next_deadline && now - self->next_deadline < self->interval)
+      self->next_deadline += self->interval;
+    else
+      self->next_deadline = now + self->interval;
+  }
+
+  self->frame_time = now;
+
+  g_rec_mutex_lock (&self->lock);
+  self->dispatching = TRUE;
+  for (p = 0; p < LBA_FRAME_CLOCK_N_PHASES; p++) {
+    /* The handlers may add more handlers */
+    for (i = 0; i < self->handlers[p]->len; i++) {
+      LbaFrameClockHandler h =
+          g_array_index (self->handlers[p], LbaFrameClockHandler, i);
+
+      if (h.func)
+        h.func (self, now, h.user_data);
+    }
+  }
+  self->dispatching = FALSE;
+
+  if (self->removed)
+    lba_frame_clock_compact (self);
+  g_rec_mutex_unlock (&self->lock);
+
+  end = g_get_monotonic_time ();
+  self->frames++;
+
+  budget = self->budget ? self->budget :
+      (self->interval ? self->interval : LBA_FRAME_CLOCK_DEFAULT_BUDGET);
+  if (G_UNLIKELY (end - now > budget)) {
+    self->overruns++;
+    LBA_LOG ("Frame took %" G_GINT64_FORMAT " us, budget is %" G_GINT64_FORMAT,
+             end - now, budget);
+  }
+}
+
+static gboolean
+lba_frame_clock_dispatch (GSource *source, GSourceFunc callback, gpointer data) {
+  LbaFrameClock *self = (LbaFrameClock *) source;
+  guint64 expirations;
+  gint64 now;
+
+  g_source_set_ready_time (source, -1);
+
+  /* Clears the fd. EAGAIN means it's not the timer who woke us up. */
+  if (self->fd >= 0 && read (self->fd, &expirations, sizeof (expirations)) < 0
+      && errno != EAGAIN)
+    g_warning ("Failed to read the timer: %s", g_strerror (errno));
+
+  if (!g_atomic_int_get (&self->scheduled) || g_atomic_int_get (&self->presenting))
+    return G_SOURCE_CONTINUE;
+
+  now = g_get_monotonic_time ();
+  if (self->interval && now < self->next_deadline) {
+    lba_frame_clock_arm (self, self->next_deadline);
+    return G_SOURCE_CONTINUE;
+  }
+
+  lba_frame_clock_run (self, now);
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+lba_frame_clock_finalize (GSource *source) {
+  LbaFrameClock *self = (LbaFrameClock *) source;
+  guint p;
+
+  for (p = 0; p < LBA_FRAME_CLOCK_N_PHASES; p++)
+    g_array_free (self->handlers[p], TRUE);
+
+  if (self->fd >= 0)
+    close (self->fd);
+
+  g_rec_mutex_clear (&self->lock);
+}
+
+static GSourceFuncs lba_frame_clock_funcs = {
+  .dispatch = lba_frame_clock_dispatch,
+  .finalize = lba_frame_clock_finalize,
+};
+
+LbaFrameClock *
+lba_frame_clock_new (GMainContext *context) {
+  LbaFrameClock *self;
+  guint p;
+
+  self = (LbaFrameClock *) g_source_new (&lba_frame_clock_funcs,
+                                         sizeof (LbaFrameClock));
+  g_source_set_name (&self->source, "LbaFrameClock");
+  /* Lets the events that may request more redraws come first */
+  g_source_set_priority (&self->source, G_PRIORITY_DEFAULT_IDLE);
+
+  g_rec_mutex_init (&self->lock);
+  for (p = 0; p < LBA_FRAME_CLOCK_N_PHASES; p++) {
+    self->handlers[p] = g_array_new (FALSE, FALSE, sizeof (LbaFrameClockHandler));
+    g_array_set_clear_func (self->handlers[p], lba_frame_clock_handler_clear);
+  }
+
+  self->fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (self->fd >= 0)
+    g_source_add_unix_fd (&self->source, self->fd, G_IO_IN);
+  else
+    g_warning ("timerfd_create failed: %s", g_strerror (errno));
+
+  g_source_attach (&self->source, context);
+
+  return self;
+}
+
+void
+lba_frame_clock_free (LbaFrameClock *self) {
+  if (!self)
+    return;
+
+  g_source_destroy (&self->source);
+  g_source_unref (&self->source);
+}
+
+guint
+lba_frame_clock_add (LbaFrameClock *self, LbaFrameClockPhase phase,
+                     LbaFrameClockFunc func, gpointer user_data,
+                     GDestroyNotify notify) {
+  LbaFrameClockHandler h;
+
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (phase < LBA_FRAME_CLOCK_N_PHASES, 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  g_rec_mutex_lock (&self->lock);
+  h.id = ++self->next_id;
+  h.func = func;
+  h.user_data = user_data;
+  h.notify = notify;
+  g_array_append_val (self->handlers[phase], h);
+  g_rec_mutex_unlock (&self->lock);
+
+  return h.id;
+}
+
+void
+lba_frame_clock_remove (LbaFrameClock *self, guint id) {
+  GDestroyNotify notify = NULL;
+  gpointer user_data = NULL;
+  guint p,
+    i;
+
+  g_return_if_fail (self != NULL);
+
+  g_rec_mutex_lock (&self->lock);
+  for (p = 0; p < LBA_FRAME_CLOCK_N_PHASES; p++) {
+    GArray *handlers = self->handlers[p];
+
+    for (i = 0; i < handlers->len; i++) {
+      LbaFrameClockHandler *h = &g_array_index (handlers, LbaFrameClockHandler, i);
+
+      if (h->id != id || !h->func)
+        continue;
+
+      notify = h->notify;
+      user_data = h->user_data;
+
+      if (self->dispatching) {
+        /* Can't move the handlers under the loop's feet */
+        h->func = NULL;
+        h->notify = NULL;
+        self->removed = TRUE;
+      } else {
+        h->notify = NULL;
+        g_array_remove_index (handlers, i);
+      }
+      goto done;
+    }
+  }
+
+done:
+  g_rec_mutex_unlock (&self->lock);
+
+  if (notify)
+    notify (user_data);
+}
+
+void
+lba_frame_clock_schedule (LbaFrameClock *self) {
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_int_get (&self->scheduled)) {
+    self->scheduled_at = g_get_monotonic_time ();
+    g_atomic_int_set (&self->scheduled, TRUE);
+  }
+
+  if (!g_atomic_int_get (&self->presenting))
+    g_source_set_ready_time (&self->source, 0);
+}
+
+void
+lba_frame_clock_wait_presentation (LbaFrameClock *self) {
+  g_return_if_fail (self != NULL);
+
+  g_atomic_int_set (&self->presenting, TRUE);
+}
+
+void
+lba_frame_clock_presented (LbaFrameClock *self) {
+  g_return_if_fail (self != NULL);
+
+  g_atomic_int_set (&self->presenting, FALSE);
+
+  if (g_atomic_int_get (&self->scheduled))
+    g_source_set_ready_time (&self->source, 0);
+}
+
+void
+lba_frame_clock_set_interval (LbaFrameClock *self, gint64 interval_us) {
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (interval_us >= 0);
+
+  self->interval = interval_us;
+  /* Start a new grid */
+  self->next_deadline = 0;
+}
+
+gint64
+lba_frame_clock_get_interval (LbaFrameClock *self) {
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->interval;
+}
+
+void
+lba_frame_clock_set_budget (LbaFrameClock *self, gint64 budget_us) {
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (budget_us >= 0);
+
+  self->budget = budget_us;
+}
+
+gint64
+lba_frame_clock_get_budget (LbaFrameClock *self) {
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->budget;
+}
+
+gint64
+lba_frame_clock_get_frame_time (LbaFrameClock *self) {
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->frame_time;
+}
+
+void
+lba_frame_clock_get_counters (LbaFrameClock *self, guint64 *frames,
+                              guint64 *overruns, guint64 *missed) {
+  g_return_if_fail (self != NULL);
+
+  if (frames)
+    *frames = self->frames;
+  if (overruns)
+    *overruns = self->overruns;
+  if (missed)
+    *missed = self->missed;
+}
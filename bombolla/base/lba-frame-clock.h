@@ -0,0 +1,92 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LBA_FRAME_CLOCK
+#  define _LBA_FRAME_CLOCK
+#  include <glib.h>
+
+/* Paces the frames of a window. Each frame runs the handlers of every phase
+ * in order, so whatever changes in "update" is there before "paint".
+ * A frame starts when it's been scheduled and both:
+ * - the previous one was presented, if the owner waits for it (vsync), and
+ * - the next deadline of the interval has come, if there's an interval.
+ * The deadlines are absolute, on a CLOCK_MONOTONIC timerfd. */
+
+typedef enum {
+  /* Animations, property changes */
+  LBA_FRAME_CLOCK_PHASE_UPDATE,
+  /* Sizes, positions, sorting */
+  LBA_FRAME_CLOCK_PHASE_LAYOUT,
+  LBA_FRAME_CLOCK_PHASE_PAINT,
+  LBA_FRAME_CLOCK_N_PHASES
+} LbaFrameClockPhase;
+
+typedef struct _LbaFrameClock LbaFrameClock;
+
+/* @frame_time: g_get_monotonic_time () of the start of the frame, the same
+ * for all the handlers */
+typedef void (*LbaFrameClockFunc) (LbaFrameClock * clock, gint64 frame_time,
+                                   gpointer user_data);
+
+/* Dispatched in @context, NULL means the default one */
+LbaFrameClock *lba_frame_clock_new (GMainContext * context);
+/* Calls the destroy notifies of the handlers that are left */
+void lba_frame_clock_free (LbaFrameClock * clock);
+
+guint
+lba_frame_clock_add (LbaFrameClock * clock, LbaFrameClockPhase phase,
+                     LbaFrameClockFunc func, gpointer user_data,
+                     GDestroyNotify notify);
+void lba_frame_clock_remove (LbaFrameClock * clock, guint id);
+
+/* Requests a frame. Thread safe. */
+void lba_frame_clock_schedule (LbaFrameClock * clock);
+
+/* The current frame was handed to the display: the next one waits for
+ * lba_frame_clock_presented (). Thread safe. */
+void lba_frame_clock_wait_presentation (LbaFrameClock * clock);
+void lba_frame_clock_presented (LbaFrameClock * clock);
+
+/* 0 means as soon as possible, or as the presentation allows */
+void lba_frame_clock_set_interval (LbaFrameClock * clock, gint64 interval_us);
+gint64 lba_frame_clock_get_interval (LbaFrameClock * clock);
+
+/* Frames that take longer count as overruns. 0 means the interval, or 60 Hz
+ * if there's none. */
+void lba_frame_clock_set_budget (LbaFrameClock * clock, gint64 budget_us);
+gint64 lba_frame_clock_get_budget (LbaFrameClock * clock);
+
+/* Of the last frame */
+gint64 lba_frame_clock_get_frame_time (LbaFrameClock * clock);
+
+/* @overruns: frames over the budget
+ * @missed: deadlines that passed while a frame was due */
+void
+lba_frame_clock_get_counters (LbaFrameClock * clock, guint64 * frames,
+                              guint64 * overruns, guint64 * missed);
+
+#endif
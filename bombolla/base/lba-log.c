@@ -0,0 +1,476 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bombolla/lba-log.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#  include <pthread.h>
+#endif
+
+/* Records per thread, the older ones are overwritten */
+#define LBA_TRACE_RING_SIZE 8192
+
+typedef struct {
+  gchar *pattern;
+  /* -1 if the rule doesn't change it */
+  gint level;
+  gint trace;
+} LbaLogRule;
+
+typedef struct _LbaTraceRing {
+  /* Written only by the thread of the ring, read by the dump */
+  guint64 head;
+  guint32 thread;
+  /* Of the thread that took the ring, if the system tells it */
+  gchar name[16];
+  /* The thread is gone, another one can take the ring */
+  gint free;
+  struct _LbaTraceRing *next;
+  LbaTraceRecord records[LBA_TRACE_RING_SIZE];
+} LbaTraceRing;
+
+static GMutex lba_log_lock;
+static LbaLogDomain *lba_log_domains;
+/* LbaLogRule, the later ones win */
+static GPtrArray *lba_log_rules;
+static gint lba_log_default_level;
+static gboolean lba_log_default_trace;
+
+/* LbaTraceEvent by id - 1 */
+static GPtrArray *lba_trace_events;
+static LbaTraceRing *lba_trace_rings;
+static guint32 lba_trace_n_threads;
+static __thread LbaTraceRing *lba_trace_ring;
+
+static void lba_trace_ring_release (gpointer data);
+static GPrivate lba_trace_ring_key = G_PRIVATE_INIT (lba_trace_ring_release);
+
+static const gchar *
+lba_log_domain_name (LbaLogDomain *domain) {
+  return *domain->name ? *domain->name : "bombolla";
+}
+
+static gboolean
+lba_log_parse_level (const gchar *str, LbaLogRule *rule) {
+  static const gchar *names[] = { "none", "info", "debug" };
+  guint i;
+
+  /* Only the recording, the printing stays as it is */
+  if (!g_ascii_strcasecmp (str, "trace")) {
+    rule->level = -1;
+    rule->trace = TRUE;
+    return TRUE;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++) {
+    if (!g_ascii_strcasecmp (str, names[i])) {
+      rule->level = i;
+      /* "none" turns the trace off too, the others leave it */
+      rule->trace = i == LBA_LOG_LEVEL_NONE ? FALSE : -1;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* NOTE: called with the lock taken */
+static gint
+lba_log_domain_update (LbaLogDomain *domain) {
+  const gchar *name = lba_log_domain_name (domain);
+  gint level = lba_log_default_level;
+  gint trace = lba_log_default_trace;
+  guint i;
+
+  for (i = 0; i < lba_log_rules->len; i++) {
+    LbaLogRule *rule = g_ptr_array_index (lba_log_rules, i);
+
+    if (!g_pattern_match_simple (rule->pattern, name))
+      continue;
+
+    if (rule->level != -1)
+      level = rule->level;
+    if (rule->trace != -1)
+      trace = rule->trace;
+  }
+
+  __atomic_store_n (&domain->trace, trace, __ATOMIC_RELAXED);
+  __atomic_store_n (&domain->level, level, __ATOMIC_RELAXED);
+
+  return level;
+}
+
+static void
+lba_log_rule_free (gpointer data) {
+  LbaLogRule *rule = (LbaLogRule *) data;
+
+  g_free (rule->pattern);
+  g_free (rule);
+}
+
+/* NOTE: called with the lock taken */
+static gboolean
+lba_log_add_rules (const gchar *spec) {
+  gchar **items = g_strsplit (spec, ",", -1);
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; items[i]; i++) {
+    gchar *item = g_strstrip (items[i]);
+    gchar *colon = strrchr (item, ':');
+    const gchar *pattern = "*";
+    const gchar *level_str = item;
+    LbaLogRule *rule;
+
+    if (*item == '\0')
+      continue;
+
+    if (colon) {
+      *colon = '\0';
+      pattern = item;
+      level_str = colon + 1;
+    }
+
+    rule = g_new (LbaLogRule, 1);
+    if (!lba_log_parse_level (level_str, rule)) {
+      g_warning ("Unknown log level '%s'", level_str);
+      g_free (rule);
+      ret = FALSE;
+      continue;
+    }
+
+    rule->pattern = g_strdup (pattern);
+    g_ptr_array_add (lba_log_rules, rule);
+  }
+
+  g_strfreev (items);
+  return ret;
+}
+
+static void
+lba_trace_dump_at_exit (void) {
+  GError *err = NULL;
+
+  if (!lba_trace_dump (g_getenv ("LBA_TRACE_FILE"), &err)) {
+    g_printerr ("Couldn't write the trace: %s\n", err->message);
+    g_error_free (err);
+  }
+}
+
+static void
+lba_log_init_once (void) {
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited)) {
+    const gchar *env = g_getenv ("LBA_LOG");
+
+    lba_log_rules = g_ptr_array_new_with_free_func (lba_log_rule_free);
+    lba_trace_events = g_ptr_array_new ();
+
+    /* As it was before the levels, G_MESSAGES_DEBUG shows the debug */
+    lba_log_default_level = g_getenv ("G_MESSAGES_DEBUG") ?
+        LBA_LOG_LEVEL_DEBUG : LBA_LOG_LEVEL_NONE;
+    /* Asking for the file is enough to get the trace, printing is not */
+    lba_log_default_trace = g_getenv ("LBA_TRACE_FILE") != NULL;
+    if (env)
+      lba_log_add_rules (env);
+
+    if (g_getenv ("LBA_TRACE_FILE"))
+      atexit (lba_trace_dump_at_exit);
+
+    g_once_init_leave (&inited, 1);
+  }
+}
+
+gint
+lba_log_domain_register (LbaLogDomain *domain) {
+  gint level;
+
+  lba_log_init_once ();
+
+  g_mutex_lock (&lba_log_lock);
+  level = domain->level;
+  if (level == LBA_LOG_LEVEL_UNKNOWN) {
+    level = lba_log_domain_update (domain);
+    domain->next = lba_log_domains;
+    lba_log_domains = domain;
+  }
+  g_mutex_unlock (&lba_log_lock);
+
+  return level;
+}
+
+gboolean
+lba_log_set_levels (const gchar *spec) {
+  LbaLogDomain *domain;
+  gboolean ret;
+
+  g_return_val_if_fail (spec != NULL, FALSE);
+
+  lba_log_init_once ();
+
+  g_mutex_lock (&lba_log_lock);
+  ret = lba_log_add_rules (spec);
+  for (domain = lba_log_domains; domain; domain = domain->next)
+    lba_log_domain_update (domain);
+  g_mutex_unlock (&lba_log_lock);
+
+  return ret;
+}
+
+void
+lba_log_message (const gchar *domain, const gchar *format, ...) {
+  GLogField fields[] = {
+    {"GLIB_DOMAIN", domain ? domain : "bombolla", -1},
+    {"MESSAGE", NULL, -1},
+  };
+  gchar *message;
+  va_list args;
+
+  va_start (args, format);
+  message = g_strdup_vprintf (format, args);
+  va_end (args);
+  fields[1].value = message;
+
+  /* Not through g_log (): the default writer drops the debug unless
+   * G_MESSAGES_DEBUG has the domain. This one prints it as it would. */
+  g_log_writer_standard_streams (G_LOG_LEVEL_DEBUG, fields,
+                                 G_N_ELEMENTS (fields), NULL);
+  g_free (message);
+}
+
+static void
+lba_trace_ring_release (gpointer data) {
+  LbaTraceRing *ring = (LbaTraceRing *) data;
+
+  /* The records stay until somebody else takes it */
+  g_atomic_int_set (&ring->free, TRUE);
+}
+
+static LbaTraceRing *
+lba_trace_ring_get (void) {
+  LbaTraceRing *ring;
+
+  g_mutex_lock (&lba_log_lock);
+  for (ring = lba_trace_rings; ring; ring = ring->next) {
+    if (g_atomic_int_get (&ring->free))
+      break;
+  }
+
+  if (!ring) {
+    ring = g_new0 (LbaTraceRing, 1);
+    ring->next = lba_trace_rings;
+    lba_trace_rings = ring;
+  }
+
+  ring->free = FALSE;
+  ring->thread = ++lba_trace_n_threads;
+  memset (ring->name, 0, sizeof (ring->name));
+#ifdef __GLIBC__
+  /* GThreads have the names set */
+  pthread_getname_np (pthread_self (), ring->name, sizeof (ring->name));
+#endif
+  g_mutex_unlock (&lba_log_lock);
+
+  g_private_set (&lba_trace_ring_key, ring);
+  lba_trace_ring = ring;
+  return ring;
+}
+
+static guint32
+lba_trace_event_register (LbaTraceEvent *event) {
+  guint32 id;
+
+  g_mutex_lock (&lba_log_lock);
+  id = event->id;
+  if (id == 0) {
+    g_ptr_array_add (lba_trace_events, event);
+    id = lba_trace_events->len;
+    __atomic_store_n (&event->id, id, __ATOMIC_RELEASE);
+  }
+  g_mutex_unlock (&lba_log_lock);
+
+  return id;
+}
+
+void
+lba_trace_record (LbaTraceEvent *event, guint64 arg0, guint64 arg1) {
+  LbaTraceRing *ring = lba_trace_ring;
+  LbaTraceRecord *record;
+  guint32 id;
+  guint64 head;
+
+  id = __atomic_load_n (&event->id, __ATOMIC_ACQUIRE);
+  if (G_UNLIKELY (id == 0))
+    id = lba_trace_event_register (event);
+
+  if (G_UNLIKELY (ring == NULL))
+    ring = lba_trace_ring_get ();
+
+  /* Only this thread writes it */
+  head = ring->head;
+  record = &ring->records[head & (LBA_TRACE_RING_SIZE - 1)];
+  record->time = g_get_monotonic_time ();
+  record->event = id;
+  record->thread = ring->thread;
+  record->args[0] = arg0;
+  record->args[1] = arg1;
+  __atomic_store_n (&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static void
+lba_trace_append_string (GByteArray *buf, const gchar *str) {
+  g_byte_array_append (buf, (const guint8 *) str, strlen (str) + 1);
+}
+
+/* NOTE: called with the lock taken.
+ * The thread keeps going meanwhile, so the oldest ones may be torn, they
+ * are dropped. */
+static GArray *
+lba_trace_ring_copy (LbaTraceRing *ring) {
+  guint64 head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE);
+  guint64 start = head > LBA_TRACE_RING_SIZE ? head - LBA_TRACE_RING_SIZE : 0;
+  guint64 overwritten;
+  GArray *ret;
+  guint64 h;
+
+  ret = g_array_sized_new (FALSE, FALSE, sizeof (LbaTraceRecord), head - start);
+  for (h = start; h < head; h++)
+    g_array_append_val (ret, ring->records[h & (LBA_TRACE_RING_SIZE - 1)]);
+
+  overwritten = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) + 1;
+  overwritten = overwritten > LBA_TRACE_RING_SIZE ?
+      overwritten - LBA_TRACE_RING_SIZE : 0;
+  if (overwritten > start)
+    g_array_remove_range (ret, 0, MIN (overwritten, head) - start);
+
+  return ret;
+}
+
+/* The file is, in the host byte order:
+   [LBATRACE] - magic, 8 bytes
+   [version] - 4 bytes
+   [number of events] - 4 bytes
+   for each event:
+     [id] - 4 bytes
+     [line] - 4 bytes
+     [phase], [flags] - 2 bytes each
+     [domain], [function], [format] - zero-terminated strings
+   [number of rings] - 4 bytes
+   for each ring:
+     [thread name] - 16 bytes, zero-padded
+     [number of records] - 4 bytes
+     [records] - LbaTraceRecord each, the oldest first
+   [number of names] - 4 bytes
+   for each string of the LBA_TRACE_FLAG_NAMED records:
+     [the pointer, as in the records] - 8 bytes
+     [the string] - zero-terminated
+*/
+gboolean
+lba_trace_dump (const gchar *path, GError **err) {
+  GByteArray *buf;
+  GHashTable *names;
+  GHashTableIter iter;
+  gpointer name;
+  LbaTraceRing *ring;
+  guint32 val;
+  guint32 n_rings = 0;
+  guint n_rings_pos;
+  gboolean ret;
+  guint i;
+
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  lba_log_init_once ();
+
+  buf = g_byte_array_new ();
+  names = g_hash_table_new (NULL, NULL);
+  g_byte_array_append (buf, (const guint8 *) LBA_TRACE_MAGIC, 8);
+  val = LBA_TRACE_VERSION;
+  g_byte_array_append (buf, (const guint8 *) &val, 4);
+
+  g_mutex_lock (&lba_log_lock);
+  val = lba_trace_events->len;
+  g_byte_array_append (buf, (const guint8 *) &val, 4);
+  for (i = 0; i < lba_trace_events->len; i++) {
+    LbaTraceEvent *event = g_ptr_array_index (lba_trace_events, i);
+
+    g_byte_array_append (buf, (const guint8 *) &event->id, 4);
+    g_byte_array_append (buf, (const guint8 *) &event->line, 4);
+    g_byte_array_append (buf, (const guint8 *) &event->phase, 2);
+    g_byte_array_append (buf, (const guint8 *) &event->flags, 2);
+    lba_trace_append_string (buf, lba_log_domain_name (event->domain));
+    lba_trace_append_string (buf, event->func);
+    lba_trace_append_string (buf, event->format);
+  }
+
+  n_rings_pos = buf->len;
+  g_byte_array_append (buf, (const guint8 *) &n_rings, 4);
+  for (ring = lba_trace_rings; ring; ring = ring->next) {
+    GArray *records = lba_trace_ring_copy (ring);
+
+    g_byte_array_append (buf, (const guint8 *) ring->name, sizeof (ring->name));
+    val = records->len;
+    g_byte_array_append (buf, (const guint8 *) &val, 4);
+    g_byte_array_append (buf, (const guint8 *) records->data,
+                         records->len * sizeof (LbaTraceRecord));
+
+    for (i = 0; i < records->len; i++) {
+      LbaTraceRecord *rec = &g_array_index (records, LbaTraceRecord, i);
+      LbaTraceEvent *event;
+
+      if (rec->event == 0 || rec->event > lba_trace_events->len)
+        continue;
+
+      event = g_ptr_array_index (lba_trace_events, rec->event - 1);
+      if (event->flags & LBA_TRACE_FLAG_NAMED)
+        g_hash_table_add (names, (gpointer) (guintptr) rec->args[0]);
+    }
+
+    g_array_unref (records);
+    n_rings++;
+  }
+  memcpy (buf->data + n_rings_pos, &n_rings, 4);
+  g_mutex_unlock (&lba_log_lock);
+
+  val = g_hash_table_size (names);
+  g_byte_array_append (buf, (const guint8 *) &val, 4);
+  g_hash_table_iter_init (&iter, names);
+  while (g_hash_table_iter_next (&iter, &name, NULL)) {
+    guint64 ptr = (guintptr) name;
+
+    g_byte_array_append (buf, (const guint8 *) &ptr, 8);
+    lba_trace_append_string (buf, name ? (const gchar *) name : "");
+  }
+  g_hash_table_unref (names);
+
+  ret = g_file_set_contents (path, (const gchar *) buf->data, buf->len, err);
+  g_byte_array_unref (buf);
+
+  return ret;
+}
@@ -29,6 +29,12 @@
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
 #include "lba-picture.h"
+#include <string.h>
+
+typedef struct {
+  GBytes *bytes;
+  guint stride;
+} LbaPictureConverted;
 
 typedef struct _LbaPicture {
   BMixinInstance i;
@@ -36,32 +42,184 @@ typedef struct _LbaPicture {
   gchar *format;
   GValue data;
   GRecMutex lock;
+
+  LbaPictureFrameInfo info;
+  gint64 next_produced;
+  LbaPictureDamage next_damage;
+
+  /* The current frame in other formats, and its number */
+  LbaPictureConverted converted[LBA_PIXEL_FORMAT_LAST];
+  guint64 seq;
 } LbaPicture;
 
 BM_DEFINE_MIXIN (lba_picture, LbaPicture);
 
+/* Links the frame from the producer to the consumers in the trace */
+#define LBA_PICTURE_FLOW_ID(self) \
+  ((guint64) (guintptr) (self) ^ ((self)->seq << 48))
+
+/* NOTE: called with the lock taken */
+static void
+lba_picture_new_frame (LbaPicture *self) {
+  guint i;
+
+  self->seq++;
+  for (i = 0; i < LBA_PIXEL_FORMAT_LAST; i++)
+    g_clear_pointer (&self->converted[i].bytes, g_bytes_unref);
+}
+
+/* NOTE: called with the lock taken */
+static gboolean
+lba_picture_parse_format (LbaPicture *self, gchar fmt[16], guint *w, guint *h,
+                          guint *stride) {
+  if (G_UNLIKELY (self->format == NULL))
+    return FALSE;
+
+  /* The stride is optional */
+  *stride = 0;
+  if (3 > sscanf (self->format, "%15s w(%u) h(%u) s(%u)", fmt, w, h, stride)) {
+    g_critical ("Bad format %s", self->format);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 gpointer
-lba_picture_get (GObject *obj, gchar fmt[16], guint *w, guint *h) {
+lba_picture_get_full (GObject *obj, gchar fmt[16], guint *w, guint *h,
+                      guint *stride, LbaPictureFrameInfo *info) {
   LbaPicture *self = bm_get_LbaPicture (obj);
+  gpointer ret;
+  guint s = 0;
 
   g_return_val_if_fail (self != NULL, NULL);
   g_return_val_if_fail (fmt != NULL, NULL);
   g_return_val_if_fail (w != NULL, NULL);
   g_return_val_if_fail (h != NULL, NULL);
 
-  if (G_UNLIKELY (self->format == NULL))
+  g_rec_mutex_lock (&self->lock);
+  if (!lba_picture_parse_format (self, fmt, w, h, &s)) {
+    g_rec_mutex_unlock (&self->lock);
     return NULL;
+  }
 
-  if (3 != sscanf (self->format, "%s w(%u) h(%u)", fmt, w, h)) {
-    g_critical ("Bad format %s", self->format);
+  ret = g_value_dup_boxed (&self->data);
+  if (info)
+    *info = self->info;
+  LBA_TRACE_FLOW_IN ("picture", LBA_PICTURE_FLOW_ID (self), self->seq);
+  g_rec_mutex_unlock (&self->lock);
+
+  if (stride)
+    *stride = s;
+
+  return ret;
+}
+
+gpointer
+lba_picture_get (GObject *obj, gchar fmt[16], guint *w, guint *h) {
+  return lba_picture_get_full (obj, fmt, w, h, NULL, NULL);
+}
+
+GBytes *
+lba_picture_get_converted (GObject *obj, LbaPixelFormat format, guint *w,
+                           guint *h, guint *stride, LbaPictureFrameInfo *info) {
+  LbaPicture *self = bm_get_LbaPicture (obj);
+  LbaPictureClass *mc;
+  LbaPixelFormat from;
+  GBytes *src,
+   *ret;
+  gchar fmt[16];
+  guint src_stride,
+    dst_stride;
+  gsize size;
+  guint64 seq;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (w != NULL, NULL);
+  g_return_val_if_fail (h != NULL, NULL);
+  g_return_val_if_fail (stride != NULL, NULL);
+  g_return_val_if_fail (format > LBA_PIXEL_FORMAT_UNKNOWN
+                        && format < LBA_PIXEL_FORMAT_LAST, NULL);
+
+  mc = BM_GET_CLASS (self, LbaPictureClass);
+  g_return_val_if_fail (mc->data_type == G_TYPE_BYTES, NULL);
+
+  g_rec_mutex_lock (&self->lock);
+  if (!lba_picture_parse_format (self, fmt, w, h, &src_stride)) {
+    g_rec_mutex_unlock (&self->lock);
+    return NULL;
+  }
+
+  if (info)
+    *info = self->info;
+  LBA_TRACE_FLOW_IN ("picture", LBA_PICTURE_FLOW_ID (self), self->seq);
+
+  from = lba_pixel_format_from_string (fmt);
+  if (from == format || self->converted[format].bytes) {
+    if (from == format) {
+      ret = g_value_dup_boxed (&self->data);
+      *stride = src_stride;
+    } else {
+      ret = g_bytes_ref (self->converted[format].bytes);
+      *stride = self->converted[format].stride;
+    }
+    g_rec_mutex_unlock (&self->lock);
+    return ret;
+  }
+
+  src = g_value_dup_boxed (&self->data);
+  seq = self->seq;
+  g_rec_mutex_unlock (&self->lock);
+
+  if (!src)
     return NULL;
+
+  if (!lba_pixel_format_can_convert (from, format)) {
+    LBA_LOG ("Can't convert %s to %s", fmt, lba_pixel_format_to_string (format));
+    g_bytes_unref (src);
+    return NULL;
+  }
+
+  if (g_bytes_get_size (src) < lba_pixel_format_frame_size (from, *w, *h,
+                                                            src_stride)) {
+    g_warning ("The frame is too small for %s", fmt);
+    g_bytes_unref (src);
+    return NULL;
+  }
+
+  /* The lock is not held for the conversion: the producer may go on */
+  dst_stride = lba_pixel_format_default_stride (format, *w);
+  size = lba_pixel_format_frame_size (format, *w, *h, dst_stride);
+  {
+    guint8 *dst = g_malloc (size);
+
+    lba_pixel_format_convert (from, g_bytes_get_data (src, NULL), src_stride,
+                              format, dst, dst_stride, *w, *h);
+    ret = g_bytes_new_take (dst, size);
+  }
+  g_bytes_unref (src);
+
+  g_rec_mutex_lock (&self->lock);
+  /* Unless the frame has changed meanwhile */
+  if (seq == self->seq) {
+    if (self->converted[format].bytes) {
+      /* Someone else was converting it at the same time */
+      g_bytes_unref (ret);
+      ret = g_bytes_ref (self->converted[format].bytes);
+    } else {
+      self->converted[format].bytes = g_bytes_ref (ret);
+      self->converted[format].stride = dst_stride;
+    }
   }
+  g_rec_mutex_unlock (&self->lock);
 
-  return g_value_dup_boxed (&self->data);
+  *stride = dst_stride;
+  return ret;
 }
 
 void
-lba_picture_set (GObject *obj, const gchar fmt[16], guint w, guint h, gpointer data) {
+lba_picture_set_full (GObject *obj, const gchar fmt[16], guint w, guint h,
+                      guint stride, gpointer data) {
   LbaPicture *self = bm_get_LbaPicture (obj);
 
   g_return_if_fail (self != NULL);
@@ -74,16 +232,79 @@ lba_picture_set (GObject *obj, const gchar fmt[16], guint w, guint h, gpointer d
   /* g_return_val_if_fail (G_TYPE_IS_BOXED (data), FALSE); */
 
   g_rec_mutex_lock (&self->lock);
+  self->info.published = lba_stats_now ();
+  self->info.produced = self->next_produced ?
+      self->next_produced : self->info.published;
+  self->next_produced = 0;
+  self->info.damage = self->next_damage;
+  self->next_damage.n_rects = 0;
+
+  lba_picture_new_frame (self);
+  LBA_TRACE_FLOW_OUT ("picture", LBA_PICTURE_FLOW_ID (self), self->seq);
   g_value_take_boxed (&self->data, data);
   g_free (self->format);
   /* NOTE: noify only if have changed */
-  self->format = g_strdup_printf ("%s w(%u) h(%u)", fmt, w, h);
+  self->format = stride ?
+      g_strdup_printf ("%s w(%u) h(%u) s(%u)", fmt, w, h, stride) :
+      g_strdup_printf ("%s w(%u) h(%u)", fmt, w, h);
   g_rec_mutex_unlock (&self->lock);
 
   g_object_notify (obj, "format");
   g_object_notify (obj, "data");
 }
 
+void
+lba_picture_set_produced (GObject *obj, gint64 ts) {
+  LbaPicture *self = bm_get_LbaPicture (obj);
+
+  g_return_if_fail (self != NULL);
+
+  g_rec_mutex_lock (&self->lock);
+  self->next_produced = ts;
+  g_rec_mutex_unlock (&self->lock);
+}
+
+void
+lba_picture_set_damage (GObject *obj, const LbaPictureRect *rects, guint n_rects) {
+  LbaPicture *self = bm_get_LbaPicture (obj);
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (rects != NULL || n_rects == 0);
+
+  g_rec_mutex_lock (&self->lock);
+  if (n_rects > LBA_PICTURE_MAX_DAMAGE)
+    n_rects = 0;
+
+  self->next_damage.n_rects = n_rects;
+  memcpy (self->next_damage.rects, rects, n_rects * sizeof (LbaPictureRect));
+  g_rec_mutex_unlock (&self->lock);
+}
+
+void
+lba_picture_damage_union (LbaPictureDamage *dst, const LbaPictureDamage *src) {
+  g_return_if_fail (dst != NULL);
+  g_return_if_fail (src != NULL);
+
+  /* Whole picture either way */
+  if (dst->n_rects == 0)
+    return;
+
+  if (src->n_rects == 0 || dst->n_rects + src->n_rects > LBA_PICTURE_MAX_DAMAGE) {
+    dst->n_rects = 0;
+    return;
+  }
+
+  /* Overlaps are just uploaded twice */
+  memcpy (dst->rects + dst->n_rects, src->rects,
+          src->n_rects * sizeof (LbaPictureRect));
+  dst->n_rects += src->n_rects;
+}
+
+void
+lba_picture_set (GObject *obj, const gchar fmt[16], guint w, guint h, gpointer data) {
+  lba_picture_set_full (obj, fmt, w, h, 0, data);
+}
+
 typedef enum {
   PROP_DATA = 1,
   PROP_FORMAT,
@@ -101,9 +322,13 @@ lba_picture_set_property (GObject *object,
   case PROP_FORMAT:
     g_free (self->format);
     self->format = g_value_dup_string (value);
+    lba_picture_new_frame (self);
     break;
   case PROP_DATA:
     g_value_copy (value, &self->data);
+    lba_picture_new_frame (self);
+    /* We don't know what has changed */
+    self->info.damage.n_rects = 0;
     break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -144,6 +369,7 @@ static void
 lba_picture_finalize (GObject *gobject) {
   LbaPicture *self = bm_get_LbaPicture (gobject);
 
+  lba_picture_new_frame (self);
   g_value_unset (&self->data);
   g_clear_pointer (&self->format, g_free);
   g_rec_mutex_clear (&self->lock);
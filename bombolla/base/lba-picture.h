@@ -28,6 +28,8 @@
 #ifndef _LBA_PICTURE
 
 #  include <bmixin/bmixin.h>
+#  include "lba-stats.h"
+#  include "lba-pixel-format.h"
 
 typedef struct _LbaPictureClass {
   BMixinClass c;
@@ -45,4 +47,61 @@ void
 lba_picture_set (GObject * obj, const gchar fmt[16], guint w, guint h,
                  gpointer data);
 
+#  define LBA_PICTURE_MAX_DAMAGE 16
+
+typedef struct {
+  gint x;
+  gint y;
+  gint w;
+  gint h;
+} LbaPictureRect;
+
+/* The areas changed since the previous frame.
+ * No rectangles means the whole picture. */
+typedef struct {
+  guint n_rects;
+  LbaPictureRect rects[LBA_PICTURE_MAX_DAMAGE];
+} LbaPictureDamage;
+
+/* Describes the current frame */
+typedef struct {
+  /* Timestamps, g_get_monotonic_time () based. Only filled while
+   * lba_stats_enabled (), 0 otherwise. */
+  /* The producer got the frame, e.g. appsink "new-sample" */
+  gint64 produced;
+  /* The frame was published with lba_picture_set () */
+  gint64 published;
+
+  LbaPictureDamage damage;
+} LbaPictureFrameInfo;
+
+/* Same, with the distance in bytes between the lines (0 means the lines are
+ * packed) and the description of the frame. */
+gpointer
+lba_picture_get_full (GObject * obj, gchar fmt[16], guint * w, guint * h,
+                      guint * stride, LbaPictureFrameInfo * info);
+void
+
+
+lba_picture_set_full (GObject * obj, const gchar fmt[16], guint w, guint h,
+                      guint stride, gpointer data);
+
+/* When the next frame was produced, if earlier than lba_picture_set () */
+void lba_picture_set_produced (GObject * obj, gint64 ts);
+
+/* What the next frame changes. If never called, the whole picture. */
+void
+lba_picture_set_damage (GObject * obj, const LbaPictureRect * rects, guint n_rects);
+
+/* The current frame in @format, converting it if needed. Each conversion is
+ * done once per frame and shared between all the callers. Only for the
+ * GBytes data. */
+GBytes *lba_picture_get_converted (GObject * obj, LbaPixelFormat format,
+                                   guint * w, guint * h, guint * stride,
+                                   LbaPictureFrameInfo * info);
+
+/* Adds @src to @dst. Too many rectangles become the whole picture. */
+void
+lba_picture_damage_union (LbaPictureDamage * dst, const LbaPictureDamage * src);
+
 #endif
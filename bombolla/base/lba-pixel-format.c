@@ -0,0 +1,719 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lba-pixel-format.h"
+#include <string.h>
+
+#if defined (__SSE2__)
+#  include <emmintrin.h>
+#  if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#    include <immintrin.h>
+#    define LBA_PIXEL_FORMAT_AVX2 1
+#  endif
+#elif defined (__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+static const struct {
+  const gchar *name;
+  /* Byte of each channel in a packed pixel */
+  gint r;
+  gint g;
+  gint b;
+  gint a;
+  gboolean premultiplied;
+  gboolean planar;
+} formats[LBA_PIXEL_FORMAT_LAST] = {
+  [LBA_PIXEL_FORMAT_UNKNOWN] = { NULL },
+  [LBA_PIXEL_FORMAT_ARGB8888] = { "argb8888", 1, 2, 3, 0, FALSE, FALSE },
+  [LBA_PIXEL_FORMAT_RGBA8888] = { "rgba8888", 0, 1, 2, 3, FALSE, FALSE },
+  [LBA_PIXEL_FORMAT_BGRA8888] = { "bgra8888", 2, 1, 0, 3, FALSE, FALSE },
+  [LBA_PIXEL_FORMAT_ARGB8888_PRE] = { "argb8888_pre", 1, 2, 3, 0, TRUE, FALSE },
+  [LBA_PIXEL_FORMAT_RGBA8888_PRE] = { "rgba8888_pre", 0, 1, 2, 3, TRUE, FALSE },
+  [LBA_PIXEL_FORMAT_BGRA8888_PRE] = { "bgra8888_pre", 2, 1, 0, 3, TRUE, FALSE },
+  [LBA_PIXEL_FORMAT_I420] = { "i420", 0, 0, 0, 0, FALSE, TRUE },
+  [LBA_PIXEL_FORMAT_NV12] = { "nv12", 0, 0, 0, 0, FALSE, TRUE },
+};
+
+typedef enum {
+  SIMD_SCALAR,
+  SIMD_SSE2,
+  SIMD_AVX2,
+  SIMD_NEON
+} LbaPixelFormatSimd;
+
+static gint force_scalar;
+
+LbaPixelFormat
+lba_pixel_format_from_string (const gchar *str) {
+  guint i;
+
+  if (!str)
+    return LBA_PIXEL_FORMAT_UNKNOWN;
+
+  for (i = 1; i < LBA_PIXEL_FORMAT_LAST; i++)
+    if (!g_strcmp0 (formats[i].name, str))
+      return (LbaPixelFormat) i;
+
+  return LBA_PIXEL_FORMAT_UNKNOWN;
+}
+
+const gchar *
+lba_pixel_format_to_string (LbaPixelFormat format) {
+  g_return_val_if_fail (format < LBA_PIXEL_FORMAT_LAST, NULL);
+
+  return formats[format].name;
+}
+
+gboolean
+lba_pixel_format_is_planar (LbaPixelFormat format) {
+  g_return_val_if_fail (format < LBA_PIXEL_FORMAT_LAST, FALSE);
+
+  return formats[format].planar;
+}
+
+guint
+lba_pixel_format_default_stride (LbaPixelFormat format, guint w) {
+  g_return_val_if_fail (format < LBA_PIXEL_FORMAT_LAST, 0);
+
+  /* Even, so the chroma lines fit in the half of it */
+  return formats[format].planar ? (w + 1) & ~1 : w * 4;
+}
+
+gsize
+lba_pixel_format_frame_size (LbaPixelFormat format, guint w, guint h,
+                             guint stride) {
+  gsize luma;
+
+  g_return_val_if_fail (format < LBA_PIXEL_FORMAT_LAST, 0);
+
+  if (!stride)
+    stride = lba_pixel_format_default_stride (format, w);
+
+  luma = (gsize) stride * h;
+
+  switch (format) {
+  case LBA_PIXEL_FORMAT_I420:
+    return luma + 2 * (gsize) (stride / 2) * ((h + 1) / 2);
+  case LBA_PIXEL_FORMAT_NV12:
+    return luma + (gsize) stride * ((h + 1) / 2);
+  default:
+    return luma;
+  }
+}
+
+gboolean
+lba_pixel_format_can_convert (LbaPixelFormat from, LbaPixelFormat to) {
+  g_return_val_if_fail (from < LBA_PIXEL_FORMAT_LAST, FALSE);
+  g_return_val_if_fail (to < LBA_PIXEL_FORMAT_LAST, FALSE);
+
+  if (from == LBA_PIXEL_FORMAT_UNKNOWN || to == LBA_PIXEL_FORMAT_UNKNOWN)
+    return FALSE;
+
+  return from == to || !formats[to].planar;
+}
+
+void
+lba_pixel_format_force_scalar (gboolean force) {
+  g_atomic_int_set (&force_scalar, force);
+}
+
+static LbaPixelFormatSimd
+lba_pixel_format_simd (void) {
+  if (g_atomic_int_get (&force_scalar))
+    return SIMD_SCALAR;
+
+#if defined (LBA_PIXEL_FORMAT_AVX2)
+  {
+    static gint have_avx2 = -1;
+
+    if (G_UNLIKELY (have_avx2 < 0)) {
+      __builtin_cpu_init ();
+      have_avx2 = __builtin_cpu_supports ("avx2");
+    }
+
+    return have_avx2 ? SIMD_AVX2 : SIMD_SSE2;
+  }
+#elif defined (__SSE2__)
+  return SIMD_SSE2;
+#elif defined (__ARM_NEON)
+  return SIMD_NEON;
+#else
+  return SIMD_SCALAR;
+#endif
+}
+
+const gchar *
+lba_pixel_format_get_simd (void) {
+  switch (lba_pixel_format_simd ()) {
+  case SIMD_AVX2:
+    return "avx2";
+  case SIMD_SSE2:
+    return "sse2";
+  case SIMD_NEON:
+    return "neon";
+  default:
+    return "scalar";
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+/* Byte shuffles between the packed formats: dst[i] = src[perm[i]].
+ * @src and @dst may be the same. */
+
+static void
+lba_shuffle_scalar (const guint8 *src, guint8 *dst, guint n, const guint8 perm[4]) {
+  guint i;
+
+  for (i = 0; i < n; i++, src += 4, dst += 4) {
+    guint8 p0 = src[perm[0]],
+      p1 = src[perm[1]],
+      p2 = src[perm[2]],
+      p3 = src[perm[3]];
+
+    dst[0] = p0;
+    dst[1] = p1;
+    dst[2] = p2;
+    dst[3] = p3;
+  }
+}
+
+#if defined (__SSE2__)
+/* Moves each byte of the 32 bit pixels with shifts and masks */
+static void
+lba_shuffle_sse2 (const guint8 *src, guint8 *dst, guint n, const guint8 perm[4]) {
+  const __m128i byte = _mm_set1_epi32 (0xff);
+  __m128i from[4],
+    to[4];
+  guint i,
+    c;
+
+  for (c = 0; c < 4; c++) {
+    from[c] = _mm_cvtsi32_si128 (8 * perm[c]);
+    to[c] = _mm_cvtsi32_si128 (8 * c);
+  }
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+    __m128i out = _mm_setzero_si128 ();
+
+    for (c = 0; c < 4; c++) {
+      __m128i b = _mm_and_si128 (_mm_srl_epi32 (v, from[c]), byte);
+
+      out = _mm_or_si128 (out, _mm_sll_epi32 (b, to[c]));
+    }
+
+    _mm_storeu_si128 ((__m128i *) (dst + 4 * i), out);
+  }
+
+  lba_shuffle_scalar (src + 4 * i, dst + 4 * i, n - i, perm);
+}
+#endif
+
+#if defined (LBA_PIXEL_FORMAT_AVX2)
+__attribute__((target ("avx2")))
+static void
+lba_shuffle_avx2 (const guint8 *src, guint8 *dst, guint n, const guint8 perm[4]) {
+  guint8 m[32];
+  __m256i mask;
+  guint i;
+
+  /* pshufb works inside of each 128 bit lane */
+  for (i = 0; i < 32; i++)
+    m[i] = 4 * ((i / 4) % 4) + perm[i % 4];
+  mask = _mm256_loadu_si256 ((const __m256i *) m);
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256 ((const __m256i *) (src + 4 * i));
+
+    _mm256_storeu_si256 ((__m256i *) (dst + 4 * i), _mm256_shuffle_epi8 (v, mask));
+  }
+
+  lba_shuffle_scalar (src + 4 * i, dst + 4 * i, n - i, perm);
+}
+#endif
+
+#if defined (__ARM_NEON)
+static void
+lba_shuffle_neon (const guint8 *src, guint8 *dst, guint n, const guint8 perm[4]) {
+  guint i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    uint8x16x4_t in = vld4q_u8 (src + 4 * i),
+        out;
+
+    out.val[0] = in.val[perm[0]];
+    out.val[1] = in.val[perm[1]];
+    out.val[2] = in.val[perm[2]];
+    out.val[3] = in.val[perm[3]];
+    vst4q_u8 (dst + 4 * i, out);
+  }
+
+  lba_shuffle_scalar (src + 4 * i, dst + 4 * i, n - i, perm);
+}
+#endif
+
+static void
+lba_shuffle (LbaPixelFormatSimd simd, const guint8 *src, guint8 *dst, guint n,
+             const guint8 perm[4]) {
+  switch (simd) {
+#if defined (LBA_PIXEL_FORMAT_AVX2)
+  case SIMD_AVX2:
+    lba_shuffle_avx2 (src, dst, n, perm);
+    return;
+#endif
+#if defined (__SSE2__)
+  case SIMD_SSE2:
+    lba_shuffle_sse2 (src, dst, n, perm);
+    return;
+#endif
+#if defined (__ARM_NEON)
+  case SIMD_NEON:
+    lba_shuffle_neon (src, dst, n, perm);
+    return;
+#endif
+  default:
+    lba_shuffle_scalar (src, dst, n, perm);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+/* Premultiplication, in place. @a is the byte of alpha: 0 or 3. */
+
+/* c * a / 255, rounded */
+#define LBA_MUL_DIV_255(c, a) \
+  ((((c) * (a) + 128) + (((c) * (a) + 128) >> 8)) >> 8)
+
+static void
+lba_premultiply_scalar (guint8 *p, guint n, guint a) {
+  guint i,
+    c;
+
+  for (i = 0; i < n; i++, p += 4) {
+    guint alpha = p[a];
+
+    for (c = 0; c < 4; c++)
+      if (c != a)
+        p[c] = LBA_MUL_DIV_255 (p[c], alpha);
+  }
+}
+
+#if defined (__SSE2__)
+static void
+lba_premultiply_sse2 (guint8 *p, guint n, guint a) {
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i half = _mm_set1_epi16 (128);
+  /* Alpha itself is kept as it is */
+  const __m128i amask = a == 0 ?
+      _mm_set_epi16 (0, 0, 0, -1, 0, 0, 0, -1) :
+      _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+  guint i,
+    k;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) (p + 4 * i));
+    __m128i w[2];
+
+    w[0] = _mm_unpacklo_epi8 (v, zero);
+    w[1] = _mm_unpackhi_epi8 (v, zero);
+
+    for (k = 0; k < 2; k++) {
+      __m128i alpha,
+        m;
+
+      /* The shuffles need immediates */
+      if (a == 0) {
+        alpha = _mm_shufflelo_epi16 (w[k], _MM_SHUFFLE (0, 0, 0, 0));
+        alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (0, 0, 0, 0));
+      } else {
+        alpha = _mm_shufflelo_epi16 (w[k], _MM_SHUFFLE (3, 3, 3, 3));
+        alpha = _mm_shufflehi_epi16 (alpha, _MM_SHUFFLE (3, 3, 3, 3));
+      }
+
+      m = _mm_add_epi16 (_mm_mullo_epi16 (w[k], alpha), half);
+      m = _mm_srli_epi16 (_mm_add_epi16 (m, _mm_srli_epi16 (m, 8)), 8);
+      w[k] = _mm_or_si128 (_mm_andnot_si128 (amask, m), _mm_and_si128 (amask, w[k]));
+    }
+
+    _mm_storeu_si128 ((__m128i *) (p + 4 * i), _mm_packus_epi16 (w[0], w[1]));
+  }
+
+  lba_premultiply_scalar (p + 4 * i, n - i, a);
+}
+#endif
+
+#if defined (__ARM_NEON)
+static inline uint8x16_t
+lba_mul_div_255_neon (uint8x16_t c, uint8x16_t a) {
+  uint16x8_t lo = vmull_u8 (vget_low_u8 (c), vget_low_u8 (a)),
+      hi = vmull_u8 (vget_high_u8 (c), vget_high_u8 (a));
+
+  return vcombine_u8 (vrshrn_n_u16 (vaddq_u16 (lo, vrshrq_n_u16 (lo, 8)), 8),
+                      vrshrn_n_u16 (vaddq_u16 (hi, vrshrq_n_u16 (hi, 8)), 8));
+}
+
+static void
+lba_premultiply_neon (guint8 *p, guint n, guint a) {
+  guint i,
+    c;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    uint8x16x4_t v = vld4q_u8 (p + 4 * i);
+
+    for (c = 0; c < 4; c++)
+      if (c != a)
+        v.val[c] = lba_mul_div_255_neon (v.val[c], v.val[a]);
+
+    vst4q_u8 (p + 4 * i, v);
+  }
+
+  lba_premultiply_scalar (p + 4 * i, n - i, a);
+}
+#endif
+
+static void
+lba_premultiply (LbaPixelFormatSimd simd, guint8 *p, guint n, guint a) {
+  switch (simd) {
+#if defined (__SSE2__)
+  case SIMD_AVX2:
+  case SIMD_SSE2:
+    lba_premultiply_sse2 (p, n, a);
+    return;
+#endif
+#if defined (__ARM_NEON)
+  case SIMD_NEON:
+    lba_premultiply_neon (p, n, a);
+    return;
+#endif
+  default:
+    lba_premultiply_scalar (p, n, a);
+  }
+}
+
+/* Unpremultiplication needs a division, so it goes through a table of
+ * reciprocals. There's no vector kernel for it. */
+static void
+lba_unpremultiply (guint8 *p, guint n, guint a) {
+  static guint32 recip[256];
+  static gsize inited = 0;
+  guint i,
+    c;
+
+  if (g_once_init_enter (&inited)) {
+    recip[0] = 0;
+    for (i = 1; i < 256; i++)
+      recip[i] = (255 * 65536 + i / 2) / i;
+
+    g_once_init_leave (&inited, 1);
+  }
+
+  for (i = 0; i < n; i++, p += 4) {
+    guint32 r = recip[p[a]];
+
+    for (c = 0; c < 4; c++)
+      if (c != a)
+        p[c] = MIN ((p[c] * r + 32768) >> 16, 255);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+/* BT.601 limited range YUV to RGBA8888. The coefficients are scaled by 64,
+ * so the vector kernels can stay in 16 bits and give the same result. */
+
+static inline guint8
+lba_clamp_255 (gint v) {
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static void
+lba_yuv_row_scalar (const guint8 *y, const guint8 *u, const guint8 *v,
+                    guint uv_step, guint8 *dst, guint x, guint w) {
+  for (; x < w; x++, dst += 4) {
+    gint c = 75 * (y[x] - 16),
+      d = u[(x / 2) * uv_step] - 128,
+      e = v[(x / 2) * uv_step] - 128;
+
+    dst[0] = lba_clamp_255 ((c + 102 * e + 32) >> 6);
+    dst[1] = lba_clamp_255 ((c - 25 * d - 52 * e + 32) >> 6);
+    dst[2] = lba_clamp_255 ((c + 129 * d + 32) >> 6);
+    dst[3] = 255;
+  }
+}
+
+#if defined (__SSE2__)
+/* 8 pixels, with 8 chroma values (each one twice) in 16 bit lanes */
+static inline void
+lba_yuv8_sse2 (const guint8 *y, __m128i u, __m128i v, guint8 *dst) {
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i round = _mm_set1_epi16 (32);
+  __m128i yy = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) y), zero);
+  __m128i c = _mm_mullo_epi16 (_mm_sub_epi16 (yy, _mm_set1_epi16 (16)),
+                               _mm_set1_epi16 (75));
+  __m128i d = _mm_sub_epi16 (u, _mm_set1_epi16 (128));
+  __m128i e = _mm_sub_epi16 (v, _mm_set1_epi16 (128));
+  __m128i r,
+    g,
+    b,
+    rg,
+    ba;
+
+  r = _mm_adds_epi16 (c, _mm_mullo_epi16 (e, _mm_set1_epi16 (102)));
+  g = _mm_subs_epi16 (c, _mm_mullo_epi16 (d, _mm_set1_epi16 (25)));
+  g = _mm_subs_epi16 (g, _mm_mullo_epi16 (e, _mm_set1_epi16 (52)));
+  b = _mm_adds_epi16 (c, _mm_mullo_epi16 (d, _mm_set1_epi16 (129)));
+
+  r = _mm_srai_epi16 (_mm_adds_epi16 (r, round), 6);
+  g = _mm_srai_epi16 (_mm_adds_epi16 (g, round), 6);
+  b = _mm_srai_epi16 (_mm_adds_epi16 (b, round), 6);
+
+  rg = _mm_unpacklo_epi8 (_mm_packus_epi16 (r, r), _mm_packus_epi16 (g, g));
+  ba = _mm_unpacklo_epi8 (_mm_packus_epi16 (b, b), _mm_set1_epi8 (-1));
+
+  _mm_storeu_si128 ((__m128i *) dst, _mm_unpacklo_epi16 (rg, ba));
+  _mm_storeu_si128 ((__m128i *) (dst + 16), _mm_unpackhi_epi16 (rg, ba));
+}
+
+static void
+lba_yuv_row_sse2 (const guint8 *y, const guint8 *u, const guint8 *v,
+                  guint uv_step, guint8 *dst, guint w) {
+  const __m128i zero = _mm_setzero_si128 ();
+  guint x;
+
+  for (x = 0; x + 8 <= w; x += 8) {
+    __m128i uu,
+      vv;
+
+    if (uv_step == 1) {
+      gint32 u4,
+        v4;
+
+      memcpy (&u4, u + x / 2, 4);
+      memcpy (&v4, v + x / 2, 4);
+      uu = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (u4), zero);
+      vv = _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (v4), zero);
+    } else {
+      /* Interleaved: u is the even bytes, v the odd ones */
+      __m128i uv = _mm_loadl_epi64 ((const __m128i *) (u + x));
+
+      uv = _mm_unpacklo_epi8 (uv, zero);
+      uu = _mm_and_si128 (uv, _mm_set1_epi32 (0x0000ffff));
+      vv = _mm_srli_epi32 (uv, 16);
+      uu = _mm_packs_epi32 (uu, zero);
+      vv = _mm_packs_epi32 (vv, zero);
+    }
+
+    /* Each chroma value covers two pixels */
+    uu = _mm_unpacklo_epi16 (uu, uu);
+    vv = _mm_unpacklo_epi16 (vv, vv);
+
+    lba_yuv8_sse2 (y + x, uu, vv, dst + 4 * x);
+  }
+
+  lba_yuv_row_scalar (y, u, v, uv_step, dst + 4 * x, x, w);
+}
+#endif
+
+#if defined (__ARM_NEON)
+static inline void
+lba_yuv8_neon (uint8x8_t y, uint8x8_t u, uint8x8_t v, guint8 *dst) {
+  int16x8_t c = vmulq_n_s16 (vsubq_s16 (vreinterpretq_s16_u16 (vmovl_u8 (y)),
+                                        vdupq_n_s16 (16)), 75);
+  int16x8_t d = vsubq_s16 (vreinterpretq_s16_u16 (vmovl_u8 (u)), vdupq_n_s16 (128));
+  int16x8_t e = vsubq_s16 (vreinterpretq_s16_u16 (vmovl_u8 (v)), vdupq_n_s16 (128));
+  int16x8_t round = vdupq_n_s16 (32);
+  int16x8_t r,
+    g,
+    b;
+  uint8x8x4_t out;
+
+  r = vqaddq_s16 (c, vmulq_n_s16 (e, 102));
+  g = vqsubq_s16 (c, vmulq_n_s16 (d, 25));
+  g = vqsubq_s16 (g, vmulq_n_s16 (e, 52));
+  b = vqaddq_s16 (c, vmulq_n_s16 (d, 129));
+
+  out.val[0] = vqmovun_s16 (vshrq_n_s16 (vqaddq_s16 (r, round), 6));
+  out.val[1] = vqmovun_s16 (vshrq_n_s16 (vqaddq_s16 (g, round), 6));
+  out.val[2] = vqmovun_s16 (vshrq_n_s16 (vqaddq_s16 (b, round), 6));
+  out.val[3] = vdup_n_u8 (255);
+
+  vst4_u8 (dst, out);
+}
+
+static void
+lba_yuv_row_neon (const guint8 *y, const guint8 *u, const guint8 *v,
+                  guint uv_step, guint8 *dst, guint w) {
+  guint x;
+
+  for (x = 0; x + 16 <= w; x += 16) {
+    uint8x8x2_t uu,
+      vv;
+
+    if (uv_step == 1) {
+      uint8x8_t u8 = vld1_u8 (u + x / 2),
+          v8 = vld1_u8 (v + x / 2);
+
+      uu = vzip_u8 (u8, u8);
+      vv = vzip_u8 (v8, v8);
+    } else {
+      uint8x8x2_t uv = vld2_u8 (u + x);
+
+      uu = vzip_u8 (uv.val[0], uv.val[0]);
+      vv = vzip_u8 (uv.val[1], uv.val[1]);
+    }
+
+    lba_yuv8_neon (vld1_u8 (y + x), uu.val[0], vv.val[0], dst + 4 * x);
+    lba_yuv8_neon (vld1_u8 (y + x + 8), uu.val[1], vv.val[1], dst + 4 * x + 32);
+  }
+
+  lba_yuv_row_scalar (y, u, v, uv_step, dst + 4 * x, x, w);
+}
+#endif
+
+static void
+lba_yuv_row (LbaPixelFormatSimd simd, const guint8 *y, const guint8 *u,
+             const guint8 *v, guint uv_step, guint8 *dst, guint w) {
+  switch (simd) {
+#if defined (__SSE2__)
+  case SIMD_AVX2:
+  case SIMD_SSE2:
+    lba_yuv_row_sse2 (y, u, v, uv_step, dst, w);
+    return;
+#endif
+#if defined (__ARM_NEON)
+  case SIMD_NEON:
+    lba_yuv_row_neon (y, u, v, uv_step, dst, w);
+    return;
+#endif
+  default:
+    lba_yuv_row_scalar (y, u, v, uv_step, dst, 0, w);
+  }
+}
+
+/* ---------------------------------------------------------------------- */
+
+/* Where each byte of @to comes from in @from */
+static gboolean
+lba_pixel_format_perm (LbaPixelFormat from, LbaPixelFormat to, guint8 perm[4]) {
+  perm[formats[to].r] = formats[from].r;
+  perm[formats[to].g] = formats[from].g;
+  perm[formats[to].b] = formats[from].b;
+  perm[formats[to].a] = formats[from].a;
+
+  return perm[0] != 0 || perm[1] != 1 || perm[2] != 2 || perm[3] != 3;
+}
+
+gboolean
+lba_pixel_format_convert (LbaPixelFormat from, const guint8 *src,
+                          guint src_stride, LbaPixelFormat to, guint8 *dst,
+                          guint dst_stride, guint w, guint h) {
+  LbaPixelFormatSimd simd = lba_pixel_format_simd ();
+  gboolean premultiply,
+    unpremultiply,
+    shuffle;
+  guint8 perm[4];
+  guint row;
+
+  g_return_val_if_fail (src != NULL, FALSE);
+  g_return_val_if_fail (dst != NULL, FALSE);
+
+  if (!lba_pixel_format_can_convert (from, to))
+    return FALSE;
+
+  if (!src_stride)
+    src_stride = lba_pixel_format_default_stride (from, w);
+  if (!dst_stride)
+    dst_stride = lba_pixel_format_default_stride (to, w);
+
+  if (from == to) {
+    gsize size = lba_pixel_format_frame_size (from, w, h, src_stride);
+
+    if (src_stride == dst_stride) {
+      memcpy (dst, src, size);
+    } else {
+      g_return_val_if_fail (!formats[from].planar, FALSE);
+
+      for (row = 0; row < h; row++)
+        memcpy (dst + row * dst_stride, src + row * src_stride, 4 * w);
+    }
+    return TRUE;
+  }
+
+  if (formats[from].planar) {
+    const guint8 *u,
+     *v;
+    guint uv_stride,
+      uv_step;
+
+    if (from == LBA_PIXEL_FORMAT_I420) {
+      uv_stride = src_stride / 2;
+      uv_step = 1;
+      u = src + src_stride * h;
+      v = u + uv_stride * ((h + 1) / 2);
+    } else {
+      uv_stride = src_stride;
+      uv_step = 2;
+      u = src + src_stride * h;
+      v = u + 1;
+    }
+
+    shuffle = lba_pixel_format_perm (LBA_PIXEL_FORMAT_RGBA8888, to, perm);
+
+    for (row = 0; row < h; row++) {
+      guint8 *line = dst + row * dst_stride;
+
+      lba_yuv_row (simd, src + row * src_stride, u + (row / 2) * uv_stride,
+                   v + (row / 2) * uv_stride, uv_step, line, w);
+      /* Opaque, so premultiplied or not, it's the same */
+      if (shuffle)
+        lba_shuffle (simd, line, line, w, perm);
+    }
+
+    return TRUE;
+  }
+
+  shuffle = lba_pixel_format_perm (from, to, perm);
+  premultiply = !formats[from].premultiplied && formats[to].premultiplied;
+  unpremultiply = formats[from].premultiplied && !formats[to].premultiplied;
+
+  for (row = 0; row < h; row++) {
+    const guint8 *in = src + row * src_stride;
+    guint8 *line = dst + row * dst_stride;
+
+    if (shuffle)
+      lba_shuffle (simd, in, line, w, perm);
+    else
+      memcpy (line, in, 4 * w);
+
+    /* The line is in the cache now */
+    if (premultiply)
+      lba_premultiply (simd, line, w, formats[to].a);
+    else if (unpremultiply)
+      lba_unpremultiply (line, w, formats[to].a);
+  }
+
+  return TRUE;
+}
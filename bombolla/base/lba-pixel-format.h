@@ -0,0 +1,78 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LBA_PIXEL_FORMAT
+#  define _LBA_PIXEL_FORMAT
+#  include <glib.h>
+
+/* The pixel formats LbaPicture may carry.
+ * The packed formats are named after the order of the bytes in memory,
+ * "_pre" ones have the color premultiplied by alpha. Cairo's ARGB32 is
+ * "bgra8888_pre" on little endian machines.
+ * The planar ones are 8 bit 4:2:0 with the chroma planes right after the
+ * luma plane. Their stride is the one of the luma plane, the chroma stride
+ * is half of it for I420 and the same for NV12. */
+typedef enum {
+  LBA_PIXEL_FORMAT_UNKNOWN,
+  LBA_PIXEL_FORMAT_ARGB8888,
+  LBA_PIXEL_FORMAT_RGBA8888,
+  LBA_PIXEL_FORMAT_BGRA8888,
+  LBA_PIXEL_FORMAT_ARGB8888_PRE,
+  LBA_PIXEL_FORMAT_RGBA8888_PRE,
+  LBA_PIXEL_FORMAT_BGRA8888_PRE,
+  LBA_PIXEL_FORMAT_I420,
+  LBA_PIXEL_FORMAT_NV12,
+  LBA_PIXEL_FORMAT_LAST
+} LbaPixelFormat;
+
+LbaPixelFormat lba_pixel_format_from_string (const gchar * str);
+const gchar *lba_pixel_format_to_string (LbaPixelFormat format);
+
+gboolean lba_pixel_format_is_planar (LbaPixelFormat format);
+
+/* Stride of the packed lines, or of the luma plane */
+guint lba_pixel_format_default_stride (LbaPixelFormat format, guint w);
+/* Bytes needed for the whole frame */
+gsize lba_pixel_format_frame_size (LbaPixelFormat format, guint w, guint h,
+                                   guint stride);
+
+gboolean lba_pixel_format_can_convert (LbaPixelFormat from, LbaPixelFormat to);
+
+/* Converts a frame. The planar formats can only be converted from.
+ * Returns FALSE if the conversion is not supported. */
+gboolean
+lba_pixel_format_convert (LbaPixelFormat from, const guint8 * src,
+                          guint src_stride, LbaPixelFormat to, guint8 * dst,
+                          guint dst_stride, guint w, guint h);
+
+/* Which kernels are used: "avx2", "sse2", "neon" or "scalar" */
+const gchar *lba_pixel_format_get_simd (void);
+
+/* For the tests: never use the vector kernels */
+void lba_pixel_format_force_scalar (gboolean force);
+
+#endif
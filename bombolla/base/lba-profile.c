@@ -0,0 +1,374 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lba-profile.h"
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  guint64 count;
+  guint64 total;
+  guint64 max;
+} LbaProfileEntry;
+
+typedef struct _LbaProfileThread {
+  /* Taken by the thread when it adds, and by the readers,
+   * so it's almost never contended */
+  GMutex lock;
+  /* LbaProfileEntry by name */
+  GHashTable *entries[LBA_PROFILE_N_KINDS];
+  /* The thread is gone, another one can take the table */
+  gint free;
+  struct _LbaProfileThread *next;
+} LbaProfileThread;
+
+static gint lba_profile_enabled_flag;
+
+/* Protects the list of the threads */
+static GMutex lba_profile_lock;
+static LbaProfileThread *lba_profile_threads;
+static __thread LbaProfileThread *lba_profile_thread;
+
+static void lba_profile_thread_release (gpointer data);
+static GPrivate lba_profile_thread_key =
+G_PRIVATE_INIT (lba_profile_thread_release);
+
+static void
+lba_profile_init_once (void) {
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited)) {
+    const gchar *env = g_getenv ("LBA_PROFILE");
+
+    g_atomic_int_set (&lba_profile_enabled_flag, !env || g_strcmp0 (env, "0"));
+    g_once_init_leave (&inited, 1);
+  }
+}
+
+void
+lba_profile_set_enabled (gboolean enabled) {
+  lba_profile_init_once ();
+  g_atomic_int_set (&lba_profile_enabled_flag, ! !enabled);
+}
+
+gboolean
+lba_profile_enabled (void) {
+  lba_profile_init_once ();
+  return g_atomic_int_get (&lba_profile_enabled_flag);
+}
+
+gint64
+lba_profile_now (void) {
+  struct timespec ts;
+
+  if (G_UNLIKELY (!lba_profile_enabled ()))
+    return 0;
+
+  /* Served from the vDSO, it's just a read of the TSC on x86 */
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static void
+lba_profile_thread_release (gpointer data) {
+  LbaProfileThread *thr = (LbaProfileThread *) data;
+
+  /* The entries stay, so they are still counted */
+  g_atomic_int_set (&thr->free, TRUE);
+}
+
+static LbaProfileThread *
+lba_profile_thread_get (void) {
+  LbaProfileThread *thr;
+  guint k;
+
+  g_mutex_lock (&lba_profile_lock);
+  for (thr = lba_profile_threads; thr; thr = thr->next) {
+    if (g_atomic_int_get (&thr->free))
+      break;
+  }
+
+  if (!thr) {
+    thr = g_new0 (LbaProfileThread, 1);
+    g_mutex_init (&thr->lock);
+    for (k = 0; k < LBA_PROFILE_N_KINDS; k++)
+      thr->entries[k] = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                               g_free, g_free);
+    thr->next = lba_profile_threads;
+    lba_profile_threads = thr;
+  }
+
+  thr->free = FALSE;
+  g_mutex_unlock (&lba_profile_lock);
+
+  g_private_set (&lba_profile_thread_key, thr);
+  lba_profile_thread = thr;
+  return thr;
+}
+
+void
+lba_profile_add (LbaProfileKind kind, const gchar *name, gint64 start,
+                 gint64 end) {
+  LbaProfileThread *thr = lba_profile_thread;
+  LbaProfileEntry *entry;
+  guint64 took;
+
+  if (!start || !end)
+    return;
+
+  g_return_if_fail (kind < LBA_PROFILE_N_KINDS);
+  g_return_if_fail (name != NULL);
+
+  if (G_UNLIKELY (thr == NULL))
+    thr = lba_profile_thread_get ();
+
+  took = end > start ? end - start : 0;
+
+  g_mutex_lock (&thr->lock);
+  entry = g_hash_table_lookup (thr->entries[kind], name);
+  if (G_UNLIKELY (entry == NULL)) {
+    entry = g_new0 (LbaProfileEntry, 1);
+    g_hash_table_insert (thr->entries[kind], g_strdup (name), entry);
+  }
+
+  entry->count++;
+  entry->total += took;
+  entry->max = MAX (entry->max, took);
+  g_mutex_unlock (&thr->lock);
+}
+
+static void
+lba_profile_stat_clear (gpointer data) {
+  LbaProfileStat *stat = (LbaProfileStat *) data;
+
+  g_free (stat->name);
+}
+
+static gint
+lba_profile_stat_cmp (gconstpointer a, gconstpointer b) {
+  const LbaProfileStat *sa = (const LbaProfileStat *) a;
+  const LbaProfileStat *sb = (const LbaProfileStat *) b;
+
+  if (sa->kind != sb->kind)
+    return sa->kind < sb->kind ? -1 : 1;
+
+  if (sa->total != sb->total)
+    return sa->total > sb->total ? -1 : 1;
+
+  return strcmp (sa->name, sb->name);
+}
+
+GArray *
+lba_profile_collect (void) {
+  GHashTable *merged[LBA_PROFILE_N_KINDS];
+  LbaProfileThread *thr;
+  GHashTableIter iter;
+  gpointer key,
+    value;
+  GArray *ret;
+  guint k;
+
+  ret = g_array_new (FALSE, FALSE, sizeof (LbaProfileStat));
+  g_array_set_clear_func (ret, lba_profile_stat_clear);
+
+  /* The names are borrowed from the tables of the threads. Only reset
+   * frees them, and it takes the same lock. */
+  for (k = 0; k < LBA_PROFILE_N_KINDS; k++)
+    merged[k] = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+
+  g_mutex_lock (&lba_profile_lock);
+  for (thr = lba_profile_threads; thr; thr = thr->next) {
+    g_mutex_lock (&thr->lock);
+    for (k = 0; k < LBA_PROFILE_N_KINDS; k++) {
+      g_hash_table_iter_init (&iter, thr->entries[k]);
+      while (g_hash_table_iter_next (&iter, &key, &value)) {
+        LbaProfileEntry *entry = (LbaProfileEntry *) value;
+        LbaProfileEntry *sum = g_hash_table_lookup (merged[k], key);
+
+        if (!sum) {
+          sum = g_new0 (LbaProfileEntry, 1);
+          g_hash_table_insert (merged[k], key, sum);
+        }
+
+        sum->count += entry->count;
+        sum->total += entry->total;
+        sum->max = MAX (sum->max, entry->max);
+      }
+    }
+    g_mutex_unlock (&thr->lock);
+  }
+
+  for (k = 0; k < LBA_PROFILE_N_KINDS; k++) {
+    g_hash_table_iter_init (&iter, merged[k]);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      LbaProfileEntry *sum = (LbaProfileEntry *) value;
+      LbaProfileStat stat = {
+        .kind = k,
+        .name = g_strdup (key),
+        .count = sum->count,
+        .total = sum->total,
+        .max = sum->max
+      };
+
+      g_array_append_val (ret, stat);
+    }
+    g_hash_table_unref (merged[k]);
+  }
+  g_mutex_unlock (&lba_profile_lock);
+
+  g_array_sort (ret, lba_profile_stat_cmp);
+  return ret;
+}
+
+void
+lba_profile_reset (void) {
+  LbaProfileThread *thr;
+  guint k;
+
+  g_mutex_lock (&lba_profile_lock);
+  for (thr = lba_profile_threads; thr; thr = thr->next) {
+    g_mutex_lock (&thr->lock);
+    for (k = 0; k < LBA_PROFILE_N_KINDS; k++)
+      g_hash_table_remove_all (thr->entries[k]);
+    g_mutex_unlock (&thr->lock);
+  }
+  g_mutex_unlock (&lba_profile_lock);
+}
+
+const gchar *
+lba_profile_kind_name (LbaProfileKind kind) {
+  static const gchar *names[] = { "command", "signal", "object", "on" };
+
+  g_return_val_if_fail (kind < LBA_PROFILE_N_KINDS, NULL);
+
+  return names[kind];
+}
+
+static void
+lba_profile_append_json_string (GString *out, const gchar *str) {
+  g_string_append_c (out, '"');
+  for (; *str; str++) {
+    switch (*str) {
+    case '"':
+    case '\\':
+      g_string_append_c (out, '\\');
+      g_string_append_c (out, *str);
+      break;
+    case '\n':
+      g_string_append (out, "\\n");
+      break;
+    case '\t':
+      g_string_append (out, "\\t");
+      break;
+    default:
+      if ((guchar) * str < 0x20)
+        g_string_append_printf (out, "\\u%04x", (guchar) * str);
+      else
+        g_string_append_c (out, *str);
+    }
+  }
+  g_string_append_c (out, '"');
+}
+
+static void
+lba_profile_append_csv_string (GString *out, const gchar *str) {
+  if (!strpbrk (str, ",\"\n")) {
+    g_string_append (out, str);
+    return;
+  }
+
+  g_string_append_c (out, '"');
+  for (; *str; str++) {
+    if (*str == '"')
+      g_string_append_c (out, '"');
+    g_string_append_c (out, *str);
+  }
+  g_string_append_c (out, '"');
+}
+
+/* TEXT is for the humans, in microseconds. The others are in nanoseconds:
+ * JSON - an array of {"kind", "name", "count", "total_ns", "max_ns"}
+ * CSV - the same columns, with a header line */
+gchar *
+lba_profile_to_string (LbaProfileFormat format) {
+  GArray *stats = lba_profile_collect ();
+  GString *out = g_string_new (NULL);
+  guint i;
+
+  switch (format) {
+  case LBA_PROFILE_FORMAT_TEXT:
+    g_string_append_printf (out, "%-8s %-40s %10s %12s %10s %10s\n", "kind",
+                            "name", "count", "total(us)", "avg(us)", "max(us)");
+    break;
+  case LBA_PROFILE_FORMAT_JSON:
+    g_string_append_c (out, '[');
+    break;
+  case LBA_PROFILE_FORMAT_CSV:
+    g_string_append (out, "kind,name,count,total_ns,max_ns\n");
+    break;
+  }
+
+  for (i = 0; i < stats->len; i++) {
+    LbaProfileStat *stat = &g_array_index (stats, LbaProfileStat, i);
+    const gchar *kind = lba_profile_kind_name (stat->kind);
+
+    switch (format) {
+    case LBA_PROFILE_FORMAT_TEXT:
+      g_string_append_printf (out,
+                              "%-8s %-40s %10" G_GUINT64_FORMAT
+                              " %12.1f %10.1f %10.1f\n", kind, stat->name,
+                              stat->count, stat->total / 1000.0,
+                              stat->total / 1000.0 / stat->count,
+                              stat->max / 1000.0);
+      break;
+    case LBA_PROFILE_FORMAT_JSON:
+      g_string_append_printf (out, "%s\n  {\"kind\": \"%s\", \"name\": ",
+                              i ? "," : "", kind);
+      lba_profile_append_json_string (out, stat->name);
+      g_string_append_printf (out,
+                              ", \"count\": %" G_GUINT64_FORMAT
+                              ", \"total_ns\": %" G_GUINT64_FORMAT
+                              ", \"max_ns\": %" G_GUINT64_FORMAT "}",
+                              stat->count, stat->total, stat->max);
+      break;
+    case LBA_PROFILE_FORMAT_CSV:
+      g_string_append_printf (out, "%s,", kind);
+      lba_profile_append_csv_string (out, stat->name);
+      g_string_append_printf (out,
+                              ",%" G_GUINT64_FORMAT ",%" G_GUINT64_FORMAT ",%"
+                              G_GUINT64_FORMAT "\n", stat->count, stat->total,
+                              stat->max);
+      break;
+    }
+  }
+
+  if (format == LBA_PROFILE_FORMAT_JSON)
+    g_string_append (out, stats->len ? "\n]\n" : "]\n");
+
+  g_array_unref (stats);
+  return g_string_free (out, FALSE);
+}
@@ -0,0 +1,84 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LBA_PROFILE
+#  define _LBA_PROFILE
+#  include <glib.h>
+
+/* Count, total and max time of the commands, signal emissions, objects
+ * and "on" handlers.
+ * It's cheap enough to be always on: every thread adds into its own table,
+ * and they are merged only when read. LBA_PROFILE=0 in the environment or
+ * (stats off) turn it off. */
+
+typedef enum {
+  /* Built-in and plugin commands, by name */
+  LBA_PROFILE_COMMAND,
+  /* (call obj.signal ...), by "obj.signal" */
+  LBA_PROFILE_SIGNAL,
+  /* Everything done on an object, by the name of the object */
+  LBA_PROFILE_OBJECT,
+  /* The handlers installed with (on ...), by "Type.signal: commands" */
+  LBA_PROFILE_ON,
+  LBA_PROFILE_N_KINDS
+} LbaProfileKind;
+
+typedef enum {
+  LBA_PROFILE_FORMAT_TEXT,
+  LBA_PROFILE_FORMAT_JSON,
+  LBA_PROFILE_FORMAT_CSV,
+} LbaProfileFormat;
+
+typedef struct {
+  LbaProfileKind kind;
+  gchar *name;
+  guint64 count;
+  /* In nanoseconds */
+  guint64 total;
+  guint64 max;
+} LbaProfileStat;
+
+void lba_profile_set_enabled (gboolean enabled);
+gboolean lba_profile_enabled (void);
+
+/* Monotonic, in nanoseconds. 0 if the profiler is disabled */
+gint64 lba_profile_now (void);
+
+/* Adds end - start to the entry. Ignored if start is 0, that is when the
+ * profiler was disabled. @name is copied only the first time it's seen. */
+void lba_profile_add (LbaProfileKind kind, const gchar * name, gint64 start,
+                      gint64 end);
+
+/* Merges the threads. Returns LbaProfileStat, sorted by kind, and then by
+ * the total time, the biggest first. */
+GArray *lba_profile_collect (void);
+void lba_profile_reset (void);
+
+const gchar *lba_profile_kind_name (LbaProfileKind kind);
+gchar *lba_profile_to_string (LbaProfileFormat format);
+
+#endif
@@ -0,0 +1,230 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "lba-stats.h"
+#include <string.h>
+
+gint lba_stats_enabled_flag;
+
+typedef struct {
+  guint buckets[LBA_STATS_N_BUCKETS];
+  guint count;
+} LbaHistogram;
+
+struct _LbaStats {
+  const gchar *const *stage_names;
+  guint n_stages;
+  LbaHistogram *stages;
+
+  /* fps is computed over windows of at least a second */
+  GMutex lock;
+  gint64 window_start;
+  guint window_frames;
+  gdouble fps;
+};
+
+static void
+lba_stats_init_once (void) {
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited)) {
+    const gchar *env = g_getenv ("LBA_STATS");
+
+    if (env && g_strcmp0 (env, "0"))
+      g_atomic_int_set (&lba_stats_enabled_flag, TRUE);
+
+    g_once_init_leave (&inited, 1);
+  }
+}
+
+void
+lba_stats_set_enabled (gboolean enabled) {
+  lba_stats_init_once ();
+  g_atomic_int_set (&lba_stats_enabled_flag, ! !enabled);
+}
+
+LbaStats *
+lba_stats_new (const gchar * const *stage_names) {
+  LbaStats *stats = g_new0 (LbaStats, 1);
+
+  lba_stats_init_once ();
+
+  stats->stage_names = stage_names;
+  stats->n_stages = stage_names ? g_strv_length ((gchar **) stage_names) : 0;
+  stats->stages = g_new0 (LbaHistogram, stats->n_stages);
+  g_mutex_init (&stats->lock);
+
+  return stats;
+}
+
+void
+lba_stats_free (LbaStats *stats) {
+  if (!stats)
+    return;
+
+  g_mutex_clear (&stats->lock);
+  g_free (stats->stages);
+  g_free (stats);
+}
+
+void
+lba_stats_reset (LbaStats *stats) {
+  guint i;
+
+  g_return_if_fail (stats != NULL);
+
+  g_mutex_lock (&stats->lock);
+  for (i = 0; i < stats->n_stages; i++)
+    memset (&stats->stages[i], 0, sizeof (LbaHistogram));
+
+  stats->window_start = 0;
+  stats->window_frames = 0;
+  stats->fps = 0;
+  g_mutex_unlock (&stats->lock);
+}
+
+/* Log-linear: exact below 4us, then 4 buckets per power of two */
+static guint
+lba_stats_bucket (gint64 us) {
+  guint octave;
+
+  if (us < 4)
+    return us < 0 ? 0 : (guint) us;
+
+  octave = g_bit_storage ((gulong) us) - 1;
+  return MIN (4 * (octave - 1) + ((us >> (octave - 2)) & 3),
+              LBA_STATS_N_BUCKETS - 1);
+}
+
+static gint64
+lba_stats_bucket_upper (guint bucket) {
+  guint octave;
+
+  if (bucket < 4)
+    return bucket;
+
+  octave = bucket / 4 + 1;
+  return ((gint64) (4 + (bucket & 3) + 1) << (octave - 2)) - 1;
+}
+
+void
+lba_stats_add (LbaStats *stats, guint stage, gint64 start, gint64 end) {
+  LbaHistogram *h;
+
+  if (!start || !end || !stats)
+    return;
+
+  g_return_if_fail (stage < stats->n_stages);
+
+  /* Streaming threads of different producers may be adding concurrently */
+  h = &stats->stages[stage];
+  g_atomic_int_inc (&h->buckets[lba_stats_bucket (end - start)]);
+  g_atomic_int_inc (&h->count);
+}
+
+void
+lba_stats_frame (LbaStats *stats, gint64 now) {
+  if (!now || !stats)
+    return;
+
+  g_mutex_lock (&stats->lock);
+  if (!stats->window_start)
+    stats->window_start = now;
+
+  stats->window_frames++;
+  if (now - stats->window_start >= G_USEC_PER_SEC) {
+    stats->fps = stats->window_frames * (gdouble) G_USEC_PER_SEC
+        / (now - stats->window_start);
+    stats->window_start = now;
+    stats->window_frames = 0;
+  }
+  g_mutex_unlock (&stats->lock);
+}
+
+gdouble
+lba_stats_get_fps (LbaStats *stats) {
+  gdouble ret;
+
+  g_return_val_if_fail (stats != NULL, 0);
+
+  g_mutex_lock (&stats->lock);
+  ret = stats->fps;
+  g_mutex_unlock (&stats->lock);
+
+  return ret;
+}
+
+gint64
+lba_stats_get_percentile (LbaStats *stats, guint stage, gdouble p) {
+  LbaHistogram *h;
+  guint64 rank,
+    seen = 0;
+  guint count,
+    i;
+
+  g_return_val_if_fail (stats != NULL, 0);
+  g_return_val_if_fail (stage < stats->n_stages, 0);
+
+  h = &stats->stages[stage];
+  count = g_atomic_int_get (&h->count);
+  if (!count)
+    return 0;
+
+  rank = (guint64) (count * CLAMP (p, 0, 100) / 100.0 + 0.5);
+  rank = MAX (rank, 1);
+
+  for (i = 0; i < LBA_STATS_N_BUCKETS; i++) {
+    seen += g_atomic_int_get (&h->buckets[i]);
+    if (seen >= rank)
+      return lba_stats_bucket_upper (i);
+  }
+
+  return lba_stats_bucket_upper (LBA_STATS_N_BUCKETS - 1);
+}
+
+gchar *
+lba_stats_to_string (LbaStats *stats) {
+  GString *str;
+  guint i;
+
+  g_return_val_if_fail (stats != NULL, NULL);
+
+  str = g_string_new (NULL);
+  g_string_append_printf (str, "fps %.1f", lba_stats_get_fps (stats));
+
+  for (i = 0; i < stats->n_stages; i++) {
+    g_string_append_printf (str, ", %s p50 %" G_GINT64_FORMAT
+                            "us p95 %" G_GINT64_FORMAT
+                            "us p99 %" G_GINT64_FORMAT "us",
+                            stats->stage_names[i],
+                            lba_stats_get_percentile (stats, i, 50),
+                            lba_stats_get_percentile (stats, i, 95),
+                            lba_stats_get_percentile (stats, i, 99));
+  }
+
+  return g_string_free (str, FALSE);
+}
@@ -0,0 +1,74 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _LBA_STATS
+#  define _LBA_STATS
+#  include <glib.h>
+
+/* Latency and throughput counters of the video path.
+ * Everything is a no-op until enabled with LBA_STATS=1 in the environment
+ * or with the (latency on) command, so the counters cost a single load
+ * otherwise. */
+
+/* 4 buckets per power of two, up to ~16 seconds */
+#  define LBA_STATS_N_BUCKETS 96
+
+typedef struct _LbaStats LbaStats;
+
+extern gint lba_stats_enabled_flag;
+
+static inline gboolean
+lba_stats_enabled (void) {
+  return G_UNLIKELY (g_atomic_int_get (&lba_stats_enabled_flag));
+}
+
+/* 0 if the stats are disabled */
+static inline gint64
+lba_stats_now (void) {
+  return lba_stats_enabled ()? g_get_monotonic_time () : 0;
+}
+
+void lba_stats_set_enabled (gboolean enabled);
+
+/* @stage_names: NULL-terminated, must outlive the stats */
+LbaStats *lba_stats_new (const gchar * const *stage_names);
+void lba_stats_free (LbaStats * stats);
+void lba_stats_reset (LbaStats * stats);
+
+/* Adds end - start (in µs) to the stage histogram. Ignored if any of them
+ * is 0, that is when the stats were disabled at some point. */
+void lba_stats_add (LbaStats * stats, guint stage, gint64 start, gint64 end);
+/* Counts one frame for the fps */
+void lba_stats_frame (LbaStats * stats, gint64 now);
+
+gdouble lba_stats_get_fps (LbaStats * stats);
+/* @p: 0..100. Returns the upper bound of the bucket in µs */
+gint64 lba_stats_get_percentile (LbaStats * stats, guint stage, gdouble p);
+/* "fps 59.9, upload p50 120us p95 400us p99 1100us, ..." */
+gchar *lba_stats_to_string (LbaStats * stats);
+
+#endif
@@ -0,0 +1,202 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../lba-frame-clock.h"
+
+typedef struct {
+  LbaFrameClock *clock;
+  GString *log;
+  guint n_frames;
+  gboolean wait_presentation;
+  gboolean remove_self;
+  guint paint_id;
+  gint64 frame_times[16];
+} Fixture;
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer user_data) {
+  fixture->clock = lba_frame_clock_new (NULL);
+  fixture->log = g_string_new (NULL);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer user_data) {
+  lba_frame_clock_free (fixture->clock);
+  g_string_free (fixture->log, TRUE);
+
+  /* The source is destroyed */
+  while (g_main_context_iteration (NULL, FALSE));
+}
+
+static void
+update_cb (LbaFrameClock *clock, gint64 frame_time, gpointer user_data) {
+  Fixture *fixture = user_data;
+
+  g_string_append_c (fixture->log, 'u');
+}
+
+static void
+layout_cb (LbaFrameClock *clock, gint64 frame_time, gpointer user_data) {
+  Fixture *fixture = user_data;
+
+  g_string_append_c (fixture->log, 'l');
+}
+
+static void
+paint_cb (LbaFrameClock *clock, gint64 frame_time, gpointer user_data) {
+  Fixture *fixture = user_data;
+
+  g_string_append_c (fixture->log, 'p');
+
+  if (fixture->n_frames < G_N_ELEMENTS (fixture->frame_times))
+    fixture->frame_times[fixture->n_frames] = frame_time;
+  fixture->n_frames++;
+
+  if (fixture->wait_presentation)
+    lba_frame_clock_wait_presentation (clock);
+
+  if (fixture->remove_self)
+    lba_frame_clock_remove (clock, fixture->paint_id);
+}
+
+static void
+add_handlers (Fixture *fixture) {
+  /* Added in the reverse order on purpose */
+  fixture->paint_id = lba_frame_clock_add (fixture->clock,
+                                           LBA_FRAME_CLOCK_PHASE_PAINT, paint_cb,
+                                           fixture, NULL);
+  lba_frame_clock_add (fixture->clock, LBA_FRAME_CLOCK_PHASE_LAYOUT, layout_cb,
+                       fixture, NULL);
+  lba_frame_clock_add (fixture->clock, LBA_FRAME_CLOCK_PHASE_UPDATE, update_cb,
+                       fixture, NULL);
+}
+
+/* Iterates until @n_frames have run, or for @timeout_us at most */
+static void
+run_frames (Fixture *fixture, guint n_frames, gint64 timeout_us) {
+  gint64 end = g_get_monotonic_time () + timeout_us;
+
+  while (fixture->n_frames < n_frames && g_get_monotonic_time () < end)
+    g_main_context_iteration (NULL, FALSE);
+}
+
+static void
+test_phases (Fixture *fixture, gconstpointer user_data) {
+  add_handlers (fixture);
+
+  /* Several requests make one frame */
+  lba_frame_clock_schedule (fixture->clock);
+  lba_frame_clock_schedule (fixture->clock);
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 2, G_USEC_PER_SEC / 10);
+
+  g_assert_cmpstr (fixture->log->str, ==, "ulp");
+  g_assert_cmpint (fixture->frame_times[0], ==,
+                   lba_frame_clock_get_frame_time (fixture->clock));
+}
+
+static void
+test_presentation (Fixture *fixture, gconstpointer user_data) {
+  guint64 frames;
+
+  add_handlers (fixture);
+  fixture->wait_presentation = TRUE;
+
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 1, G_USEC_PER_SEC);
+  g_assert_cmpuint (fixture->n_frames, ==, 1);
+
+  /* Not presented yet */
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 2, G_USEC_PER_SEC / 20);
+  g_assert_cmpuint (fixture->n_frames, ==, 1);
+
+  lba_frame_clock_presented (fixture->clock);
+  run_frames (fixture, 2, G_USEC_PER_SEC);
+  g_assert_cmpuint (fixture->n_frames, ==, 2);
+
+  lba_frame_clock_get_counters (fixture->clock, &frames, NULL, NULL);
+  g_assert_cmpuint (frames, ==, 2);
+}
+
+static void
+keep_going_cb (LbaFrameClock *clock, gint64 frame_time, gpointer user_data) {
+  lba_frame_clock_schedule (clock);
+}
+
+static void
+test_interval (Fixture *fixture, gconstpointer user_data) {
+  const gint64 interval = G_USEC_PER_SEC / 50;
+  guint i;
+
+  add_handlers (fixture);
+  lba_frame_clock_add (fixture->clock, LBA_FRAME_CLOCK_PHASE_UPDATE,
+                       keep_going_cb, NULL, NULL);
+  lba_frame_clock_set_interval (fixture->clock, interval);
+
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 5, 5 * G_USEC_PER_SEC);
+  g_assert_cmpuint (fixture->n_frames, >=, 5);
+
+  /* The frames never start before their deadline */
+  for (i = 1; i < 5; i++)
+    g_assert_cmpint (fixture->frame_times[i] - fixture->frame_times[i - 1], >=,
+                     interval / 2);
+  g_assert_cmpint (fixture->frame_times[4] - fixture->frame_times[0], >=,
+                   4 * interval);
+}
+
+static void
+test_remove_while_dispatching (Fixture *fixture, gconstpointer user_data) {
+  add_handlers (fixture);
+  fixture->remove_self = TRUE;
+
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 1, G_USEC_PER_SEC);
+
+  lba_frame_clock_schedule (fixture->clock);
+  run_frames (fixture, 2, G_USEC_PER_SEC / 20);
+
+  /* The second frame had no paint */
+  g_assert_cmpstr (fixture->log->str, ==, "ulpul");
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/frame-clock/phases", Fixture, NULL,
+              fixture_set_up, test_phases, fixture_tear_down);
+  g_test_add ("/frame-clock/presentation", Fixture, NULL,
+              fixture_set_up, test_presentation, fixture_tear_down);
+  g_test_add ("/frame-clock/interval", Fixture, NULL,
+              fixture_set_up, test_interval, fixture_tear_down);
+  g_test_add ("/frame-clock/remove-while-dispatching", Fixture, NULL,
+              fixture_set_up, test_remove_while_dispatching, fixture_tear_down);
+
+  return g_test_run ();
+}
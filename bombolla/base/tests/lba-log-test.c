@@ -0,0 +1,271 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bombolla/lba-log.h"
+#include <string.h>
+#include <unistd.h>
+
+#define N_TICKS 20000
+
+static gint evaluated;
+
+static gint
+side_effect (void) {
+  return ++evaluated;
+}
+
+static void
+test_levels (void) {
+  evaluated = 0;
+
+  lba_log_set_levels ("none");
+  LBA_LOG ("%d", side_effect ());
+  LBA_INFO ("%d", side_effect ());
+  /* The arguments are not even evaluated */
+  g_assert_cmpint (evaluated, ==, 0);
+
+  lba_log_set_levels ("LbaLog*:info");
+  LBA_LOG ("%d", side_effect ());
+  g_assert_cmpint (evaluated, ==, 0);
+  LBA_INFO ("%d", side_effect ());
+  g_assert_cmpint (evaluated, ==, 1);
+
+  lba_log_set_levels ("LbaLogTest:debug");
+  LBA_LOG ("%d", side_effect ());
+  g_assert_cmpint (evaluated, ==, 2);
+
+  /* The later ones win */
+  lba_log_set_levels ("*:debug, Other:none, LbaLogTest:none");
+  LBA_LOG ("%d", side_effect ());
+  g_assert_cmpint (evaluated, ==, 2);
+
+  lba_log_set_levels ("none");
+}
+
+typedef struct {
+  guint n_events;
+  guint n_rings;
+  guint max_ring;
+  guint n_ticks;
+  guint64 last_tick;
+  gboolean ordered;
+  /* Of the spans and flows */
+  guint n_phases[LBA_TRACE_PHASE_FLOW_IN + 1];
+  gboolean named_span;
+  gboolean thread_named;
+} TraceInfo;
+
+static void
+parse_trace (const gchar *path, TraceInfo *info) {
+  gchar *contents;
+  const guint8 *ptr;
+  const guint8 *end;
+  guint32 version,
+    n_events,
+    n_rings,
+    n_names,
+    tick_id = 0,
+    i;
+  guint16 phases[64] = { 0 };
+  guint64 span_name = 0;
+  gsize size;
+
+  memset (info, 0, sizeof (*info));
+  info->ordered = TRUE;
+
+  g_assert_true (g_file_get_contents (path, &contents, &size, NULL));
+  ptr = (const guint8 *) contents;
+  end = ptr + size;
+
+  g_assert_cmpmem (ptr, 8, LBA_TRACE_MAGIC, 8);
+  memcpy (&version, ptr + 8, 4);
+  g_assert_cmpuint (version, ==, LBA_TRACE_VERSION);
+  memcpy (&n_events, ptr + 12, 4);
+  ptr += 16;
+  info->n_events = n_events;
+
+  for (i = 0; i < n_events; i++) {
+    const gchar *domain,
+     *func,
+     *format;
+    guint16 flags;
+    guint32 id;
+
+    memcpy (&id, ptr, 4);
+    g_assert_cmpuint (id, <, G_N_ELEMENTS (phases));
+    memcpy (&phases[id], ptr + 8, 2);
+    memcpy (&flags, ptr + 10, 2);
+    ptr += 12;
+    domain = (const gchar *) ptr;
+    ptr += strlen (domain) + 1;
+    func = (const gchar *) ptr;
+    ptr += strlen (func) + 1;
+    format = (const gchar *) ptr;
+    ptr += strlen (format) + 1;
+    g_assert_true (ptr <= end);
+
+    g_assert_cmpstr (domain, ==, "LbaLogTest");
+    if (flags & LBA_TRACE_FLAG_NAMED)
+      g_assert_cmpstr (format, ==, "command");
+    if (g_strcmp0 (func, "test_trace"))
+      continue;
+
+    if (!g_strcmp0 (format, "tick"))
+      tick_id = id;
+  }
+  g_assert_cmpuint (tick_id, !=, 0);
+
+  memcpy (&n_rings, ptr, 4);
+  ptr += 4;
+  info->n_rings = n_rings;
+
+  for (i = 0; i < n_rings; i++) {
+    LbaTraceRecord rec;
+    guint32 n_records,
+      r;
+    gint64 prev = 0;
+
+    if (!g_strcmp0 ((const gchar *) ptr, "tracer"))
+      info->thread_named = TRUE;
+    ptr += 16;
+    memcpy (&n_records, ptr, 4);
+    ptr += 4;
+    info->max_ring = MAX (info->max_ring, n_records);
+
+    for (r = 0; r < n_records; r++) {
+      memcpy (&rec, ptr, sizeof (rec));
+      ptr += sizeof (rec);
+      g_assert_true (ptr <= end);
+
+      if (rec.time < prev)
+        info->ordered = FALSE;
+      prev = rec.time;
+
+      info->n_phases[phases[rec.event]]++;
+      if (phases[rec.event] == LBA_TRACE_PHASE_BEGIN && rec.args[1] == 42)
+        span_name = rec.args[0];
+
+      if (rec.event == tick_id) {
+        info->n_ticks++;
+        info->last_tick = MAX (info->last_tick, rec.args[0]);
+        g_assert_cmpuint (rec.args[1], ==, rec.args[0] * 2);
+      }
+    }
+  }
+
+  /* The strings of the named spans */
+  memcpy (&n_names, ptr, 4);
+  ptr += 4;
+  for (i = 0; i < n_names; i++) {
+    guint64 name;
+
+    memcpy (&name, ptr, 8);
+    ptr += 8;
+    if (name == span_name && !g_strcmp0 ((const gchar *) ptr, "set"))
+      info->named_span = TRUE;
+    ptr += strlen ((const gchar *) ptr) + 1;
+    g_assert_true (ptr <= end);
+  }
+  g_assert_true (ptr == end);
+
+  g_free (contents);
+}
+
+static gpointer
+trace_thread (gpointer data) {
+  LBA_TRACE ("tick", 0, 0);
+  LBA_TRACE_FLOW_IN ("hop", 1, 0);
+
+  return NULL;
+}
+
+static void
+test_trace (void) {
+  gchar *path;
+  TraceInfo info;
+  gint fd;
+  guint64 i;
+
+  fd = g_file_open_tmp ("lba-log-test-XXXXXX", &path, NULL);
+  g_assert_cmpint (fd, >=, 0);
+  close (fd);
+
+  /* Not recorded unless the domain is traced */
+  lba_log_set_levels ("LbaLogTest:debug");
+  LBA_TRACE ("tick", 1, 2);
+
+  lba_log_set_levels ("none, LbaLogTest:trace");
+  evaluated = 0;
+  for (i = 1; i <= N_TICKS; i++)
+    LBA_TRACE ("tick", i, i * 2);
+
+  /* The trace doesn't print anything more */
+  LBA_LOG ("%d", side_effect ());
+  LBA_INFO ("%d", side_effect ());
+  g_assert_cmpint (evaluated, ==, 0);
+
+  LBA_TRACE_BEGIN_NAMED ("command", g_intern_string ("set"), 42);
+  LBA_TRACE_FLOW_OUT ("hop", 1, 0);
+  g_thread_join (g_thread_new ("tracer", trace_thread, NULL));
+  LBA_TRACE_END_NAMED ("command", g_intern_string ("set"), 42);
+
+  g_assert_true (lba_trace_dump (path, NULL));
+  parse_trace (path, &info);
+
+  g_assert_cmpuint (info.n_events, >=, 2);
+  g_assert_cmpuint (info.n_rings, >=, 2);
+  g_assert_true (info.ordered);
+  /* The ring is smaller than all of it, the newest ones are kept */
+  g_assert_cmpuint (info.max_ring, <, N_TICKS);
+  g_assert_cmpuint (info.n_ticks, >, 0);
+  g_assert_cmpuint (info.last_tick, ==, N_TICKS);
+
+  g_assert_cmpuint (info.n_phases[LBA_TRACE_PHASE_BEGIN], ==, 1);
+  g_assert_cmpuint (info.n_phases[LBA_TRACE_PHASE_END], ==, 1);
+  g_assert_cmpuint (info.n_phases[LBA_TRACE_PHASE_FLOW_OUT], ==, 1);
+  g_assert_cmpuint (info.n_phases[LBA_TRACE_PHASE_FLOW_IN], ==, 1);
+  g_assert_true (info.named_span);
+#ifdef __GLIBC__
+  g_assert_true (info.thread_named);
+#endif
+
+  lba_log_set_levels ("none");
+  g_unlink (path);
+  g_free (path);
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  global_lba_plugin_name = "LbaLogTest";
+
+  g_test_add_func ("/log/levels", test_levels);
+  g_test_add_func ("/log/trace", test_trace);
+
+  return g_test_run ();
+}
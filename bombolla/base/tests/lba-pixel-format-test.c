@@ -0,0 +1,221 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../lba-pixel-format.h"
+#include <string.h>
+
+/* Odd, so the vector kernels also go through their scalar tails */
+#define W 67
+#define H 9
+#define STRIDE_PAD 12
+
+static guint8 *
+random_frame (LbaPixelFormat format, guint w, guint h, guint stride) {
+  gsize size = lba_pixel_format_frame_size (format, w, h, stride);
+  guint8 *ret = g_malloc (size);
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    ret[i] = g_test_rand_int_range (0, 256);
+
+  return ret;
+}
+
+static guint8 *
+convert (LbaPixelFormat from, const guint8 *src, guint src_stride,
+         LbaPixelFormat to, guint w, guint h, gboolean scalar) {
+  guint8 *dst = g_malloc0 (4 * w * h);
+
+  lba_pixel_format_force_scalar (scalar);
+  g_assert_true (lba_pixel_format_convert (from, src, src_stride, to, dst, 0, w, h));
+  lba_pixel_format_force_scalar (FALSE);
+
+  return dst;
+}
+
+static void
+test_names (void) {
+  guint i;
+
+  for (i = 1; i < LBA_PIXEL_FORMAT_LAST; i++) {
+    const gchar *name = lba_pixel_format_to_string (i);
+
+    g_assert_nonnull (name);
+    g_assert_cmpint (lba_pixel_format_from_string (name), ==, i);
+  }
+
+  g_assert_cmpint (lba_pixel_format_from_string ("argb8888 w(1) h(1)"), ==,
+                   LBA_PIXEL_FORMAT_UNKNOWN);
+  g_assert_cmpint (lba_pixel_format_from_string (NULL), ==,
+                   LBA_PIXEL_FORMAT_UNKNOWN);
+  g_assert_false (lba_pixel_format_can_convert (LBA_PIXEL_FORMAT_RGBA8888,
+                                                LBA_PIXEL_FORMAT_I420));
+
+  g_test_message ("Kernels: %s", lba_pixel_format_get_simd ());
+}
+
+static void
+test_shuffle (void) {
+  const guint8 argb[] = { 0x40, 0x10, 0x20, 0x30 };
+  guint8 out[4];
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_ARGB8888, argb, 0,
+                                           LBA_PIXEL_FORMAT_RGBA8888, out, 0, 1, 1));
+  g_assert_cmpmem (out, 4, ((guint8[]) { 0x10, 0x20, 0x30, 0x40 }), 4);
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_ARGB8888, argb, 0,
+                                           LBA_PIXEL_FORMAT_BGRA8888, out, 0, 1, 1));
+  g_assert_cmpmem (out, 4, ((guint8[]) { 0x30, 0x20, 0x10, 0x40 }), 4);
+}
+
+/* Every alpha with every color value */
+static void
+test_premultiply (void) {
+  guint8 *src = g_malloc (256 * 256 * 4);
+  guint8 *dst;
+  guint c,
+    a;
+
+  for (a = 0; a < 256; a++) {
+    for (c = 0; c < 256; c++) {
+      guint8 *p = src + 4 * (a * 256 + c);
+
+      p[0] = p[1] = p[2] = c;
+      p[3] = a;
+    }
+  }
+
+  dst = convert (LBA_PIXEL_FORMAT_RGBA8888, src, 0, LBA_PIXEL_FORMAT_RGBA8888_PRE,
+                 256, 256, FALSE);
+
+  for (a = 0; a < 256; a++) {
+    for (c = 0; c < 256; c++) {
+      const guint8 *p = dst + 4 * (a * 256 + c);
+      /* Rounded c * a / 255 */
+      guint expected = (2 * c * a + 255) / 510;
+
+      g_assert_cmpuint (p[0], ==, expected);
+      g_assert_cmpuint (p[2], ==, expected);
+      g_assert_cmpuint (p[3], ==, a);
+    }
+  }
+
+  g_free (src);
+  g_free (dst);
+}
+
+static void
+test_unpremultiply (void) {
+  const guint8 pre[] = {
+    0x80, 0x40, 0x00, 0xff,
+    0x00, 0x00, 0x00, 0x00,
+    0x40, 0x20, 0x00, 0x80,
+  };
+  guint8 out[sizeof (pre)];
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_RGBA8888_PRE, pre, 0,
+                                           LBA_PIXEL_FORMAT_RGBA8888, out, 0, 3, 1));
+
+  /* Opaque is left as it is, transparent is black */
+  g_assert_cmpmem (out, 8, pre, 8);
+  g_assert_cmpuint (out[8], ==, 0x80);
+  g_assert_cmpuint (out[9], ==, 0x40);
+  g_assert_cmpuint (out[10], ==, 0x00);
+  g_assert_cmpuint (out[11], ==, 0x80);
+}
+
+static void
+test_yuv_reference (void) {
+  /* Y plane 2x2, then U and V */
+  const guint8 white[] = { 235, 235, 235, 235, 128, 128 };
+  const guint8 black[] = { 16, 16, 16, 16, 128, 128 };
+  /* Pure red in BT.601 limited range */
+  const guint8 red[] = { 81, 81, 81, 81, 90, 240 };
+  guint8 out[16];
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_I420, white, 0,
+                                           LBA_PIXEL_FORMAT_RGBA8888, out, 0, 2, 2));
+  g_assert_cmpmem (out, 4, ((guint8[]) { 255, 255, 255, 255 }), 4);
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_NV12, black, 0,
+                                           LBA_PIXEL_FORMAT_RGBA8888, out, 0, 2, 2));
+  g_assert_cmpmem (out + 12, 4, ((guint8[]) { 0, 0, 0, 255 }), 4);
+
+  g_assert_true (lba_pixel_format_convert (LBA_PIXEL_FORMAT_I420, red, 0,
+                                           LBA_PIXEL_FORMAT_BGRA8888, out, 0, 2, 2));
+  g_assert_cmpuint (out[0], <=, 2);
+  g_assert_cmpuint (out[1], <=, 2);
+  g_assert_cmpuint (out[2], >=, 253);
+  g_assert_cmpuint (out[3], ==, 255);
+}
+
+/* The vector kernels must give exactly what the scalar ones give */
+static void
+test_simd_matches_scalar (void) {
+  guint from,
+    to;
+
+  for (from = 1; from < LBA_PIXEL_FORMAT_LAST; from++) {
+    guint stride = lba_pixel_format_default_stride (from, W) + STRIDE_PAD;
+    guint8 *src = random_frame (from, W, H, stride);
+
+    for (to = 1; to < LBA_PIXEL_FORMAT_LAST; to++) {
+      guint8 *simd,
+       *scalar;
+
+      if (lba_pixel_format_is_planar (to))
+        continue;
+
+      simd = convert (from, src, stride, to, W, H, FALSE);
+      scalar = convert (from, src, stride, to, W, H, TRUE);
+
+      if (memcmp (simd, scalar, 4 * W * H))
+        g_error ("%s -> %s: %s differs from scalar",
+                 lba_pixel_format_to_string (from), lba_pixel_format_to_string (to),
+                 lba_pixel_format_get_simd ());
+
+      g_free (simd);
+      g_free (scalar);
+    }
+
+    g_free (src);
+  }
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/pixel-format/names", test_names);
+  g_test_add_func ("/pixel-format/shuffle", test_shuffle);
+  g_test_add_func ("/pixel-format/premultiply", test_premultiply);
+  g_test_add_func ("/pixel-format/unpremultiply", test_unpremultiply);
+  g_test_add_func ("/pixel-format/yuv-reference", test_yuv_reference);
+  g_test_add_func ("/pixel-format/simd-matches-scalar", test_simd_matches_scalar);
+
+  return g_test_run ();
+}
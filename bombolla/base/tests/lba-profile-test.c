@@ -0,0 +1,185 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../lba-profile.h"
+#include <string.h>
+
+#define N_THREADS 4
+#define N_ADDS 1000
+
+static const LbaProfileStat *
+find_stat (GArray *stats, LbaProfileKind kind, const gchar *name) {
+  guint i;
+
+  for (i = 0; i < stats->len; i++) {
+    LbaProfileStat *stat = &g_array_index (stats, LbaProfileStat, i);
+
+    if (stat->kind == kind && !g_strcmp0 (stat->name, name))
+      return stat;
+  }
+
+  return NULL;
+}
+
+static gpointer
+add_thread (gpointer data) {
+  guint i;
+
+  for (i = 0; i < N_ADDS; i++) {
+    /* 1..10 ns, and one of 1000 */
+    lba_profile_add (LBA_PROFILE_COMMAND, "call", 100, 101 + i % 10);
+    lba_profile_add (LBA_PROFILE_SIGNAL, "obj.ping", 100,
+                     i == GPOINTER_TO_UINT (data) ? 1100 : 101);
+  }
+
+  return NULL;
+}
+
+static void
+test_merge (void) {
+  GThread *threads[N_THREADS];
+  const LbaProfileStat *stat;
+  GArray *stats;
+  guint i;
+
+  lba_profile_set_enabled (TRUE);
+  lba_profile_reset ();
+
+  for (i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("profile", add_thread, GUINT_TO_POINTER (i));
+  for (i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* And one from this thread, that is still alive */
+  lba_profile_add (LBA_PROFILE_COMMAND, "set", 1000, 3000);
+
+  stats = lba_profile_collect ();
+  g_assert_cmpuint (stats->len, ==, 3);
+
+  /* Sorted by kind first */
+  g_assert_cmpint (g_array_index (stats, LbaProfileStat, 2).kind, ==,
+                   LBA_PROFILE_SIGNAL);
+
+  stat = find_stat (stats, LBA_PROFILE_COMMAND, "call");
+  g_assert_nonnull (stat);
+  g_assert_cmpuint (stat->count, ==, N_THREADS * N_ADDS);
+  g_assert_cmpuint (stat->total, ==, N_THREADS * N_ADDS / 10 * 55);
+  g_assert_cmpuint (stat->max, ==, 10);
+
+  stat = find_stat (stats, LBA_PROFILE_SIGNAL, "obj.ping");
+  g_assert_nonnull (stat);
+  g_assert_cmpuint (stat->count, ==, N_THREADS * N_ADDS);
+  g_assert_cmpuint (stat->max, ==, 1000);
+
+  stat = find_stat (stats, LBA_PROFILE_COMMAND, "set");
+  g_assert_nonnull (stat);
+  g_assert_cmpuint (stat->count, ==, 1);
+  g_assert_cmpuint (stat->total, ==, 2000);
+  g_array_unref (stats);
+
+  /* The threads are gone, their tables are reused */
+  threads[0] = g_thread_new ("profile", add_thread, GUINT_TO_POINTER (0));
+  g_thread_join (threads[0]);
+
+  stats = lba_profile_collect ();
+  stat = find_stat (stats, LBA_PROFILE_COMMAND, "call");
+  g_assert_cmpuint (stat->count, ==, (N_THREADS + 1) * N_ADDS);
+  g_array_unref (stats);
+
+  lba_profile_reset ();
+  stats = lba_profile_collect ();
+  g_assert_cmpuint (stats->len, ==, 0);
+  g_array_unref (stats);
+}
+
+static void
+test_disabled (void) {
+  GArray *stats;
+
+  lba_profile_reset ();
+  lba_profile_set_enabled (FALSE);
+
+  g_assert_cmpint (lba_profile_now (), ==, 0);
+  lba_profile_add (LBA_PROFILE_COMMAND, "call", lba_profile_now (),
+                   lba_profile_now ());
+
+  stats = lba_profile_collect ();
+  g_assert_cmpuint (stats->len, ==, 0);
+  g_array_unref (stats);
+
+  lba_profile_set_enabled (TRUE);
+  g_assert_cmpint (lba_profile_now (), >, 0);
+}
+
+static void
+test_formats (void) {
+  gchar *out;
+
+  lba_profile_set_enabled (TRUE);
+  lba_profile_reset ();
+
+  lba_profile_add (LBA_PROFILE_ON, "LbaClock.tick: (set \"a,b\" 1)", 10, 2010);
+  lba_profile_add (LBA_PROFILE_OBJECT, "clock", 10, 1010);
+
+  out = lba_profile_to_string (LBA_PROFILE_FORMAT_JSON);
+  g_assert_cmpstr (out, ==,
+                   "[\n"
+                   "  {\"kind\": \"object\", \"name\": \"clock\", \"count\": 1,"
+                   " \"total_ns\": 1000, \"max_ns\": 1000},\n"
+                   "  {\"kind\": \"on\", \"name\": "
+                   "\"LbaClock.tick: (set \\\"a,b\\\" 1)\", \"count\": 1,"
+                   " \"total_ns\": 2000, \"max_ns\": 2000}\n" "]\n");
+  g_free (out);
+
+  out = lba_profile_to_string (LBA_PROFILE_FORMAT_CSV);
+  g_assert_cmpstr (out, ==,
+                   "kind,name,count,total_ns,max_ns\n"
+                   "object,clock,1,1000,1000\n"
+                   "on,\"LbaClock.tick: (set \"\"a,b\"\" 1)\",1,2000,2000\n");
+  g_free (out);
+
+  out = lba_profile_to_string (LBA_PROFILE_FORMAT_TEXT);
+  g_assert_nonnull (strstr (out, "clock"));
+  g_assert_nonnull (strstr (out, "2.0"));
+  g_free (out);
+
+  lba_profile_reset ();
+  out = lba_profile_to_string (LBA_PROFILE_FORMAT_JSON);
+  g_assert_cmpstr (out, ==, "[]\n");
+  g_free (out);
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/profile/merge", test_merge);
+  g_test_add_func ("/profile/disabled", test_disabled);
+  g_test_add_func ("/profile/formats", test_formats);
+
+  return g_test_run ();
+}
@@ -26,7 +26,9 @@
  */
 
 #include "bombolla/lba-log.h"
+#include "bombolla/base/lba-profile.h"
 #include "lba-commands.h"
+#include <string.h>
 
 /* HACK: Needed to use LBA_LOG */
 static const gchar *global_lba_plugin_name = "LbaCore";
@@ -186,6 +188,8 @@ lba_command_set (BombollaContext *ctx, const gchar *expr, guint len) {
   GParamSpec *prop;
   gboolean ret = FALSE;
   gint i;
+  gint64 start,
+    end;
   gchar **tokens = FIXME_adapt_to_old (expr, len);
 
   if (FALSE == (tokens[1] && tokens[2])) {
@@ -236,7 +240,18 @@ lba_command_set (BombollaContext *ctx, const gchar *expr, guint len) {
   }
 
   LBA_LOG ("setting %s to [%s]", tokens[1], prop_val);
+  start = lba_profile_now ();
   g_object_set_property (obj, prop_name, &outp);
+  end = lba_profile_now ();
+
+  if (start) {
+    /* tokens[1] is "obj.prop" */
+    gchar *objname = g_strndup (tokens[1],
+                                strlen (tokens[1]) - strlen (prop_name) - 1);
+
+    lba_profile_add (LBA_PROFILE_OBJECT, objname, start, end);
+    g_free (objname);
+  }
 
   ret = TRUE;
 done:
@@ -26,6 +26,7 @@
  */
 
 #include "bombolla/lba-log.h"
+#include "bombolla/base/lba-profile.h"
 #include "lba-commands.h"
 #include <bmixin/bmixin.h>
 
@@ -101,6 +102,8 @@ lba_command_call (BombollaContext *ctx, const gchar *expr, guint len) {
     int p;
     guint signal_id;
     GSignalQuery query;
+    gint64 start,
+      end;
 
     signal_id = g_signal_lookup (signame, G_OBJECT_TYPE (obj));
     if (!signal_id) {
@@ -173,8 +176,16 @@ lba_command_call (BombollaContext *ctx, const gchar *expr, guint len) {
     }
 
     LBA_LOG ("calling %s.%s ()", objname, signame);
+    start = lba_profile_now ();
+    LBA_TRACE_BEGIN_NAMED ("signal", g_intern_string (tokens[1]), 0);
     g_signal_emitv ((GValue *) instance_and_params->data,
                     signal_id, 0, &return_value);
+    LBA_TRACE_END_NAMED ("signal", g_intern_string (tokens[1]), 0);
+    end = lba_profile_now ();
+
+    /* tokens[1] is "obj.signal" */
+    lba_profile_add (LBA_PROFILE_SIGNAL, tokens[1], start, end);
+    lba_profile_add (LBA_PROFILE_OBJECT, objname, start, end);
   }
 
   ret = TRUE;
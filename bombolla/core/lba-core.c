@@ -28,6 +28,7 @@
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
 #include "bombolla/base/lba-module-scanner.h"
+#include "bombolla/base/lba-profile.h"
 #include "lba-expr-parser.h"
 #include <bmixin/bmixin.h>
 #include <glib/gstdio.h>
@@ -245,10 +246,16 @@ DEPRECATED_lba_core_eval_expression (gpointer selv, const char *expr, guint len)
   /* So now find the command: */
   for (command = commands; command->name != NULL; command++) {
     if (g_str_has_prefix (expr, command->name)) {
+      gint64 start = lba_profile_now ();
+
+      LBA_TRACE_BEGIN_NAMED ("command", command->name, 0);
       if (!command->parse (self->ctx, expr, len)) {
         g_error ("Command parse error");
       }
+      LBA_TRACE_END_NAMED ("command", command->name, 0);
 
+      lba_profile_add (LBA_PROFILE_COMMAND, command->name, start,
+                       lba_profile_now ());
       return;
     }
   }
@@ -276,6 +283,9 @@ lba_expr_node_action (gpointer data, LbaCore *self) {
   GSignalQuery query;
   LbaExprNode *en = (LbaExprNode *) data;
   LbaExprNode *cen;
+  const gchar *objname = NULL;
+  gint64 start,
+    end;
 
   LBA_LOG ("Actioning [%s]", en->str);
   /* Ok, so we are actioning a node, all of which children have
@@ -336,6 +346,9 @@ lba_expr_node_action (gpointer data, LbaCore *self) {
       g_value_set_object (dst,
                           g_hash_table_lookup (self->ctx->objects,
                                                g_value_get_string (&cen->value)));
+      /* The command is counted for the object too */
+      if (!objname)
+        objname = g_value_get_string (&cen->value);
     } else {
       g_assert (TRUE == g_value_type_transformable (G_VALUE_TYPE (&cen->value),
                                                     query.param_types[p]));
@@ -349,7 +362,16 @@ lba_expr_node_action (gpointer data, LbaCore *self) {
   /* Now we can happily emit the signal */
   LBA_LOG ("Executing the signal %s of %d params", query.signal_name,
            query.n_params);
+  start = lba_profile_now ();
+  LBA_TRACE_BEGIN_NAMED ("command", query.signal_name, 0);
   g_signal_emitv (instance_and_params, signal_id, 0, &en->value);
+  LBA_TRACE_END_NAMED ("command", query.signal_name, 0);
+  end = lba_profile_now ();
+
+  lba_profile_add (LBA_PROFILE_COMMAND, query.signal_name, start, end);
+  if (objname)
+    lba_profile_add (LBA_PROFILE_OBJECT, objname, start, end);
+
   /* Now release the values */
   for (p = 0; p < query.n_params + 1; p++)
     g_value_unset (&instance_and_params[p]);
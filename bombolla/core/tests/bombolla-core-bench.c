@@ -0,0 +1,828 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Micro-benchmarks of the core primitives: the parser, "execute", the set and
+ * create commands, the BMixin lookups and registration, the hops of LbaAsync
+ * to the main loop, LbaPicture and the remote object protocol.
+ *
+ * Each case runs in batches of as many iterations as take --time ms, found
+ * on the warm up, and the median of --runs batches is reported, in ns per
+ * operation. The result is a table, CSV or JSON. Saved with --save, it can be
+ * the --baseline of a later run: then the change of each case is shown, and
+ * the exit code is 1 if any of them got slower by more than --threshold %.
+ *
+ * Usage: bombolla-core-bench [-f text|csv|json] [-p GLOB] [-s FILE] [-b FILE] */
+
+#include <glib-object.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bombolla/base/lba-picture.h"
+#include "bombolla/base/lba-profile.h"
+#include "bombolla/core/lba-expr-parser.h"
+#include "remote-object/robj-protocol.h"
+
+/* Declare this magic symbols explicitly */
+GType lba_core_object_get_type (void);
+GType lba_async_get_type (void);
+
+#define BENCH_MAX_RUNS 31
+/* The commands in the set scripts */
+#define BENCH_N_SETS 100
+#define BENCH_PICTURE_SIZE 64
+
+/* ======================= A plain object to play with */
+typedef struct {
+  GObject parent;
+
+  gint value;
+  gchar *label;
+} BenchObject;
+
+typedef struct {
+  GObjectClass parent_class;
+} BenchObjectClass;
+
+G_DEFINE_TYPE (BenchObject, bench_object, G_TYPE_OBJECT);
+
+enum {
+  PROP_VALUE = 1,
+  PROP_LABEL
+};
+
+static void
+bench_object_set_property (GObject *object, guint property_id,
+                           const GValue *value, GParamSpec *pspec) {
+  BenchObject *self = (BenchObject *) object;
+
+  switch (property_id) {
+  case PROP_VALUE:
+    self->value = g_value_get_int (value);
+    break;
+  case PROP_LABEL:
+    g_free (self->label);
+    self->label = g_value_dup_string (value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+bench_object_get_property (GObject *object, guint property_id,
+                           GValue *value, GParamSpec *pspec) {
+  BenchObject *self = (BenchObject *) object;
+
+  switch (property_id) {
+  case PROP_VALUE:
+    g_value_set_int (value, self->value);
+    break;
+  case PROP_LABEL:
+    g_value_set_string (value, self->label);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+bench_object_finalize (GObject *object) {
+  BenchObject *self = (BenchObject *) object;
+
+  g_free (self->label);
+  G_OBJECT_CLASS (bench_object_parent_class)->finalize (object);
+}
+
+static void
+bench_object_init (BenchObject *self) {
+}
+
+static void
+bench_object_class_init (BenchObjectClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = bench_object_set_property;
+  gobject_class->get_property = bench_object_get_property;
+  gobject_class->finalize = bench_object_finalize;
+
+  g_object_class_install_property
+      (gobject_class, PROP_VALUE,
+       g_param_spec_int ("value", "Value", "Value",
+                         G_MININT, G_MAXINT, 0,
+                         G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property
+      (gobject_class, PROP_LABEL,
+       g_param_spec_string ("label", "Label", "Label", NULL,
+                            G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+/* ======================= The cases */
+typedef struct {
+  GObject *core;
+
+  GType picture_mixin;
+  GType async_type;
+  /* GObject+LbaPicture+LbaAsync, for the lookups not on the top */
+  GObject *deep;
+  GObject *picture;
+  GBytes *frame;
+
+  gchar *set_int_script;
+  gchar *set_string_script;
+  guint n_registered;
+
+  RObjMap send_map;
+  RObjMap recv_map;
+  RObjPN *pn_int;
+  RObjPN *pn_string;
+  GBytes *msg_int;
+  GBytes *msg_string;
+  GByteArray *buf;
+
+  /* So the compiler doesn't throw the lookups away */
+  volatile guintptr sink;
+} BenchData;
+
+typedef struct {
+  const gchar *name;
+  void (*run) (BenchData * d, guint64 n);
+  /* How many operations one iteration does, 1 if 0 */
+  guint ops;
+  /* For the ones that can't be undone, f.e. the type registration.
+   * 0 - no limit */
+  guint64 max_iterations;
+} BenchCase;
+
+static const gchar bench_script[] =
+    "(create BenchObject o)\n"
+    "(set o.value 42)\n"
+    "(set o.label hello)\n"
+    "(on o.notify::value (set o.label changed))\n"
+    "(call o.notify)\n" "(destroy o)\n";
+
+static void
+bench_parse (BenchData *d, guint64 n) {
+  guint len = strlen (bench_script);
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    lba_expr_node_destroy (lba_expr_parser_sniff (LBA_EXPR_NODE_IS_LIST,
+                                                  bench_script, len));
+}
+
+static void
+bench_execute_empty (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute", "\n");
+}
+
+static void
+bench_execute_set (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute", "(set b.value 7)");
+}
+
+static void
+bench_set_int (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute", d->set_int_script);
+}
+
+static void
+bench_set_string (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute", d->set_string_script);
+}
+
+static void
+bench_create_gobject (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute",
+                           "(create BenchObject tmp)\n(destroy tmp)");
+}
+
+static void
+bench_create_mixin (BenchData *d, guint64 n) {
+  guint64 i;
+
+  /* The mixed type is looked up by name each time */
+  for (i = 0; i < n; i++)
+    g_signal_emit_by_name (d->core, "execute",
+                           "(create LbaPicture tmp)\n(destroy tmp)");
+}
+
+static void
+bench_bm_instance_get_mixin (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    d->sink += (guintptr) bm_instance_get_mixin (d->deep, d->picture_mixin);
+}
+
+static void
+bench_bm_class_get_mixin (BenchData *d, guint64 n) {
+  gpointer klass = G_OBJECT_GET_CLASS (d->deep);
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    d->sink += (guintptr) bm_class_get_mixin (klass, d->picture_mixin);
+}
+
+static void
+bench_bm_register_existing (BenchData *d, guint64 n) {
+  guint64 i;
+
+  /* What (create) does for a mixin */
+  for (i = 0; i < n; i++)
+    d->sink += bm_register_mixed_type (NULL, G_TYPE_OBJECT, d->picture_mixin, NULL);
+}
+
+static void
+bench_bm_register_new (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++) {
+    gchar *name = g_strdup_printf ("BenchPicture%u", d->n_registered++);
+
+    d->sink += bm_register_mixed_type (name, G_TYPE_OBJECT, d->picture_mixin, NULL);
+    g_free (name);
+  }
+}
+
+static void
+bench_async_new_unref (BenchData *d, guint64 n) {
+  guint64 i;
+
+  /* constructor, constructed, the last ref, dispose and finalize: each one
+   * is a hop to the main loop and back */
+  for (i = 0; i < n; i++)
+    g_object_unref (g_object_new (d->async_type, NULL));
+}
+
+static void
+bench_picture_publish_consume (BenchData *d, guint64 n) {
+  gchar fmt[16];
+  guint w,
+    h,
+    stride;
+  guint64 i;
+
+  for (i = 0; i < n; i++) {
+    lba_picture_set_full (d->picture, "rgba8888", BENCH_PICTURE_SIZE,
+                          BENCH_PICTURE_SIZE, 0, g_bytes_ref (d->frame));
+    g_bytes_unref (lba_picture_get_full (d->picture, fmt, &w, &h, &stride, NULL));
+  }
+}
+
+static void
+bench_picture_publish_convert (BenchData *d, guint64 n) {
+  guint w,
+    h,
+    stride;
+  guint64 i;
+
+  for (i = 0; i < n; i++) {
+    lba_picture_set_full (d->picture, "rgba8888", BENCH_PICTURE_SIZE,
+                          BENCH_PICTURE_SIZE, 0, g_bytes_ref (d->frame));
+    g_bytes_unref (lba_picture_get_converted (d->picture,
+                                              LBA_PIXEL_FORMAT_BGRA8888,
+                                              &w, &h, &stride, NULL));
+  }
+}
+
+static void
+bench_robj_encode_int (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_bytes_unref (robj_protocol_pn_to_message (d->pn_int));
+}
+
+static void
+bench_robj_encode_string (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    g_bytes_unref (robj_protocol_pn_to_message (d->pn_string));
+}
+
+static void
+bench_robj_write_int (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++) {
+    g_byte_array_set_size (d->buf, 0);
+    robj_protocol_write_pn (d->pn_int, d->buf);
+  }
+}
+
+static void
+bench_robj_decode_int (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    robj_protocol_message_to_pn (&d->recv_map, d->msg_int);
+}
+
+static void
+bench_robj_decode_string (BenchData *d, guint64 n) {
+  guint64 i;
+
+  for (i = 0; i < n; i++)
+    robj_protocol_message_to_pn (&d->recv_map, d->msg_string);
+}
+
+static const BenchCase bench_cases[] = {
+  { "parse/script", bench_parse },
+  { "execute/empty", bench_execute_empty },
+  { "execute/set", bench_execute_set },
+  { "set/int", bench_set_int, BENCH_N_SETS },
+  { "set/string", bench_set_string, BENCH_N_SETS },
+  { "create/gobject", bench_create_gobject },
+  { "create/mixin", bench_create_mixin },
+  { "bm/instance-get-mixin", bench_bm_instance_get_mixin },
+  { "bm/class-get-mixin", bench_bm_class_get_mixin },
+  { "bm/register-mixed-type/existing", bench_bm_register_existing },
+  { "bm/register-mixed-type/new", bench_bm_register_new, 0, 1000 },
+  { "async/new-unref", bench_async_new_unref },
+  { "picture/publish-consume", bench_picture_publish_consume },
+  { "picture/publish-convert", bench_picture_publish_convert },
+  { "robj/encode-int", bench_robj_encode_int },
+  { "robj/encode-string", bench_robj_encode_string },
+  { "robj/write-int", bench_robj_write_int },
+  { "robj/decode-int", bench_robj_decode_int },
+  { "robj/decode-string", bench_robj_decode_string },
+  { NULL }
+};
+
+static gboolean
+bench_setup (BenchData *d) {
+  GObject *b = NULL;
+  GString *script;
+  GValue pval = G_VALUE_INIT;
+  guint32 o_id;
+  guint8 *pixels;
+  guint i;
+
+  d->core = g_object_new (lba_core_object_get_type (), NULL);
+
+  /* So (create) finds them by name */
+  g_type_ensure (bench_object_get_type ());
+  d->picture_mixin = lba_picture_get_type ();
+
+  g_signal_emit_by_name (d->core, "execute", "(create BenchObject b)");
+  g_signal_emit_by_name (d->core, "pick", "b", &b);
+  if (!b) {
+    g_printerr ("Couldn't create the object: core plugins not found\n");
+    return FALSE;
+  }
+  g_object_unref (b);
+
+  script = g_string_new (NULL);
+  for (i = 0; i < BENCH_N_SETS; i++)
+    g_string_append_printf (script, "(set b.value %u)\n", i);
+  d->set_int_script = g_string_free (script, FALSE);
+
+  script = g_string_new (NULL);
+  for (i = 0; i < BENCH_N_SETS; i++)
+    g_string_append_printf (script, "(set b.label label-%u)\n", i);
+  d->set_string_script = g_string_free (script, FALSE);
+
+  /* The bench thread doesn't own the main context, so LbaAsync hops */
+  d->async_type = bm_register_mixed_type (NULL, G_TYPE_OBJECT,
+                                          lba_async_get_type (), NULL);
+  d->picture = g_object_new (bm_register_mixed_type (NULL, G_TYPE_OBJECT,
+                                                     d->picture_mixin, NULL),
+                             NULL);
+  d->deep = g_object_new (bm_register_mixed_type (NULL,
+                                                  G_OBJECT_TYPE (d->picture),
+                                                  lba_async_get_type (), NULL),
+                          NULL);
+
+  pixels = g_malloc (BENCH_PICTURE_SIZE * BENCH_PICTURE_SIZE * 4);
+  for (i = 0; i < BENCH_PICTURE_SIZE * BENCH_PICTURE_SIZE * 4; i++)
+    pixels[i] = i * 7;
+  d->frame = g_bytes_new_take (pixels, BENCH_PICTURE_SIZE * BENCH_PICTURE_SIZE * 4);
+
+  robj_protocol_init ();
+  robj_map_init (&d->send_map);
+  robj_map_init (&d->recv_map);
+  o_id = robj_map_add_object (&d->send_map, "bench");
+  robj_map_add_object (&d->recv_map, "bench");
+
+  g_value_init (&pval, G_TYPE_INT);
+  g_value_set_int (&pval, 123456);
+  d->pn_int = robj_map_new_pn (&d->send_map, o_id, "value", &pval);
+  robj_map_new_pn (&d->recv_map, o_id, "value", &pval);
+  g_value_unset (&pval);
+
+  g_value_init (&pval, G_TYPE_STRING);
+  g_value_set_static_string (&pval, "la Bombolla GObject shell");
+  d->pn_string = robj_map_new_pn (&d->send_map, o_id, "label", &pval);
+  robj_map_new_pn (&d->recv_map, o_id, "label", &pval);
+  g_value_unset (&pval);
+
+  d->msg_int = robj_protocol_pn_to_message (d->pn_int);
+  d->msg_string = robj_protocol_pn_to_message (d->pn_string);
+  d->buf = g_byte_array_new ();
+
+  return TRUE;
+}
+
+static void
+bench_teardown (BenchData *d) {
+  g_clear_pointer (&d->buf, g_byte_array_unref);
+  g_clear_pointer (&d->msg_int, g_bytes_unref);
+  g_clear_pointer (&d->msg_string, g_bytes_unref);
+  if (d->pn_int) {
+    robj_map_clear (&d->send_map);
+    robj_map_clear (&d->recv_map);
+  }
+
+  g_clear_pointer (&d->frame, g_bytes_unref);
+  g_clear_object (&d->deep);
+  g_clear_object (&d->picture);
+  g_clear_pointer (&d->set_int_script, g_free);
+  g_clear_pointer (&d->set_string_script, g_free);
+  g_clear_object (&d->core);
+}
+
+/* ======================= Running and reporting */
+typedef struct {
+  const gchar *name;
+  /* Operations in one batch */
+  guint64 ops;
+  /* The median and the best batch */
+  gdouble ns_per_op;
+  gdouble min_ns_per_op;
+  /* 0 if the case is not in the baseline */
+  gdouble baseline_ns_per_op;
+} BenchResult;
+
+static gint
+bench_cmp_double (gconstpointer a, gconstpointer b) {
+  gdouble da = *(const gdouble *) a;
+  gdouble db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+static gint64
+bench_now (void) {
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+static gint64
+bench_batch (BenchData *d, const BenchCase *bc, guint64 n) {
+  gint64 start = bench_now ();
+
+  bc->run (d, n);
+  return bench_now () - start;
+}
+
+static void
+bench_run_case (BenchData *d, const BenchCase *bc, guint runs, gint64 batch_ns,
+                BenchResult *res) {
+  gdouble samples[BENCH_MAX_RUNS];
+  guint ops = MAX (bc->ops, 1);
+  guint64 n = 1;
+  gint64 t;
+  guint r;
+
+  /* Warm up, and find how many iterations take long enough */
+  for (;;) {
+    t = bench_batch (d, bc, n);
+    if (t >= batch_ns || (bc->max_iterations && n >= bc->max_iterations))
+      break;
+
+    /* Aim a bit over, but don't believe a single fast batch too much */
+    n = MAX (n + 1, MIN (n * 100, (guint64) (n * 1.2 * batch_ns / MAX (t, 1))));
+    if (bc->max_iterations)
+      n = MIN (n, bc->max_iterations);
+  }
+
+  for (r = 0; r < runs; r++)
+    samples[r] = bench_batch (d, bc, n) / (gdouble) (n * ops);
+
+  qsort (samples, runs, sizeof (gdouble), bench_cmp_double);
+
+  res->name = bc->name;
+  res->ops = n * ops;
+  res->ns_per_op = samples[runs / 2];
+  res->min_ns_per_op = samples[0];
+}
+
+/* name -> gdouble ns_per_op, from a CSV written by --save */
+static GHashTable *
+bench_load_baseline (const gchar *path, GError **err) {
+  GHashTable *ret;
+  gchar *contents;
+  gchar **lines,
+  **header;
+  gint name_col = -1,
+    ns_col = -1,
+    i;
+
+  if (!g_file_get_contents (path, &contents, NULL, err))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  header = g_strsplit (lines[0] ? lines[0] : "", ",", -1);
+  for (i = 0; header[i]; i++) {
+    if (!g_strcmp0 (header[i], "name"))
+      name_col = i;
+    else if (!g_strcmp0 (header[i], "ns_per_op"))
+      ns_col = i;
+  }
+  g_strfreev (header);
+
+  if (name_col < 0 || ns_col < 0) {
+    g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                 "%s doesn't have the name and ns_per_op columns", path);
+    g_strfreev (lines);
+    return NULL;
+  }
+
+  ret = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  for (i = 1; lines[i]; i++) {
+    gchar **fields = g_strsplit (lines[i], ",", -1);
+
+    if ((gint) g_strv_length (fields) > MAX (name_col, ns_col)) {
+      gdouble *ns = g_new (gdouble, 1);
+
+      *ns = g_ascii_strtod (fields[ns_col], NULL);
+      g_hash_table_insert (ret, g_strdup (fields[name_col]), ns);
+    }
+    g_strfreev (fields);
+  }
+  g_strfreev (lines);
+
+  return ret;
+}
+
+/* TEXT is for the humans. The others are in nanoseconds per operation:
+ * JSON - an array of {"name", "ops", "ns_per_op", "min_ns_per_op"}
+ * CSV - the same columns, with a header line.
+ * With a baseline, "baseline_ns_per_op" and "change" (0.1 is 10% slower)
+ * are added for the cases found in it. */
+static gchar *
+bench_results_to_string (GArray *results, LbaProfileFormat format,
+                         gboolean with_baseline) {
+  GString *out = g_string_new (NULL);
+  guint i;
+
+  switch (format) {
+  case LBA_PROFILE_FORMAT_TEXT:
+    g_string_append_printf (out, "%-34s %12s %12s %12s", "name", "ops",
+                            "ns/op", "min ns/op");
+    if (with_baseline)
+      g_string_append_printf (out, " %12s %8s", "baseline", "change");
+    g_string_append_c (out, '\n');
+    break;
+  case LBA_PROFILE_FORMAT_JSON:
+    g_string_append_c (out, '[');
+    break;
+  case LBA_PROFILE_FORMAT_CSV:
+    g_string_append (out, "name,ops,ns_per_op,min_ns_per_op");
+    if (with_baseline)
+      g_string_append (out, ",baseline_ns_per_op,change");
+    g_string_append_c (out, '\n');
+    break;
+  }
+
+  for (i = 0; i < results->len; i++) {
+    BenchResult *res = &g_array_index (results, BenchResult, i);
+    gboolean in_baseline = with_baseline && res->baseline_ns_per_op > 0;
+    gdouble change = in_baseline ?
+        res->ns_per_op / res->baseline_ns_per_op - 1 : 0;
+
+    switch (format) {
+    case LBA_PROFILE_FORMAT_TEXT:
+      g_string_append_printf (out, "%-34s %12" G_GUINT64_FORMAT " %12.1f %12.1f",
+                              res->name, res->ops, res->ns_per_op,
+                              res->min_ns_per_op);
+      if (in_baseline)
+        g_string_append_printf (out, " %12.1f %+7.1f%%",
+                                res->baseline_ns_per_op, change * 100);
+      g_string_append_c (out, '\n');
+      break;
+    case LBA_PROFILE_FORMAT_JSON:
+      g_string_append_printf (out, "%s\n  {\"name\": \"%s\", \"ops\": %"
+                              G_GUINT64_FORMAT ", \"ns_per_op\": %.1f"
+                              ", \"min_ns_per_op\": %.1f",
+                              i ? "," : "", res->name, res->ops,
+                              res->ns_per_op, res->min_ns_per_op);
+      if (in_baseline)
+        g_string_append_printf (out, ", \"baseline_ns_per_op\": %.1f"
+                                ", \"change\": %.4f",
+                                res->baseline_ns_per_op, change);
+      g_string_append_c (out, '}');
+      break;
+    case LBA_PROFILE_FORMAT_CSV:
+      g_string_append_printf (out, "%s,%" G_GUINT64_FORMAT ",%.1f,%.1f",
+                              res->name, res->ops, res->ns_per_op,
+                              res->min_ns_per_op);
+      if (in_baseline)
+        g_string_append_printf (out, ",%.1f,%.4f", res->baseline_ns_per_op,
+                                change);
+      else if (with_baseline)
+        g_string_append (out, ",,");
+      g_string_append_c (out, '\n');
+      break;
+    }
+  }
+
+  if (format == LBA_PROFILE_FORMAT_JSON)
+    g_string_append (out, "\n]\n");
+
+  return g_string_free (out, FALSE);
+}
+
+int
+main (int argc, char *argv[]) {
+  gchar *format_name = NULL,
+   *pattern = NULL,
+   *save = NULL,
+   *baseline_path = NULL;
+  gint runs = 5,
+    time_ms = 50;
+  gdouble threshold = 20;
+  gboolean list = FALSE;
+  GOptionContext *ctx;
+  GError *err = NULL;
+  LbaProfileFormat format = LBA_PROFILE_FORMAT_TEXT;
+  GHashTable *baseline = NULL;
+  BenchData data = { 0 };
+  GArray *results;
+  const BenchCase *bc;
+  gchar *str;
+  guint i,
+    n_slower = 0;
+  int ret = 0;
+
+  GOptionEntry options[] = {
+    { "format", 'f', 0, G_OPTION_ARG_STRING, &format_name,
+     "Output format: text, csv or json", NULL },
+    { "pattern", 'p', 0, G_OPTION_ARG_STRING, &pattern,
+     "Only run the cases that match, f.e. 'robj/*'", NULL },
+    { "runs", 'r', 0, G_OPTION_ARG_INT, &runs,
+     "Batches to take the median of, 5 by default", NULL },
+    { "time", 't', 0, G_OPTION_ARG_INT, &time_ms,
+     "Milliseconds that one batch takes at least, 50 by default", NULL },
+    { "save", 's', 0, G_OPTION_ARG_FILENAME, &save,
+     "Save the results as CSV, to compare with later", NULL },
+    { "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline_path,
+     "Compare with the results saved before", NULL },
+    { "threshold", 'T', 0, G_OPTION_ARG_DOUBLE, &threshold,
+     "Fail if any case is slower than the baseline by this %, 20 by default",
+     NULL },
+    { "list", 'l', 0, G_OPTION_ARG_NONE, &list, "List the cases", NULL },
+    { NULL }
+  };
+
+  ctx = g_option_context_new ("- micro-benchmarks of the core");
+  g_option_context_add_main_entries (ctx, options, NULL);
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_error_free (err);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (list) {
+    for (bc = bench_cases; bc->name; bc++)
+      g_print ("%s\n", bc->name);
+    return 0;
+  }
+
+  if (!format_name || !g_strcmp0 (format_name, "text")) {
+    format = LBA_PROFILE_FORMAT_TEXT;
+  } else if (!g_strcmp0 (format_name, "csv")) {
+    format = LBA_PROFILE_FORMAT_CSV;
+  } else if (!g_strcmp0 (format_name, "json")) {
+    format = LBA_PROFILE_FORMAT_JSON;
+  } else {
+    g_printerr ("Unknown format %s\n", format_name);
+    return 1;
+  }
+
+  runs = CLAMP (runs, 1, BENCH_MAX_RUNS);
+  time_ms = MAX (time_ms, 1);
+
+  if (baseline_path) {
+    baseline = bench_load_baseline (baseline_path, &err);
+    if (!baseline) {
+      g_printerr ("Couldn't load the baseline: %s\n", err->message);
+      g_error_free (err);
+      return 1;
+    }
+  }
+
+  if (!bench_setup (&data)) {
+    bench_teardown (&data);
+    return 77;
+  }
+
+  results = g_array_new (FALSE, TRUE, sizeof (BenchResult));
+  for (bc = bench_cases; bc->name; bc++) {
+    BenchResult res = { 0 };
+
+    if (pattern && !g_pattern_match_simple (pattern, bc->name))
+      continue;
+
+    bench_run_case (&data, bc, runs, time_ms * G_GINT64_CONSTANT (1000000), &res);
+
+    if (baseline) {
+      gdouble *ns = g_hash_table_lookup (baseline, bc->name);
+
+      if (ns)
+        res.baseline_ns_per_op = *ns;
+    }
+
+    g_array_append_val (results, res);
+  }
+
+  bench_teardown (&data);
+
+  str = bench_results_to_string (results, format, baseline != NULL);
+  g_print ("%s", str);
+  g_free (str);
+
+  if (save) {
+    str = bench_results_to_string (results, LBA_PROFILE_FORMAT_CSV, FALSE);
+    if (!g_file_set_contents (save, str, -1, &err)) {
+      g_printerr ("Couldn't save the results: %s\n", err->message);
+      g_clear_error (&err);
+      ret = 1;
+    }
+    g_free (str);
+  }
+
+  for (i = 0; i < results->len; i++) {
+    BenchResult *res = &g_array_index (results, BenchResult, i);
+
+    if (res->baseline_ns_per_op > 0
+        && res->ns_per_op > res->baseline_ns_per_op * (1 + threshold / 100)) {
+      g_printerr ("%s got slower: %.1f ns/op, was %.1f\n", res->name,
+                  res->ns_per_op, res->baseline_ns_per_op);
+      n_slower++;
+    }
+  }
+
+  if (n_slower) {
+    g_printerr ("%u cases are slower than the baseline by more than %.0f%%\n",
+                n_slower, threshold);
+    ret = 1;
+  }
+
+  g_array_unref (results);
+  if (baseline)
+    g_hash_table_unref (baseline);
+  g_free (format_name);
+  g_free (pattern);
+  g_free (save);
+  g_free (baseline_path);
+  return ret;
+}
@@ -26,6 +26,7 @@
  */
 
 #include <glib-object.h>
+#include "bombolla/base/lba-profile.h"
 
 /* Declare this magic symbol explicitly */
 GType lba_core_object_get_type (void);
@@ -56,6 +57,32 @@ test_dump (Fixture *fixture, gconstpointer user_data) {
   g_signal_emit_by_name (fixture->obj, "execute", "(dump LbaCoreObject)");
 }
 
+static void
+test_stats (Fixture *fixture, gconstpointer user_data) {
+  GArray *stats;
+  guint i;
+  guint64 dumps = 0;
+
+  lba_profile_set_enabled (TRUE);
+  lba_profile_reset ();
+
+  g_signal_emit_by_name (fixture->obj, "execute",
+                         "(dump LbaCoreObject)\n(dump LbaCoreObject)");
+
+  stats = lba_profile_collect ();
+  for (i = 0; i < stats->len; i++) {
+    LbaProfileStat *stat = &g_array_index (stats, LbaProfileStat, i);
+
+    if (stat->kind == LBA_PROFILE_COMMAND && !g_strcmp0 (stat->name, "dump")) {
+      g_assert_cmpuint (stat->total, >=, stat->max);
+      dumps = stat->count;
+    }
+  }
+  g_array_unref (stats);
+
+  g_assert_cmpuint (dumps, ==, 2);
+}
+
 static void
 test_singleton (Fixture *fixture, gconstpointer user_data) {
   GObject *more_lba_cores[2];
@@ -80,6 +107,8 @@ main (int argc, char *argv[]) {
               fixture_set_up, test_singleton, fixture_tear_down);
   g_test_add ("/core/test-dump", Fixture, NULL,
               fixture_set_up, test_dump, fixture_tear_down);
+  g_test_add ("/core/test-stats", Fixture, NULL,
+              fixture_set_up, test_stats, fixture_tear_down);
 
   return g_test_run ();
 }
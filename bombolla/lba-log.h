@@ -30,11 +30,204 @@
 #  include <glib/gstdio.h>
 #  include "bombolla/lba-plugin-system.h"
 
-#  define LBA_LOG(form, ...) do {                                       \
-    g_log(global_lba_plugin_name, G_LOG_LEVEL_DEBUG,  "[%p %s] " form,  \
-        g_thread_self (), __func__,  ##__VA_ARGS__); \
+/* Logging with the levels per domain, that is per plugin. When a message
+ * is off, it costs one relaxed load and a branch, the arguments are not
+ * evaluated.
+ *
+ * The levels are set with LBA_LOG in the environment or with the (log)
+ * command, f.e. LBA_LOG="LbaCogl*:debug,LbaClock:trace,*:info".
+ * If it's not set, G_MESSAGES_DEBUG turns the debug on, as before. The
+ * messages that pass the level are printed, with or without it.
+ *
+ * The trace is not a level: it turns on the LBA_TRACE () events of the
+ * domain and leaves the printing as it is, "none" turns both off. The
+ * events are not formatted: the place they come from is recorded into a
+ * ring of the thread, with the time and two integer arguments. The rings
+ * are written into a file with lba_trace_dump (), or at exit if
+ * LBA_TRACE_FILE is set, and decoded with lba-trace-decode, as text or as
+ * Chrome trace events JSON for Perfetto. LBA_TRACE_FILE alone traces all
+ * the domains, without printing anything more.
+ *
+ * With -Dlog=false all of it is compiled out. */
+
+typedef enum {
+  LBA_LOG_LEVEL_NONE,
+  LBA_LOG_LEVEL_INFO,
+  LBA_LOG_LEVEL_DEBUG,
+  /* Not registered yet, so the first check goes to the slow path */
+  LBA_LOG_LEVEL_UNKNOWN = G_MAXINT
+} LbaLogLevel;
+
+typedef struct _LbaLogDomain {
+  gint level;
+  /* If the LBA_TRACE () events are recorded, LBA_LOG_LEVEL_UNKNOWN too
+   * until it's registered */
+  gint trace;
+  /* The name can be set after the first message, so it's looked up each
+   * time the levels change */
+  const gchar **name;
+  struct _LbaLogDomain *next;
+} LbaLogDomain;
+
+typedef enum {
+  LBA_TRACE_PHASE_POINT,
+  /* A span of the thread, they nest */
+  LBA_TRACE_PHASE_BEGIN,
+  LBA_TRACE_PHASE_END,
+  /* The two ends of an arrow, f.e. from one thread to another.
+   * They are matched by the first argument. */
+  LBA_TRACE_PHASE_FLOW_OUT,
+  LBA_TRACE_PHASE_FLOW_IN,
+} LbaTracePhase;
+
+/* The first argument is a string that names the event, instead of the
+ * format. It must stay as long as the process: a literal, a signal name,
+ * a type name or a g_intern_string (). */
+#  define LBA_TRACE_FLAG_NAMED (1 << 0)
+
+/* A place in the code that goes to the trace */
+typedef struct {
+  /* 0 until it's recorded for the first time */
+  guint32 id;
+  guint32 line;
+  const gchar *func;
+  /* The name of the event */
+  const gchar *format;
+  LbaLogDomain *domain;
+  /* LbaTracePhase */
+  guint16 phase;
+  guint16 flags;
+} LbaTraceEvent;
+
+/* As it's in the ring and in the file of lba_trace_dump () */
+#  define LBA_TRACE_MAGIC "LBATRACE"
+#  define LBA_TRACE_VERSION 2
+
+typedef struct {
+  /* g_get_monotonic_time () */
+  gint64 time;
+  guint32 event;
+  guint32 thread;
+  guint64 args[2];
+} LbaTraceRecord;
+
+/* One per plugin */
+G_GNUC_UNUSED static LbaLogDomain global_lba_log_domain = {
+  LBA_LOG_LEVEL_UNKNOWN, LBA_LOG_LEVEL_UNKNOWN, &global_lba_plugin_name, NULL
+};
+
+/* Returns the level of the domain, registering it if needed */
+gint lba_log_domain_register (LbaLogDomain * domain);
+
+static inline gint
+lba_log_get_level (LbaLogDomain *domain) {
+  gint level = __atomic_load_n (&domain->level, __ATOMIC_RELAXED);
+
+  if (G_UNLIKELY (level == LBA_LOG_LEVEL_UNKNOWN))
+    level = lba_log_domain_register (domain);
+
+  return level;
+}
+
+static inline gboolean
+lba_log_get_trace (LbaLogDomain *domain) {
+  gint trace = __atomic_load_n (&domain->trace, __ATOMIC_RELAXED);
+
+  if (G_UNLIKELY (trace == LBA_LOG_LEVEL_UNKNOWN)) {
+    lba_log_domain_register (domain);
+    trace = __atomic_load_n (&domain->trace, __ATOMIC_RELAXED);
+  }
+
+  return trace;
+}
+
+/* "domain:level,..." as in LBA_LOG, the level can be "trace" too. The
+ * domains can have * and ?.
+ * The later ones win. Returns FALSE if something couldn't be parsed. */
+gboolean lba_log_set_levels (const gchar * spec);
+
+/* Prints the message as the debug of GLib, even without G_MESSAGES_DEBUG:
+ * the level of the domain has already let it through */
+G_GNUC_PRINTF (2, 3)
+void lba_log_message (const gchar * domain, const gchar * format, ...);
+
+void lba_trace_record (LbaTraceEvent * event, guint64 arg0, guint64 arg1);
+gboolean lba_trace_dump (const gchar * path, GError ** err);
+
+#  ifndef LBA_LOG_DISABLED
+
+#    define LBA_LOG_ON(lvl)                                             \
+  G_UNLIKELY (__atomic_load_n (&global_lba_log_domain.level,            \
+                               __ATOMIC_RELAXED) >= (lvl))
+
+#    define LBA_LOG_AT(lvl, form, ...) do {                             \
+    if (LBA_LOG_ON (lvl)                                                \
+        && lba_log_get_level (&global_lba_log_domain) >= (lvl)) {       \
+      lba_log_message (global_lba_plugin_name,                          \
+                       "[%p %s] " form, g_thread_self (), __func__,     \
+                       ##__VA_ARGS__);                                  \
+    }                                                                   \
+  } while (0)
+
+#    define LBA_TRACE_ON()                                              \
+  G_UNLIKELY (__atomic_load_n (&global_lba_log_domain.trace,            \
+                               __ATOMIC_RELAXED))
+
+#    define LBA_TRACE_AT(phase, flags, name, arg0, arg1) do {           \
+    if (LBA_TRACE_ON ()                                                 \
+        && lba_log_get_trace (&global_lba_log_domain)) {                \
+      static LbaTraceEvent lba_trace_event_ =                           \
+          { 0, __LINE__, __func__, name, &global_lba_log_domain,        \
+            phase, flags };                                             \
+                                                                        \
+      lba_trace_record (&lba_trace_event_, (arg0), (arg1));             \
+    }                                                                   \
   } while (0)
 
+#  else
+
+/* Still type-checked, but never called */
+#    define LBA_LOG_ON(lvl) FALSE
+#    define LBA_TRACE_ON() FALSE
+#    define LBA_LOG_AT(lvl, form, ...) do {                             \
+    if (0)                                                              \
+      g_log (NULL, G_LOG_LEVEL_DEBUG, form, ##__VA_ARGS__);             \
+  } while (0)
+#    define LBA_TRACE_AT(phase, flags, name, arg0, arg1) do {           \
+    if (0) {                                                            \
+      (void) (arg0);                                                    \
+      (void) (arg1);                                                    \
+    }                                                                   \
+  } while (0)
+
+#  endif
+
+/* Only recorded if the domain is traced, with two integer arguments */
+#  define LBA_TRACE(name, arg0, arg1)                                   \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_POINT, 0, name, arg0, arg1)
+#  define LBA_TRACE_BEGIN(name, arg0, arg1)                             \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_BEGIN, 0, name, arg0, arg1)
+#  define LBA_TRACE_END(name, arg0, arg1)                               \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_END, 0, name, arg0, arg1)
+
+/* A span named at run time, f.e. by the command. @category is the name of
+ * the event, see LBA_TRACE_FLAG_NAMED for @str. */
+#  define LBA_TRACE_BEGIN_NAMED(category, str, arg)                     \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_BEGIN, LBA_TRACE_FLAG_NAMED, category,  \
+                (guint64) (guintptr) (str), arg)
+#  define LBA_TRACE_END_NAMED(category, str, arg)                       \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_END, LBA_TRACE_FLAG_NAMED, category,    \
+                (guint64) (guintptr) (str), arg)
+
+/* @id links the out to the in, it has to be unique among the flows */
+#  define LBA_TRACE_FLOW_OUT(name, id, arg)                             \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_FLOW_OUT, 0, name, id, arg)
+#  define LBA_TRACE_FLOW_IN(name, id, arg)                              \
+  LBA_TRACE_AT (LBA_TRACE_PHASE_FLOW_IN, 0, name, id, arg)
+
+#  define LBA_LOG(form, ...) LBA_LOG_AT (LBA_LOG_LEVEL_DEBUG, form, ##__VA_ARGS__)
+#  define LBA_INFO(form, ...) LBA_LOG_AT (LBA_LOG_LEVEL_INFO, form, ##__VA_ARGS__)
+
 #  define LBA_ASSERT(cond) do {                   \
     if (G_UNLIKELY (!(cond))) {                   \
       LBA_LOG ("FATAL: %s", #cond);               \
@@ -29,73 +29,865 @@
 #include "bombolla/lba-log.h"
 #include "bombolla/base/lba-picture.h"
 #include <cairo.h>
+#include <string.h>
+
+/* LbaCairo is a live 2D canvas. The frames are rendered in a worker thread,
+ * into a back buffer that nobody else uses, and then published as a whole.
+ * A buffer returns to the pool when the last user of the picture drops it. */
+
+#define LBA_CAIRO_MAX_BUFFERS 4
+/* Damage of the last frames, to bring an older buffer up to date */
+#define LBA_CAIRO_HISTORY (LBA_CAIRO_MAX_BUFFERS + 1)
+/* Unit of the incremental and parallel rendering */
+#define LBA_CAIRO_TILE_SIZE 256
+
+#define DEFAULT_WIDTH 512
+#define DEFAULT_HEIGHT 512
+#define DEFAULT_COMMANDS \
+  "color 0 0 1; font 32 serif bold; text 10 50 Hello from Cairo!!; " \
+  "rect 10 70 20 90; fill"
+
+typedef enum {
+  CMD_COLOR,
+  CMD_CLEAR,
+  CMD_FONT,
+  CMD_TEXT,
+  CMD_MOVE,
+  CMD_LINE,
+  CMD_RECT,
+  CMD_LINE_WIDTH,
+  CMD_FILL,
+  CMD_STROKE
+} LbaCairoCommandType;
+
+/* "name v0 v1 .. [string]", one of:
+ *   color r g b [a], clear r g b [a], font size family [bold],
+ *   text x y string, move x y, line x y, rect x y w h, line-width w,
+ *   fill, stroke */
+static const struct {
+  const gchar *name;
+  LbaCairoCommandType type;
+  guint n_values;
+  gboolean has_string;
+} command_table[] = {
+  { "color", CMD_COLOR, 4, FALSE },
+  { "clear", CMD_CLEAR, 4, FALSE },
+  { "font", CMD_FONT, 1, TRUE },
+  { "text", CMD_TEXT, 2, TRUE },
+  { "move", CMD_MOVE, 2, FALSE },
+  { "line", CMD_LINE, 2, FALSE },
+  { "rect", CMD_RECT, 4, FALSE },
+  { "line-width", CMD_LINE_WIDTH, 1, FALSE },
+  { "fill", CMD_FILL, 0, FALSE },
+  { "stroke", CMD_STROKE, 0, FALSE }
+};
+
+typedef struct {
+  LbaCairoCommandType type;
+  gdouble v[4];
+  gchar *str;
+} LbaCairoCommand;
+
+struct _LbaCairo;
+
+/* Lets the published frames wake up the worker when they are released,
+ * even if they outlive the object */
+typedef struct {
+  gint ref_count;
+  GMutex lock;
+  struct _LbaCairo *self;
+} LbaCairoWaker;
 
 typedef struct _LbaCairo {
   BMixinInstance i;
 
-  cairo_surface_t *surface;
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean stopping;
+
+  /* What the next frame has to redraw */
+  cairo_region_t *damage;
+  /* Frame counter, and what the last frames have redrawn */
+  guint64 seq;
+  cairo_region_t *history[LBA_CAIRO_HISTORY];
+
+  guint width;
+  guint height;
+  guint frame_rate;
+  gchar *commands_str;
+  /* LbaCairoCommand, replaced as a whole */
+  GArray *commands;
+
+  /* LbaCairoBuffer. The surface is referenced by each published frame */
+  GPtrArray *buffers;
+  LbaCairoWaker *waker;
+
+  GThreadPool *tile_pool;
+  GMutex tiles_lock;
+  GCond tiles_cond;
+  guint tiles_pending;
 } LbaCairo;
 
+typedef struct {
+  cairo_surface_t *surface;
+  /* Which frame it has, 0 if none yet */
+  guint64 seq;
+} LbaCairoBuffer;
+
+/* The pixels of a published frame */
+typedef struct {
+  cairo_surface_t *surface;
+  LbaCairoWaker *waker;
+} LbaCairoFrame;
+
+typedef struct {
+  cairo_surface_t *surface;
+  cairo_rectangle_int_t rect;
+  /* The part of the tile to redraw */
+  cairo_region_t *clip;
+  GArray *commands;
+} LbaCairoTile;
+
 typedef struct _LbaCairoClass {
   BMixinClass c;
+
+  void (*invalidate) (GObject *);
+  void (*invalidate_rect) (GObject *, gint x, gint y, gint width, gint height);
 } LbaCairoClass;
 
+typedef enum {
+  PROP_WIDTH = 1,
+  PROP_HEIGHT,
+  PROP_FRAME_RATE,
+  PROP_COMMANDS,
+  N_PROPERTIES
+} LbaCairoProperty;
+
+enum {
+  SIGNAL_DRAW,
+  SIGNAL_INVALIDATE,
+  SIGNAL_INVALIDATE_RECT,
+  LAST_SIGNAL
+};
+
+static guint lba_cairo_signals[LAST_SIGNAL] = { 0 };
+
 BM_DEFINE_MIXIN (lba_cairo, LbaCairo, BM_ADD_DEP (lba_picture));
 
 static void
-lba_cairo_init (GObject *obj, LbaCairo *self) {
+lba_cairo_command_clear (gpointer data) {
+  g_free (((LbaCairoCommand *) data)->str);
+}
+
+static gboolean
+lba_cairo_parse_command (const gchar *str, LbaCairoCommand *cmd) {
+  const gchar *p = str;
+  gsize len;
+  guint i,
+    n;
+
+  len = strcspn (p, " \t");
+
+  for (i = 0; i < G_N_ELEMENTS (command_table); i++) {
+    if (strlen (command_table[i].name) == len
+        && !strncmp (command_table[i].name, p, len))
+      break;
+  }
+
+  if (i == G_N_ELEMENTS (command_table))
+    return FALSE;
+
+  memset (cmd, 0, sizeof (*cmd));
+  cmd->type = command_table[i].type;
+  /* Opaque by default */
+  cmd->v[3] = 1.0;
+  p += len;
+
+  for (n = 0; n < command_table[i].n_values; n++) {
+    gchar *end;
+
+    cmd->v[n] = g_ascii_strtod (p, &end);
+    if (end == p) {
+      if (n == 3 && (cmd->type == CMD_COLOR || cmd->type == CMD_CLEAR)) {
+        cmd->v[3] = 1.0;
+        break;
+      }
+      return FALSE;
+    }
+    p = end;
+  }
+
+  if (command_table[i].has_string) {
+    while (*p == ' ' || *p == '\t')
+      p++;
+    cmd->str = g_strdup (p);
+  }
+
+  return TRUE;
+}
+
+/* "color 1 0 0; rect 0 0 10 10; fill" */
+static GArray *
+lba_cairo_parse_commands (const gchar *str) {
+  GArray *commands = g_array_new (FALSE, FALSE, sizeof (LbaCairoCommand));
+  gchar **lines;
+  guint i;
+
+  g_array_set_clear_func (commands, lba_cairo_command_clear);
+
+  if (!str)
+    return commands;
+
+  lines = g_strsplit (str, ";", -1);
+  for (i = 0; lines[i]; i++) {
+    LbaCairoCommand cmd;
+    gchar *line = g_strstrip (lines[i]);
+
+    if (!*line)
+      continue;
+
+    if (lba_cairo_parse_command (line, &cmd))
+      g_array_append_val (commands, cmd);
+    else
+      g_warning ("Can't parse cairo command '%s'", line);
+  }
+  g_strfreev (lines);
+
+  return commands;
+}
+
+/* NOTE: called in the worker thread */
+static void
+lba_cairo_replay (cairo_t *cr, GArray *commands) {
+  guint i;
+
+  for (i = 0; i < commands->len; i++) {
+    LbaCairoCommand *cmd = &g_array_index (commands, LbaCairoCommand, i);
+
+    switch (cmd->type) {
+    case CMD_COLOR:
+      cairo_set_source_rgba (cr, cmd->v[0], cmd->v[1], cmd->v[2], cmd->v[3]);
+      break;
+    case CMD_CLEAR:
+      cairo_save (cr);
+      cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+      cairo_set_source_rgba (cr, cmd->v[0], cmd->v[1], cmd->v[2], cmd->v[3]);
+      cairo_paint (cr);
+      cairo_restore (cr);
+      break;
+    case CMD_FONT:
+      {
+        gboolean bold = g_str_has_suffix (cmd->str, " bold");
+        gchar *family = bold ? g_strndup (cmd->str, strlen (cmd->str) - 5) :
+            g_strdup (cmd->str);
+
+        cairo_select_font_face (cr, family, CAIRO_FONT_SLANT_NORMAL,
+                                bold ? CAIRO_FONT_WEIGHT_BOLD :
+                                CAIRO_FONT_WEIGHT_NORMAL);
+        cairo_set_font_size (cr, cmd->v[0]);
+        g_free (family);
+      }
+      break;
+    case CMD_TEXT:
+      cairo_move_to (cr, cmd->v[0], cmd->v[1]);
+      cairo_show_text (cr, cmd->str);
+      break;
+    case CMD_MOVE:
+      cairo_move_to (cr, cmd->v[0], cmd->v[1]);
+      break;
+    case CMD_LINE:
+      cairo_line_to (cr, cmd->v[0], cmd->v[1]);
+      break;
+    case CMD_RECT:
+      cairo_rectangle (cr, cmd->v[0], cmd->v[1], cmd->v[2], cmd->v[3]);
+      break;
+    case CMD_LINE_WIDTH:
+      cairo_set_line_width (cr, cmd->v[0]);
+      break;
+    case CMD_FILL:
+      cairo_fill (cr);
+      break;
+    case CMD_STROKE:
+      cairo_stroke (cr);
+      break;
+    }
+  }
+}
+
+/* A buffer is free when only the pool references it.
+ * NOTE: called with the lock taken */
+static LbaCairoBuffer *
+lba_cairo_get_back_buffer (LbaCairo *self, guint w, guint h) {
+  LbaCairoBuffer *buffer;
+  guint i;
+
+  for (i = 0; i < self->buffers->len;) {
+    buffer = g_ptr_array_index (self->buffers, i);
+
+    if (cairo_surface_get_reference_count (buffer->surface) != 1) {
+      i++;
+      continue;
+    }
+
+    if (cairo_image_surface_get_width (buffer->surface) == w
+        && cairo_image_surface_get_height (buffer->surface) == h)
+      return buffer;
+
+    /* The size has changed */
+    g_ptr_array_remove_index_fast (self->buffers, i);
+  }
+
+  if (self->buffers->len >= LBA_CAIRO_MAX_BUFFERS)
+    return NULL;
+
+  buffer = g_new0 (LbaCairoBuffer, 1);
+  buffer->surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, w, h);
+  g_ptr_array_add (self->buffers, buffer);
+
+  return buffer;
+}
+
+static void
+lba_cairo_buffer_free (gpointer data) {
+  LbaCairoBuffer *buffer = (LbaCairoBuffer *) data;
+
+  cairo_surface_destroy (buffer->surface);
+  g_free (buffer);
+}
+
+static LbaCairoWaker *
+lba_cairo_waker_ref (LbaCairoWaker *waker) {
+  g_atomic_int_inc (&waker->ref_count);
+  return waker;
+}
+
+static void
+lba_cairo_waker_unref (LbaCairoWaker *waker) {
+  if (!g_atomic_int_dec_and_test (&waker->ref_count))
+    return;
+
+  g_mutex_clear (&waker->lock);
+  g_free (waker);
+}
+
+/* The buffer of the frame can be reused now, so the worker may be waiting
+ * for it. NOTE: called wherever the last user drops the picture */
+static void
+lba_cairo_frame_free (gpointer data) {
+  LbaCairoFrame *frame = (LbaCairoFrame *) data;
+  LbaCairoWaker *waker = frame->waker;
+
+  cairo_surface_destroy (frame->surface);
+
+  g_mutex_lock (&waker->lock);
+  if (waker->self) {
+    g_mutex_lock (&waker->self->lock);
+    g_cond_signal (&waker->self->cond);
+    g_mutex_unlock (&waker->self->lock);
+  }
+  g_mutex_unlock (&waker->lock);
+
+  lba_cairo_waker_unref (waker);
+  g_free (frame);
+}
+
+/* NOTE: called with the lock taken */
+static void
+lba_cairo_damage_all (LbaCairo *self) {
+  cairo_rectangle_int_t all = { 0, 0, self->width, self->height };
+
+  cairo_region_union_rectangle (self->damage, &all);
+  g_cond_signal (&self->cond);
+}
+
+/* NOTE: called in the worker thread or in the tile pool */
+static void
+lba_cairo_render_tile (LbaCairoTile *tile) {
+  int stride = cairo_image_surface_get_stride (tile->surface);
+  guchar *data;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  gint i,
+    n;
+
+  /* The tiles don't overlap, so each one gets its own surface over its part
+   * of the buffer and they can be drawn in parallel */
+  data = cairo_image_surface_get_data (tile->surface)
+      + tile->rect.y * stride + tile->rect.x * 4;
+  surface = cairo_image_surface_create_for_data (data, CAIRO_FORMAT_ARGB32,
+                                                 tile->rect.width,
+                                                 tile->rect.height, stride);
+  cr = cairo_create (surface);
+  cairo_translate (cr, -tile->rect.x, -tile->rect.y);
+
+  n = cairo_region_num_rectangles (tile->clip);
+  for (i = 0; i < n; i++) {
+    cairo_rectangle_int_t r;
+
+    cairo_region_get_rectangle (tile->clip, i, &r);
+    cairo_rectangle (cr, r.x, r.y, r.width, r.height);
+  }
+  cairo_clip (cr);
+
+  cairo_save (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_restore (cr);
+
+  lba_cairo_replay (cr, tile->commands);
+
+  cairo_destroy (cr);
+  cairo_surface_finish (surface);
+  cairo_surface_destroy (surface);
+}
+
+static void
+lba_cairo_tile_pool_func (gpointer data, gpointer user_data) {
+  LbaCairoTile *tile = (LbaCairoTile *) data;
+  LbaCairo *self = (LbaCairo *) user_data;
 
-  const char fmt[16] = "argb8888";
-  guint w = 512;
-  guint h = 512;
+  lba_cairo_render_tile (tile);
 
-  /* Cairo */
-  self->surface =
-      /* todo fmt lba <--> cairo */
-      cairo_image_surface_create (CAIRO_FORMAT_ARGB32, h, w);
+  g_mutex_lock (&self->tiles_lock);
+  if (--self->tiles_pending == 0)
+    g_cond_signal (&self->tiles_cond);
+  g_mutex_unlock (&self->tiles_lock);
+}
+
+/* Replays the commands in the tiles that intersect @region, and then lets
+ * the "draw" handlers add their part.
+ * NOTE: called in the worker thread */
+static void
+lba_cairo_render_region (LbaCairo *self, cairo_surface_t *surface,
+                         cairo_region_t *region, GArray *commands, guint w,
+                         guint h) {
+  GArray *tiles = g_array_new (FALSE, FALSE, sizeof (LbaCairoTile));
+  LbaCairoTile tile = {.surface = surface,.commands = commands };
+  guint i;
+  gint n;
+
+  for (tile.rect.y = 0; tile.rect.y < h; tile.rect.y += LBA_CAIRO_TILE_SIZE) {
+    for (tile.rect.x = 0; tile.rect.x < w; tile.rect.x += LBA_CAIRO_TILE_SIZE) {
+      tile.rect.width = MIN (LBA_CAIRO_TILE_SIZE, w - tile.rect.x);
+      tile.rect.height = MIN (LBA_CAIRO_TILE_SIZE, h - tile.rect.y);
+
+      if (cairo_region_contains_rectangle (region, &tile.rect)
+          == CAIRO_REGION_OVERLAP_OUT)
+        continue;
+
+      tile.clip = cairo_region_create_rectangle (&tile.rect);
+      cairo_region_intersect (tile.clip, region);
+      g_array_append_val (tiles, tile);
+    }
+  }
+
+  cairo_surface_flush (surface);
+
+  if (tiles->len == 1 || !self->tile_pool) {
+    for (i = 0; i < tiles->len; i++)
+      lba_cairo_render_tile (&g_array_index (tiles, LbaCairoTile, i));
+  } else {
+    self->tiles_pending = tiles->len;
+    for (i = 0; i < tiles->len; i++)
+      g_thread_pool_push (self->tile_pool, &g_array_index (tiles, LbaCairoTile, i),
+                          NULL);
+
+    g_mutex_lock (&self->tiles_lock);
+    while (self->tiles_pending)
+      g_cond_wait (&self->tiles_cond, &self->tiles_lock);
+    g_mutex_unlock (&self->tiles_lock);
+  }
+
+  /* Modified behind cairo's back */
+  cairo_surface_mark_dirty (surface);
+
+  for (i = 0; i < tiles->len; i++)
+    cairo_region_destroy (g_array_index (tiles, LbaCairoTile, i).clip);
+  g_array_free (tiles, TRUE);
 
-  {
-    cairo_t *cr = cairo_create (self->surface);
+  if (g_signal_has_handler_pending (BM_GET_GOBJECT (self),
+                                    lba_cairo_signals[SIGNAL_DRAW], 0, FALSE)) {
+    cairo_t *cr = cairo_create (surface);
 
-    /* --------------------------------------- how to?? */
-    cairo_select_font_face (cr, "serif", CAIRO_FONT_SLANT_NORMAL,
-                            CAIRO_FONT_WEIGHT_BOLD);
-    cairo_set_font_size (cr, 32.0);
-    cairo_set_source_rgb (cr, 0.0, 0.0, 1.0);
-    cairo_move_to (cr, 10.0, 50.0);
-    cairo_show_text (cr, "Hello from Cairo!!");
+    for (n = 0; n < cairo_region_num_rectangles (region); n++) {
+      cairo_rectangle_int_t r;
 
-    cairo_rectangle (cr, 10.0, 70.0, 20.0, 90.0);
-    cairo_fill (cr);
-    /* ---------------------------------------- */
+      cairo_region_get_rectangle (region, n, &r);
+      cairo_rectangle (cr, r.x, r.y, r.width, r.height);
+    }
+    cairo_clip (cr);
 
+    g_signal_emit (BM_GET_GOBJECT (self), lba_cairo_signals[SIGNAL_DRAW], 0, cr,
+                   w, h);
     cairo_destroy (cr);
+  }
+}
+
+/* Publishes what @damage covers with the next frame */
+static void
+lba_cairo_set_damage (LbaCairo *self, cairo_region_t *damage, guint w, guint h) {
+  LbaPictureRect rects[LBA_PICTURE_MAX_DAMAGE];
+  cairo_rectangle_int_t all = { 0, 0, w, h };
+  gint i,
+    n = cairo_region_num_rectangles (damage);
+
+  if (n > LBA_PICTURE_MAX_DAMAGE
+      || cairo_region_contains_rectangle (damage, &all) == CAIRO_REGION_OVERLAP_IN) {
+    lba_picture_set_damage (BM_GET_GOBJECT (self), NULL, 0);
+    return;
+  }
+
+  for (i = 0; i < n; i++) {
+    cairo_rectangle_int_t r;
+
+    cairo_region_get_rectangle (damage, i, &r);
+    rects[i].x = r.x;
+    rects[i].y = r.y;
+    rects[i].w = r.width;
+    rects[i].h = r.height;
+  }
+
+  lba_picture_set_damage (BM_GET_GOBJECT (self), rects, n);
+}
+
+/* NOTE: called in the worker thread with the lock taken */
+static gboolean
+lba_cairo_render (LbaCairo *self) {
+  GObject *obj = BM_GET_GOBJECT (self);
+  LbaCairoBuffer *buffer;
+  cairo_surface_t *surface;
+  cairo_region_t *damage,
+   *redraw;
+  GBytes *bytes;
+  GArray *commands;
+  LbaCairoFrame *frame;
+  guint w = self->width,
+    h = self->height;
+  guint64 seq,
+    s;
+  int stride;
+
+  buffer = lba_cairo_get_back_buffer (self, w, h);
+  if (!buffer) {
+    LBA_LOG ("All the buffers are in use, skipping the frame");
+    return FALSE;
+  }
+
+  damage = self->damage;
+  self->damage = cairo_region_create ();
+  seq = ++self->seq;
+
+  /* The buffer also misses what the frames since it was drawn have changed */
+  redraw = cairo_region_copy (damage);
+  if (!buffer->seq || seq - buffer->seq >= LBA_CAIRO_HISTORY) {
+    cairo_rectangle_int_t all = { 0, 0, w, h };
+
+    cairo_region_union_rectangle (redraw, &all);
+  } else {
+    for (s = buffer->seq + 1; s < seq; s++)
+      cairo_region_union (redraw, self->history[s % LBA_CAIRO_HISTORY]);
+  }
+
+  g_clear_pointer (&self->history[seq % LBA_CAIRO_HISTORY], cairo_region_destroy);
+  self->history[seq % LBA_CAIRO_HISTORY] = cairo_region_reference (damage);
+  buffer->seq = seq;
+
+  /* Protect the buffer from being reused by the next frame */
+  surface = cairo_surface_reference (buffer->surface);
+  commands = g_array_ref (self->commands);
+  g_mutex_unlock (&self->lock);
+
+  lba_cairo_render_region (self, surface, redraw, commands, w, h);
+  cairo_region_destroy (redraw);
+  g_array_unref (commands);
+
+  stride = cairo_image_surface_get_stride (surface);
+  frame = g_new (LbaCairoFrame, 1);
+  frame->surface = surface;
+  frame->waker = lba_cairo_waker_ref (self->waker);
+  bytes = g_bytes_new_with_free_func (cairo_image_surface_get_data (surface),
+                                      stride * h, lba_cairo_frame_free, frame);
+
+  lba_cairo_set_damage (self, damage, w, h);
+  cairo_region_destroy (damage);
+
+  /* CAIRO_FORMAT_ARGB32 is a premultiplied native endian 32 bit word */
+  lba_picture_set_full (obj, lba_pixel_format_to_string
+                        (G_BYTE_ORDER == G_LITTLE_ENDIAN ?
+                         LBA_PIXEL_FORMAT_BGRA8888_PRE :
+                         LBA_PIXEL_FORMAT_ARGB8888_PRE), w, h, stride, bytes);
+
+  g_mutex_lock (&self->lock);
+  return TRUE;
+}
+
+static gpointer
+lba_cairo_thread (gpointer data) {
+  LbaCairo *self = (LbaCairo *) data;
+  gint64 next_frame = 0;
+
+  g_mutex_lock (&self->lock);
+  while (!self->stopping) {
+    gint64 now = g_get_monotonic_time ();
+
+    if (self->frame_rate && now >= next_frame) {
+      lba_cairo_damage_all (self);
+      next_frame = MAX (next_frame + G_USEC_PER_SEC / self->frame_rate, now);
+    }
+
+    if (cairo_region_is_empty (self->damage)) {
+      if (self->frame_rate)
+        g_cond_wait_until (&self->cond, &self->lock, next_frame);
+      else
+        g_cond_wait (&self->cond, &self->lock);
+      continue;
+    }
+
+    if (!lba_cairo_render (self)) {
+      /* Retry when some buffer is released, the damage is still there */
+      if (self->frame_rate)
+        g_cond_wait_until (&self->cond, &self->lock, next_frame);
+      else
+        g_cond_wait (&self->cond, &self->lock);
+    }
+  }
+  g_mutex_unlock (&self->lock);
+
+  return NULL;
+}
+
+static void
+lba_cairo_invalidate (GObject *obj) {
+  LbaCairo *self = bm_get_LbaCairo (obj);
+
+  g_mutex_lock (&self->lock);
+  lba_cairo_damage_all (self);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+lba_cairo_invalidate_rect (GObject *obj, gint x, gint y, gint width, gint height) {
+  LbaCairo *self = bm_get_LbaCairo (obj);
+  cairo_rectangle_int_t rect = { x, y, width, height };
+
+  g_mutex_lock (&self->lock);
+  cairo_region_union_rectangle (self->damage, &rect);
+  g_cond_signal (&self->cond);
+  g_mutex_unlock (&self->lock);
+}
 
-    /* Must do after modifying the surface */
-    cairo_surface_flush (self->surface);
-    cairo_surface_mark_dirty (self->surface);
+static void
+lba_cairo_set_property (GObject *object,
+                        guint property_id, const GValue *value, GParamSpec *pspec) {
+  LbaCairo *self = bm_get_LbaCairo (object);
+
+  g_mutex_lock (&self->lock);
+  switch ((LbaCairoProperty) property_id) {
+  case PROP_WIDTH:
+    self->width = g_value_get_uint (value);
+    break;
+  case PROP_HEIGHT:
+    self->height = g_value_get_uint (value);
+    break;
+  case PROP_FRAME_RATE:
+    self->frame_rate = g_value_get_uint (value);
+    break;
+  case PROP_COMMANDS:
+    g_free (self->commands_str);
+    self->commands_str = g_value_dup_string (value);
+    g_array_unref (self->commands);
+    /* Parsed once, replayed by every frame */
+    self->commands = lba_cairo_parse_commands (self->commands_str);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
   }
 
-  lba_picture_set (obj, fmt, w, h,
-                   g_bytes_new_with_free_func (cairo_image_surface_get_data
-                                               (self->surface), w * h * 4,
-                                               /* TODO need to block and unblock when the surface have been rendered
-                                                * (in the OpenGL thread). So we don't modify the surface meanwhile. */
-                                               NULL, NULL));
+  lba_cairo_damage_all (self);
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+lba_cairo_get_property (GObject *object,
+                        guint property_id, GValue *value, GParamSpec *pspec) {
+  LbaCairo *self = bm_get_LbaCairo (object);
+
+  g_mutex_lock (&self->lock);
+  switch ((LbaCairoProperty) property_id) {
+  case PROP_WIDTH:
+    g_value_set_uint (value, self->width);
+    break;
+  case PROP_HEIGHT:
+    g_value_set_uint (value, self->height);
+    break;
+  case PROP_FRAME_RATE:
+    g_value_set_uint (value, self->frame_rate);
+    break;
+  case PROP_COMMANDS:
+    g_value_set_string (value, self->commands_str);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+  g_mutex_unlock (&self->lock);
+}
+
+static void
+lba_cairo_init (GObject *obj, LbaCairo *self) {
+  g_mutex_init (&self->lock);
+  g_cond_init (&self->cond);
+
+  self->width = DEFAULT_WIDTH;
+  self->height = DEFAULT_HEIGHT;
+  self->commands_str = g_strdup (DEFAULT_COMMANDS);
+  self->commands = lba_cairo_parse_commands (self->commands_str);
+  self->buffers = g_ptr_array_new_with_free_func (lba_cairo_buffer_free);
+  self->damage = cairo_region_create ();
+  self->waker = g_new0 (LbaCairoWaker, 1);
+  self->waker->ref_count = 1;
+  g_mutex_init (&self->waker->lock);
+  self->waker->self = self;
+  g_mutex_init (&self->tiles_lock);
+  g_cond_init (&self->tiles_cond);
+}
+
+static void
+lba_cairo_constructed (GObject *gobject) {
+  LbaCairo *self = bm_get_LbaCairo (gobject);
+
+  /* Independent tiles are drawn in parallel */
+  if (g_get_num_processors () > 1) {
+    self->tile_pool = g_thread_pool_new (lba_cairo_tile_pool_func, self,
+                                         g_get_num_processors (), FALSE, NULL);
+  }
+
+  /* The first frame */
+  g_mutex_lock (&self->lock);
+  lba_cairo_damage_all (self);
+  g_mutex_unlock (&self->lock);
+
+  self->thread = g_thread_new ("LbaCairo", lba_cairo_thread, self);
+
+  BM_CHAINUP (self, GObject)->constructed (gobject);
 }
 
 static void
 lba_cairo_dispose (GObject *gobject) {
   LbaCairo *self = bm_get_LbaCairo (gobject);
 
-  g_clear_pointer (&self->surface, cairo_surface_destroy);
+  if (self->thread) {
+    g_mutex_lock (&self->lock);
+    self->stopping = TRUE;
+    g_cond_signal (&self->cond);
+    g_mutex_unlock (&self->lock);
+
+    g_thread_join (self->thread);
+    self->thread = NULL;
+  }
+
+  if (self->tile_pool) {
+    g_thread_pool_free (self->tile_pool, FALSE, TRUE);
+    self->tile_pool = NULL;
+  }
+
+  /* The published frames keep their own references */
+  g_clear_pointer (&self->buffers, g_ptr_array_unref);
 
   BM_CHAINUP (self, GObject)->dispose (gobject);
 }
 
+static void
+lba_cairo_finalize (GObject *gobject) {
+  LbaCairo *self = bm_get_LbaCairo (gobject);
+  guint i;
+
+  g_clear_pointer (&self->commands, g_array_unref);
+  g_clear_pointer (&self->commands_str, g_free);
+  g_clear_pointer (&self->damage, cairo_region_destroy);
+  for (i = 0; i < LBA_CAIRO_HISTORY; i++)
+    g_clear_pointer (&self->history[i], cairo_region_destroy);
+
+  /* The frames that are still out there won't wake anybody up anymore */
+  g_mutex_lock (&self->waker->lock);
+  self->waker->self = NULL;
+  g_mutex_unlock (&self->waker->lock);
+  g_clear_pointer (&self->waker, lba_cairo_waker_unref);
+
+  g_mutex_clear (&self->tiles_lock);
+  g_cond_clear (&self->tiles_cond);
+  g_cond_clear (&self->cond);
+  g_mutex_clear (&self->lock);
+
+  BM_CHAINUP (self, GObject)->finalize (gobject);
+}
+
 static void
 lba_cairo_class_init (GObjectClass *gobj_class, LbaCairoClass *klass) {
+  gobj_class->constructed = lba_cairo_constructed;
   gobj_class->dispose = lba_cairo_dispose;
+  gobj_class->finalize = lba_cairo_finalize;
+  gobj_class->set_property = lba_cairo_set_property;
+  gobj_class->get_property = lba_cairo_get_property;
+
+  klass->invalidate = lba_cairo_invalidate;
+  klass->invalidate_rect = lba_cairo_invalidate_rect;
+
+  g_object_class_install_property (gobj_class, PROP_WIDTH,
+                                   g_param_spec_uint ("width",
+                                                      "Width", "Width",
+                                                      1, G_MAXUINT16, DEFAULT_WIDTH,
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_HEIGHT,
+                                   g_param_spec_uint ("height",
+                                                      "Height", "Height",
+                                                      1, G_MAXUINT16, DEFAULT_HEIGHT,
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAME_RATE,
+                                   g_param_spec_uint ("frame-rate",
+                                                      "Frame rate",
+                                                      "Frames per second to render, "
+                                                      "0 to render only on changes",
+                                                      0, 1000, 0,
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_COMMANDS,
+                                   g_param_spec_string ("commands",
+                                                        "Commands",
+                                                        "Drawing commands separated by ';'",
+                                                        DEFAULT_COMMANDS,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READWRITE));
+
+  /* Emitted in the worker thread once per frame, with a cairo_t of the back
+   * buffer clipped to what has been redrawn. The commands are already
+   * there, so the handlers draw on top of them */
+  lba_cairo_signals[SIGNAL_DRAW] =
+      g_signal_new ("draw", G_TYPE_FROM_CLASS (gobj_class),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 3, G_TYPE_POINTER,
+                    G_TYPE_UINT, G_TYPE_UINT);
+
+  /* Requests a new frame */
+  lba_cairo_signals[SIGNAL_INVALIDATE] =
+      g_signal_new ("invalidate", G_TYPE_FROM_CLASS (gobj_class),
+                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                    BM_CLASS_VFUNC_OFFSET (klass, invalidate),
+                    NULL, NULL, NULL, G_TYPE_NONE, 0);
+
+  /* Requests a new frame that only redraws the given area */
+  lba_cairo_signals[SIGNAL_INVALIDATE_RECT] =
+      g_signal_new ("invalidate-rect", G_TYPE_FROM_CLASS (gobj_class),
+                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                    BM_CLASS_VFUNC_OFFSET (klass, invalidate_rect),
+                    NULL, NULL, NULL, G_TYPE_NONE, 4, G_TYPE_INT, G_TYPE_INT,
+                    G_TYPE_INT, G_TYPE_INT);
 }
 
 /* Export plugin */
@@ -37,6 +37,10 @@ typedef struct _LbaICoglInterface {
   void (*reopen) (GObject * obj, CoglFramebuffer * fb, CoglPipeline * pipeline,
                   CoglContext * ctx);
   void (*get_ctx) (GObject * obj, CoglContext ** ctx, CoglPipeline ** pipeline);
+
+  /* Optional: paints n objects of the same type and texture in one go */
+  void (*paint_batch) (GObject ** objs, guint n, CoglFramebuffer * fb,
+                       CoglPipeline * pipeline);
 } LbaICoglInterface;
 
 typedef LbaICoglInterface LbaICogl;
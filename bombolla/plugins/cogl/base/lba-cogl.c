@@ -75,7 +75,8 @@ lba_cogl_draw (BaseDrawable *obj) {
   LbaCogl *self = bm_get_LbaCogl (obj);
   LbaICogl *iface;
 
-  LBA_LOG ("draw");
+  /* NOTE: can't be looked up in init, the children's class is not there
+   * yet, and paint is implemented by them */
   iface = G_TYPE_INSTANCE_GET_INTERFACE (obj, LBA_ICOGL, LbaICogl);
 
   if (!iface->paint)
@@ -97,6 +98,37 @@ done:
   g_mutex_unlock (&self->lock);
 }
 
+static void
+lba_cogl_draw_batch (BaseDrawable **objs, guint n) {
+  LbaCogl *self = bm_get_LbaCogl (objs[0]);
+  LbaICogl *iface;
+  guint i;
+
+  iface = G_TYPE_INSTANCE_GET_INTERFACE (objs[0], LBA_ICOGL, LbaICogl);
+
+  if (!iface->paint_batch) {
+    for (i = 0; i < n; i++)
+      lba_cogl_draw (objs[i]);
+    return;
+  }
+
+  /* All the objects share the drawing scene, so it's enough to
+   * take the framebuffer and the pipeline of the first one */
+  g_mutex_lock (&self->lock);
+  if (G_UNLIKELY (self->closing))
+    goto done;
+
+  if (!self->fb || !self->pipeline) {
+    LBA_LOG ("Incompatible drawing scene: needs COGL framebuffer and pipeline");
+    goto done;
+  }
+
+  iface->paint_batch ((GObject **) objs, n, self->fb, self->pipeline);
+
+done:
+  g_mutex_unlock (&self->lock);
+}
+
 static void
 lba_cogl_scene_reopen (GObject *scene, gpointer user_data) {
   LbaICogl *iface;
@@ -176,6 +208,7 @@ lba_cogl_class_init (GObjectClass *gobject_class, LbaCoglClass *mixin_class) {
   BaseDrawableClass *base_drawable_class = (BaseDrawableClass *) gobject_class;
 
   base_drawable_class->draw = lba_cogl_draw;
+  base_drawable_class->draw_batch = lba_cogl_draw_batch;
   gobject_class->finalize = lba_cogl_finalize;
 }
 
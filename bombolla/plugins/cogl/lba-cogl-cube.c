@@ -26,18 +26,106 @@
  */
 
 #include <bmixin/bmixin.h>
+#include <math.h>
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
 #include "bombolla/base/i3d.h"
+#include "bombolla/base/lba-basedrawable.h"
+#include "bombolla/base/lba-frame-clock.h"
 #include "base/icogl.h"
 
+/* All the cubes are drawn from one unit cube: the positions live in the
+ * shared instance arrays (SoA), and each paint expands as many cubes as
+ * fits into one vertex buffer, so N cubes take N / LBA_COGL_CUBE_BATCH
+ * draw calls.
+ * NOTE: Cogl has no API for the hardware instancing, so the instances
+ * are expanded on the CPU. */
+
+/* 24 vertices per cube must fit in 16 bit indices */
+#define LBA_COGL_CUBE_BATCH 2048
+#define LBA_COGL_CUBE_N_VERTICES 24
+#define LBA_COGL_CUBE_SIZE 3.0f
+#define LBA_COGL_CUBE_ROTATION_SPEED 15.0f      /* degrees per second */
+
+typedef struct {
+  gint refcount;
+
+  /* Instances */
+  gfloat *x;
+  gfloat *y;
+  gfloat *z;
+  guint n_slots;
+  GArray *free_slots;
+
+  /* Same rotation for all the cubes, advanced in the update phase of the
+   * frame clock of the scene */
+  gint64 last_frame_ts;
+  gfloat rotation;
+  LbaFrameClock *clock;
+  guint clock_handler;
+
+  /* GPU side, recreated if the context changes */
+  CoglContext *ctx;
+  CoglAttributeBuffer *buffer;
+  CoglPrimitive *prim;
+
+  /* Scratch space to expand the instances */
+  CoglVertexP3T2 *vertices;
+  gfloat *px;
+  gfloat *py;
+  gfloat *pz;
+  gfloat *rx;
+  gfloat *ry;
+  gfloat *rz;
+} LbaCoglCubeShared;
+
+G_LOCK_DEFINE_STATIC (shared);
+static LbaCoglCubeShared *shared;
+
+/* Unit cube */
+static const CoglVertexP3T2 lba_cogl_cube_vertices[LBA_COGL_CUBE_N_VERTICES] = {
+  /* Front face */
+  { -1.0f, -1.0f, 1.0f, 0.0f, 1.0f },
+  { 1.0f, -1.0f, 1.0f, 1.0f, 1.0f },
+  { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f },
+  { -1.0f, 1.0f, 1.0f, 0.0f, 0.0f },
+
+  /* Back face */
+  { -1.0f, -1.0f, -1.0f, 1.0f, 0.0f },
+  { -1.0f, 1.0f, -1.0f, 1.0f, 1.0f },
+  { 1.0f, 1.0f, -1.0f, 0.0f, 1.0f },
+  { 1.0f, -1.0f, -1.0f, 0.0f, 0.0f },
+
+  /* Top face */
+  { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f },
+  { -1.0f, 1.0f, 1.0f, 0.0f, 0.0f },
+  { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f },
+  { 1.0f, 1.0f, -1.0f, 1.0f, 1.0f },
+
+  /* Bottom face */
+  { -1.0f, -1.0f, -1.0f, 1.0f, 1.0f },
+  { 1.0f, -1.0f, -1.0f, 0.0f, 1.0f },
+  { 1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+  { -1.0f, -1.0f, 1.0f, 1.0f, 0.0f },
+
+  /* Right face */
+  { 1.0f, -1.0f, -1.0f, 1.0f, 0.0f },
+  { 1.0f, 1.0f, -1.0f, 1.0f, 1.0f },
+  { 1.0f, 1.0f, 1.0f, 0.0f, 1.0f },
+  { 1.0f, -1.0f, 1.0f, 0.0f, 0.0f },
+
+  /* Left face */
+  { -1.0f, -1.0f, -1.0f, 0.0f, 0.0f },
+  { -1.0f, -1.0f, 1.0f, 1.0f, 0.0f },
+  { -1.0f, 1.0f, 1.0f, 1.0f, 1.0f },
+  { -1.0f, 1.0f, -1.0f, 0.0f, 1.0f }
+};
+
 typedef struct _LbaCoglCube {
   BMixinInstance i;
-  CoglPrimitive *prim;
-  CoglIndices *indices;
 
-  guint64 last_frame_ts;
-  float rotation;
+  /* Index in the shared instance arrays */
+  guint slot;
 } LbaCoglCube;
 
 typedef struct _LbaCoglCubeClass {
@@ -58,145 +146,386 @@ BM_DEFINE_MIXIN (lba_cogl_cube, LbaCoglCube,
     BM_ADD_DEP (lba_mixin_3d));
 /* *INDENT-ON* */ 
 
+/* NOTE: called with the lock taken */
 static void
-lba_cogl_cube_paint (GObject *obj, CoglFramebuffer *fb, CoglPipeline *pipeline) {
-  int framebuffer_width;
-  int framebuffer_height;
+lba_cogl_cube_shared_clear_gpu (LbaCoglCubeShared *sh) {
+  g_clear_pointer (&sh->prim, cogl_object_unref);
+  g_clear_pointer (&sh->buffer, cogl_object_unref);
+  sh->ctx = NULL;
+}
+
+/* NOTE: called with the lock taken */
+static void
+lba_cogl_cube_shared_ensure_gpu (LbaCoglCubeShared *sh, CoglContext *ctx) {
+  CoglAttribute *attributes[2];
+  CoglIndices *indices;
+
+  if (sh->ctx == ctx)
+    return;
+
+  lba_cogl_cube_shared_clear_gpu (sh);
+
+  sh->buffer = cogl_attribute_buffer_new (ctx, sizeof (CoglVertexP3T2)
+                                          * LBA_COGL_CUBE_N_VERTICES
+                                          * LBA_COGL_CUBE_BATCH, NULL);
+
+  attributes[0] = cogl_attribute_new (sh->buffer, "cogl_position_in",
+                                      sizeof (CoglVertexP3T2),
+                                      G_STRUCT_OFFSET (CoglVertexP3T2, x),
+                                      3, COGL_ATTRIBUTE_TYPE_FLOAT);
+  attributes[1] = cogl_attribute_new (sh->buffer, "cogl_tex_coord0_in",
+                                      sizeof (CoglVertexP3T2),
+                                      G_STRUCT_OFFSET (CoglVertexP3T2, s),
+                                      2, COGL_ATTRIBUTE_TYPE_FLOAT);
+
+  sh->prim = cogl_primitive_new_with_attributes (COGL_VERTICES_MODE_TRIANGLES,
+                                                 LBA_COGL_CUBE_N_VERTICES
+                                                 * LBA_COGL_CUBE_BATCH,
+                                                 attributes, 2);
+  cogl_object_unref (attributes[0]);
+  cogl_object_unref (attributes[1]);
+
+  /* 6 faces per cube, each face is a rectangle */
+  indices = cogl_get_rectangle_indices (ctx, 6 * LBA_COGL_CUBE_BATCH);
+  cogl_primitive_set_indices (sh->prim, indices, 6 * 6 * LBA_COGL_CUBE_BATCH);
+
+  sh->ctx = ctx;
+}
+
+static guint
+lba_cogl_cube_shared_new_slot (void) {
+  guint slot;
+
+  G_LOCK (shared);
+  if (!shared) {
+    shared = g_new0 (LbaCoglCubeShared, 1);
+    shared->free_slots = g_array_new (FALSE, FALSE, sizeof (guint));
+    shared->vertices = g_new (CoglVertexP3T2,
+                              LBA_COGL_CUBE_N_VERTICES * LBA_COGL_CUBE_BATCH);
+    shared->px = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+    shared->py = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+    shared->pz = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+    shared->rx = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+    shared->ry = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+    shared->rz = g_new (gfloat, LBA_COGL_CUBE_BATCH);
+  }
+
+  shared->refcount++;
+
+  if (shared->free_slots->len > 0) {
+    slot = g_array_index (shared->free_slots, guint, shared->free_slots->len - 1);
+    g_array_set_size (shared->free_slots, shared->free_slots->len - 1);
+  } else {
+    slot = shared->n_slots++;
+    /* Grow by powers of 2 */
+    if ((slot & (slot - 1)) == 0) {
+      guint n = MAX (slot * 2, 16);
+
+      shared->x = g_renew (gfloat, shared->x, n);
+      shared->y = g_renew (gfloat, shared->y, n);
+      shared->z = g_renew (gfloat, shared->z, n);
+    }
+  }
+
+  shared->x[slot] = shared->y[slot] = shared->z[slot] = 0;
+  G_UNLOCK (shared);
+
+  return slot;
+}
+
+/* Update phase: turn all the cubes once per frame */
+static void
+lba_cogl_cube_update_cb (LbaFrameClock *clock, gint64 frame_time,
+                         gpointer user_data) {
+  G_LOCK (shared);
+  if (shared && shared->clock == clock) {
+    // TODO: there should be Lba3DMotion mixin.
+    // With the speed of motions x.y.z rotation(x,y,z) as properties
+    if (shared->last_frame_ts != 0) {
+      shared->rotation += (frame_time - shared->last_frame_ts)
+          * LBA_COGL_CUBE_ROTATION_SPEED / G_TIME_SPAN_SECOND;
+      shared->rotation = fmodf (shared->rotation, 360.0f);
+    }
+
+    shared->last_frame_ts = frame_time;
+  }
+  G_UNLOCK (shared);
+}
+
+/* The clock is freed together with its window */
+static void
+lba_cogl_cube_clock_gone (gpointer data) {
+  G_LOCK (shared);
+  if (shared && shared->clock == data) {
+    shared->clock = NULL;
+    shared->clock_handler = 0;
+  }
+  G_UNLOCK (shared);
+}
+
+/* NOTE: the clock runs the handlers with its own lock taken, so it's only
+ * called without the shared lock */
+static void
+lba_cogl_cube_shared_set_clock (LbaFrameClock *clock) {
+  LbaFrameClock *old;
+  guint old_handler,
+    handler;
+
+  G_LOCK (shared);
+  old = shared->clock;
+  old_handler = shared->clock_handler;
+  if (old == clock) {
+    G_UNLOCK (shared);
+    return;
+  }
+
+  shared->clock = clock;
+  shared->clock_handler = 0;
+  G_UNLOCK (shared);
+
+  if (old)
+    lba_frame_clock_remove (old, old_handler);
+
+  if (!clock)
+    return;
+
+  handler = lba_frame_clock_add (clock, LBA_FRAME_CLOCK_PHASE_UPDATE,
+                                 lba_cogl_cube_update_cb, clock,
+                                 lba_cogl_cube_clock_gone);
+
+  G_LOCK (shared);
+  if (shared && shared->clock == clock)
+    shared->clock_handler = handler;
+  G_UNLOCK (shared);
+}
+
+static void
+lba_cogl_cube_shared_free_slot (guint slot) {
+  LbaFrameClock *clock = NULL;
+  guint clock_handler = 0;
+
+  G_LOCK (shared);
+  g_array_append_val (shared->free_slots, slot);
+
+  if (--shared->refcount == 0) {
+    clock = shared->clock;
+    clock_handler = shared->clock_handler;
+
+    lba_cogl_cube_shared_clear_gpu (shared);
+    g_array_free (shared->free_slots, TRUE);
+    g_free (shared->x);
+    g_free (shared->y);
+    g_free (shared->z);
+    g_free (shared->vertices);
+    g_free (shared->px);
+    g_free (shared->py);
+    g_free (shared->pz);
+    g_free (shared->rx);
+    g_free (shared->ry);
+    g_free (shared->rz);
+    g_clear_pointer (&shared, g_free);
+  }
+  G_UNLOCK (shared);
+
+  if (clock)
+    lba_frame_clock_remove (clock, clock_handler);
+}
+
+/* x/y/z only update the instance data, the geometry is shared */
+static void
+lba_cogl_cube_xyz_changed (GObject *obj, GParamSpec *pspec, gpointer data) {
   LbaCoglCube *self = bm_get_LbaCoglCube (obj);
+  LbaI3D *iface3d = G_TYPE_INSTANCE_GET_INTERFACE (obj, LBA_I3D, LbaI3D);
+  gdouble x,
+    y,
+    z;
 
-  // make the cubes spin.
-  // TODO: there should be Lba3DMotion mixin.
-  // With the speed of motions x.y.z rotation(x,y,z) as properties
-  {
-    guint rotation_speed_degrees_per_second = 15;
-    guint64 now = g_get_monotonic_time ();
+  iface3d->xyz (obj, &x, &y, &z);
 
-    guint64 time_elapsed = now - self->last_frame_ts;
+  G_LOCK (shared);
+  shared->x[self->slot] = x;
+  shared->y[self->slot] = y;
+  shared->z[self->slot] = z;
+  G_UNLOCK (shared);
+}
 
-    double secs_elapsed = (double)time_elapsed / (double)G_TIME_SPAN_SECOND;
+/* rotation matrix of the cubes: Rz * Ry * Rx, all by the same angle */
+static void
+lba_cogl_cube_rotation_matrix (gfloat degrees, gfloat m[9]) {
+  gfloat a = degrees * G_PI / 180.0f;
+  gfloat c = cosf (a);
+  gfloat s = sinf (a);
+
+  m[0] = c * c;
+  m[1] = c * s * s - s * c;
+  m[2] = c * s * c + s * s;
+  m[3] = s * c;
+  m[4] = s * s * s + c * c;
+  m[5] = s * s * c - c * s;
+  m[6] = -s;
+  m[7] = c * s;
+  m[8] = c * c;
+}
+
+/* Rotates the positions of n instances. Plain loops over the
+ * separate arrays, so the compiler vectorizes them. */
+static void
+lba_cogl_cube_rotate_instances (const gfloat m[9], guint n,
+                                const gfloat *restrict x,
+                                const gfloat *restrict y,
+                                const gfloat *restrict z, gfloat *restrict rx,
+                                gfloat *restrict ry, gfloat *restrict rz) {
+  guint i;
+
+  for (i = 0; i < n; i++)
+    rx[i] = m[0] * x[i] + m[1] * y[i] + m[2] * z[i];
 
-    self->rotation += secs_elapsed * rotation_speed_degrees_per_second;
+  for (i = 0; i < n; i++)
+    ry[i] = m[3] * x[i] + m[4] * y[i] + m[5] * z[i];
 
-    if (G_UNLIKELY (self->rotation > 360.0))
-      self->rotation -= 360.0;
+  for (i = 0; i < n; i++)
+    rz[i] = m[6] * x[i] + m[7] * y[i] + m[8] * z[i];
+}
 
-    LBA_LOG ("Will rotate by %f", self->rotation);
+static void
+lba_cogl_cube_paint_batch (GObject **objs, guint n, CoglFramebuffer *fb,
+                           CoglPipeline *pipeline) {
+  CoglVertexP3T2 corners[LBA_COGL_CUBE_N_VERTICES];
+  CoglContext *ctx;
+  gfloat m[9];
+  guint done,
+    i,
+    k;
+
+  if (n == 0)
+    return;
 
-    self->last_frame_ts = now;
+  {
+    LbaICogl *iface =
+        G_TYPE_INSTANCE_GET_INTERFACE (objs[0], LBA_ICOGL, LbaICogl);
+
+    iface->get_ctx (objs[0], &ctx, NULL);
   }
 
-  framebuffer_width = cogl_framebuffer_get_width (fb);
-  framebuffer_height = cogl_framebuffer_get_height (fb);
+  G_LOCK (shared);
+  lba_cogl_cube_shared_ensure_gpu (shared, ctx);
 
-  cogl_framebuffer_push_matrix (fb);
+  /* Rotate the unit cube once for everybody */
+  lba_cogl_cube_rotation_matrix (shared->rotation, m);
+  for (k = 0; k < LBA_COGL_CUBE_N_VERTICES; k++) {
+    const CoglVertexP3T2 *v = &lba_cogl_cube_vertices[k];
 
-  cogl_framebuffer_translate (fb, framebuffer_width / 2, framebuffer_height / 2, 0);
+    corners[k].x = LBA_COGL_CUBE_SIZE * (m[0] * v->x + m[1] * v->y + m[2] * v->z);
+    corners[k].y = LBA_COGL_CUBE_SIZE * (m[3] * v->x + m[4] * v->y + m[5] * v->z);
+    corners[k].z = LBA_COGL_CUBE_SIZE * (m[6] * v->x + m[7] * v->y + m[8] * v->z);
+    corners[k].s = v->s;
+    corners[k].t = v->t;
+  }
 
+  cogl_framebuffer_push_matrix (fb);
+  cogl_framebuffer_translate (fb, cogl_framebuffer_get_width (fb) / 2,
+                              cogl_framebuffer_get_height (fb) / 2, 0);
   cogl_framebuffer_scale (fb, 35, 35, 35);
 
-  cogl_framebuffer_rotate (fb, self->rotation, 0, 0, 1);
-  cogl_framebuffer_rotate (fb, self->rotation, 0, 1, 0);
-  cogl_framebuffer_rotate (fb, self->rotation, 1, 0, 0);
+  for (done = 0; done < n; done += LBA_COGL_CUBE_BATCH) {
+    guint chunk = MIN (n - done, LBA_COGL_CUBE_BATCH);
+    CoglVertexP3T2 *out = shared->vertices;
+
+    /* Gather the instances of this run */
+    for (i = 0; i < chunk; i++) {
+      guint slot = bm_get_LbaCoglCube (objs[done + i])->slot;
+
+      shared->px[i] = shared->x[slot];
+      shared->py[i] = shared->y[slot];
+      shared->pz[i] = shared->z[slot];
+    }
+
+    lba_cogl_cube_rotate_instances (m, chunk, shared->px, shared->py, shared->pz,
+                                    shared->rx, shared->ry, shared->rz);
+
+    /* Expand: each instance is the rotated unit cube moved
+     * by the rotated position */
+    for (i = 0; i < chunk; i++) {
+      for (k = 0; k < LBA_COGL_CUBE_N_VERTICES; k++, out++) {
+        out->x = corners[k].x + shared->rx[i];
+        out->y = corners[k].y + shared->ry[i];
+        out->z = corners[k].z + shared->rz[i];
+        out->s = corners[k].s;
+        out->t = corners[k].t;
+      }
+    }
+
+    cogl_buffer_set_data (COGL_BUFFER (shared->buffer), 0, shared->vertices,
+                          sizeof (CoglVertexP3T2) * (out - shared->vertices));
+
+    /* With indices set, this is the number of indices to draw */
+    cogl_primitive_set_n_vertices (shared->prim, 6 * 6 * chunk);
+    cogl_primitive_draw (shared->prim, fb, pipeline);
+  }
 
-  cogl_primitive_draw (self->prim, fb, pipeline);
   cogl_framebuffer_pop_matrix (fb);
+  G_UNLOCK (shared);
+}
+
+static void
+lba_cogl_cube_paint (GObject *obj, CoglFramebuffer *fb, CoglPipeline *pipeline) {
+  lba_cogl_cube_paint_batch (&obj, 1, fb, pipeline);
 }
 
 static void
 lba_cogl_cube_reopen (GObject *base, CoglFramebuffer *fb,
                       CoglPipeline *pipeline, CoglContext *ctx) {
-  LbaCoglCube *self = bm_get_LbaCoglCube (base);
-  LbaI3D *iface3d = G_TYPE_INSTANCE_GET_INTERFACE (base,
-                                                   LBA_I3D,
-                                                   LbaI3D);
-  double x,
-    y,
-    z;
+  BaseDrawable *drawable = (BaseDrawable *) base;
+  LbaFrameClock *clock = NULL;
+
+  LBA_LOG ("reopen");
+
+  /* Spin with the frames of the scene */
+  if (drawable->scene
+      && g_object_class_find_property (G_OBJECT_GET_CLASS (drawable->scene),
+                                       "frame-clock"))
+    g_object_get (drawable->scene, "frame-clock", &clock, NULL);
+
+  lba_cogl_cube_shared_set_clock (clock);
+
+  /* Nothing to build per cube: the geometry is shared */
+  lba_cogl_cube_xyz_changed (base, NULL, NULL);
+
+  G_LOCK (shared);
+  lba_cogl_cube_shared_ensure_gpu (shared, ctx);
+  G_UNLOCK (shared);
+}
+
+static void
+lba_cogl_cube_init (GObject *object, LbaCoglCube *self) {
+  self->slot = lba_cogl_cube_shared_new_slot ();
+
+  g_signal_connect (object, "notify::x", G_CALLBACK (lba_cogl_cube_xyz_changed),
+                    NULL);
+  g_signal_connect (object, "notify::y", G_CALLBACK (lba_cogl_cube_xyz_changed),
+                    NULL);
+  g_signal_connect (object, "notify::z", G_CALLBACK (lba_cogl_cube_xyz_changed),
+                    NULL);
+}
+
+static void
+lba_cogl_cube_finalize (GObject *object) {
+  LbaCoglCube *self = bm_get_LbaCoglCube (object);
+
+  lba_cogl_cube_shared_free_slot (self->slot);
 
-  iface3d->xyz (base, &x, &y, &z);
-  LBA_LOG ("reopen (%f, %f, %f)", x, y, z);
-
-  float size = 3.0f;
-
-  CoglVertexP3T2 vertices[] = {
-    /* Front face */
-    { /* pos = */ (x - size), (y - size), (z + size), /* tex coords = */ 0.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y - size), (z + size), /* tex coords = */ 1.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y + size), (z + size), /* tex coords = */ 1.0f,
-     0.0f },
-    { /* pos = */ (x - size), (y + size), (z + size), /* tex coords = */ 0.0f,
-     0.0f },
-
-    /* Back face */
-    { /* pos = */ (x - size), (y - size), (z - size), /* tex coords = */ 1.0f,
-     0.0f },
-    { /* pos = */ (x - size), (y + size), (z - size), /* tex coords = */ 1.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y + size), (z - size), /* tex coords = */ 0.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y - size), (z - size), /* tex coords = */ 0.0f,
-     0.0f },
-
-    /* Top face */
-    { /* pos = */ (x - size), (y + size), (z - size), /* tex coords = */ 0.0f,
-     1.0f },
-    { /* pos = */ (x - size), (y + size), (z + size), /* tex coords = */ 0.0f,
-     0.0f },
-    { /* pos = */ (x + size), (y + size), (z + size), /* tex coords = */ 1.0f,
-     0.0f },
-    { /* pos = */ (x + size), (y + size), (z - size), /* tex coords = */ 1.0f,
-     1.0f },
-
-    /* Bottom face */
-    { /* pos = */ (x - size), (y - size), (z - size), /* tex coords = */ 1.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y - size), (z - size), /* tex coords = */ 0.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y - size), (z + size), /* tex coords = */ 0.0f,
-     0.0f },
-    { /* pos = */ (x - size), (y - size), (z + size), /* tex coords = */ 1.0f,
-     0.0f },
-
-    /* Right face */
-    { /* pos = */ (x + size), (y - size), (z - size), /* tex coords = */ 1.0f,
-     0.0f },
-    { /* pos = */ (x + size), (y + size), (z - size), /* tex coords = */ 1.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y + size), (z + size), /* tex coords = */ 0.0f,
-     1.0f },
-    { /* pos = */ (x + size), (y - size), (z + size), /* tex coords = */ 0.0f,
-     0.0f },
-
-    /* Left face */
-    { /* pos = */ (x - size), (y - size), (z - size), /* tex coords = */ 0.0f,
-     0.0f },
-    { /* pos = */ (x - size), (y - size), (z + size), /* tex coords = */ 1.0f,
-     0.0f },
-    { /* pos = */ (x - size), (y + size), (z + size), /* tex coords = */ 1.0f,
-     1.0f },
-    { /* pos = */ (x - size), (y + size), (z - size), /* tex coords = */ 0.0f, 1.0f }
-  };
-
-  self->indices = cogl_get_rectangle_indices (ctx, 6 /* n_rectangles */ );
-  self->prim = cogl_primitive_new_p3t2 (ctx, COGL_VERTICES_MODE_TRIANGLES,
-                                        G_N_ELEMENTS (vertices), vertices);
-
-  cogl_primitive_set_indices (self->prim, self->indices, 6 * 6);
-}
-
-static void
-lba_cogl_cube_init (GObject *object, LbaCoglCube *mixin) {
+  BM_CHAINUP (self, GObject)->finalize (object);
 }
 
 static void
 lba_cogl_cube_class_init (GObjectClass *object_class, LbaCoglCubeClass *mixin_class) {
+  object_class->finalize = lba_cogl_cube_finalize;
 }
 
 static void
 lba_cogl_cube_icogl_init (LbaICogl *iface) {
   iface->paint = lba_cogl_cube_paint;
+  iface->paint_batch = lba_cogl_cube_paint_batch;
   iface->reopen = lba_cogl_cube_reopen;
 }
 
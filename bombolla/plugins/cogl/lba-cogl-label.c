@@ -32,15 +32,47 @@
 #include "base/icogl.h"
 #include <cogl-pango/cogl-pango.h>
 
+/* The font map (and so the glyph cache) is shared by all the labels.
+ * The layouts are shared too: the labels with the same font, size and
+ * text use the same PangoLayout. The layouts nobody uses are kept
+ * for a while in case the text comes back (f.e. a clock), and the least
+ * recently used are dropped when there are too many. */
+#define LBA_COGL_LABEL_MAX_UNUSED_LAYOUTS 64
+
+typedef struct {
+  gchar *key;
+  PangoLayout *layout;
+  int width;
+  int height;
+
+  /* How many labels show it. When 0 it's in the unused queue */
+  guint users;
+  GList *unused_link;
+} LbaCoglLabelLayout;
+
+typedef struct {
+  guint refcount;
+  CoglPangoFontMap *font_map;
+  PangoContext *context;
+
+  /* key -> LbaCoglLabelLayout */
+  GHashTable *layouts;
+  /* Unused layouts, the least recently used first */
+  GQueue unused;
+} LbaCoglLabelCache;
+
+/* Protects the cache and the text/font of the labels */
+G_LOCK_DEFINE_STATIC (cache);
+static LbaCoglLabelCache *cache;
+
 typedef struct _LbaCoglLabel {
   BMixinInstance m;
-  CoglPangoFontMap *pango_font_map;
-  PangoContext *pango_context;
-  PangoFontDescription *pango_font_desc;
 
-  PangoLayout *hello_label;
-  int hello_label_width;
-  int hello_label_height;
+  /* Shared, from the cache */
+  LbaCoglLabelLayout *layout;
+  /* text, font or size changed since the layout was picked */
+  gboolean dirty;
+
   CoglMatrix view;
 
   CoglColor color;
@@ -67,6 +99,112 @@ BM_DEFINE_MIXIN (lba_cogl_label, LbaCoglLabel,
                      BM_ADD_DEP (lba_mixin_2d));
 /* *INDENT-ON* */ 
 
+static void
+lba_cogl_label_layout_free (gpointer data) {
+  LbaCoglLabelLayout *l = (LbaCoglLabelLayout *) data;
+
+  g_object_unref (l->layout);
+  g_free (l->key);
+  g_free (l);
+}
+
+/* NOTE: called with the cache lock taken */
+static void
+lba_cogl_label_cache_ref (void) {
+  if (!cache) {
+    cache = g_new0 (LbaCoglLabelCache, 1);
+    cache->layouts = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                            lba_cogl_label_layout_free);
+    g_queue_init (&cache->unused);
+  }
+
+  cache->refcount++;
+}
+
+/* NOTE: called with the cache lock taken */
+static void
+lba_cogl_label_cache_unref (void) {
+  if (--cache->refcount > 0)
+    return;
+
+  g_queue_clear (&cache->unused);
+  g_hash_table_unref (cache->layouts);
+  g_clear_object (&cache->context);
+  g_clear_object (&cache->font_map);
+  g_clear_pointer (&cache, g_free);
+}
+
+/* NOTE: called with the cache lock taken */
+static void
+lba_cogl_label_cache_release (LbaCoglLabelLayout *l) {
+  if (!l || --l->users > 0)
+    return;
+
+  g_queue_push_tail (&cache->unused, l);
+  l->unused_link = cache->unused.tail;
+
+  /* Keep the memory bounded */
+  while (cache->unused.length > LBA_COGL_LABEL_MAX_UNUSED_LAYOUTS) {
+    LbaCoglLabelLayout *old = g_queue_pop_head (&cache->unused);
+
+    LBA_LOG ("Evicting layout [%s]", old->key);
+    g_hash_table_remove (cache->layouts, old->key);
+  }
+}
+
+/* NOTE: called in GL thread with the cache lock taken */
+static LbaCoglLabelLayout *
+lba_cogl_label_cache_acquire (const gchar *font_name, guint font_size,
+                              const gchar *text) {
+  LbaCoglLabelLayout *l;
+  gchar *key;
+
+  key = g_strdup_printf ("%s|%u|%s", font_name ? font_name : "", font_size,
+                         text ? text : "");
+
+  l = g_hash_table_lookup (cache->layouts, key);
+  if (l) {
+    g_free (key);
+
+    if (l->users++ == 0) {
+      g_queue_delete_link (&cache->unused, l->unused_link);
+      l->unused_link = NULL;
+    }
+    return l;
+  }
+
+  if (!cache->font_map) {
+    cache->font_map = COGL_PANGO_FONT_MAP (cogl_pango_font_map_new ());
+    cogl_pango_font_map_set_use_mipmapping (cache->font_map, TRUE);
+    cache->context = cogl_pango_font_map_create_context (cache->font_map);
+  }
+
+  l = g_new0 (LbaCoglLabelLayout, 1);
+  l->key = key;
+  l->users = 1;
+  l->layout = pango_layout_new (cache->context);
+
+  {
+    PangoFontDescription *desc = pango_font_description_new ();
+    PangoRectangle size;
+
+    pango_font_description_set_family (desc, font_name);
+    pango_font_description_set_size (desc, font_size * PANGO_SCALE);
+    pango_layout_set_font_description (l->layout, desc);
+    pango_font_description_free (desc);
+
+    pango_layout_set_text (l->layout, text, -1);
+
+    pango_layout_get_extents (l->layout, NULL, &size);
+    l->width = PANGO_PIXELS (size.width);
+    l->height = PANGO_PIXELS (size.height);
+  }
+
+  g_hash_table_insert (cache->layouts, l->key, l);
+  LBA_LOG ("New layout [%s] (%u cached)", key, g_hash_table_size (cache->layouts));
+  return l;
+}
+
 static void
 lba_cogl_label_paint (GObject *obj, CoglFramebuffer *fb, CoglPipeline *pipeline) {
   double x,
@@ -78,46 +216,41 @@ lba_cogl_label_paint (GObject *obj, CoglFramebuffer *fb, CoglPipeline *pipeline)
                                                    LBA_I2D,
                                                    LbaI2D);
 
-  iface2d->xy (obj, &x, &y);
+  G_LOCK (cache);
+  if (G_UNLIKELY (self->dirty)) {
+    LbaCoglLabelLayout *old = self->layout;
 
-  LBA_LOG ("draw (%f, %f)", x, y);
+    /* Acquire first: if nothing changed, the same layout is picked */
+    self->layout = lba_cogl_label_cache_acquire (self->font_name,
+                                                 self->font_size, self->text);
+    lba_cogl_label_cache_release (old);
+    self->dirty = FALSE;
+  }
+  G_UNLOCK (cache);
+
+  iface2d->xy (obj, &x, &y);
 
   framebuffer_width = cogl_framebuffer_get_width (fb);
   framebuffer_height = cogl_framebuffer_get_height (fb);
 
-  cogl_pango_show_layout (fb, self->hello_label,
+  /* NOTE: the layout can't go away while we use it */
+  cogl_pango_show_layout (fb, self->layout->layout,
                           framebuffer_width * x, framebuffer_height * y,
                           &self->color);
 }
 
 static void
 lba_cogl_label_update (LbaCoglLabel *self) {
-  PangoRectangle hello_label_size;
-
-  if (!self->pango_font_desc || !self->hello_label)
-    return;
+  GObject *scene = NULL;
 
-  pango_font_description_set_family (self->pango_font_desc, self->font_name);
-  pango_font_description_set_size (self->pango_font_desc,
-                                   self->font_size * PANGO_SCALE);
+  /* The layout is picked when drawing */
+  self->dirty = TRUE;
 
-  pango_layout_set_font_description (self->hello_label, self->pango_font_desc);
-  pango_layout_set_text (self->hello_label, self->text, -1);
-
-  pango_layout_get_extents (self->hello_label, NULL, &hello_label_size);
-  self->hello_label_width = PANGO_PIXELS (hello_label_size.width);
-  self->hello_label_height = PANGO_PIXELS (hello_label_size.height);
-
-  {
-    GObject *scene = NULL;
-
-    g_object_get (self->m.root_object, "drawing-scene", &scene, NULL);
-    LBA_LOG ("scene = %p", scene);
-    if (scene) {
-      LBA_LOG ("Request redraw");
-      g_signal_emit_by_name (scene, "request-redraw", NULL);
-      g_object_unref (scene);
-    }
+  g_object_get (self->m.root_object, "drawing-scene", &scene, NULL);
+  if (scene) {
+    LBA_LOG ("Request redraw");
+    g_signal_emit_by_name (scene, "request-redraw", NULL);
+    g_object_unref (scene);
   }
 }
 
@@ -165,26 +298,34 @@ lba_cogl_label_reopen (GObject *base, CoglFramebuffer *fb,
                                       framebuffer_width, framebuffer_height);
   cogl_framebuffer_set_modelview_matrix (fb, &self->view);
 
-  /* Initialize some convenient constants */
-  cogl_color_init_from_4ub (&self->color, 0xff, 0xff, 0xff, 0xff);
-
-  /* Setup a Pango font map and context */
+  /* The font map and the layouts are shared, nothing to recreate here */
+  lba_cogl_label_update (self);
+}
 
-  self->pango_font_map = COGL_PANGO_FONT_MAP (cogl_pango_font_map_new ());
+static void
+lba_cogl_label_init (GObject *object, LbaCoglLabel *self) {
+  cogl_color_init_from_4ub (&self->color, 0xff, 0xff, 0xff, 0xff);
+  self->dirty = TRUE;
 
-  cogl_pango_font_map_set_use_mipmapping (self->pango_font_map, TRUE);
+  G_LOCK (cache);
+  lba_cogl_label_cache_ref ();
+  G_UNLOCK (cache);
+}
 
-  self->pango_context = cogl_pango_font_map_create_context (self->pango_font_map);
+static void
+lba_cogl_label_finalize (GObject *object) {
+  LbaCoglLabel *self = bm_get_LbaCoglLabel (object);
 
-  /* FIXME: free before */
-  self->pango_font_desc = pango_font_description_new ();
-  self->hello_label = pango_layout_new (self->pango_context);
+  G_LOCK (cache);
+  lba_cogl_label_cache_release (self->layout);
+  self->layout = NULL;
+  lba_cogl_label_cache_unref ();
+  G_UNLOCK (cache);
 
-  lba_cogl_label_update (self);
-}
+  g_free (self->text);
+  g_free (self->font_name);
 
-static void
-lba_cogl_label_init (GObject *object, LbaCoglLabel *self) {
+  BM_CHAINUP (self, GObject)->finalize (object);
 }
 
 typedef enum {
@@ -203,21 +344,45 @@ lba_cogl_label_set_property (GObject *object,
 
   switch ((LbaCoglLabelProperty) property_id) {
   case PROP_TEXT:
-    g_free (self->text);
-    self->text = g_value_dup_string (value);
+    {
+      const gchar *text = g_value_get_string (value);
 
-    lba_cogl_label_update (self);
+      /* Bound properties may set the same value again and again */
+      if (!g_strcmp0 (text, self->text))
+        break;
+
+      G_LOCK (cache);
+      g_free (self->text);
+      self->text = g_strdup (text);
+      G_UNLOCK (cache);
+
+      lba_cogl_label_update (self);
+    }
     break;
 
   case PROP_FONT_NAME:
-    g_free (self->font_name);
-    self->font_name = g_value_dup_string (value);
+    {
+      const gchar *font_name = g_value_get_string (value);
 
-    lba_cogl_label_update (self);
+      if (!g_strcmp0 (font_name, self->font_name))
+        break;
+
+      G_LOCK (cache);
+      g_free (self->font_name);
+      self->font_name = g_strdup (font_name);
+      G_UNLOCK (cache);
+
+      lba_cogl_label_update (self);
+    }
     break;
 
   case PROP_FONT_SIZE:
+    if (self->font_size == g_value_get_uint (value))
+      break;
+
+    G_LOCK (cache);
     self->font_size = g_value_get_uint (value);
+    G_UNLOCK (cache);
 
     lba_cogl_label_update (self);
     break;
@@ -260,6 +425,7 @@ lba_cogl_label_class_init (GObjectClass *klass, LbaCoglLabelClass *mixin_class)
 
   gobj_class->set_property = lba_cogl_label_set_property;
   gobj_class->get_property = lba_cogl_label_get_property;
+  gobj_class->finalize = lba_cogl_label_finalize;
 
   g_object_class_install_property (gobj_class,
                                    PROP_TEXT,
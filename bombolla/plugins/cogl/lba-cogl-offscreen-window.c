@@ -0,0 +1,310 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A window that renders into an offscreen framebuffer, so the drawing can be
+ * benchmarked and tested without a display. If there's no GL at all, Cogl's
+ * no-op driver is used: nothing is really drawn, but all the rest of the
+ * pipeline runs.
+ *
+ * Once opened, it can render "frames" frames as fast as possible, and
+ * reports how long each frame took. */
+
+#include "lba-cogl-window.h"
+#include "bombolla/lba-plugin-system.h"
+#include "bombolla/lba-log.h"
+
+typedef struct _LbaCoglOffscreenWindow {
+  LbaCoglWindow parent;
+
+  gboolean gpu;
+  gboolean print_timing;
+  guint frames;
+
+  guint frames_left;
+  guint frames_rendered;
+  gint64 frame_time;
+} LbaCoglOffscreenWindow;
+
+typedef struct _LbaCoglOffscreenWindowClass {
+  LbaCoglWindowClass parent;
+} LbaCoglOffscreenWindowClass;
+
+G_DEFINE_TYPE (LbaCoglOffscreenWindow, lba_cogl_offscreen_window,
+               G_TYPE_LBA_COGL_WINDOW);
+
+enum {
+  SIGNAL_FRAME_DONE,
+  SIGNAL_FRAMES_DONE,
+  LAST_SIGNAL
+};
+
+static guint lba_cogl_offscreen_window_signals[LAST_SIGNAL] = { 0 };
+
+typedef enum {
+  PROP_GPU = 1,
+  PROP_FRAMES,
+  PROP_PRINT_TIMING,
+  PROP_FRAMES_RENDERED,
+  PROP_FRAME_TIME,
+  N_PROPERTIES
+} LbaCoglOffscreenWindowProperty;
+
+static CoglContext *
+lba_cogl_offscreen_window_create_context (LbaCoglWindow *base, CoglError **error) {
+  LbaCoglOffscreenWindow *self = (LbaCoglOffscreenWindow *) base;
+  CoglRenderer *renderer;
+  CoglDisplay *display;
+  CoglContext *ctx;
+
+  if (self->gpu) {
+    ctx = cogl_context_new (NULL, error);
+    if (ctx)
+      return ctx;
+
+    LBA_LOG ("No GL (%s), falling back to the no-op driver", (*error)->message);
+    cogl_error_free (*error);
+    *error = NULL;
+  }
+
+  renderer = cogl_renderer_new ();
+  cogl_renderer_set_driver (renderer, COGL_DRIVER_NOP);
+  cogl_renderer_set_winsys_id (renderer, COGL_WINSYS_ID_STUB);
+
+  if (!cogl_renderer_connect (renderer, error)) {
+    cogl_object_unref (renderer);
+    return NULL;
+  }
+
+  display = cogl_display_new (renderer, NULL);
+  cogl_object_unref (renderer);
+
+  ctx = cogl_context_new (display, error);
+  cogl_object_unref (display);
+
+  return ctx;
+}
+
+static CoglFramebuffer *
+lba_cogl_offscreen_window_create_framebuffer (LbaCoglWindow *base,
+                                              int width, int height) {
+  CoglTexture *texture;
+  CoglOffscreen *offscreen;
+  CoglError *error = NULL;
+
+  texture = cogl_texture_2d_new_with_size (base->ctx, width, height);
+  offscreen = cogl_offscreen_new_with_texture (texture);
+  /* Owned by the offscreen now */
+  cogl_object_unref (texture);
+
+  if (!cogl_framebuffer_allocate (COGL_FRAMEBUFFER (offscreen), &error)) {
+    LBA_LOG ("Failed to allocate %dx%d offscreen: %s", width, height,
+             error->message);
+    cogl_error_free (error);
+    cogl_object_unref (offscreen);
+    return NULL;
+  }
+
+  return COGL_FRAMEBUFFER (offscreen);
+}
+
+/* NOTE: called in GL thread with the lock taken */
+static void
+lba_cogl_offscreen_window_swap_buffers (LbaCoglWindow *base) {
+  LbaCoglOffscreenWindow *self = (LbaCoglOffscreenWindow *) base;
+
+  /* Wait for the GPU, so the timing includes the real drawing */
+  cogl_framebuffer_finish (base->fb);
+
+  self->frame_time = g_get_monotonic_time () - base->frame_start_ts;
+  self->frames_rendered++;
+
+  if (self->print_timing) {
+    g_print ("frame %u: %.3f ms\n", self->frames_rendered,
+             self->frame_time / 1000.0);
+  }
+
+  g_signal_emit (self, lba_cogl_offscreen_window_signals[SIGNAL_FRAME_DONE], 0,
+                 self->frames_rendered, self->frame_time);
+
+  if (self->frames_left > 0) {
+    if (--self->frames_left == 0) {
+      g_signal_emit (self, lba_cogl_offscreen_window_signals[SIGNAL_FRAMES_DONE],
+                     0);
+    } else {
+      g_signal_emit_by_name (self, "request-redraw", NULL);
+    }
+  }
+}
+
+static void
+lba_cogl_offscreen_window_open (BaseWindow *base) {
+  LbaCoglOffscreenWindow *self = (LbaCoglOffscreenWindow *) base;
+  LbaCoglWindow *window = (LbaCoglWindow *) base;
+
+  BASE_WINDOW_CLASS (lba_cogl_offscreen_window_parent_class)->open (base);
+
+  LBA_LOCK (window);
+  self->frames_left = self->frames;
+  self->frames_rendered = 0;
+  LBA_UNLOCK (window);
+
+  /* Nobody will tell us the framebuffer is dirty, so draw the first frame */
+  g_signal_emit_by_name (self, "request-redraw", NULL);
+}
+
+static void
+lba_cogl_offscreen_window_set_property (GObject *object,
+                                        guint property_id, const GValue *value,
+                                        GParamSpec *pspec) {
+  LbaCoglOffscreenWindow *self = (LbaCoglOffscreenWindow *) object;
+
+  switch ((LbaCoglOffscreenWindowProperty) property_id) {
+  case PROP_GPU:
+    self->gpu = g_value_get_boolean (value);
+    break;
+
+  case PROP_FRAMES:
+    self->frames = g_value_get_uint (value);
+    break;
+
+  case PROP_PRINT_TIMING:
+    self->print_timing = g_value_get_boolean (value);
+    break;
+
+  default:
+    /* We don't have any other property... */
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+lba_cogl_offscreen_window_get_property (GObject *object,
+                                        guint property_id, GValue *value,
+                                        GParamSpec *pspec) {
+  LbaCoglOffscreenWindow *self = (LbaCoglOffscreenWindow *) object;
+
+  switch ((LbaCoglOffscreenWindowProperty) property_id) {
+  case PROP_GPU:
+    g_value_set_boolean (value, self->gpu);
+    break;
+
+  case PROP_FRAMES:
+    g_value_set_uint (value, self->frames);
+    break;
+
+  case PROP_PRINT_TIMING:
+    g_value_set_boolean (value, self->print_timing);
+    break;
+
+  case PROP_FRAMES_RENDERED:
+    g_value_set_uint (value, self->frames_rendered);
+    break;
+
+  case PROP_FRAME_TIME:
+    g_value_set_int64 (value, self->frame_time);
+    break;
+
+  default:
+    /* We don't have any other property... */
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
+static void
+lba_cogl_offscreen_window_init (LbaCoglOffscreenWindow *self) {
+}
+
+static void
+lba_cogl_offscreen_window_class_init (LbaCoglOffscreenWindowClass *klass) {
+  GObjectClass *gobj_class = G_OBJECT_CLASS (klass);
+  BaseWindowClass *base_class = BASE_WINDOW_CLASS (klass);
+  LbaCoglWindowClass *cogl_window_class = LBA_COGL_WINDOW_CLASS (klass);
+
+  gobj_class->set_property = lba_cogl_offscreen_window_set_property;
+  gobj_class->get_property = lba_cogl_offscreen_window_get_property;
+
+  base_class->open = lba_cogl_offscreen_window_open;
+
+  cogl_window_class->create_context = lba_cogl_offscreen_window_create_context;
+  cogl_window_class->create_framebuffer =
+      lba_cogl_offscreen_window_create_framebuffer;
+  cogl_window_class->swap_buffers = lba_cogl_offscreen_window_swap_buffers;
+
+  g_object_class_install_property (gobj_class, PROP_GPU,
+                                   g_param_spec_boolean ("gpu", "GPU",
+                                                         "Use GL if available",
+                                                         TRUE,
+                                                         G_PARAM_STATIC_STRINGS |
+                                                         G_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT));
+
+  g_object_class_install_property (gobj_class, PROP_FRAMES,
+                                   g_param_spec_uint ("frames", "Frames",
+                                                      "Frames to render as fast as "
+                                                      "possible, 0 - on request",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_PRINT_TIMING,
+                                   g_param_spec_boolean ("print-timing",
+                                                         "Print timing",
+                                                         "Print frame durations",
+                                                         FALSE,
+                                                         G_PARAM_STATIC_STRINGS |
+                                                         G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAMES_RENDERED,
+                                   g_param_spec_uint ("frames-rendered",
+                                                      "Frames rendered",
+                                                      "Frames rendered since opened",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_STATIC_STRINGS |
+                                                      G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAME_TIME,
+                                   g_param_spec_int64 ("frame-time", "Frame time",
+                                                       "Last frame duration, us",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_STATIC_STRINGS |
+                                                       G_PARAM_READABLE));
+
+  lba_cogl_offscreen_window_signals[SIGNAL_FRAME_DONE] =
+      g_signal_new ("frame-done", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_INT64);
+
+  lba_cogl_offscreen_window_signals[SIGNAL_FRAMES_DONE] =
+      g_signal_new ("frames-done", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+                    g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+}
+
+/* Export plugin */
+BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_GTYPE (lba_cogl_offscreen_window);
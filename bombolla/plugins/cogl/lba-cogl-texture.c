@@ -29,22 +29,62 @@
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
 #include "bombolla/base/lba-picture.h"
+#include "bombolla/base/lba-stats.h"
+#include <string.h>
+
+/* We upload the new frames into the back texture, while the front one
+ * may still be in use by the draw calls of the previous frame. */
+#define LBA_COGL_TEXTURE_N_BUFFERS 2
+
+/* The back texture is one upload behind, see last_damage */
+G_STATIC_ASSERT (LBA_COGL_TEXTURE_N_BUFFERS == 2);
+
+/* A picture received from the producer, waiting to be uploaded */
+typedef struct {
+  GBytes *data;
+  guint w;
+  guint h;
+  guint rowstride;
+  CoglPixelFormat format;
+
+  LbaPictureFrameInfo info;
+  /* When "notify::data" reached us */
+  gint64 received;
+} LbaCoglTextureFrame;
 
 typedef struct _LbaCoglTexture {
   GObject parent;
 
-  CoglTexture *texture;
-  GRecMutex lock;
-  GObject *scene;
+  /* Only touched from the GL thread */
   struct {
-    guint64 last_cookie;
-    guint64 cookie;
-    GBytes *data;
+    CoglTexture *texture;
     guint w;
     guint h;
     CoglPixelFormat format;
-    GObject *obj;
-  } pic;
+  } buf[LBA_COGL_TEXTURE_N_BUFFERS];
+  guint front;
+  /* What the last uploaded frame changed. The back texture misses it. */
+  LbaPictureDamage last_damage;
+
+  /* Staging buffer for the asynchronous uploads, if the driver supports it */
+  CoglPixelBuffer *pbo;
+  gsize pbo_size;
+  gboolean pbo_checked;
+  gboolean have_pbo;
+
+  /* Handed over from the producer thread to the upload stage.
+   * If the producer is faster than the drawing, older frames are dropped.
+   * The lock is only held to swap it, and to merge the damage of the
+   * dropped one, that the upload stage could free meanwhile otherwise. */
+  GMutex pending_lock;
+  LbaCoglTextureFrame *pending;
+
+  /* Protects the properties */
+  GRecMutex lock;
+  GObject *scene;
+  GObject *pic_obj;
+
+  LbaStats *stats;
 } LbaCoglTexture;
 
 typedef struct _LbaCoglTextureClass {
@@ -57,32 +97,75 @@ typedef struct _LbaCoglTextureClass {
 typedef enum {
   PROP_PICTURE_OBJECT = 1,
   PROP_DRAWING_SCENE,
+  PROP_FPS,
+  PROP_LATENCY,
   N_PROPERTIES
 } LbaCoglTextureProperty;
 
+typedef enum {
+  STAGE_DELIVER,
+  STAGE_QUEUE,
+  STAGE_UPLOAD,
+  STAGE_TOTAL
+} LbaCoglTextureStage;
+
+static const gchar *const stage_names[] = {
+  /* lba_picture_set () -> "notify::data" */
+  "deliver",
+  /* "notify::data" -> the upload stage */
+  "queue",
+  "upload",
+  /* produced -> uploaded */
+  "total",
+  NULL
+};
+
 /* TODO: make mixin */
 G_DEFINE_TYPE (LbaCoglTexture, lba_cogl_texture, G_TYPE_OBJECT);
 
-/* transfer-full */
+/* COGL_PIXEL_FORMAT_ANY if it has to be converted first */
 static CoglPixelFormat
-lba_cogl_texture_format_to_cogl (const gchar *format) {
-  static const struct {
-    const gchar *str;
-    CoglPixelFormat cogl;
-  } bunch[] = {
-    { "argb8888", COGL_PIXEL_FORMAT_ARGB_8888 },
-    { "rgba8888", COGL_PIXEL_FORMAT_RGBA_8888 }
-  };
-
-  CoglPixelFormat ret = COGL_PIXEL_FORMAT_RGBA_8888;
-  int i;
+lba_cogl_texture_format_to_cogl (LbaPixelFormat format) {
+  /* Both are named after the order of the bytes */
+  switch (format) {
+  case LBA_PIXEL_FORMAT_ARGB8888:
+    return COGL_PIXEL_FORMAT_ARGB_8888;
+  case LBA_PIXEL_FORMAT_RGBA8888:
+    return COGL_PIXEL_FORMAT_RGBA_8888;
+  case LBA_PIXEL_FORMAT_BGRA8888:
+    return COGL_PIXEL_FORMAT_BGRA_8888;
+  case LBA_PIXEL_FORMAT_ARGB8888_PRE:
+    return COGL_PIXEL_FORMAT_ARGB_8888_PRE;
+  case LBA_PIXEL_FORMAT_RGBA8888_PRE:
+    return COGL_PIXEL_FORMAT_RGBA_8888_PRE;
+  case LBA_PIXEL_FORMAT_BGRA8888_PRE:
+    return COGL_PIXEL_FORMAT_BGRA_8888_PRE;
+  default:
+    return COGL_PIXEL_FORMAT_ANY;
+  }
+}
 
-  for (i = 0; i < G_N_ELEMENTS (bunch); i++)
-    if (g_strcmp0 (bunch[i].str, format)) {
-      ret = bunch[i].cogl;
-    }
+static void
+lba_cogl_texture_frame_free (LbaCoglTextureFrame *frame) {
+  if (!frame)
+    return;
 
-  return ret;
+  g_bytes_unref (frame->data);
+  g_free (frame);
+}
+
+/* Puts the new frame (or NULL) as pending and returns the previous one */
+static LbaCoglTextureFrame *
+lba_cogl_texture_exchange_pending (LbaCoglTexture *self,
+                                   LbaCoglTextureFrame *frame) {
+  LbaCoglTextureFrame *old;
+
+  g_mutex_lock (&self->pending_lock);
+  old = self->pending;
+  g_atomic_pointer_set (&self->pending, frame);
+  g_mutex_unlock (&self->pending_lock);
+
+  return old;
 }
 
 static void
@@ -90,33 +173,237 @@ lba_cogl_texture_picture_update_cb (GObject *pic,
                                     GParamSpec *pspec, LbaCoglTexture *self) {
   gchar format[16];
   GBytes *pic_data;
+  LbaCoglTextureFrame *frame;
+  GObject *scene;
+  LbaPictureFrameInfo info;
+  LbaCoglTextureFrame *old;
+  CoglPixelFormat cogl_format;
   guint w,
-    h;
+    h,
+    stride;
 
-  pic_data = (GBytes *) lba_picture_get (pic, format, &w, &h);
+  pic_data = (GBytes *) lba_picture_get_full (pic, format, &w, &h, &stride,
+                                              &info);
   if (!pic_data)
     return;
 
+  cogl_format = lba_cogl_texture_format_to_cogl (lba_pixel_format_from_string
+                                                 (format));
+  if (cogl_format == COGL_PIXEL_FORMAT_ANY) {
+    /* YUV, for example. Other consumers may need the same conversion,
+     * so it's done by the picture. */
+    g_bytes_unref (pic_data);
+    pic_data = lba_picture_get_converted (pic, LBA_PIXEL_FORMAT_RGBA8888, &w, &h,
+                                          &stride, &info);
+    if (!pic_data)
+      return;
+
+    cogl_format = COGL_PIXEL_FORMAT_RGBA_8888;
+  }
+
   LBA_LOG ("Picture update: w=%d, h=%d, format=%s", w, h, format);
 
   LBA_ASSERT (w != 0 && h != 0);
   LBA_ASSERT (pic_data != NULL);
 
-  LBA_LOCK (self);
-  if (self->pic.data) {
-    g_bytes_unref (self->pic.data);
-  }
+  frame = g_new (LbaCoglTextureFrame, 1);
+  frame->format = cogl_format;
+  frame->data = pic_data;
+  frame->w = w;
+  frame->h = h;
+  /* All the formats we upload are 4 bytes per pixel */
+  frame->rowstride = stride ? stride : w * 4;
+  frame->received = lba_stats_now ();
+  lba_stats_add (self->stats, STAGE_DELIVER, info.published, frame->received);
+
+  /* If the previous frame didn't make it to the GPU, it's dropped, but what
+   * it has changed must still be uploaded */
+  frame->info = info;
+  g_mutex_lock (&self->pending_lock);
+  old = self->pending;
+  if (old)
+    lba_picture_damage_union (&frame->info.damage, &old->info.damage);
+  g_atomic_pointer_set (&self->pending, frame);
+  g_mutex_unlock (&self->pending_lock);
+
+  lba_cogl_texture_frame_free (old);
 
-  self->pic.format = lba_cogl_texture_format_to_cogl (format);
-  self->pic.data = pic_data;
-  self->pic.w = w;
-  self->pic.h = h;
-  self->pic.last_cookie = self->pic.cookie;
-  self->pic.cookie++;
+  LBA_LOCK (self);
+  scene = self->scene ? g_object_ref (self->scene) : NULL;
   LBA_UNLOCK (self);
 
   /* Now request update the drawing scene */
-  g_signal_emit_by_name (self->scene, "request-redraw", NULL);
+  if (scene) {
+    g_signal_emit_by_name (scene, "request-redraw", NULL);
+    g_object_unref (scene);
+  }
+}
+
+/* NOTE: called in GL thread */
+static gboolean
+lba_cogl_texture_upload_pbo (LbaCoglTexture *self, CoglContext *cogl_ctx,
+                             LbaCoglTextureFrame *frame, CoglTexture *texture) {
+  CoglBitmap *bitmap;
+  gsize size = frame->rowstride * frame->h;
+  gsize data_size;
+  gconstpointer data = g_bytes_get_data (frame->data, &data_size);
+  gpointer dst;
+  gboolean ret;
+
+  if (!self->pbo_checked) {
+    self->pbo_checked = TRUE;
+    self->have_pbo = cogl_has_feature (cogl_ctx,
+                                       COGL_FEATURE_ID_MAP_BUFFER_FOR_WRITE);
+    LBA_LOG ("Pixel buffers are %savailable", self->have_pbo ? "" : "NOT ");
+  }
+
+  if (!self->have_pbo)
+    return FALSE;
+
+  if (self->pbo_size != size) {
+    g_clear_pointer (&self->pbo, cogl_object_unref);
+    self->pbo = cogl_pixel_buffer_new (cogl_ctx, size, NULL);
+    self->pbo_size = self->pbo ? size : 0;
+  }
+
+  if (!self->pbo)
+    return FALSE;
+
+  /* Discarding the previous contents lets the driver give us a fresh
+   * storage instead of waiting for the previous upload to finish */
+  dst = cogl_buffer_map (COGL_BUFFER (self->pbo), COGL_BUFFER_ACCESS_WRITE,
+                         COGL_BUFFER_MAP_HINT_DISCARD);
+  if (!dst)
+    return FALSE;
+
+  /* The padding after the last line may be missing */
+  memcpy (dst, data, MIN (size, data_size));
+  cogl_buffer_unmap (COGL_BUFFER (self->pbo));
+
+  /* The copy from the pixel buffer to the texture is done by the GPU */
+  bitmap = cogl_bitmap_new_from_buffer (COGL_BUFFER (self->pbo), frame->format,
+                                        frame->w, frame->h, frame->rowstride, 0);
+  ret = cogl_texture_set_region_from_bitmap (texture, 0, 0, 0, 0,
+                                             frame->w, frame->h, bitmap);
+  cogl_object_unref (bitmap);
+
+  return ret;
+}
+
+/* NOTE: called in GL thread */
+static void
+lba_cogl_texture_upload (LbaCoglTexture *self, CoglContext *cogl_ctx,
+                         LbaCoglTextureFrame *frame) {
+  guint back = (self->front + 1) % LBA_COGL_TEXTURE_N_BUFFERS;
+  const guint8 *data = g_bytes_get_data (frame->data, NULL);
+  LbaPictureDamage damage = frame->info.damage;
+  guint i;
+
+  /* The back texture has the frame before the last one */
+  lba_picture_damage_union (&damage, &self->last_damage);
+  self->last_damage = frame->info.damage;
+
+  if (self->buf[back].texture
+      && (self->buf[back].w != frame->w || self->buf[back].h != frame->h
+          || self->buf[back].format != frame->format)) {
+    LBA_LOG ("Picture geometry changed, recreating the texture");
+    g_clear_pointer (&self->buf[back].texture, cogl_object_unref);
+  }
+
+  if (!self->buf[back].texture) {
+    self->buf[back].texture = cogl_texture_2d_new_from_data (cogl_ctx,
+                                                             frame->w, frame->h,
+                                                             frame->format,
+                                                             frame->rowstride,
+                                                             data,
+                                                             NULL);
+    self->buf[back].w = frame->w;
+    self->buf[back].h = frame->h;
+    self->buf[back].format = frame->format;
+  } else if (damage.n_rects) {
+    /* Only what has changed */
+    for (i = 0; i < damage.n_rects; i++) {
+      LbaPictureRect *r = &damage.rects[i];
+      gint x = CLAMP (r->x, 0, (gint) frame->w),
+        y = CLAMP (r->y, 0, (gint) frame->h),
+        rw = CLAMP (r->x + r->w, 0, (gint) frame->w) - x,
+        rh = CLAMP (r->y + r->h, 0, (gint) frame->h) - y;
+
+      if (rw <= 0 || rh <= 0)
+        continue;
+
+      cogl_texture_set_region (self->buf[back].texture, x, y, x, y, rw, rh,
+                               frame->w, frame->h, frame->format,
+                               frame->rowstride, data);
+    }
+  } else if (!lba_cogl_texture_upload_pbo (self, cogl_ctx, frame,
+                                           self->buf[back].texture)) {
+    /* Same size and format: just update the contents */
+    cogl_texture_set_region (self->buf[back].texture, 0, 0, 0, 0,
+                             frame->w, frame->h, frame->w, frame->h,
+                             frame->format, frame->rowstride, data);
+  }
+
+  self->front = back;
+}
+
+/* The upload stage: runs once per frame in the GL thread, before the scene
+ * emits "on-draw". However many drawables share this texture, the new picture
+ * is uploaded only once. */
+static void
+lba_cogl_texture_scene_prepare_cb (GObject *scene, LbaCoglTexture *self) {
+  LbaCoglTextureFrame *frame;
+  CoglContext *cogl_ctx = NULL;
+
+  /* Only a peek, most of the frames have nothing new */
+  if (g_atomic_pointer_get (&self->pending) == NULL)
+    return;
+
+  g_object_get (scene, "cogl-ctx", &cogl_ctx, NULL);
+  if (!cogl_ctx) {
+    /* Not opened yet. Keep the frame for later */
+    return;
+  }
+
+  frame = lba_cogl_texture_exchange_pending (self, NULL);
+  if (frame) {
+    gint64 start = lba_stats_now (),
+      end;
+
+    LBA_TRACE_BEGIN ("texture upload", frame->w, frame->h);
+    lba_cogl_texture_upload (self, cogl_ctx, frame);
+    LBA_TRACE_END ("texture upload", frame->w, frame->h);
+
+    end = lba_stats_now ();
+    lba_stats_add (self->stats, STAGE_QUEUE, frame->received, start);
+    lba_stats_add (self->stats, STAGE_UPLOAD, start, end);
+    lba_stats_add (self->stats, STAGE_TOTAL, frame->info.produced, end);
+    lba_stats_frame (self->stats, end);
+
+    /* The data is on the GPU side now, so we can release the picture */
+    lba_cogl_texture_frame_free (frame);
+  }
+}
+
+static void
+lba_cogl_texture_set_scene (LbaCoglTexture *self, GObject *scene) {
+  if (self->scene == scene)
+    return;
+
+  if (self->scene) {
+    g_signal_handlers_disconnect_by_data (self->scene, self);
+  }
+
+  self->scene = scene;
+
+  if (self->scene) {
+    if (!g_object_class_find_property (G_OBJECT_GET_CLASS (scene), "cogl-ctx")) {
+      LBA_LOG ("Incompatible drawing scene: must have 'cogl-ctx' parameter");
+    }
+
+    g_signal_connect (self->scene, "on-prepare",
+                      G_CALLBACK (lba_cogl_texture_scene_prepare_cb), self);
+  }
 }
 
 static void
@@ -128,22 +415,23 @@ lba_cogl_texture_set_property (GObject *object,
   switch ((LbaCoglTextureProperty) property_id) {
   case PROP_DRAWING_SCENE:
     LBA_LOCK (self);
-    self->scene = g_value_get_object (value);
+    lba_cogl_texture_set_scene (self, g_value_get_object (value));
     LBA_UNLOCK (self);
     break;
 
   case PROP_PICTURE_OBJECT:
     LBA_LOCK (self);
-    if (self->pic.obj) {
-      g_object_unref (self->pic.obj);
+    if (self->pic_obj) {
+      g_signal_handlers_disconnect_by_data (self->pic_obj, self);
+      g_object_unref (self->pic_obj);
     }
 
-    self->pic.obj = g_value_dup_object (value);
+    self->pic_obj = g_value_dup_object (value);
 
-    if (self->pic.obj) {
-      lba_cogl_texture_picture_update_cb (self->pic.obj, NULL, self);
+    if (self->pic_obj) {
+      lba_cogl_texture_picture_update_cb (self->pic_obj, NULL, self);
 
-      g_signal_connect (self->pic.obj, "notify::data",
+      g_signal_connect (self->pic_obj, "notify::data",
                         G_CALLBACK (lba_cogl_texture_picture_update_cb), self);
     }
     LBA_UNLOCK (self);
@@ -163,9 +451,15 @@ lba_cogl_texture_get_property (GObject *object,
   switch ((LbaCoglTextureProperty) property_id) {
   case PROP_PICTURE_OBJECT:
     LBA_LOCK (self);
-    g_value_set_object (value, self->pic.obj);
+    g_value_set_object (value, self->pic_obj);
     LBA_UNLOCK (self);
     break;
+  case PROP_FPS:
+    g_value_set_double (value, lba_stats_get_fps (self->stats));
+    break;
+  case PROP_LATENCY:
+    g_value_take_string (value, lba_stats_to_string (self->stats));
+    break;
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -173,10 +467,11 @@ lba_cogl_texture_get_property (GObject *object,
   }
 }
 
+/* The render path: only binds what the upload stage have prepared,
+ * so no locking here. */
 static void
 lba_cogl_texture_unset (LbaCoglTexture *self, GObject *obj_3d) {
   LbaICogl *iface;
-  CoglContext *cogl_ctx;
   CoglPipeline *cogl_pipeline;
 
   /* NOTE: called in GL thread */
@@ -184,93 +479,101 @@ lba_cogl_texture_unset (LbaCoglTexture *self, GObject *obj_3d) {
     return;
 
   iface = G_TYPE_INSTANCE_GET_INTERFACE (obj_3d, LBA_ICOGL, LbaICogl);
-  iface->get_ctx (obj_3d, &cogl_ctx, &cogl_pipeline);
+  iface->get_ctx (obj_3d, NULL, &cogl_pipeline);
 
-  g_assert (cogl_ctx && cogl_pipeline);
+  g_assert (cogl_pipeline);
 
-  LBA_LOCK (self);
   cogl_pipeline_set_layer_texture (cogl_pipeline, 0, NULL);
-  LBA_UNLOCK (self);
 }
 
 static void
 lba_cogl_texture_set (LbaCoglTexture *self, GObject *obj_3d) {
   LbaICogl *iface;
-  CoglContext *cogl_ctx;
   CoglPipeline *cogl_pipeline;
 
   /* NOTE: called in GL thread */
-  if (!obj_3d || !self->pic.data)
+  if (!obj_3d || !self->buf[self->front].texture)
     return;
 
   iface = G_TYPE_INSTANCE_GET_INTERFACE (obj_3d, LBA_ICOGL, LbaICogl);
-  iface->get_ctx (obj_3d, &cogl_ctx, &cogl_pipeline);
+  iface->get_ctx (obj_3d, NULL, &cogl_pipeline);
 
-  g_assert (cogl_ctx && cogl_pipeline);
+  g_assert (cogl_pipeline);
 
-  LBA_LOCK (self);
-  if (!self->texture || self->pic.cookie != self->pic.last_cookie) {
-    g_clear_pointer (&self->texture, cogl_object_unref);
-    self->texture = cogl_texture_2d_new_from_data (cogl_ctx,
-                                                   self->pic.w, self->pic.h,
-                                                   self->pic.format, 0,
-                                                   g_bytes_get_data (self->pic.data,
-                                                                     NULL), NULL);
-  }
-
-  cogl_pipeline_set_layer_texture (cogl_pipeline, 0, self->texture);
-  LBA_UNLOCK (self);
+  cogl_pipeline_set_layer_texture (cogl_pipeline, 0,
+                                   self->buf[self->front].texture);
 }
 
-#define DEFAULT_PICTURE_SIZE_BYTES (4 * 32 * 32)
+#define DEFAULT_PICTURE_SIZE 32
+#define DEFAULT_PICTURE_SIZE_BYTES (4 * DEFAULT_PICTURE_SIZE * DEFAULT_PICTURE_SIZE)
 
 static void
 lba_cogl_texture_default_picture (LbaCoglTexture *self) {
   int i;
   static uint8_t test_rgba_tex[DEFAULT_PICTURE_SIZE_BYTES];
+  LbaCoglTextureFrame *frame = g_new (LbaCoglTextureFrame, 1);
 
-  self->pic.w = 32;
-  self->pic.h = 32;
-  self->pic.format = COGL_PIXEL_FORMAT_RGBA_8888;
+  frame->w = DEFAULT_PICTURE_SIZE;
+  frame->h = DEFAULT_PICTURE_SIZE;
+  frame->format = COGL_PIXEL_FORMAT_RGBA_8888;
+  frame->rowstride = 4 * DEFAULT_PICTURE_SIZE;
+  memset (&frame->info, 0, sizeof (frame->info));
+  frame->received = 0;
 
   for (i = 0; i < DEFAULT_PICTURE_SIZE_BYTES; i++) {
     test_rgba_tex[i] = g_random_int_range (0, 256);
   }
 
-  self->pic.data = g_bytes_new_static (test_rgba_tex, DEFAULT_PICTURE_SIZE_BYTES);
+  frame->data = g_bytes_new_static (test_rgba_tex, DEFAULT_PICTURE_SIZE_BYTES);
+  self->pending = frame;
 }
 
 static void
 lba_cogl_texture_init (LbaCoglTexture *self) {
   g_rec_mutex_init (&self->lock);
+  g_mutex_init (&self->pending_lock);
+  self->stats = lba_stats_new (stage_names);
   lba_cogl_texture_default_picture (self);
 }
 
 static void
 lba_cogl_texture_dispose (GObject *gobject) {
   LbaCoglTexture *self = (LbaCoglTexture *) gobject;
+  guint i;
 
-  if (self->texture) {
-    cogl_object_unref (self->texture);
-  }
+  for (i = 0; i < LBA_COGL_TEXTURE_N_BUFFERS; i++)
+    g_clear_pointer (&self->buf[i].texture, cogl_object_unref);
 
-  if (self->pic.obj) {
-    g_object_unref (self->pic.obj);
-  }
+  g_clear_pointer (&self->pbo, cogl_object_unref);
 
-  if (self->pic.data) {
-    g_bytes_unref (self->pic.data);
+  lba_cogl_texture_set_scene (self, NULL);
+
+  if (self->pic_obj) {
+    g_signal_handlers_disconnect_by_data (self->pic_obj, self);
+    g_clear_object (&self->pic_obj);
   }
 
-  g_rec_mutex_clear (&self->lock);
+  lba_cogl_texture_frame_free (lba_cogl_texture_exchange_pending (self, NULL));
+
   G_OBJECT_CLASS (lba_cogl_texture_parent_class)->dispose (gobject);
 }
 
+static void
+lba_cogl_texture_finalize (GObject *gobject) {
+  LbaCoglTexture *self = (LbaCoglTexture *) gobject;
+
+  g_rec_mutex_clear (&self->lock);
+  g_mutex_clear (&self->pending_lock);
+  lba_stats_free (self->stats);
+  G_OBJECT_CLASS (lba_cogl_texture_parent_class)->finalize (gobject);
+}
+
 static void
 lba_cogl_texture_class_init (LbaCoglTextureClass *klass) {
   GObjectClass *gobj_class = G_OBJECT_CLASS (klass);
 
   gobj_class->dispose = lba_cogl_texture_dispose;
+  gobj_class->finalize = lba_cogl_texture_finalize;
   gobj_class->set_property = lba_cogl_texture_set_property;
   gobj_class->get_property = lba_cogl_texture_get_property;
 
@@ -290,6 +593,24 @@ lba_cogl_texture_class_init (LbaCoglTextureClass *klass) {
                                                         G_PARAM_STATIC_STRINGS |
                                                         G_PARAM_WRITABLE));
 
+  g_object_class_install_property (gobj_class, PROP_FPS,
+                                   g_param_spec_double ("fps",
+                                                        "FPS",
+                                                        "Uploaded frames per second, "
+                                                        "if LBA_STATS are enabled",
+                                                        0, G_MAXDOUBLE, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_LATENCY,
+                                   g_param_spec_string ("latency",
+                                                        "Latency",
+                                                        "Per-stage latency percentiles, "
+                                                        "if LBA_STATS are enabled",
+                                                        NULL,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
   klass->set = lba_cogl_texture_set;
   klass->unset = lba_cogl_texture_unset;
 
@@ -25,35 +25,250 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include <bombolla/base/lba-basewindow.h>
+#include "lba-cogl-window.h"
+#include <bombolla/base/lba-basedrawable.h>
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
 
-#include <cogl/cogl.h>
+typedef struct {
+  BaseDrawable *drawable;
+  void (*draw) (BaseDrawable *);
+  void (*draw_batch) (BaseDrawable **, guint);
+  GType type;
+  GObject *texture;
+  guint seq;
+} LbaCoglWindowDrawable;
 
-typedef struct _LbaCoglWindow {
-  BaseWindow parent;
+typedef enum {
+  STAGE_DRAW,
+  STAGE_SWAP
+} LbaCoglWindowStage;
+
+static const gchar *const stage_names[] = {
+  /* clear, uploads and drawing */
+  "draw",
+  "swap",
+  NULL
+};
+
+G_DEFINE_TYPE (LbaCoglWindow, lba_cogl_window, G_TYPE_BASE_WINDOW);
+
+static gint
+lba_cogl_window_drawable_compare (gconstpointer a, gconstpointer b) {
+  const LbaCoglWindowDrawable *da = a;
+  const LbaCoglWindowDrawable *db = b;
+
+  if (da->type != db->type)
+    return da->type < db->type ? -1 : 1;
+
+  if (da->texture != db->texture)
+    return da->texture < db->texture ? -1 : 1;
+
+  /* Same state: keep the order they were added in */
+  return da->seq < db->seq ? -1 : (da->seq > db->seq);
+}
+
+static void
+lba_cogl_window_sort_drawables (LbaCoglWindow *self) {
+  guint i;
+
+  for (i = 0; i < self->drawables->len; i++) {
+    LbaCoglWindowDrawable *e =
+        &g_array_index (self->drawables, LbaCoglWindowDrawable, i);
+
+    e->texture = e->drawable->texture;
+  }
+
+  g_array_sort (self->drawables, lba_cogl_window_drawable_compare);
+  self->drawables_dirty = FALSE;
+}
+
+static void
+lba_cogl_window_bind_texture (LbaCoglWindow *self, GObject *texture,
+                              BaseDrawable *drawable, gboolean set) {
+  GType type = G_OBJECT_TYPE (texture);
+  guint id;
+
+  if (G_UNLIKELY (type != self->texture_type)) {
+    self->texture_type = type;
+    self->texture_set_id = g_signal_lookup ("set", type);
+    self->texture_unset_id = g_signal_lookup ("unset", type);
+  }
+
+  id = set ? self->texture_set_id : self->texture_unset_id;
+  if (id)
+    g_signal_emit (texture, id, 0, drawable);
+}
+
+/* Layout phase of the frame clock */
+static void
+lba_cogl_window_layout_cb (LbaFrameClock *clock, gint64 frame_time,
+                           gpointer user_data) {
+  LbaCoglWindow *self = (LbaCoglWindow *) user_data;
+
+  LBA_LOCK (self);
+  if (self->drawables && self->drawables_dirty)
+    lba_cogl_window_sort_drawables (self);
+  LBA_UNLOCK (self);
+}
+
+/* NOTE: called in GL thread with the lock taken */
+static void
+lba_cogl_window_on_draw (BaseWindow *base) {
+  LbaCoglWindow *self = (LbaCoglWindow *) base;
+  BaseDrawable *bound_by = NULL;
+  GObject *bound = NULL;
+  guint i;
+
+  if (!self->drawables || self->drawables->len == 0)
+    return;
+
+  /* Sorted in the layout phase, unless they've changed since */
+  if (self->drawables_dirty)
+    lba_cogl_window_sort_drawables (self);
+
+  i = 0;
+  while (i < self->drawables->len) {
+    LbaCoglWindowDrawable *e =
+        &g_array_index (self->drawables, LbaCoglWindowDrawable, i);
+    BaseDrawable *d = e->drawable;
+
+    if (!d->enabled) {
+      i++;
+      continue;
+    }
+
+    /* The drawables share the pipeline of the window, so the texture
+     * is only rebound when it changes */
+    if (d->texture != bound) {
+      if (bound)
+        lba_cogl_window_bind_texture (self, bound, bound_by, FALSE);
+
+      bound = d->texture;
+      if (bound)
+        lba_cogl_window_bind_texture (self, bound, d, TRUE);
+    }
+
+    bound_by = d;
+
+    if (!e->draw_batch) {
+      e->draw (d);
+      i++;
+      continue;
+    }
+
+    /* Draw the whole run of the same type and texture at once */
+    g_ptr_array_set_size (self->batch, 0);
+    for (; i < self->drawables->len; i++) {
+      LbaCoglWindowDrawable *r =
+          &g_array_index (self->drawables, LbaCoglWindowDrawable, i);
 
-  CoglContext *ctx;
-  CoglFramebuffer *fb;
-  CoglPipeline *pipeline;
+      if (r->type != e->type || r->drawable->texture != bound)
+        break;
 
-  unsigned int redraw_idle;
-  CoglBool is_dirty;
-  CoglBool draw_ready;
+      if (r->drawable->enabled)
+        g_ptr_array_add (self->batch, r->drawable);
+    }
+
+    e->draw_batch ((BaseDrawable **) self->batch->pdata, self->batch->len);
+  }
+
+  if (bound)
+    lba_cogl_window_bind_texture (self, bound, bound_by, FALSE);
+}
 
-  GRecMutex lock;
-  gboolean stopping;
+static gint
+lba_cogl_window_find_drawable (LbaCoglWindow *self, GObject *drawable) {
+  guint i;
 
-} LbaCoglWindow;
+  if (!self->drawables)
+    return -1;
 
-typedef struct _LbaCoglWindowClass {
-  BaseWindowClass parent;
-} LbaCoglWindowClass;
+  for (i = 0; i < self->drawables->len; i++) {
+    if ((GObject *) g_array_index (self->drawables, LbaCoglWindowDrawable,
+                                   i).drawable == drawable)
+      return i;
+  }
+
+  return -1;
+}
+
+static void
+lba_cogl_window_drawable_texture_cb (GObject *drawable, GParamSpec *pspec,
+                                     LbaCoglWindow *self) {
+  LBA_LOCK (self);
+  self->drawables_dirty = TRUE;
+  LBA_UNLOCK (self);
+}
+
+static void
+lba_cogl_window_drawable_gone (gpointer data, GObject *where_the_object_was) {
+  LbaCoglWindow *self = (LbaCoglWindow *) data;
+  gint i;
+
+  LBA_LOCK (self);
+  i = lba_cogl_window_find_drawable (self, where_the_object_was);
+  if (i >= 0)
+    g_array_remove_index (self->drawables, i);
+  LBA_UNLOCK (self);
+}
 
 static gboolean
-lba_cogl_window_paint_cb (void *user_data) {
+lba_cogl_window_add_drawable (BaseWindow *base, GObject *drawable) {
+  LbaCoglWindow *self = (LbaCoglWindow *) base;
+  LbaCoglWindowDrawable e;
+
+  if (!G_TYPE_CHECK_INSTANCE_TYPE (drawable, G_TYPE_BASE_DRAWABLE))
+    return FALSE;
+
+  e.drawable = (BaseDrawable *) drawable;
+  e.draw = BASE_DRAWABLE_GET_CLASS (drawable)->draw;
+  e.draw_batch = BASE_DRAWABLE_GET_CLASS (drawable)->draw_batch;
+  e.type = G_OBJECT_TYPE (drawable);
+  e.texture = NULL;
+
+  if (!e.draw)
+    return FALSE;
+
+  LBA_LOCK (self);
+  if (lba_cogl_window_find_drawable (self, drawable) < 0) {
+    e.seq = self->drawables_seq++;
+    g_array_append_val (self->drawables, e);
+    self->drawables_dirty = TRUE;
+
+    g_object_weak_ref (drawable, lba_cogl_window_drawable_gone, self);
+    g_signal_connect (drawable, "notify::texture",
+                      G_CALLBACK (lba_cogl_window_drawable_texture_cb), self);
+  }
+  LBA_UNLOCK (self);
+
+  LBA_LOG ("Retained %s", G_OBJECT_TYPE_NAME (drawable));
+  return TRUE;
+}
+
+static void
+lba_cogl_window_remove_drawable (BaseWindow *base, GObject *drawable) {
+  LbaCoglWindow *self = (LbaCoglWindow *) base;
+  gint i;
+
+  LBA_LOCK (self);
+  i = lba_cogl_window_find_drawable (self, drawable);
+  if (i >= 0) {
+    g_array_remove_index (self->drawables, i);
+    g_object_weak_unref (drawable, lba_cogl_window_drawable_gone, self);
+    g_signal_handlers_disconnect_by_func (drawable,
+                                          lba_cogl_window_drawable_texture_cb,
+                                          self);
+  }
+  LBA_UNLOCK (self);
+}
+
+/* Paint phase of the frame clock */
+static void
+lba_cogl_window_paint_cb (LbaFrameClock *clock, gint64 frame_time,
+                          gpointer user_data) {
   LbaCoglWindow *self = (LbaCoglWindow *) user_data;
+  LbaCoglWindowClass *klass = LBA_COGL_WINDOW_GET_CLASS (self);
 
   LBA_LOG ("repainting..");
 
@@ -63,9 +278,12 @@ lba_cogl_window_paint_cb (void *user_data) {
     goto cleanup;
   }
 
-  self->redraw_idle = 0;
-  self->is_dirty = FALSE;
-  self->draw_ready = FALSE;
+  /* Not opened yet */
+  if (!self->fb)
+    goto cleanup;
+
+  self->frame_start_ts = g_get_monotonic_time ();
+  LBA_TRACE_BEGIN ("paint", frame_time, 0);
 
   cogl_framebuffer_clear4f (self->fb, COGL_BUFFER_BIT_COLOR | COGL_BUFFER_BIT_DEPTH,
                             0, 0, 0, 1);
@@ -74,10 +292,24 @@ lba_cogl_window_paint_cb (void *user_data) {
   base_window_notify_display ((BaseWindow *) self);
 
   /* And swap buffers */
-  cogl_onscreen_swap_buffers (self->fb);
+  {
+    gint64 swap_start = lba_stats_now (),
+      swap_end;
+
+    LBA_TRACE_BEGIN ("swap_buffers", self->frame_sync, 0);
+    klass->swap_buffers (self);
+    if (self->frame_sync)
+      lba_frame_clock_wait_presentation (self->frame_clock);
+    LBA_TRACE_END ("swap_buffers", self->frame_sync, 0);
+
+    swap_end = lba_stats_now ();
+    lba_stats_add (self->stats, STAGE_DRAW, self->frame_start_ts, swap_start);
+    lba_stats_add (self->stats, STAGE_SWAP, swap_start, swap_end);
+    lba_stats_frame (self->stats, swap_end);
+  }
+  LBA_TRACE_END ("paint", frame_time, 0);
 cleanup:
   LBA_UNLOCK (self);
-  return G_SOURCE_REMOVE;
 }
 
 static void
@@ -88,36 +320,22 @@ lba_cogl_window_close (BaseWindow *base) {
   LBA_LOG ("TODO");
 }
 
-static void
-lba_cogl_window_maybe_redraw (LbaCoglWindow *self) {
-  if (self->is_dirty && self->draw_ready && self->redraw_idle == 0) {
-    /* We'll draw on idle instead of drawing immediately so that
-     * if Cogl reports multiple dirty rectangles we won't
-     * redundantly draw multiple frames */
-    self->redraw_idle = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
-                                         lba_cogl_window_paint_cb,
-                                         g_object_ref (self), g_object_unref);
-  }
-}
-
 static void
 lba_cogl_window_frame_event_cb (CoglOnscreen *onscreen,
                                 CoglFrameEvent event, CoglFrameInfo *info,
                                 void *user_data) {
   LbaCoglWindow *self = (LbaCoglWindow *) user_data;
 
-  if (event == COGL_FRAME_EVENT_SYNC) {
-    self->draw_ready = TRUE;
-    lba_cogl_window_maybe_redraw (self);
-  }
+  if (event == COGL_FRAME_EVENT_SYNC)
+    lba_frame_clock_presented (self->frame_clock);
 }
 
 static void
 lba_cogl_window_request_redraw (BaseWindow *base) {
   LbaCoglWindow *self = (LbaCoglWindow *) base;
 
-  self->is_dirty = TRUE;
-  lba_cogl_window_maybe_redraw (self);
+  /* Many requests before the next frame make one frame */
+  lba_frame_clock_schedule (self->frame_clock);
 }
 
 static void
@@ -126,12 +344,38 @@ lba_cogl_window_dirty_cb (CoglOnscreen *onscreen,
   lba_cogl_window_request_redraw ((BaseWindow *) user_data);
 }
 
+static CoglContext *
+lba_cogl_window_create_context (LbaCoglWindow *self, CoglError **error) {
+  return cogl_context_new (NULL, error);
+}
+
+static CoglFramebuffer *
+lba_cogl_window_create_framebuffer (LbaCoglWindow *self, int width, int height) {
+  CoglOnscreen *onscreen;
+
+  onscreen = cogl_onscreen_new (self->ctx, width, height);
+
+  cogl_onscreen_show (onscreen);
+  cogl_onscreen_set_resizable (onscreen, TRUE);
+
+  cogl_onscreen_add_frame_callback (onscreen, lba_cogl_window_frame_event_cb,
+                                    self, NULL);
+  self->frame_sync = TRUE;
+  cogl_onscreen_add_dirty_callback (onscreen, lba_cogl_window_dirty_cb, self, NULL);
+
+  return COGL_FRAMEBUFFER (onscreen);
+}
+
+static void
+lba_cogl_window_swap_buffers (LbaCoglWindow *self) {
+  cogl_onscreen_swap_buffers (self->fb);
+}
+
 /* Fixme: defaults are not set */
 static void
 lba_cogl_window_open (BaseWindow *base) {
   LbaCoglWindow *self = (LbaCoglWindow *) base;
-
-  CoglOnscreen *onscreen;
+  LbaCoglWindowClass *klass = LBA_COGL_WINDOW_GET_CLASS (self);
   CoglError *error = NULL;
   GSource *cogl_source;
 
@@ -140,22 +384,21 @@ lba_cogl_window_open (BaseWindow *base) {
     LBA_LOG ("Stopping..");
     goto cleanup;
   }
-  self->redraw_idle = 0;
-  self->is_dirty = FALSE;
-  self->draw_ready = TRUE;
+  /* Nothing is on the way to the display yet */
+  lba_frame_clock_presented (self->frame_clock);
 
-  self->ctx = cogl_context_new (NULL, &error);
+  self->ctx = klass->create_context (self, &error);
   if (!self->ctx) {
     LBA_LOG ("Failed to create context: %s\n", error->message);
+    cogl_error_free (error);
     goto cleanup;
   }
 
-  onscreen = cogl_onscreen_new (self->ctx, base->width, base->height);
-
-  cogl_onscreen_show (onscreen);
-  self->fb = onscreen;
-
-  cogl_onscreen_set_resizable (onscreen, TRUE);
+  self->fb = klass->create_framebuffer (self, base->width, base->height);
+  if (!self->fb) {
+    LBA_LOG ("Failed to create the framebuffer");
+    goto cleanup;
+  }
 
   self->pipeline = cogl_pipeline_new (self->ctx);
 
@@ -199,10 +442,6 @@ lba_cogl_window_open (BaseWindow *base) {
 
   g_source_attach (cogl_source, NULL);
 
-  cogl_onscreen_add_frame_callback (self->fb, lba_cogl_window_frame_event_cb,
-                                    self, NULL);
-  cogl_onscreen_add_dirty_callback (self->fb, lba_cogl_window_dirty_cb, self, NULL);
-
 cleanup:
   LBA_UNLOCK (self);
 }
@@ -210,15 +449,54 @@ cleanup:
 static void
 lba_cogl_window_init (LbaCoglWindow *self) {
   g_rec_mutex_init (&self->lock);
+  self->drawables = g_array_new (FALSE, FALSE, sizeof (LbaCoglWindowDrawable));
+  self->batch = g_ptr_array_new ();
+  self->stats = lba_stats_new (stage_names);
+
+  self->frame_clock = lba_frame_clock_new (NULL);
+  lba_frame_clock_add (self->frame_clock, LBA_FRAME_CLOCK_PHASE_LAYOUT,
+                       lba_cogl_window_layout_cb, self, NULL);
+  lba_frame_clock_add (self->frame_clock, LBA_FRAME_CLOCK_PHASE_PAINT,
+                       lba_cogl_window_paint_cb, self, NULL);
 }
 
 typedef enum {
   PROP_COGL_FRAMEBUFFER = 1,
   PROP_COGL_PIPELINE,
   PROP_COGL_CTX,
+  PROP_FPS,
+  PROP_LATENCY,
+  PROP_FRAME_CLOCK,
+  PROP_FRAME_INTERVAL,
+  PROP_FRAME_BUDGET,
+  PROP_CLOCK_FRAMES,
+  PROP_FRAME_OVERRUNS,
+  PROP_FRAMES_MISSED,
   N_PROPERTIES
 } LbaCoglWindowProperty;
 
+static void
+lba_cogl_window_set_property (GObject *object,
+                              guint property_id, const GValue *value,
+                              GParamSpec *pspec) {
+  LbaCoglWindow *self = (LbaCoglWindow *) object;
+
+  switch ((LbaCoglWindowProperty) property_id) {
+  case PROP_FRAME_INTERVAL:
+    lba_frame_clock_set_interval (self->frame_clock, g_value_get_int64 (value));
+    break;
+
+  case PROP_FRAME_BUDGET:
+    lba_frame_clock_set_budget (self->frame_clock, g_value_get_int64 (value));
+    break;
+
+  default:
+    /* We don't have any other property... */
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    break;
+  }
+}
+
 static void
 lba_cogl_window_get_property (GObject *object,
                               guint property_id, GValue *value, GParamSpec *pspec) {
@@ -237,6 +515,37 @@ lba_cogl_window_get_property (GObject *object,
     g_value_set_pointer (value, self->ctx);
     break;
 
+  case PROP_FPS:
+    g_value_set_double (value, lba_stats_get_fps (self->stats));
+    break;
+
+  case PROP_LATENCY:
+    g_value_take_string (value, lba_stats_to_string (self->stats));
+    break;
+
+  case PROP_FRAME_CLOCK:
+    g_value_set_pointer (value, self->frame_clock);
+    break;
+
+  case PROP_FRAME_INTERVAL:
+    g_value_set_int64 (value, lba_frame_clock_get_interval (self->frame_clock));
+    break;
+
+  case PROP_FRAME_BUDGET:
+    g_value_set_int64 (value, lba_frame_clock_get_budget (self->frame_clock));
+    break;
+
+  case PROP_CLOCK_FRAMES:
+  case PROP_FRAME_OVERRUNS:
+  case PROP_FRAMES_MISSED:{
+      guint64 counters[3];
+
+      lba_frame_clock_get_counters (self->frame_clock, &counters[0],
+                                    &counters[1], &counters[2]);
+      g_value_set_uint64 (value, counters[property_id - PROP_CLOCK_FRAMES]);
+      break;
+    }
+
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -248,10 +557,32 @@ static void
 lba_cogl_window_finalize (GObject *obj) {
   LbaCoglWindow *self = (LbaCoglWindow *) obj;
 
+  guint i;
+
+  /* No more frames. The handlers don't hold references. */
+  g_clear_pointer (&self->frame_clock, lba_frame_clock_free);
+
   LBA_LOCK (self);
   self->stopping = TRUE;
+
+  for (i = 0; i < self->drawables->len; i++) {
+    GObject *drawable = (GObject *) g_array_index (self->drawables,
+                                                   LbaCoglWindowDrawable,
+                                                   i).drawable;
+
+    g_object_weak_unref (drawable, lba_cogl_window_drawable_gone, self);
+    g_signal_handlers_disconnect_by_func (drawable,
+                                          lba_cogl_window_drawable_texture_cb,
+                                          self);
+  }
+  g_array_free (self->drawables, TRUE);
+  self->drawables = NULL;
+  g_ptr_array_free (self->batch, TRUE);
   LBA_UNLOCK (self);
   g_rec_mutex_clear (&self->lock);
+  lba_stats_free (self->stats);
+
+  G_OBJECT_CLASS (lba_cogl_window_parent_class)->finalize (obj);
 }
 
 static void
@@ -259,10 +590,18 @@ lba_cogl_window_class_init (LbaCoglWindowClass *klass) {
   GObjectClass *gobj_class = G_OBJECT_CLASS (klass);
   BaseWindowClass *base_class = BASE_WINDOW_CLASS (klass);
 
+  klass->create_context = lba_cogl_window_create_context;
+  klass->create_framebuffer = lba_cogl_window_create_framebuffer;
+  klass->swap_buffers = lba_cogl_window_swap_buffers;
+
   base_class->open = lba_cogl_window_open;
   base_class->close = lba_cogl_window_close;
   base_class->request_redraw = lba_cogl_window_request_redraw;
+  base_class->on_draw = lba_cogl_window_on_draw;
+  base_class->add_drawable = lba_cogl_window_add_drawable;
+  base_class->remove_drawable = lba_cogl_window_remove_drawable;
 
+  gobj_class->set_property = lba_cogl_window_set_property;
   gobj_class->get_property = lba_cogl_window_get_property;
   gobj_class->finalize = lba_cogl_window_finalize;
 
@@ -288,8 +627,79 @@ lba_cogl_window_class_init (LbaCoglWindowClass *klass) {
                                                          "Cogl Context",
                                                          G_PARAM_STATIC_STRINGS |
                                                          G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_FPS,
+                                   g_param_spec_double ("fps",
+                                                        "FPS",
+                                                        "Swapped frames per second, "
+                                                        "if LBA_STATS are enabled",
+                                                        0, G_MAXDOUBLE, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_LATENCY,
+                                   g_param_spec_string ("latency",
+                                                        "Latency",
+                                                        "Per-stage latency percentiles, "
+                                                        "if LBA_STATS are enabled",
+                                                        NULL,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  /* LbaFrameClock, to subscribe to the phases of the frames */
+  g_object_class_install_property (gobj_class, PROP_FRAME_CLOCK,
+                                   g_param_spec_pointer ("frame-clock",
+                                                         "Frame clock",
+                                                         "Frame clock",
+                                                         G_PARAM_STATIC_STRINGS |
+                                                         G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAME_INTERVAL,
+                                   g_param_spec_int64 ("frame-interval-us",
+                                                       "Frame interval",
+                                                       "Minimum time between the "
+                                                       "frames, 0 - paced by the "
+                                                       "display only",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_STATIC_STRINGS |
+                                                       G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAME_BUDGET,
+                                   g_param_spec_int64 ("frame-budget-us",
+                                                       "Frame budget",
+                                                       "Frames that take longer are "
+                                                       "overruns, 0 - the interval "
+                                                       "or 60 Hz",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_STATIC_STRINGS |
+                                                       G_PARAM_READWRITE));
+
+  /* NOTE: not "frames", LbaCoglOffscreenWindow has its own */
+  g_object_class_install_property (gobj_class, PROP_CLOCK_FRAMES,
+                                   g_param_spec_uint64 ("clock-frames",
+                                                        "Clock frames",
+                                                        "Frames run by the clock",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAME_OVERRUNS,
+                                   g_param_spec_uint64 ("frame-overruns",
+                                                        "Frame overruns",
+                                                        "Frames over the budget",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_FRAMES_MISSED,
+                                   g_param_spec_uint64 ("frames-missed",
+                                                        "Frames missed",
+                                                        "Deadlines missed while a "
+                                                        "frame was due",
+                                                        0, G_MAXUINT64, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
 }
 
-G_DEFINE_TYPE (LbaCoglWindow, lba_cogl_window, G_TYPE_BASE_WINDOW)
 /* Export plugin */
-    BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_GTYPE (lba_cogl_window);
+BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_GTYPE (lba_cogl_window);
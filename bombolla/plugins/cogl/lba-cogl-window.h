@@ -0,0 +1,85 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LBA_COGL_WINDOW_H__
+#  define __LBA_COGL_WINDOW_H__
+
+#  include <bombolla/base/lba-basewindow.h>
+#  include <bombolla/base/lba-stats.h>
+#  include <bombolla/base/lba-frame-clock.h>
+#  include <cogl/cogl.h>
+
+GType lba_cogl_window_get_type (void);
+
+#  define G_TYPE_LBA_COGL_WINDOW (lba_cogl_window_get_type ())
+#  define LBA_COGL_WINDOW_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj),G_TYPE_LBA_COGL_WINDOW ,LbaCoglWindowClass))
+#  define LBA_COGL_WINDOW_CLASS(klass)  (G_TYPE_CHECK_CLASS_CAST((klass), G_TYPE_LBA_COGL_WINDOW ,LbaCoglWindowClass))
+
+typedef struct _LbaCoglWindow {
+  BaseWindow parent;
+
+  CoglContext *ctx;
+  CoglFramebuffer *fb;
+  CoglPipeline *pipeline;
+
+  /* Paces the redraws. With frame_sync each frame also waits for the
+   * previous one to be presented. */
+  LbaFrameClock *frame_clock;
+  gboolean frame_sync;
+
+  GRecMutex lock;
+  gboolean stopping;
+
+  /* When the current frame started to paint */
+  gint64 frame_start_ts;
+
+  LbaStats *stats;
+
+  /* Retained render list: the drawables register once and are drawn
+   * in one loop, grouped by type and texture */
+  GArray *drawables;
+  gboolean drawables_dirty;
+  guint drawables_seq;
+  GPtrArray *batch;
+
+  /* Cached "set"/"unset" signals of the last texture type */
+  GType texture_type;
+  guint texture_set_id;
+  guint texture_unset_id;
+} LbaCoglWindow;
+
+typedef struct _LbaCoglWindowClass {
+  BaseWindowClass parent;
+
+  /* Where to draw: by default a context for the display and an onscreen
+   * framebuffer, the subclasses may render somewhere else */
+  CoglContext *(*create_context) (LbaCoglWindow *, CoglError **);
+  CoglFramebuffer *(*create_framebuffer) (LbaCoglWindow *, int width, int height);
+  void (*swap_buffers) (LbaCoglWindow *);
+} LbaCoglWindowClass;
+
+#endif
@@ -0,0 +1,147 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Draws N textured cubes and labels into an offscreen window as fast as
+ * it can, and prints the frame rate and the time spent on each frame.
+ * Doesn't need a display.
+ *
+ * Usage: lba-cogl-bench-drawables [N drawables] [frames] */
+
+#include <glib-object.h>
+#include <stdlib.h>
+
+/* Declare this magic symbol explicitly */
+GType lba_core_object_get_type (void);
+
+#define N_TEXTURES 4
+#define N_WARMUP_FRAMES 10
+
+static gint done;
+static gint64 start;
+static gint64 draw_time;
+static gint64 draw_time_max;
+
+static void
+bench_frame_done_cb (GObject *window, guint n, gint64 duration, gpointer data) {
+  /* The first frames upload the textures */
+  if (n <= N_WARMUP_FRAMES) {
+    start = g_get_monotonic_time ();
+    return;
+  }
+
+  draw_time += duration;
+  draw_time_max = MAX (draw_time_max, duration);
+}
+
+static void
+bench_frames_done_cb (GObject *window, gpointer data) {
+  g_atomic_int_set (&done, 1);
+}
+
+int
+main (int argc, char *argv[]) {
+  guint n_drawables = argc > 1 ? atoi (argv[1]) : 1000;
+  guint n_frames = argc > 2 ? atoi (argv[2]) : 300;
+  GObject *core,
+   *window = NULL;
+  GString *script;
+  gpointer ctx = NULL;
+  gint64 elapsed;
+  guint i;
+
+  core = g_object_new (lba_core_object_get_type (), NULL);
+
+  script = g_string_new ("(create LbaCoglOffscreenWindow w)\n"
+                         "(set w.width 640)\n" "(set w.height 480)\n");
+  g_string_append_printf (script, "(set w.frames %u)\n",
+                          n_frames + N_WARMUP_FRAMES);
+
+  for (i = 0; i < N_TEXTURES; i++)
+    g_string_append_printf (script, "(create LbaCoglTexture t%u)\n", i);
+
+  /* The textures are interleaved, so the render list has something to sort */
+  for (i = 0; i < n_drawables; i++) {
+    g_string_append_printf (script,
+                            "(create LbaCoglCube c%u)\n"
+                            "(set c%u.drawing-scene w)\n"
+                            "(set c%u.texture t%u)\n"
+                            "(set c%u.x %d.0)\n"
+                            "(set c%u.y %d.0)\n"
+                            "(set c%u.z -4.0)\n",
+                            i, i, i, i % N_TEXTURES,
+                            i, (gint) (i % 20) - 10,
+                            i, (gint) (i / 20 % 20) - 10, i);
+  }
+
+  /* And a few labels */
+  for (i = 0; i < 10; i++) {
+    g_string_append_printf (script,
+                            "(create LbaCoglLabel l%u)\n"
+                            "(set l%u.drawing-scene w)\n"
+                            "(set l%u.y 0.%u)\n", i, i, i, i);
+  }
+
+  g_signal_emit_by_name (core, "execute", script->str);
+  g_string_free (script, TRUE);
+
+  g_signal_emit_by_name (core, "pick", "w", &window);
+  if (!window) {
+    g_printerr ("Couldn't create the window: cogl plugins not found\n");
+    g_object_unref (core);
+    return 77;
+  }
+
+  g_signal_connect (window, "frame-done", G_CALLBACK (bench_frame_done_cb), NULL);
+  g_signal_connect (window, "frames-done", G_CALLBACK (bench_frames_done_cb), NULL);
+
+  g_signal_emit_by_name (core, "execute", "(async call w.open)\n(sync)");
+
+  g_object_get (window, "cogl-ctx", &ctx, NULL);
+  if (!ctx) {
+    g_printerr ("Couldn't open the window\n");
+    g_object_unref (window);
+    g_object_unref (core);
+    return 77;
+  }
+
+  while (!g_atomic_int_get (&done))
+    g_usleep (1000);
+
+  elapsed = g_get_monotonic_time () - start;
+
+  g_signal_handlers_disconnect_by_func (window, bench_frame_done_cb, NULL);
+  g_signal_handlers_disconnect_by_func (window, bench_frames_done_cb, NULL);
+
+  g_print ("drawables: %u frames: %u fps: %.2f "
+           "frame: %.3f ms avg, %.3f ms max\n",
+           n_drawables, n_frames, n_frames * (gdouble) G_USEC_PER_SEC / elapsed,
+           draw_time / 1000.0 / n_frames, draw_time_max / 1000.0);
+
+  g_object_unref (window);
+  g_object_unref (core);
+  return 0;
+}
@@ -0,0 +1,277 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <glib-object.h>
+#include <bmixin/bmixin.h>
+#include "bombolla/plugins/cogl/base/icogl.h"
+#include "bombolla/base/lba-picture.h"
+
+/* Declare this magic symbols explicitly */
+GType lba_core_object_get_type (void);
+GType lba_cogl_get_type (void);
+
+#define N_FRAMES 5
+/* Big enough for the cube in the middle not to cover the label at (0, 0) */
+#define READBACK_SIZE 256
+
+/* A drawable that only counts how many times it was painted */
+typedef struct {
+  BMixinInstance i;
+} LbaTestPainter;
+
+typedef struct {
+  BMixinClass c;
+} LbaTestPainterClass;
+
+static gint painted;
+
+static void
+  lba_test_painter_icogl_init (LbaICogl * iface);
+
+/* *INDENT-OFF* */ 
+BM_DEFINE_MIXIN (lba_test_painter, LbaTestPainter,
+                 BM_ADD_IFACE (lba, test_painter, icogl),
+                 BM_ADD_DEP (lba_cogl));
+/* *INDENT-ON* */ 
+
+static void
+lba_test_painter_paint (GObject *obj, CoglFramebuffer *fb, CoglPipeline *pipeline) {
+  g_atomic_int_inc (&painted);
+}
+
+static void
+lba_test_painter_icogl_init (LbaICogl *iface) {
+  iface->paint = lba_test_painter_paint;
+}
+
+static void
+lba_test_painter_init (GObject *object, LbaTestPainter *self) {
+}
+
+static void
+lba_test_painter_class_init (GObjectClass *object_class,
+                             LbaTestPainterClass *klass) {
+}
+
+typedef struct {
+  GObject *core;
+  GObject *window;
+  gint done;
+
+  /* The last frame, RGBA. NULL if nothing was really drawn */
+  guint8 *pixels;
+} Fixture;
+
+static void
+frames_done_cb (GObject *window, Fixture *fixture) {
+  g_atomic_int_set (&fixture->done, 1);
+}
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer user_data) {
+  fixture->core = g_object_new (lba_core_object_get_type (), NULL);
+  fixture->done = 0;
+
+  /* Without GPU the test doesn't depend on the machine */
+  g_signal_emit_by_name (fixture->core, "execute",
+                         "(create LbaCoglOffscreenWindow w)\n"
+                         "(set w.gpu false)\n"
+                         "(set w.width 64)\n" "(set w.height 64)\n");
+
+  g_signal_emit_by_name (fixture->core, "pick", "w", &fixture->window);
+  g_assert_nonnull (fixture->window);
+
+  g_signal_connect (fixture->window, "frames-done",
+                    G_CALLBACK (frames_done_cb), fixture);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer user_data) {
+  g_signal_handlers_disconnect_by_data (fixture->window, fixture);
+  g_signal_emit_by_name (fixture->core, "execute", "(destroy w)");
+  g_clear_pointer (&fixture->pixels, g_free);
+  g_clear_object (&fixture->window);
+  g_clear_object (&fixture->core);
+}
+
+static void
+render_frames (Fixture *fixture) {
+  gint64 deadline = g_get_monotonic_time () + 10 * G_USEC_PER_SEC;
+  guint rendered = 0;
+  gchar *cmd;
+
+  cmd = g_strdup_printf ("(set w.frames %u)\n(async call w.open)\n(sync)",
+                         N_FRAMES);
+  g_signal_emit_by_name (fixture->core, "execute", cmd);
+  g_free (cmd);
+
+  while (!g_atomic_int_get (&fixture->done)) {
+    g_assert_cmpint (g_get_monotonic_time (), <, deadline);
+    g_usleep (1000);
+  }
+
+  g_object_get (fixture->window, "frames-rendered", &rendered, NULL);
+  g_assert_cmpuint (rendered, ==, N_FRAMES);
+}
+
+static void
+test_empty (Fixture *fixture, gconstpointer user_data) {
+  render_frames (fixture);
+}
+
+/* NOTE: called in GL thread, after the frame is drawn */
+static void
+read_back_cb (GObject *window, guint n, gint64 duration, Fixture *fixture) {
+  CoglFramebuffer *fb = NULL;
+  CoglContext *ctx = NULL;
+  CoglRenderer *renderer;
+
+  if (n != N_FRAMES)
+    return;
+
+  g_object_get (window, "cogl-framebuffer", &fb, "cogl-ctx", &ctx, NULL);
+  g_assert_nonnull (fb);
+  g_assert_nonnull (ctx);
+
+  /* The no-op driver doesn't draw anything */
+  renderer = cogl_display_get_renderer (cogl_context_get_display (ctx));
+  if (cogl_renderer_get_driver (renderer) == COGL_DRIVER_NOP)
+    return;
+
+  fixture->pixels = g_malloc (READBACK_SIZE * READBACK_SIZE * 4);
+  g_assert_true (cogl_framebuffer_read_pixels (fb, 0, 0, READBACK_SIZE,
+                                               READBACK_SIZE,
+                                               COGL_PIXEL_FORMAT_RGBA_8888,
+                                               fixture->pixels));
+}
+
+static const guint8 *
+pixel_at (Fixture *fixture, guint x, guint y) {
+  return fixture->pixels + 4 * (y * READBACK_SIZE + x);
+}
+
+static void
+test_drawables (Fixture *fixture, gconstpointer user_data) {
+  GObject *pic = NULL;
+  guint8 red[4 * 4 * 4];
+  const guint8 *p;
+  guint x,
+    y,
+    i,
+    white = 0;
+
+  /* A red picture for the texture of the cube, so it can be told apart from
+   * the background, that is black, and the label, that is white */
+  for (i = 0; i < sizeof (red); i += 4) {
+    red[i] = 0xff;
+    red[i + 1] = 0;
+    red[i + 2] = 0;
+    red[i + 3] = 0xff;
+  }
+
+  g_type_ensure (lba_picture_get_type ());
+  g_signal_emit_by_name (fixture->core, "execute", "(create LbaPicture pic)");
+  g_signal_emit_by_name (fixture->core, "pick", "pic", &pic);
+  g_assert_nonnull (pic);
+  lba_picture_set_full (pic, "rgba8888", 4, 4, 0, g_bytes_new (red, sizeof (red)));
+  g_object_unref (pic);
+
+  /* Pixels can only be read back from the GPU */
+  g_signal_emit_by_name (fixture->core, "execute",
+                         "(set w.gpu true)\n"
+                         "(set w.width " G_STRINGIFY (READBACK_SIZE) ")\n"
+                         "(set w.height " G_STRINGIFY (READBACK_SIZE) ")\n"
+                         "(create LbaCoglTexture t)\n"
+                         "(set t.picture pic)\n"
+                         "(create LbaCoglCube c1)\n"
+                         "(set c1.drawing-scene w)\n"
+                         "(set c1.texture t)\n"
+                         "(create LbaCoglCube c2)\n"
+                         "(set c2.drawing-scene w)\n"
+                         "(set c2.x 4.0)\n"
+                         "(create LbaCoglLabel l)\n"
+                         "(set l.drawing-scene w)\n" "(set l.text test)\n");
+
+  g_signal_connect (fixture->window, "frame-done", G_CALLBACK (read_back_cb),
+                    fixture);
+
+  render_frames (fixture);
+
+  g_signal_emit_by_name (fixture->core, "execute",
+                         "(destroy c1)\n(destroy c2)\n(destroy l)\n(destroy t)\n"
+                         "(destroy pic)");
+
+  if (!fixture->pixels) {
+    g_test_skip ("No GL: the frames were rendered, but nothing was drawn");
+    return;
+  }
+
+  /* The textured cube is in the middle, whatever its rotation is */
+  p = pixel_at (fixture, READBACK_SIZE / 2, READBACK_SIZE / 2);
+  g_assert_cmpuint (p[0], >, 0x80);
+  g_assert_cmpuint (p[1], <, 0x40);
+  g_assert_cmpuint (p[2], <, 0x40);
+
+  /* And the label is somewhere in the top left corner */
+  for (y = 0; y < READBACK_SIZE / 4; y++) {
+    for (x = 0; x < READBACK_SIZE / 4; x++) {
+      p = pixel_at (fixture, x, y);
+      if (p[0] > 0x80 && p[1] > 0x80 && p[2] > 0x80)
+        white++;
+    }
+  }
+  g_assert_cmpuint (white, >, 0);
+}
+
+static void
+test_paint (Fixture *fixture, gconstpointer user_data) {
+  /* So (create) finds it by name */
+  g_type_ensure (lba_test_painter_get_type ());
+  g_atomic_int_set (&painted, 0);
+
+  g_signal_emit_by_name (fixture->core, "execute",
+                         "(create LbaTestPainter p)\n(set p.drawing-scene w)");
+
+  render_frames (fixture);
+  g_assert_cmpint (g_atomic_int_get (&painted), >, 0);
+
+  g_signal_emit_by_name (fixture->core, "execute", "(destroy p)");
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/cogl/offscreen/empty", Fixture, NULL,
+              fixture_set_up, test_empty, fixture_tear_down);
+  g_test_add ("/cogl/offscreen/drawables", Fixture, NULL,
+              fixture_set_up, test_drawables, fixture_tear_down);
+  g_test_add ("/cogl/offscreen/paint", Fixture, NULL,
+              fixture_set_up, test_paint, fixture_tear_down);
+
+  return g_test_run ();
+}
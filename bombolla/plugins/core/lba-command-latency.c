@@ -0,0 +1,74 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bombolla/lba-log.h>
+#include <bombolla/base/lba-stats.h>
+#include <bmixin/bmixin.h>
+
+/* (latency on), (latency off): toggles the latency and fps counters.
+ * (latency obj): prints the counters of the object. */
+static void
+lba_command_latency (GObject *core, const char *arg) {
+  GObject *obj = NULL;
+  gchar *latency = NULL;
+
+  g_return_if_fail (arg != NULL);
+
+  if (!g_strcmp0 (arg, "on") || !g_strcmp0 (arg, "off")) {
+    LBA_LOG ("Latency stats %s", arg);
+    lba_stats_set_enabled (!g_strcmp0 (arg, "on"));
+    return;
+  }
+
+  g_signal_emit_by_name (core, "pick", arg, &obj);
+  if (G_UNLIKELY (!obj)) {
+    g_warning ("Object '%s' not found", arg);
+    return;
+  }
+
+  if (!g_object_class_find_property (G_OBJECT_GET_CLASS (obj), "latency")) {
+    g_warning ("'%s' has no latency stats", arg);
+    g_object_unref (obj);
+    return;
+  }
+
+  g_object_get (obj, "latency", &latency, NULL);
+  g_object_unref (obj);
+
+  if (!lba_stats_enabled ())
+    g_printf ("%s: disabled, use (latency on) or LBA_STATS=1\n", arg);
+  else
+    g_printf ("%s: %s\n", arg, latency);
+
+  g_free (latency);
+}
+
+BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_COMMAND (latency, LBA_COMMAND_SETUP (
+                                                                     .c_marshaller
+                                                                     =
+                                                                     g_cclosure_marshal_VOID__STRING),
+                                        G_TYPE_STRING);
@@ -0,0 +1,57 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bombolla/lba-log.h>
+#include <string.h>
+
+/* (log LbaCogl*:debug,*:none): sets the levels, as LBA_LOG does.
+ * (log "dump FILE"): writes the trace, to decode it with lba-trace-decode. */
+static void
+lba_command_log (GObject *core, const char *arg) {
+  GError *err = NULL;
+
+  g_return_if_fail (arg != NULL);
+
+  if (g_str_has_prefix (arg, "dump ")) {
+    const gchar *path = arg + strlen ("dump ");
+
+    if (!lba_trace_dump (path, &err)) {
+      g_warning ("Couldn't write the trace: %s", err->message);
+      g_error_free (err);
+    }
+    return;
+  }
+
+  if (!lba_log_set_levels (arg))
+    g_warning ("Bad log levels '%s'", arg);
+}
+
+BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_COMMAND (log, LBA_COMMAND_SETUP (
+                                                                 .c_marshaller
+                                                                 =
+                                                                 g_cclosure_marshal_VOID__STRING),
+                                        G_TYPE_STRING);
@@ -26,11 +26,14 @@
  */
 
 #include <bombolla/lba-log.h>
+#include <bombolla/base/lba-profile.h>
 #include <bmixin/bmixin.h>
 
 typedef struct {
   gchar *expr;
   GObject *self;
+  /* "Type.signal: expr", for the profiler and the trace. Interned */
+  const gchar *label;
 } BombollaOnCommandCtx;
 
 /* Callback for "on" command. It's designed to use parameters
@@ -43,6 +46,7 @@ lba_command_on_cb (GClosure *closure,
                    const GValue *param_values,
                    gpointer invocation_hint, gpointer marshal_data) {
   BombollaOnCommandCtx *ctx;
+  gint64 start;
 
   /* Execute stored commands */
   LBA_LOG ("on something of %d parameters", n_param_values);
@@ -50,7 +54,11 @@ lba_command_on_cb (GClosure *closure,
   ctx = closure->data;
 
   /* Now execute  */
+  start = lba_profile_now ();
+  LBA_TRACE_BEGIN_NAMED ("on", ctx->label, 0);
   g_signal_emit_by_name (ctx->self, "execute", ctx->expr);
+  LBA_TRACE_END_NAMED ("on", ctx->label, 0);
+  lba_profile_add (LBA_PROFILE_ON, ctx->label, start, lba_profile_now ());
 }
 
 static void
@@ -97,6 +105,13 @@ lba_command_on (GObject *core, GObject *obj, const char *signal, const char *exp
   /* ref ?? */
   on_ctx->self = core;
   on_ctx->expr = g_strdup (expr);
+  {
+    gchar *label = g_strdup_printf ("%s.%s: %s", G_OBJECT_TYPE_NAME (obj),
+                                    signal, expr);
+
+    on_ctx->label = g_intern_string (label);
+    g_free (label);
+  }
 
   /* User data are the lines we will execute. */
   closure =
@@ -0,0 +1,93 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bombolla/lba-log.h>
+#include <bombolla/base/lba-profile.h>
+
+/* (stats show): prints how many times the commands, signals, objects and
+ * "on" handlers ran, and for how long.
+ * (stats json), (stats csv): the same, for the machines.
+ * (stats "json FILE"), (stats "csv FILE"): writes it into the file.
+ * (stats reset), (stats on), (stats off) */
+static void
+lba_command_stats (GObject *core, const char *arg) {
+  LbaProfileFormat format;
+  GError *err = NULL;
+  gchar **tokens;
+  const gchar *verb;
+  const gchar *path;
+  gchar *out;
+
+  g_return_if_fail (arg != NULL);
+
+  tokens = g_strsplit (arg, " ", 2);
+  verb = tokens[0] ? tokens[0] : "";
+  path = tokens[0] ? tokens[1] : NULL;
+
+  if (!g_strcmp0 (verb, "on") || !g_strcmp0 (verb, "off")) {
+    LBA_LOG ("Profiler %s", verb);
+    lba_profile_set_enabled (!g_strcmp0 (verb, "on"));
+    goto done;
+  }
+
+  if (!g_strcmp0 (verb, "reset")) {
+    lba_profile_reset ();
+    goto done;
+  }
+
+  if (!g_strcmp0 (verb, "show")) {
+    format = LBA_PROFILE_FORMAT_TEXT;
+  } else if (!g_strcmp0 (verb, "json")) {
+    format = LBA_PROFILE_FORMAT_JSON;
+  } else if (!g_strcmp0 (verb, "csv")) {
+    format = LBA_PROFILE_FORMAT_CSV;
+  } else {
+    g_warning ("Unknown stats command '%s'", arg);
+    goto done;
+  }
+
+  if (!lba_profile_enabled ())
+    g_warning ("The profiler is off, use (stats on) or unset LBA_PROFILE");
+
+  out = lba_profile_to_string (format);
+  if (!path) {
+    g_print ("%s", out);
+  } else if (!g_file_set_contents (path, out, -1, &err)) {
+    g_warning ("Couldn't write the stats: %s", err->message);
+    g_error_free (err);
+  }
+  g_free (out);
+
+done:
+  g_strfreev (tokens);
+}
+
+BOMBOLLA_PLUGIN_SYSTEM_PROVIDE_COMMAND (stats, LBA_COMMAND_SETUP (
+                                                                   .c_marshaller
+                                                                   =
+                                                                   g_cclosure_marshal_VOID__STRING),
+                                        G_TYPE_STRING);
@@ -27,185 +27,622 @@
 
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
+#include <string.h>
 #include <gst/gst.h>
+#include <gst/app/app.h>
+#include <gst/video/video.h>
 #include "bombolla/base/lba-picture.h"
-
-typedef struct _LbaGst {
+#include "bombolla/base/lba-stats.h"
+
+/* How many frames may be in flight between GStreamer and the picture users:
+ * one being shown, one being uploaded, one waiting */
+#define LBA_GST_N_FRAMES 3
+
+typedef struct _LbaGst LbaGst;
+
+/* One appsrc or appsink of the pipeline, and the picture it talks to.
+ * "lba_in" and "lba_out" use LbaGst itself as the picture, "lba_in_*" and
+ * "lba_out_*" get a child picture each. */
+typedef struct {
+  LbaGst *gst;
+  GstElement *element;
+  GObject *picture;
+  gulong data_notify_id;
+
+  /* appsink: last caps seen and what they mean for LbaPicture */
+  GstCaps *caps;
+  GstVideoInfo info;
+  LbaPixelFormat format;
+
+  /* appsrc: what it was configured with */
+  GstVideoFormat src_format;
+  guint src_w;
+  guint src_h;
+} LbaGstPad;
+
+struct _LbaGst {
   BMixinInstance i;
 
   gchar *pipeline_desc;
   GstElement *pipeline;
-  GstElement *appsrc;
-} LbaGst;
+
+  /* LbaGstPad */
+  GPtrArray *pads;
+  /* element name -> child picture. Kept across the pipeline updates, so
+   * whatever was bound to them keeps working */
+  GHashTable *pictures;
+
+  /* All the pads together */
+  LbaStats *stats;
+};
 
 typedef struct _LbaGstClass {
   BMixinClass c;
+
+  GObject *(*picture) (GObject *, const gchar *);
 } LbaGstClass;
 
+/* Child pictures */
+typedef struct _LbaGstInput {
+  BMixinInstance i;
+} LbaGstInput;
+
+typedef struct _LbaGstInputClass {
+  BMixinClass c;
+} LbaGstInputClass;
+
+typedef struct _LbaGstOutput {
+  BMixinInstance i;
+} LbaGstOutput;
+
+typedef struct _LbaGstOutputClass {
+  BMixinClass c;
+} LbaGstOutputClass;
+
+/* A buffer mapped for as long as the picture data is alive */
+typedef struct {
+  GstBuffer *buffer;
+  GstMapInfo map;
+} LbaGstFrame;
+
 typedef enum {
   PROP_PIPELINE = 1,
+  PROP_FPS,
+  PROP_LATENCY,
   N_PROPERTIES
 } LbaGstProperty;
 
+typedef enum {
+  STAGE_PRODUCE,
+  STAGE_PUSH
+} LbaGstStage;
+
+static const gchar *const stage_names[] = {
+  /* appsink "new-sample" -> all the picture users are notified */
+  "produce",
+  /* lba_picture_set () -> pushed to appsrc */
+  "push",
+  NULL
+};
+
+enum {
+  SIGNAL_PICTURE,
+  LAST_SIGNAL
+};
+
+static guint lba_gst_signals[LAST_SIGNAL] = { 0 };
+
 static void
 lba_picture_class_setup (gpointer class_ptr) {
   LbaPictureClass *pklass = bm_class_get_mixin (class_ptr, lba_picture_get_type ());
 
-  /* FIXME: split this setup into another mixin "LbaWritablePicture".
-   * also LbaGst should have a multitude of pictures on input and multitude on
-   * output. Probably it should be split into various mixins. Such as LbaGstInput
-   * LbaGstOutput.
-   * Or LbaGstPicture, LbaGstWritablePicture */
-
+  /* FIXME: split this setup into another mixin "LbaWritablePicture". */
   pklass->writable_properties = TRUE;
 }
 
 BM_DEFINE_MIXIN (lba_gst, LbaGst, BM_ADD_DEP (lba_picture),
                  BM_ADD_CLASS_SETUP (lba_picture));
 
-static const struct {
-  const gchar *lba;
-  const gchar *gst;
-} bunch[] = {
-  { "argb8888", "ARGB" },
-  { "rgba8888", "RGBA" }
-};
+BM_DEFINE_MIXIN (lba_gst_input, LbaGstInput, BM_ADD_DEP (lba_picture),
+                 BM_ADD_CLASS_SETUP (lba_picture));
 
-static const char *
-lba_gst_format_to_gst (const char *fmt) {
-  int i;
+BM_DEFINE_MIXIN (lba_gst_output, LbaGstOutput, BM_ADD_DEP (lba_picture));
 
-  for (i = 0; i < G_N_ELEMENTS (bunch); i++)
-    if (g_strcmp0 (bunch[i].lba, fmt)) {
-      return bunch[i].gst;
-    }
+static void
+lba_gst_input_init (GObject *object, LbaGstInput *self) {
+}
+
+static void
+lba_gst_input_class_init (GObjectClass *gobj_class, LbaGstInputClass *mixin_class) {
+}
 
-  return NULL;
+static void
+lba_gst_output_init (GObject *object, LbaGstOutput *self) {
 }
 
-static const char *
-lba_gst_format_to_lba (const char *fmt) {
-  int i;
+static void
+lba_gst_output_class_init (GObjectClass *gobj_class,
+                           LbaGstOutputClass *mixin_class) {
+}
 
-  for (i = 0; i < G_N_ELEMENTS (bunch); i++)
-    if (g_strcmp0 (bunch[i].gst, fmt)) {
-      return bunch[i].lba;
-    }
+static GstVideoFormat
+lba_gst_format_to_gst (LbaPixelFormat format) {
+  switch (format) {
+  case LBA_PIXEL_FORMAT_ARGB8888:
+    return GST_VIDEO_FORMAT_ARGB;
+  case LBA_PIXEL_FORMAT_RGBA8888:
+    return GST_VIDEO_FORMAT_RGBA;
+  case LBA_PIXEL_FORMAT_BGRA8888:
+    return GST_VIDEO_FORMAT_BGRA;
+  case LBA_PIXEL_FORMAT_I420:
+    return GST_VIDEO_FORMAT_I420;
+  case LBA_PIXEL_FORMAT_NV12:
+    return GST_VIDEO_FORMAT_NV12;
+  default:
+    /* GStreamer has no premultiplied formats */
+    return GST_VIDEO_FORMAT_UNKNOWN;
+  }
+}
+
+static LbaPixelFormat
+lba_gst_format_to_lba (GstVideoFormat format) {
+  switch (format) {
+  case GST_VIDEO_FORMAT_ARGB:
+    return LBA_PIXEL_FORMAT_ARGB8888;
+  case GST_VIDEO_FORMAT_RGBA:
+    return LBA_PIXEL_FORMAT_RGBA8888;
+  case GST_VIDEO_FORMAT_BGRA:
+    return LBA_PIXEL_FORMAT_BGRA8888;
+  case GST_VIDEO_FORMAT_I420:
+    return LBA_PIXEL_FORMAT_I420;
+  case GST_VIDEO_FORMAT_NV12:
+    return LBA_PIXEL_FORMAT_NV12;
+  default:
+    return LBA_PIXEL_FORMAT_UNKNOWN;
+  }
+}
+
+/* How LbaPicture lays out the planes of @format. Returns the number of them. */
+static guint
+lba_gst_picture_layout (LbaPixelFormat format, guint h, guint stride,
+                        gsize offsets[GST_VIDEO_MAX_PLANES],
+                        gint strides[GST_VIDEO_MAX_PLANES]) {
+  gsize luma = (gsize) stride * h;
+
+  offsets[0] = 0;
+  strides[0] = stride;
+
+  switch (format) {
+  case LBA_PIXEL_FORMAT_I420:
+    offsets[1] = luma;
+    strides[1] = stride / 2;
+    offsets[2] = luma + (gsize) strides[1] * ((h + 1) / 2);
+    strides[2] = stride / 2;
+    return 3;
+  case LBA_PIXEL_FORMAT_NV12:
+    offsets[1] = luma;
+    strides[1] = stride;
+    return 2;
+  default:
+    return 1;
+  }
+}
 
-  return NULL;
+static gboolean
+lba_gst_layout_matches (LbaPixelFormat format, guint h, const gsize *offsets,
+                        const gint *strides) {
+  gsize expected_offsets[GST_VIDEO_MAX_PLANES];
+  gint expected_strides[GST_VIDEO_MAX_PLANES];
+  guint i,
+    n;
+
+  n = lba_gst_picture_layout (format, h, strides[0], expected_offsets,
+                              expected_strides);
+  for (i = 0; i < n; i++)
+    if (offsets[i] - offsets[0] != expected_offsets[i]
+        || strides[i] != expected_strides[i])
+      return FALSE;
+
+  return TRUE;
 }
 
+/* Copies the planes as LbaPicture expects them */
+static GBytes *
+lba_gst_repack (LbaPixelFormat format, const guint8 *data, guint w, guint h,
+                const gsize *offsets, const gint *strides, guint *stride) {
+  gsize dst_offsets[GST_VIDEO_MAX_PLANES];
+  gint dst_strides[GST_VIDEO_MAX_PLANES];
+  gsize size;
+  guint8 *dst;
+  guint n,
+    p,
+    row;
+
+  *stride = lba_pixel_format_default_stride (format, w);
+  size = lba_pixel_format_frame_size (format, w, h, *stride);
+  n = lba_gst_picture_layout (format, h, *stride, dst_offsets, dst_strides);
+  dst = g_malloc (size);
+
+  for (p = 0; p < n; p++) {
+    guint rows = p ? (h + 1) / 2 : h;
+    gsize len = MIN (strides[p], dst_strides[p]);
+
+    for (row = 0; row < rows; row++)
+      memcpy (dst + dst_offsets[p] + row * dst_strides[p],
+              data + offsets[p] + row * strides[p], len);
+  }
+
+  return g_bytes_new_take (dst, size);
+}
+
+static void
+lba_gst_frame_free (gpointer data) {
+  LbaGstFrame *frame = (LbaGstFrame *) data;
+
+  gst_buffer_unmap (frame->buffer, &frame->map);
+  gst_buffer_unref (frame->buffer);
+  g_free (frame);
+}
+
+/* NOTE: called in the streaming thread of this very appsink. Several
+ * outputs are delivered in parallel. */
 static GstFlowReturn
-lba_gst_new_sample (GstElement *object, gpointer user_data) {
-  LbaGst *self = (LbaGst *) user_data;
-  GstSample *samp = NULL;
+lba_gst_pad_new_sample (GstAppSink *appsink, gpointer user_data) {
+  LbaGstPad *pad = (LbaGstPad *) user_data;
+  GstSample *samp;
+  GstCaps *caps;
   GstBuffer *buffer;
-  GstMapInfo map;
+  GstVideoMeta *meta;
+  LbaGstFrame *frame;
+  GBytes *bytes;
+  const gsize *offsets;
+  const gint *strides;
+  guint stride;
+  gint64 produced = lba_stats_now ();
+
+  samp = gst_app_sink_pull_sample (appsink);
+  if (!samp)
+    return GST_FLOW_EOS;
+
+  /* Parse the caps only when they change */
+  caps = gst_sample_get_caps (samp);
+  if (caps != pad->caps
+      && !(caps && pad->caps && gst_caps_is_equal (caps, pad->caps))) {
+    gst_caps_replace (&pad->caps, caps);
+    pad->format = LBA_PIXEL_FORMAT_UNKNOWN;
+
+    if (caps && gst_video_info_from_caps (&pad->info, caps)) {
+      pad->format = lba_gst_format_to_lba (GST_VIDEO_INFO_FORMAT (&pad->info));
+    }
 
-  g_signal_emit_by_name (object, "pull-sample", &samp);
-  buffer = gst_sample_get_buffer (samp);
+    LBA_LOG ("%s: new caps, LbaPicture format: %s",
+             GST_ELEMENT_NAME (appsink), lba_pixel_format_to_string (pad->format));
+  }
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  /* This buffer will travel with the data through the LbaPicture mixin */
-  GBytes *bytes = g_bytes_new_with_free_func (map.data,
-                                              map.size,
-                                              (GDestroyNotify) gst_buffer_unref,
-                                              gst_buffer_ref (buffer));
+  if (G_UNLIKELY (pad->format == LBA_PIXEL_FORMAT_UNKNOWN)) {
+    LBA_LOG ("Unsupported caps, dropping the frame");
+    goto done;
+  }
 
-  gst_buffer_unmap (buffer, &map);
+  buffer = gst_sample_get_buffer (samp);
+  frame = g_new (LbaGstFrame, 1);
+  frame->buffer = gst_buffer_ref (buffer);
+
+  if (!gst_buffer_map (frame->buffer, &frame->map, GST_MAP_READ)) {
+    LBA_LOG ("Failed to map the buffer");
+    gst_buffer_unref (frame->buffer);
+    g_free (frame);
+    goto done;
+  }
 
-  GstStructure *s = gst_caps_get_structure (gst_sample_get_caps (samp), 0);
-  gint w,
-    h;
+  /* Upstream may lay out the lines differently than the caps say */
+  meta = gst_buffer_get_video_meta (buffer);
+  if (meta) {
+    offsets = meta->offset;
+    strides = meta->stride;
+  } else {
+    offsets = pad->info.offset;
+    strides = pad->info.stride;
+  }
 
-  if (s && gst_structure_get_int (s, "width", &w)
-      && gst_structure_get_int (s, "height", &h)) {
+  if (G_LIKELY (lba_gst_layout_matches (pad->format,
+                                        GST_VIDEO_INFO_HEIGHT (&pad->info),
+                                        offsets, strides))) {
+    /* The buffer stays mapped until the last user of the picture releases it */
+    stride = strides[0];
+    bytes = g_bytes_new_with_free_func (frame->map.data + offsets[0],
+                                        frame->map.size - offsets[0],
+                                        lba_gst_frame_free, frame);
+  } else {
+    /* The chroma planes are padded or placed differently */
+    bytes = lba_gst_repack (pad->format, frame->map.data,
+                            GST_VIDEO_INFO_WIDTH (&pad->info),
+                            GST_VIDEO_INFO_HEIGHT (&pad->info), offsets, strides,
+                            &stride);
+    lba_gst_frame_free (frame);
+  }
+
+  if (produced)
+    lba_picture_set_produced (pad->picture, produced);
 
-    const gchar *fmt =
-        lba_gst_format_to_lba (gst_structure_get_string (s, "format"));
+  lba_picture_set_full (pad->picture, lba_pixel_format_to_string (pad->format),
+                        GST_VIDEO_INFO_WIDTH (&pad->info),
+                        GST_VIDEO_INFO_HEIGHT (&pad->info), stride, bytes);
 
-    LBA_LOG ("Notifying bytes of size %" G_GSIZE_FORMAT, map.size);
+  if (produced) {
+    gint64 notified = lba_stats_now ();
 
-    lba_picture_set (BM_GET_GOBJECT (self), fmt, w, h, bytes);
+    lba_stats_add (pad->gst->stats, STAGE_PRODUCE, produced, notified);
+    lba_stats_frame (pad->gst->stats, notified);
   }
 
+done:
   gst_sample_unref (samp);
   return GST_FLOW_OK;
 }
 
 static void
-lba_gst_data_update_cb (GObject *pic, GParamSpec *pspec, LbaGst *self) {
+lba_gst_pad_data_update_cb (GObject *pic, GParamSpec *pspec, LbaGstPad *pad) {
   gchar format[16];
   guint w,
-    h;
+    h,
+    stride;
   GBytes *data;
+  GstBuffer *buf;
+  GstFlowReturn ret;
+  LbaPictureFrameInfo frame_info;
+  LbaPixelFormat lba_format;
+  GstVideoFormat gst_format;
+  gsize offsets[GST_VIDEO_MAX_PLANES] = { 0 };
+  gint strides[GST_VIDEO_MAX_PLANES] = { 0 };
+  guint i,
+    n_planes;
+  gboolean need_meta = FALSE;
+  gint64 pushed;
+
+  data = (GBytes *) lba_picture_get_full (pic, format, &w, &h, &stride,
+                                          &frame_info);
+  if (!data)
+    return;
+
+  lba_format = lba_pixel_format_from_string (format);
+  gst_format = lba_gst_format_to_gst (lba_format);
+  if (gst_format == GST_VIDEO_FORMAT_UNKNOWN) {
+    /* Premultiplied, for example. Converted once for all the consumers. */
+    g_bytes_unref (data);
+    lba_format = LBA_PIXEL_FORMAT_RGBA8888;
+    gst_format = GST_VIDEO_FORMAT_RGBA;
+    data = lba_picture_get_converted (pic, lba_format, &w, &h, &stride,
+                                      &frame_info);
+    if (!data) {
+      LBA_LOG ("Unsupported picture format %s", format);
+      return;
+    }
+  }
+
+  /* Reconfigure only if the format changes, otherwise push bare buffers */
+  if (w != pad->src_w || h != pad->src_h || gst_format != pad->src_format) {
+    GstCaps *caps;
+
+    /* Also resets the framerate to 0/1 */
+    if (!gst_video_info_set_format (&pad->info, gst_format, w, h)) {
+      LBA_LOG ("Bad picture size %ux%u", w, h);
+      g_bytes_unref (data);
+      return;
+    }
 
-  g_return_if_fail (self->appsrc != NULL);
+    caps = gst_video_info_to_caps (&pad->info);
 
-  data = (GBytes *) lba_picture_get (pic, format, &w, &h);
+    g_object_set (pad->element, "caps", caps,
+                  "max-bytes", (guint64) LBA_GST_N_FRAMES
+                  * GST_VIDEO_INFO_SIZE (&pad->info), NULL);
+    gst_caps_unref (caps);
 
-  /* So now we push this data to the appsrc */
-  {
-    GstSample *sample;
-    GstBuffer *buf = gst_buffer_new_wrapped_bytes (data);
-    GstCaps *caps = gst_caps_new_simple ("video/x-raw",
-                                         "width", G_TYPE_INT, w,
-                                         "height", G_TYPE_INT, h,
-                                         "format", G_TYPE_STRING,
-                                         lba_gst_format_to_gst (format),
-                                         NULL);
-    GstSegment segment;
+    pad->src_format = gst_format;
+    pad->src_w = w;
+    pad->src_h = h;
+  }
 
-    gst_segment_init (&segment, GST_FORMAT_TIME);
-    sample = gst_sample_new (buf, caps, &segment, NULL);
+  /* Zero-copy: the buffer keeps a reference to the picture data */
+  buf = gst_buffer_new_wrapped_bytes (data);
+  g_bytes_unref (data);
 
-    /* TODO push only buffer if the format is kept the same */
-    /* TODO handle ret value */
-    GstFlowReturn ret;
+  /* Tell GStreamer where the lines and the planes are if it wouldn't guess */
+  if (!stride)
+    stride = lba_pixel_format_default_stride (lba_format, w);
 
-    g_signal_emit_by_name (self->appsrc, "push-sample", sample, &ret);
+  n_planes = lba_gst_picture_layout (lba_format, h, stride, offsets, strides);
+  for (i = 0; i < n_planes; i++)
+    if (offsets[i] != GST_VIDEO_INFO_PLANE_OFFSET (&pad->info, i)
+        || strides[i] != GST_VIDEO_INFO_PLANE_STRIDE (&pad->info, i))
+      need_meta = TRUE;
 
-    gst_sample_unref (sample);
-    gst_buffer_unref (buf);
-    gst_caps_unref (caps);
-    g_bytes_unref (data);
+  if (need_meta) {
+    gst_buffer_add_video_meta_full (buf, GST_VIDEO_FRAME_FLAG_NONE, gst_format,
+                                    w, h, n_planes, offsets, strides);
   }
+
+  ret = gst_app_src_push_buffer (GST_APP_SRC (pad->element), buf);
+  if (ret != GST_FLOW_OK)
+    LBA_LOG ("Push failed: %s", gst_flow_get_name (ret));
+
+  pushed = lba_stats_now ();
+  lba_stats_add (pad->gst->stats, STAGE_PUSH, frame_info.published, pushed);
+  lba_stats_frame (pad->gst->stats, pushed);
 }
 
 static void
-lba_gst_pipeline_update (LbaGst *self, const gchar *desc) {
-  GstElement *appsink;
+lba_gst_pad_free (gpointer data) {
+  LbaGstPad *pad = (LbaGstPad *) data;
 
-  g_free (self->pipeline_desc);
-  self->pipeline_desc = g_strdup (desc);
+  if (pad->data_notify_id)
+    g_signal_handler_disconnect (pad->picture, pad->data_notify_id);
+
+  gst_caps_replace (&pad->caps, NULL);
+  gst_object_unref (pad->element);
+  g_free (pad);
+}
+
+/* Child pictures are also registered in the core under the element's name,
+ * so they can be used from the shell: (set tex.picture lba_out_cam0) */
+static void
+lba_gst_register_picture (GObject *picture, const gchar *name) {
+  GType core_type = g_type_from_name ("LbaCoreObject");
+  GObject *core;
+
+  if (!core_type)
+    return;
+
+  core = g_object_new (core_type, NULL);
+  g_signal_emit_by_name (core, "add", picture, name);
+  g_object_unref (core);
+}
+
+static GObject *
+lba_gst_pad_picture (LbaGst *self, const gchar *name, gboolean input) {
+  GObject *picture;
+  GType type;
+
+  if (!g_strcmp0 (name, "lba_in") || !g_strcmp0 (name, "lba_out"))
+    return BM_GET_GOBJECT (self);
+
+  picture = g_hash_table_lookup (self->pictures, name);
+  if (picture)
+    return picture;
+
+  type = bm_register_mixed_type (NULL, G_TYPE_OBJECT, input ?
+                                 lba_gst_input_get_type () :
+                                 lba_gst_output_get_type (), NULL);
+
+  picture = g_object_new (type, NULL);
+  g_hash_table_insert (self->pictures, g_strdup (name), picture);
+  lba_gst_register_picture (picture, name);
+
+  return picture;
+}
+
+static void
+lba_gst_add_pad (LbaGst *self, GstElement *element) {
+  GstAppSinkCallbacks callbacks = {.new_sample = lba_gst_pad_new_sample };
+  gchar *name = gst_element_get_name (element);
+  gboolean input;
+  LbaGstPad *pad;
+  guint i;
+
+  if (GST_IS_APP_SRC (element)
+      && (!g_strcmp0 (name, "lba_in") || g_str_has_prefix (name, "lba_in_"))) {
+    input = TRUE;
+  } else if (GST_IS_APP_SINK (element)
+             && (!g_strcmp0 (name, "lba_out")
+                 || g_str_has_prefix (name, "lba_out_"))) {
+    input = FALSE;
+  } else {
+    goto done;
+  }
+
+  pad = g_new0 (LbaGstPad, 1);
+  pad->gst = self;
+  pad->picture = lba_gst_pad_picture (self, name, input);
+
+  /* Feeding appsrc from the picture appsink writes to would loop */
+  for (i = 0; i < self->pads->len; i++) {
+    LbaGstPad *other = g_ptr_array_index (self->pads, i);
+
+    if (other->picture == pad->picture) {
+      g_warning ("%s: LbaGst can't be both input and output, use lba_in_* "
+                 "or lba_out_*", name);
+      g_free (pad);
+      goto done;
+    }
+  }
+
+  pad->element = gst_object_ref (element);
+  g_ptr_array_add (self->pads, pad);
+
+  if (input) {
+    pad->data_notify_id = g_signal_connect (pad->picture, "notify::data",
+                                            G_CALLBACK (lba_gst_pad_data_update_cb),
+                                            pad);
+  } else {
+    guint max_buffers = 0;
+
+    /* Don't let the frames pile up if nobody consumes them fast enough */
+    g_object_get (element, "max-buffers", &max_buffers, NULL);
+    if (max_buffers == 0)
+      g_object_set (element, "max-buffers", LBA_GST_N_FRAMES, NULL);
+
+    /* No signal emission per frame, and no need for emit-signals=true */
+    gst_app_sink_set_callbacks (GST_APP_SINK (element), &callbacks, pad, NULL);
+  }
+
+  LBA_LOG ("Found %s", name);
 
+done:
+  g_free (name);
+}
+
+static void
+lba_gst_discover_element (const GValue *item, gpointer user_data) {
+  lba_gst_add_pad ((LbaGst *) user_data, g_value_get_object (item));
+}
+
+static void
+lba_gst_stop (LbaGst *self) {
   if (self->pipeline) {
     gst_element_set_state (self->pipeline, GST_STATE_NULL);
-    gst_object_unref (self->pipeline);
+    g_clear_object (&self->pipeline);
   }
 
+  /* Nothing is streaming anymore, so the pads can go */
+  g_ptr_array_set_size (self->pads, 0);
+}
+
+static void
+lba_gst_pipeline_update (LbaGst *self, const gchar *desc) {
+  GError *err = NULL;
+
+  g_free (self->pipeline_desc);
+  self->pipeline_desc = g_strdup (desc);
+
+  lba_gst_stop (self);
+
   LBA_LOG ("Starting the pipeline '%s'", self->pipeline_desc);
-  self->pipeline = gst_parse_launch (self->pipeline_desc, NULL);
-
-  g_clear_pointer (&self->appsrc, gst_object_unref);
-  self->appsrc = gst_bin_get_by_name (GST_BIN (self->pipeline), "lba_in");
-  if (self->appsrc) {
-    /* NOTE: this is a hack, we must have input pictures and output pictures */
-    g_signal_connect (BM_GET_GOBJECT (self), "notify::data",
-                      G_CALLBACK (lba_gst_data_update_cb), self);
+  self->pipeline = gst_parse_launch (self->pipeline_desc, &err);
+  if (!self->pipeline) {
+    g_warning ("Failed to create the pipeline: %s", err ? err->message : "?");
+    g_clear_error (&err);
+    return;
   }
+  g_clear_error (&err);
 
-  appsink = gst_bin_get_by_name (GST_BIN (self->pipeline), "lba_out");
-  if (appsink) {
-    g_signal_connect (appsink, "new-sample", G_CALLBACK (lba_gst_new_sample), self);
+  if (GST_IS_BIN (self->pipeline)) {
+    GstIterator *it = gst_bin_iterate_recurse (GST_BIN (self->pipeline));
 
-    g_warn_if_fail (self->appsrc == NULL || appsink == NULL);
-    gst_object_unref (appsink);
+    while (gst_iterator_foreach (it, lba_gst_discover_element, self)
+           == GST_ITERATOR_RESYNC) {
+      g_ptr_array_set_size (self->pads, 0);
+      gst_iterator_resync (it);
+    }
+    gst_iterator_free (it);
+  } else {
+    lba_gst_add_pad (self, self->pipeline);
   }
 
   gst_element_set_state (self->pipeline, GST_STATE_PLAYING);
 }
 
+static GObject *
+lba_gst_picture (GObject *object, const gchar *name) {
+  LbaGst *self = bm_get_LbaGst (object);
+
+  g_return_val_if_fail (name != NULL, NULL);
+
+  if (!g_strcmp0 (name, "lba_in") || !g_strcmp0 (name, "lba_out"))
+    return object;
+
+  return g_hash_table_lookup (self->pictures, name);
+}
+
 static void
 lba_gst_set_property (GObject *object,
                       guint property_id, const GValue *value, GParamSpec *pspec) {
@@ -232,6 +669,12 @@ lba_gst_get_property (GObject *object,
   case PROP_PIPELINE:
     g_value_set_string (value, self->pipeline_desc);
     break;
+  case PROP_FPS:
+    g_value_set_double (value, lba_stats_get_fps (self->stats));
+    break;
+  case PROP_LATENCY:
+    g_value_take_string (value, lba_stats_to_string (self->stats));
+    break;
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -241,20 +684,23 @@ lba_gst_get_property (GObject *object,
 
 static void
 lba_gst_init (GObject *gobj, LbaGst *self) {
-  /* TODO: input-picture and output-picture?? */
+  self->pads = g_ptr_array_new_with_free_func (lba_gst_pad_free);
+  self->pictures = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                          g_free, g_object_unref);
+  self->stats = lba_stats_new (stage_names);
 }
 
 static void
 lba_gst_dispose (GObject *gobject) {
   LbaGst *self = bm_get_LbaGst (gobject);
 
-  if (self->pipeline) {
-    gst_element_set_state (self->pipeline, GST_STATE_NULL);
-    g_clear_object (&self->pipeline);
-  }
+  if (self->pads)
+    lba_gst_stop (self);
 
-  g_clear_object (&self->appsrc);
+  g_clear_pointer (&self->pads, g_ptr_array_unref);
+  g_clear_pointer (&self->pictures, g_hash_table_unref);
   g_clear_pointer (&self->pipeline_desc, g_free);
+  g_clear_pointer (&self->stats, lba_stats_free);
 
   BM_CHAINUP (self, GObject)->dispose (gobject);
 }
@@ -265,14 +711,41 @@ lba_gst_class_init (GObjectClass *gobj_class, LbaGstClass *mixin_class) {
   gobj_class->set_property = lba_gst_set_property;
   gobj_class->get_property = lba_gst_get_property;
 
+  mixin_class->picture = lba_gst_picture;
+
   g_object_class_install_property (gobj_class, PROP_PIPELINE,
                                    g_param_spec_string ("pipeline",
                                                         "Pipeline",
                                                         "Pipeline",
-                                                        "videotestsrc ! videoconvert ! appsink name=lba_out emit-signals=true",
+                                                        "videotestsrc ! videoconvert ! appsink name=lba_out",
                                                         G_PARAM_STATIC_STRINGS |
                                                         G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobj_class, PROP_FPS,
+                                   g_param_spec_double ("fps",
+                                                        "FPS",
+                                                        "Frames per second of all the "
+                                                        "pads, if LBA_STATS are enabled",
+                                                        0, G_MAXDOUBLE, 0,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  g_object_class_install_property (gobj_class, PROP_LATENCY,
+                                   g_param_spec_string ("latency",
+                                                        "Latency",
+                                                        "Per-stage latency percentiles, "
+                                                        "if LBA_STATS are enabled",
+                                                        NULL,
+                                                        G_PARAM_STATIC_STRINGS |
+                                                        G_PARAM_READABLE));
+
+  /* Returns the picture of "lba_in*" or "lba_out*" element */
+  lba_gst_signals[SIGNAL_PICTURE] =
+      g_signal_new ("picture", G_TYPE_FROM_CLASS (gobj_class),
+                    G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+                    BM_CLASS_VFUNC_OFFSET (mixin_class, picture),
+                    NULL, NULL, NULL, G_TYPE_OBJECT, 1, G_TYPE_STRING);
+
   static int gstinit = 0;
 
   if (gstinit == 0) {
@@ -27,13 +27,25 @@
 
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
+#include <glib-unix.h>
+#include <sys/timerfd.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 
 typedef struct _LbaClock {
   GObject parent;
 
-  /* TODO: mutex */
+  GRecMutex lock;
+  /* 0 = disabled */
   guint64 tick_interval;
-  guint source_id;
+  gint fd;
+  GSource *source;
+
+  /* g_get_monotonic_time () of the last tick */
+  gint64 monotonic_time;
+  /* Ticks that were due while the previous one was still being dispatched */
+  guint64 overruns;
 } LbaClock;
 
 typedef struct _LbaClockClass {
@@ -42,83 +54,122 @@ typedef struct _LbaClockClass {
 
 typedef enum {
   PROP_TICK_INTERVAL = 1,
+  PROP_TICK_INTERVAL_US,
   PROP_CURRENT_TIME,
+  PROP_MONOTONIC_TIME,
+  PROP_OVERRUNS,
   N_PROPERTIES
 } LbaClockProperty;
 
+enum {
+  SIGNAL_TICK,
+  LAST_SIGNAL
+};
+
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
+static guint lba_clock_signals[LAST_SIGNAL] = { 0 };
+static guint notify_signal_id;
+
 G_DEFINE_TYPE (LbaClock, lba_clock, G_TYPE_OBJECT);
 
+/* Most of the time nobody listens to most of the properties, and
+ * "current-time" is expensive to get: GDateTime and then a string */
+static void
+lba_clock_notify_if_watched (LbaClock *self, LbaClockProperty prop) {
+  GParamSpec *pspec = obj_properties[prop];
+
+  if (g_signal_has_handler_pending (self, notify_signal_id,
+                                    g_param_spec_get_name_quark (pspec), FALSE))
+    g_object_notify_by_pspec (G_OBJECT (self), pspec);
+}
+
 static gboolean
-lba_clock_tick (gpointer ptr) {
+lba_clock_tick (gint fd, GIOCondition condition, gpointer ptr) {
   LbaClock *self = (LbaClock *) ptr;
+  guint64 expirations;
+  gint64 now;
+
+  /* Reading is what rearms the timer, otherwise the fd stays readable */
+  if (read (fd, &expirations, sizeof (expirations)) != sizeof (expirations)) {
+    /* EAGAIN: the timer was reset meanwhile */
+    return G_SOURCE_CONTINUE;
+  }
+
+  now = g_get_monotonic_time ();
 
-  LBA_LOG ("%p, Timer notify", self);
+  LBA_LOCK (self);
+  self->monotonic_time = now;
+  self->overruns += expirations - 1;
+  LBA_UNLOCK (self);
+
+  if (G_UNLIKELY (expirations > 1)) {
+    LBA_LOG ("%p, Missed %" G_GUINT64_FORMAT " ticks", self, expirations - 1);
+  }
+
+  g_signal_emit (self, lba_clock_signals[SIGNAL_TICK], 0, now,
+                 (guint) (expirations - 1));
+
+  lba_clock_notify_if_watched (self, PROP_MONOTONIC_TIME);
+  lba_clock_notify_if_watched (self, PROP_CURRENT_TIME);
+  if (expirations > 1)
+    lba_clock_notify_if_watched (self, PROP_OVERRUNS);
 
-  g_object_notify (G_OBJECT (self), "current-time");
   return G_SOURCE_CONTINUE;
 }
 
+/* NOTE: called with the lock taken */
+static void
+lba_clock_set_interval (LbaClock *self, guint64 interval) {
+  struct itimerspec t = { 0 };
+  struct timespec now;
+
+  if (self->tick_interval == interval)
+    return;
+
+  self->tick_interval = interval;
+
+  if (G_UNLIKELY (self->fd < 0))
+    return;
+
+  if (interval != 0) {
+    t.it_interval.tv_sec = interval / G_USEC_PER_SEC;
+    t.it_interval.tv_nsec = (interval % G_USEC_PER_SEC) * 1000;
+
+    /* The first deadline is absolute, and the kernel counts the next ones
+     * from it. So the ticks don't drift, however late they are dispatched. */
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    t.it_value.tv_sec = now.tv_sec + t.it_interval.tv_sec;
+    t.it_value.tv_nsec = now.tv_nsec + t.it_interval.tv_nsec;
+    if (t.it_value.tv_nsec >= 1000000000) {
+      t.it_value.tv_sec++;
+      t.it_value.tv_nsec -= 1000000000;
+    }
+  }
+
+  /* Zero disarms it */
+  if (timerfd_settime (self->fd, TFD_TIMER_ABSTIME, &t, NULL) < 0)
+    g_warning ("timerfd_settime failed: %s", g_strerror (errno));
+}
+
 static void
 lba_clock_set_property (GObject *object,
                         guint property_id, const GValue *value, GParamSpec *pspec) {
   LbaClock *self = (LbaClock *) object;
 
+  LBA_LOCK (self);
   switch ((LbaClockProperty) property_id) {
-  case PROP_TICK_INTERVAL:{
-
-      guint64 tick = g_value_get_uint (value);
-
-      /* MUTEX_LOCK */
-      if (self->tick_interval != tick) {
-        /* Remove old timer */
-        if (self->tick_interval != 0) {
-          g_source_remove (self->source_id);
-        }
-
-        if (tick != 0) {
-#if 0
-          /* #include <sys/timerfd.h> */
-          /* #include <glib-unix.h> */
-
-          /* wtf this doesn't work ??
-           * It's dispatched all the time!!
-           * Need to read the code of g_socket. */
-          int tfd = timerfd_create (CLOCK_MONOTONIC, 0 /* TFD_NONBLOCK */ );
-
-          struct itimerspec t;
-
-          t.it_interval.tv_sec = tick / 1000;
-          t.it_interval.tv_nsec = tick * 1000000 - t.it_interval.tv_sec * 1000000000;
-          t.it_value.tv_sec = 0;
-          t.it_value.tv_nsec = 1;       /* First expiration is immediate */
-
-          timerfd_settime (tfd, 0, &t, NULL);
-
-          GSource *source = g_unix_fd_source_new (tfd, G_IO_IN);
-#else
-          /* What a shame - no cool unix stuff :/ */
-          GSource *source = g_timeout_source_new (tick);
-#endif
-
-          g_source_set_callback (source, lba_clock_tick, self, NULL);
-
-          /* So we will need to remove this source when the
-           * tick-interval changes OR when we teardown */
-          self->source_id = g_source_attach (source,
-                                             /* lba-core main context */
-                                             NULL);
-        }
-      }
-
-      self->tick_interval = tick;
-      /* MUTEX UNLOCK */
-      break;
-    }
+  case PROP_TICK_INTERVAL:
+    lba_clock_set_interval (self, (guint64) g_value_get_uint (value) * 1000);
+    break;
+  case PROP_TICK_INTERVAL_US:
+    lba_clock_set_interval (self, g_value_get_uint64 (value));
+    break;
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
   }
+  LBA_UNLOCK (self);
 }
 
 static void
@@ -126,23 +177,47 @@ lba_clock_get_property (GObject *object,
                         guint property_id, GValue *value, GParamSpec *pspec) {
   LbaClock *self = (LbaClock *) object;
 
+  LBA_LOCK (self);
   switch ((LbaClockProperty) property_id) {
   case PROP_TICK_INTERVAL:
-    g_value_set_uint (value, self->tick_interval);
+    g_value_set_uint (value, self->tick_interval / 1000);
+    break;
+  case PROP_TICK_INTERVAL_US:
+    g_value_set_uint64 (value, self->tick_interval);
+    break;
+  case PROP_CURRENT_TIME:
+    g_value_take_boxed (value, g_date_time_new_now_local ());
+    break;
+  case PROP_MONOTONIC_TIME:
+    g_value_set_int64 (value, self->monotonic_time);
+    break;
+  case PROP_OVERRUNS:
+    g_value_set_uint64 (value, self->overruns);
     break;
-  case PROP_CURRENT_TIME:{
-      g_value_take_boxed (value, g_date_time_new_now_local ());
-      break;
-    }
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
   }
+  LBA_UNLOCK (self);
 }
 
 static void
 lba_clock_init (LbaClock *self) {
+  g_rec_mutex_init (&self->lock);
+
+  self->fd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (self->fd < 0) {
+    g_warning ("timerfd_create failed: %s", g_strerror (errno));
+    return;
+  }
+
+  /* Stays idle while the timer is disarmed */
+  self->source = g_unix_fd_source_new (self->fd, G_IO_IN);
+  g_source_set_callback (self->source, (GSourceFunc) lba_clock_tick, self, NULL);
+  g_source_attach (self->source,
+                   /* lba-core main context */
+                   NULL);
 }
 
 static void
@@ -151,14 +226,28 @@ lba_clock_dispose (GObject *gobject) {
 
   /* NOTE: is there a race condition?
    * Like if the source is executed right now?? */
-  if (self->tick_interval != 0) {
-    g_source_remove (self->source_id);
-    self->tick_interval = 0;
+  if (self->source) {
+    g_source_destroy (self->source);
+    g_clear_pointer (&self->source, g_source_unref);
+  }
+
+  if (self->fd >= 0) {
+    close (self->fd);
+    self->fd = -1;
   }
 
   G_OBJECT_CLASS (lba_clock_parent_class)->dispose (gobject);
 }
 
+static void
+lba_clock_finalize (GObject *gobject) {
+  LbaClock *self = (LbaClock *) gobject;
+
+  g_rec_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (lba_clock_parent_class)->finalize (gobject);
+}
+
 static void
 _datetime2str (const GValue *src_value, GValue *dest_value) {
   g_value_take_string (dest_value, g_date_time_format_iso8601 ((GDateTime *)
@@ -171,27 +260,58 @@ lba_clock_class_init (LbaClockClass *klass) {
   GObjectClass *gobj_class = G_OBJECT_CLASS (klass);
 
   gobj_class->dispose = lba_clock_dispose;
+  gobj_class->finalize = lba_clock_finalize;
   gobj_class->set_property = lba_clock_set_property;
   gobj_class->get_property = lba_clock_get_property;
 
-  g_object_class_install_property
-      (gobj_class,
-       PROP_TICK_INTERVAL,
-       g_param_spec_uint ("tick-interval-ms",
-                          "TickIntervalMS",
-                          "Tick interval in milliseconds (0 = disabled)", 0,
-                          G_MAXUINT, 0,
-                          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
-                          G_PARAM_CONSTRUCT));
-
-  /* TODO: return boxed GDateTime and register a convertion func to string */
-  g_object_class_install_property (gobj_class, PROP_CURRENT_TIME,
-                                   g_param_spec_boxed ("current-time",
-                                                       "CurrentTime",
-                                                       "Current time",
-                                                       G_TYPE_DATE_TIME,
-                                                       G_PARAM_STATIC_STRINGS |
-                                                       G_PARAM_READABLE));
+  obj_properties[PROP_TICK_INTERVAL] =
+      g_param_spec_uint ("tick-interval-ms",
+                         "TickIntervalMS",
+                         "Tick interval in milliseconds (0 = disabled)", 0,
+                         G_MAXUINT, 0,
+                         G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+                         G_PARAM_CONSTRUCT);
+
+  obj_properties[PROP_TICK_INTERVAL_US] =
+      g_param_spec_uint64 ("tick-interval-us",
+                           "TickIntervalUS",
+                           "Tick interval in microseconds (0 = disabled)", 0,
+                           G_MAXUINT64, 0,
+                           G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE);
+
+  /* Boxed GDateTime, converted to string only for the string properties
+   * bound to it */
+  obj_properties[PROP_CURRENT_TIME] =
+      g_param_spec_boxed ("current-time",
+                          "CurrentTime",
+                          "Current time",
+                          G_TYPE_DATE_TIME,
+                          G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+
+  obj_properties[PROP_MONOTONIC_TIME] =
+      g_param_spec_int64 ("monotonic-time",
+                          "MonotonicTime",
+                          "Monotonic time of the last tick in microseconds",
+                          0, G_MAXINT64, 0,
+                          G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+
+  obj_properties[PROP_OVERRUNS] =
+      g_param_spec_uint64 ("overruns",
+                           "Overruns",
+                           "How many ticks were missed",
+                           0, G_MAXUINT64, 0,
+                           G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+
+  g_object_class_install_properties (gobj_class, N_PROPERTIES, obj_properties);
+
+  /* Emitted in the main context on each tick with its monotonic time and
+   * the number of ticks missed since the previous one */
+  lba_clock_signals[SIGNAL_TICK] =
+      g_signal_new ("tick", G_TYPE_FROM_CLASS (klass),
+                    G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                    G_TYPE_NONE, 2, G_TYPE_INT64, G_TYPE_UINT);
+
+  notify_signal_id = g_signal_lookup ("notify", G_TYPE_OBJECT);
 
   static gboolean convertions;
 
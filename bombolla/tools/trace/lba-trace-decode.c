@@ -0,0 +1,355 @@
+/* la Bombolla GObject shell
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bombolla/lba-log.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Prints the records of a file written by lba_trace_dump (), of all the
+ * threads together, in the order of time. With --chrome writes them as
+ * Chrome trace events JSON instead, to open in Perfetto or chrome://tracing.
+ *
+ * Usage: lba-trace-decode [--chrome] FILE */
+
+typedef struct {
+  guint32 line;
+  guint16 phase;
+  guint16 flags;
+  const gchar *domain;
+  const gchar *func;
+  const gchar *format;
+} DecodeEvent;
+
+typedef struct {
+  const guint8 *ptr;
+  const guint8 *end;
+} DecodeReader;
+
+typedef struct {
+  DecodeEvent *events;
+  guint32 n_events;
+  /* Thread names by the thread number */
+  GHashTable *threads;
+  /* The strings of the named records by the pointer */
+  GHashTable *names;
+  GArray *records;
+} DecodeTrace;
+
+static gboolean
+decode_bytes (DecodeReader *r, gpointer val, gsize size) {
+  if ((gsize) (r->end - r->ptr) < size)
+    return FALSE;
+
+  memcpy (val, r->ptr, size);
+  r->ptr += size;
+  return TRUE;
+}
+
+static const gchar *
+decode_string (DecodeReader *r) {
+  const guint8 *zero = memchr (r->ptr, '\0', r->end - r->ptr);
+  const gchar *str = (const gchar *) r->ptr;
+
+  if (!zero)
+    return NULL;
+
+  r->ptr = zero + 1;
+  return str;
+}
+
+static gint
+decode_compare_records (gconstpointer a, gconstpointer b) {
+  const LbaTraceRecord *ra = a;
+  const LbaTraceRecord *rb = b;
+
+  return (ra->time > rb->time) - (ra->time < rb->time);
+}
+
+/* The strings point into the contents */
+static gboolean
+decode_trace (const gchar *contents, gsize size, DecodeTrace *trace) {
+  DecodeReader r;
+  guint32 version,
+    n_rings,
+    n_names,
+    i;
+
+  r.ptr = (const guint8 *) contents;
+  r.end = r.ptr + size;
+
+  if (size < 8 || memcmp (r.ptr, LBA_TRACE_MAGIC, 8))
+    return FALSE;
+  r.ptr += 8;
+
+  if (!decode_bytes (&r, &version, 4) || version != LBA_TRACE_VERSION
+      || !decode_bytes (&r, &trace->n_events, 4))
+    return FALSE;
+
+  /* The ids go from 1 */
+  trace->events = g_new0 (DecodeEvent, trace->n_events + 1);
+  for (i = 0; i < trace->n_events; i++) {
+    DecodeEvent ev;
+    guint32 id;
+
+    if (!decode_bytes (&r, &id, 4) || !decode_bytes (&r, &ev.line, 4)
+        || !decode_bytes (&r, &ev.phase, 2) || !decode_bytes (&r, &ev.flags, 2)
+        || !(ev.domain = decode_string (&r)) || !(ev.func = decode_string (&r))
+        || !(ev.format = decode_string (&r)) || id == 0 || id > trace->n_events)
+      return FALSE;
+
+    trace->events[id] = ev;
+  }
+
+  if (!decode_bytes (&r, &n_rings, 4))
+    return FALSE;
+
+  for (i = 0; i < n_rings; i++) {
+    gchar name[16];
+    guint32 n_records;
+
+    if (!decode_bytes (&r, name, sizeof (name))
+        || !decode_bytes (&r, &n_records, 4)
+        || (gsize) (r.end - r.ptr) < n_records * sizeof (LbaTraceRecord))
+      return FALSE;
+
+    if (n_records && name[0]) {
+      LbaTraceRecord first;
+
+      /* All the records of the ring are of the same thread */
+      memcpy (&first, r.ptr, sizeof (first));
+      g_hash_table_insert (trace->threads, GUINT_TO_POINTER (first.thread),
+                           g_strndup (name, sizeof (name)));
+    }
+
+    g_array_append_vals (trace->records, r.ptr, n_records);
+    r.ptr += n_records * sizeof (LbaTraceRecord);
+  }
+
+  if (!decode_bytes (&r, &n_names, 4))
+    return FALSE;
+
+  for (i = 0; i < n_names; i++) {
+    guint64 *ptr = g_new (guint64, 1);
+    const gchar *str;
+
+    if (!decode_bytes (&r, ptr, 8) || !(str = decode_string (&r))) {
+      g_free (ptr);
+      return FALSE;
+    }
+
+    g_hash_table_insert (trace->names, ptr, (gpointer) str);
+  }
+
+  for (i = 0; i < trace->records->len; i++) {
+    LbaTraceRecord *rec = &g_array_index (trace->records, LbaTraceRecord, i);
+
+    if (rec->event == 0 || rec->event > trace->n_events)
+      return FALSE;
+  }
+
+  g_array_sort (trace->records, decode_compare_records);
+  return TRUE;
+}
+
+static const gchar *
+decode_record_name (DecodeTrace *trace, LbaTraceRecord *rec) {
+  DecodeEvent *ev = &trace->events[rec->event];
+  const gchar *name;
+
+  if (!(ev->flags & LBA_TRACE_FLAG_NAMED))
+    return ev->format;
+
+  name = g_hash_table_lookup (trace->names, &rec->args[0]);
+  return name ? name : "?";
+}
+
+static void
+decode_print_text (DecodeTrace *trace) {
+  static const gchar *marks[] = { "", "> ", "< ", "-> ", "<- " };
+  gint64 start = 0;
+  guint i;
+
+  if (trace->records->len)
+    start = g_array_index (trace->records, LbaTraceRecord, 0).time;
+
+  for (i = 0; i < trace->records->len; i++) {
+    LbaTraceRecord *rec = &g_array_index (trace->records, LbaTraceRecord, i);
+    DecodeEvent *ev = &trace->events[rec->event];
+
+    g_print ("%12.6f %4u %s %s:%u %s", (rec->time - start) / (gdouble) G_USEC_PER_SEC,
+             rec->thread, ev->domain, ev->func, ev->line,
+             ev->phase < G_N_ELEMENTS (marks) ? marks[ev->phase] : "");
+
+    if (ev->flags & LBA_TRACE_FLAG_NAMED) {
+      g_print ("%s %s", ev->format, decode_record_name (trace, rec));
+      if (rec->args[1])
+        g_print (" (%" G_GUINT64_FORMAT ")", rec->args[1]);
+    } else {
+      g_print ("%s", ev->format);
+      if (rec->args[0] || rec->args[1])
+        g_print (" (%" G_GUINT64_FORMAT ", %" G_GUINT64_FORMAT ")",
+                 rec->args[0], rec->args[1]);
+    }
+    g_print ("\n");
+  }
+}
+
+static void
+decode_print_json_string (const gchar *str) {
+  GString *out = g_string_new ("\"");
+
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      g_string_append_printf (out, "\\%c", *str);
+    else if ((guchar) * str < 0x20)
+      g_string_append_printf (out, "\\u%04x", (guchar) * str);
+    else
+      g_string_append_c (out, *str);
+  }
+  g_string_append_c (out, '"');
+
+  g_print ("%s", out->str);
+  g_string_free (out, TRUE);
+}
+
+/* In the Trace Event Format of Chrome. The flows are the "v2" ones: slices
+ * of 0 length with "bind_id", so they don't need an enclosing span. */
+static void
+decode_print_chrome (DecodeTrace *trace) {
+  GHashTableIter iter;
+  gpointer key,
+    value;
+  gboolean first = TRUE;
+  guint i;
+
+  g_print ("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+
+  g_hash_table_iter_init (&iter, trace->threads);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    g_print ("%s\n{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, "
+             "\"tid\": %u, \"args\": {\"name\": ", first ? "" : ",",
+             GPOINTER_TO_UINT (key));
+    decode_print_json_string (value);
+    g_print ("}}");
+    first = FALSE;
+  }
+
+  for (i = 0; i < trace->records->len; i++) {
+    LbaTraceRecord *rec = &g_array_index (trace->records, LbaTraceRecord, i);
+    DecodeEvent *ev = &trace->events[rec->event];
+    gboolean named = ev->flags & LBA_TRACE_FLAG_NAMED;
+
+    g_print ("%s\n{\"name\": ", first ? "" : ",");
+    decode_print_json_string (decode_record_name (trace, rec));
+    g_print (", \"cat\": ");
+    if (named) {
+      gchar *cat = g_strdup_printf ("%s,%s", ev->domain, ev->format);
+
+      decode_print_json_string (cat);
+      g_free (cat);
+    } else {
+      decode_print_json_string (ev->domain);
+    }
+    g_print (", \"pid\": 1, \"tid\": %u, \"ts\": %" G_GINT64_FORMAT ", ",
+             rec->thread, rec->time);
+
+    switch (ev->phase) {
+    case LBA_TRACE_PHASE_BEGIN:
+      g_print ("\"ph\": \"B\"");
+      break;
+    case LBA_TRACE_PHASE_END:
+      g_print ("\"ph\": \"E\"");
+      break;
+    case LBA_TRACE_PHASE_FLOW_OUT:
+    case LBA_TRACE_PHASE_FLOW_IN:
+      g_print ("\"ph\": \"X\", \"dur\": 0, \"bind_id\": \"0x%" G_GINT64_MODIFIER
+               "x\", \"%s\": true", rec->args[0],
+               ev->phase == LBA_TRACE_PHASE_FLOW_OUT ? "flow_out" : "flow_in");
+      break;
+    default:
+      g_print ("\"ph\": \"i\", \"s\": \"t\"");
+    }
+
+    g_print (", \"args\": {\"func\": ");
+    decode_print_json_string (ev->func);
+    g_print (", \"line\": %u", ev->line);
+    if (!named)
+      g_print (", \"arg0\": %" G_GUINT64_FORMAT, rec->args[0]);
+    g_print (", \"arg1\": %" G_GUINT64_FORMAT "}}", rec->args[1]);
+    first = FALSE;
+  }
+
+  g_print ("\n]}\n");
+}
+
+int
+main (int argc, char **argv) {
+  DecodeTrace trace = { 0 };
+  GError *err = NULL;
+  gboolean chrome = FALSE;
+  const gchar *path;
+  gchar *contents;
+  gsize size;
+  gint ret = 0;
+
+  if (argc == 3 && !g_strcmp0 (argv[1], "--chrome")) {
+    chrome = TRUE;
+    path = argv[2];
+  } else if (argc == 2) {
+    path = argv[1];
+  } else {
+    g_printerr ("Usage: %s [--chrome] FILE\n", argv[0]);
+    return 1;
+  }
+
+  if (!g_file_get_contents (path, &contents, &size, &err)) {
+    g_printerr ("%s\n", err->message);
+    g_error_free (err);
+    return 1;
+  }
+
+  trace.threads = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  trace.names = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+  trace.records = g_array_new (FALSE, FALSE, sizeof (LbaTraceRecord));
+
+  if (!decode_trace (contents, size, &trace)) {
+    g_printerr ("%s is not a trace of version %d, or it's broken\n", path,
+                LBA_TRACE_VERSION);
+    ret = 1;
+  } else if (chrome) {
+    decode_print_chrome (&trace);
+  } else {
+    decode_print_text (&trace);
+  }
+
+  g_array_unref (trace.records);
+  g_hash_table_unref (trace.names);
+  g_hash_table_unref (trace.threads);
+  g_free (trace.events);
+  g_free (contents);
+  return ret;
+}
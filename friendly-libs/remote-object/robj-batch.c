@@ -0,0 +1,443 @@
+#include "robj-batch.h"
+#include <string.h>
+
+/* The batch frame is:
+   Header.
+   ----------------------------------
+   [pb] - message magic of "property notify batch", 2 bytes
+   [number of entries] - 2 bytes, BE
+   ----------------------------------
+   Entries, one per PN.
+   ----------------------------------
+   [property id] - varint
+   [kind] - 1 byte:
+     'v' - followed by [value size] - 4 bytes, BE, and the value of ROBJ
+           transport,
+     'd' - followed by the zigzag varint of the difference from the value
+           this PN had in the previous entry of the stream.
+   ----------------------------------
+   The unchanged values may be not sent at all.
+*/
+#define ROBJ_BATCH_HEADER_LEN (2 + 2)
+
+/* Remembers @bytes as the last value of the PN @id. Takes them. */
+static void
+robj_batch_set_last (GPtrArray *last, guint32 id, GBytes *bytes) {
+  if (id >= last->len)
+    g_ptr_array_set_size (last, id + 1);
+
+  if (g_ptr_array_index (last, id))
+    g_bytes_unref (g_ptr_array_index (last, id));
+  g_ptr_array_index (last, id) = bytes;
+}
+
+static GBytes *
+robj_batch_get_last (GPtrArray *last, guint32 id) {
+  return id < last->len ? g_ptr_array_index (last, id) : NULL;
+}
+
+static void
+robj_batch_free_last (gpointer data) {
+  if (data)
+    g_bytes_unref (data);
+}
+
+/* The types that go as deltas. Their transport is 4 or 8 bytes of the
+ * value in the host order. */
+static gboolean
+robj_batch_is_integer (const RObjPN *pn) {
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (&pn->pval))) {
+  case G_TYPE_INT:
+  case G_TYPE_UINT:
+  case G_TYPE_LONG:
+  case G_TYPE_ULONG:
+  case G_TYPE_INT64:
+  case G_TYPE_UINT64:
+  case G_TYPE_ENUM:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+static gboolean
+robj_batch_get_integer (gconstpointer data, gsize size, guint64 *val) {
+  if (size == 4) {
+    guint32 v32;
+
+    memcpy (&v32, data, 4);
+    *val = v32;
+    return TRUE;
+  }
+
+  if (size == 8) {
+    memcpy (val, data, 8);
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+void
+robj_batch_writer_init (RObjBatchWriter *writer, RObjBatchFlags flags,
+                        gsize max_size, gint64 max_delay,
+                        RObjBatchFlushFunc flush, gpointer user_data) {
+  g_return_if_fail (flush != NULL);
+
+  memset (writer, 0, sizeof (*writer));
+
+  writer->flags = flags;
+  writer->max_size = max_size;
+  writer->max_delay = max_delay;
+  writer->flush = flush;
+  writer->user_data = user_data;
+
+  writer->buf = g_byte_array_sized_new (max_size ? max_size + 64 : 1024);
+  writer->last = g_ptr_array_new_with_free_func (robj_batch_free_last);
+}
+
+void
+robj_batch_writer_clear (RObjBatchWriter *writer) {
+  g_clear_pointer (&writer->buf, g_byte_array_unref);
+  g_clear_pointer (&writer->last, g_ptr_array_unref);
+}
+
+void
+robj_batch_writer_reset (RObjBatchWriter *writer) {
+  g_ptr_array_set_size (writer->last, 0);
+}
+
+gboolean
+robj_batch_writer_flush (RObjBatchWriter *writer) {
+  guint16 n;
+
+  if (writer->n_entries == 0)
+    return FALSE;
+
+  n = GUINT16_TO_BE (writer->n_entries);
+  memcpy (writer->buf->data + 2, &n, 2);
+
+  writer->flush (writer->buf->data, writer->buf->len, writer->user_data);
+
+  g_byte_array_set_size (writer->buf, 0);
+  writer->n_entries = 0;
+  return TRUE;
+}
+
+gint64
+robj_batch_writer_get_deadline (RObjBatchWriter *writer) {
+  if (writer->n_entries == 0 || writer->max_delay <= 0)
+    return -1;
+
+  return writer->first_time + writer->max_delay;
+}
+
+gboolean
+robj_batch_writer_tick (RObjBatchWriter *writer, gint64 now) {
+  gint64 deadline = robj_batch_writer_get_deadline (writer);
+
+  if (deadline < 0 || now < deadline)
+    return FALSE;
+
+  return robj_batch_writer_flush (writer);
+}
+
+static void
+robj_batch_writer_start_frame (RObjBatchWriter *writer) {
+  guint8 header[ROBJ_BATCH_HEADER_LEN] = { 'p', 'b' };
+
+  /* The number of entries is written on flush */
+  g_byte_array_append (writer->buf, header, sizeof (header));
+
+  if (writer->max_delay > 0)
+    writer->first_time = g_get_monotonic_time ();
+}
+
+gboolean
+robj_batch_writer_add (RObjBatchWriter *writer, RObjPN *pn) {
+  gboolean flushed = FALSE;
+  GBytes *bval = NULL;
+  GBytes *last = NULL;
+  guint8 scalar[8];
+  gconstpointer vdata;
+  gsize vsize;
+  guint64 cur = 0;
+  guint64 prev = 0;
+  guint8 entry[ROBJ_PROTOCOL_VARINT_MAX + 1 + 4];
+  guint entry_len;
+
+  g_return_val_if_fail (pn != NULL, FALSE);
+
+  if (writer->n_entries == G_MAXUINT16)
+    flushed = robj_batch_writer_flush (writer);
+
+  if (pn->scalar_size) {
+    /* No transport value in between */
+    robj_pn_read_scalar (pn, scalar);
+    vdata = scalar;
+    vsize = pn->scalar_size;
+  } else {
+    GValue tval = G_VALUE_INIT;
+    gboolean could_transform;
+
+    g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+    could_transform = robj_pn_read_value (pn, &tval);
+
+    /* Should never happen since the types are already negotiated */
+    g_return_val_if_fail (could_transform, flushed);
+
+    bval = (GBytes *) g_value_dup_boxed (&tval);
+    g_value_unset (&tval);
+    vdata = g_bytes_get_data (bval, &vsize);
+
+    /* Same as for the single PN messages */
+    if (G_UNLIKELY (vdata == NULL || vsize == 0)) {
+      g_critical ("Empty transport value of %s", pn->pname);
+      g_bytes_unref (bval);
+      return flushed;
+    }
+  }
+
+  if (writer->flags)
+    last = robj_batch_get_last (writer->last, pn->id);
+
+  if (last && (writer->flags & ROBJ_BATCH_SKIP_UNCHANGED)
+      && g_bytes_get_size (last) == vsize
+      && memcmp (g_bytes_get_data (last, NULL), vdata, vsize) == 0) {
+    g_clear_pointer (&bval, g_bytes_unref);
+    return flushed;
+  }
+
+  if (writer->n_entries == 0)
+    robj_batch_writer_start_frame (writer);
+
+  entry_len = robj_protocol_put_varint (entry, pn->id);
+
+  if (last && (writer->flags & ROBJ_BATCH_DELTA)
+      && robj_batch_is_integer (pn)
+      && g_bytes_get_size (last) == vsize
+      && robj_batch_get_integer (g_bytes_get_data (last, NULL), vsize, &prev)
+      && robj_batch_get_integer (vdata, vsize, &cur)) {
+    gint64 delta;
+
+    /* Wraps around in the width of the value */
+    delta = (vsize == 4) ? (gint64) (gint32) (guint32) (cur - prev)
+        : (gint64) (cur - prev);
+
+    entry[entry_len++] = 'd';
+    g_byte_array_append (writer->buf, entry, entry_len);
+    robj_protocol_write_varint (writer->buf,
+                             ((guint64) delta << 1) ^ (guint64) (delta >> 63));
+  } else {
+    guint32 size_be = GUINT32_TO_BE (vsize);
+
+    entry[entry_len++] = 'v';
+    memcpy (entry + entry_len, &size_be, 4);
+    g_byte_array_append (writer->buf, entry, entry_len + 4);
+    g_byte_array_append (writer->buf, vdata, vsize);
+  }
+
+  writer->n_entries++;
+
+  if (writer->flags)
+    robj_batch_set_last (writer->last, pn->id,
+                         bval ? bval : g_bytes_new (vdata, vsize));
+  else
+    g_clear_pointer (&bval, g_bytes_unref);
+
+  if (writer->max_size && writer->buf->len >= writer->max_size)
+    return robj_batch_writer_flush (writer);
+
+  if (writer->max_delay > 0
+      && robj_batch_writer_tick (writer, g_get_monotonic_time ()))
+    return TRUE;
+
+  return flushed;
+}
+
+void
+robj_batch_reader_init (RObjBatchReader *reader) {
+  reader->last = g_ptr_array_new_with_free_func (robj_batch_free_last);
+}
+
+void
+robj_batch_reader_clear (RObjBatchReader *reader) {
+  g_clear_pointer (&reader->last, g_ptr_array_unref);
+}
+
+void
+robj_batch_reader_reset (RObjBatchReader *reader) {
+  g_ptr_array_set_size (reader->last, 0);
+}
+
+static GBytes *
+robj_batch_apply_delta (GBytes *last, guint64 zigzag) {
+  gint64 delta = (gint64) (zigzag >> 1) ^ -(gint64) (zigzag & 1);
+  gsize size;
+  gconstpointer data = g_bytes_get_data (last, &size);
+  guint64 val;
+
+  if (!robj_batch_get_integer (data, size, &val))
+    return NULL;
+
+  val += delta;
+  if (g_bytes_get_size (last) == 4) {
+    guint32 v32 = val;
+
+    return g_bytes_new (&v32, 4);
+  }
+
+  return g_bytes_new (&val, 8);
+}
+
+/* NOTE: called in a read section of the map */
+static gint
+robj_batch_reader_parse_entries (RObjBatchReader *reader, RObjMap *map,
+                                 const guint8 *frame, gsize size,
+                                 RObjBatchPNFunc func, gpointer user_data) {
+  const guint8 *end = frame + size;
+  guint16 n;
+  guint i;
+  gint updated = 0;
+
+  g_return_val_if_fail (frame != NULL, -1);
+  g_return_val_if_fail (size >= ROBJ_BATCH_HEADER_LEN, -1);
+  g_return_val_if_fail (frame[0] == 'p', -1);
+  g_return_val_if_fail (frame[1] == 'b', -1);
+
+  memcpy (&n, frame + 2, 2);
+  n = GUINT16_FROM_BE (n);
+  frame += ROBJ_BATCH_HEADER_LEN;
+
+  for (i = 0; i < n; i++) {
+    guint64 id;
+    RObjPN *pn;
+    GBytes *bval = NULL;
+    GBytes *last;
+    gconstpointer vdata;
+    gsize vsize;
+
+    if (!robj_protocol_read_varint (&frame, end, &id) || frame == end)
+      goto truncated;
+
+    if (G_UNLIKELY (id > G_MAXUINT32)) {
+      g_critical ("Broken PN id in the batch");
+      return -1;
+    }
+
+    pn = robj_map_lookup_pn (map, id);
+
+    switch (*frame++) {
+    case 'v':{
+        guint32 size_be;
+
+        if (end - frame < 4)
+          goto truncated;
+
+        memcpy (&size_be, frame, 4);
+        vsize = GUINT32_FROM_BE (size_be);
+        frame += 4;
+        if (vsize == 0 || end - frame < vsize)
+          goto truncated;
+
+        /* Read in place */
+        vdata = frame;
+        frame += vsize;
+        break;
+      }
+    case 'd':{
+        guint64 zigzag;
+
+        if (!robj_protocol_read_varint (&frame, end, &zigzag))
+          goto truncated;
+
+        last = robj_batch_get_last (reader->last, id);
+        if (G_UNLIKELY (last == NULL)) {
+          g_critical ("No previous value for the delta of PN %u", (guint) id);
+          return -1;
+        }
+
+        bval = robj_batch_apply_delta (last, zigzag);
+        if (G_UNLIKELY (bval == NULL)) {
+          g_critical ("Can't apply delta to PN %u", (guint) id);
+          return -1;
+        }
+
+        vdata = g_bytes_get_data (bval, &vsize);
+        break;
+      }
+    default:
+      g_critical ("Unknown batch entry '%c'", frame[-1]);
+      return -1;
+    }
+
+    /* Only the integers are remembered, for the deltas. The writer doesn't
+     * know if we have the PN, so the unknown ones that may be integers are
+     * remembered too, or their next delta would break the frame */
+    if (pn ? robj_batch_is_integer (pn) : (vsize == 4 || vsize == 8))
+      robj_batch_set_last (reader->last, id,
+                           bval ? g_bytes_ref (bval) : g_bytes_new (vdata,
+                                                                    vsize));
+
+    if (G_UNLIKELY (pn == NULL)) {
+      /* The next entries are still fine */
+      g_critical ("PN %u not found!", (guint) id);
+      g_clear_pointer (&bval, g_bytes_unref);
+      continue;
+    }
+
+    if (pn->scalar_size) {
+      if (G_UNLIKELY (vsize != pn->scalar_size)) {
+        g_critical ("Wrong size of %s", pn->pname);
+        g_clear_pointer (&bval, g_bytes_unref);
+        continue;
+      }
+
+      /* Straight from the frame into the GValue */
+      robj_pn_write_scalar (pn, vdata);
+      g_clear_pointer (&bval, g_bytes_unref);
+    } else {
+      GValue tval = G_VALUE_INIT;
+      gboolean could_transform;
+
+      /* The rest can point to the frame, the transforms copy the data */
+      g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+      g_value_take_boxed (&tval, bval ? bval : g_bytes_new_static (vdata,
+                                                                   vsize));
+
+      could_transform = robj_pn_write_value (pn, &tval);
+      g_value_unset (&tval);
+
+      if (!could_transform) {
+        /* Should never happen since the types are already negotiated */
+        g_critical ("Could not transform %s", pn->pname);
+        continue;
+      }
+    }
+
+    if (func)
+      func (pn, user_data);
+    updated++;
+  }
+
+  return updated;
+
+truncated:
+  g_critical ("Truncated batch frame");
+  return -1;
+}
+
+gint
+robj_batch_reader_parse (RObjBatchReader *reader, RObjMap *map,
+                         const guint8 *frame, gsize size,
+                         RObjBatchPNFunc func, gpointer user_data) {
+  gint ret;
+
+  /* The PNs can't be freed under our feet, and @func can use them */
+  robj_map_read_begin (map);
+  ret = robj_batch_reader_parse_entries (reader, map, frame, size, func,
+                                         user_data);
+  robj_map_read_end (map);
+
+  return ret;
+}
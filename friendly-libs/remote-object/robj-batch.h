@@ -0,0 +1,79 @@
+#ifndef _ROBJ_BATCH_H
+#  define _ROBJ_BATCH_H
+
+#  include "robj-protocol.h"
+
+/* Batched property notify.
+ * Many PNs go in one frame, written straight into a buffer that is reused
+ * for the next frame. */
+
+typedef enum {
+  /* Integers are sent as the difference from the previous value */
+  ROBJ_BATCH_DELTA = 1 << 0,
+  /* Values that didn't change since the previous frame are not sent */
+  ROBJ_BATCH_SKIP_UNCHANGED = 1 << 1,
+} RObjBatchFlags;
+
+/* Called with a complete frame. The data is owned by the writer and is
+ * overwritten by the next frame, so it has to be consumed right away. */
+typedef void (*RObjBatchFlushFunc) (const guint8 * frame, gsize size,
+                                    gpointer user_data);
+
+typedef struct {
+  RObjBatchFlags flags;
+  /* The frame is flushed when it gets this big. 0 - no limit */
+  gsize max_size;
+  /* Or when the first PN in it is this old, in microseconds. 0 - no limit */
+  gint64 max_delay;
+
+  RObjBatchFlushFunc flush;
+  gpointer user_data;
+
+  GByteArray *buf;
+  guint n_entries;
+  gint64 first_time;
+
+  /* GBytes by PN id, the value sent last time */
+  GPtrArray *last;
+} RObjBatchWriter;
+
+void robj_batch_writer_init (RObjBatchWriter * writer, RObjBatchFlags flags,
+                             gsize max_size, gint64 max_delay,
+                             RObjBatchFlushFunc flush, gpointer user_data);
+void robj_batch_writer_clear (RObjBatchWriter * writer);
+
+/* Adds the current value of the PN. Returns TRUE if a frame was flushed. */
+gboolean robj_batch_writer_add (RObjBatchWriter * writer, RObjPN * pn);
+
+/* Returns TRUE if there was something to flush */
+gboolean robj_batch_writer_flush (RObjBatchWriter * writer);
+
+/* Flushes the frame if it's waiting for longer than max-delay.
+ * Returns TRUE if a frame was flushed. */
+gboolean robj_batch_writer_tick (RObjBatchWriter * writer, gint64 now);
+
+/* Monotonic time when the pending frame has to be flushed, or -1 */
+gint64 robj_batch_writer_get_deadline (RObjBatchWriter * writer);
+
+/* Forgets the values sent, so they all go in full again.
+ * Must be called when the reader side is reset, f.e. on reconnect. */
+void robj_batch_writer_reset (RObjBatchWriter * writer);
+
+/* Keeps the base values for the deltas */
+typedef struct {
+  GPtrArray *last;
+} RObjBatchReader;
+
+typedef void (*RObjBatchPNFunc) (RObjPN * pn, gpointer user_data);
+
+void robj_batch_reader_init (RObjBatchReader * reader);
+void robj_batch_reader_clear (RObjBatchReader * reader);
+void robj_batch_reader_reset (RObjBatchReader * reader);
+
+/* Updates the values of the PNs in the frame, and calls @func for each one.
+ * Returns the number of PNs updated, or -1 if the frame is broken. */
+gint robj_batch_reader_parse (RObjBatchReader * reader, RObjMap * map,
+                              const guint8 * frame, gsize size,
+                              RObjBatchPNFunc func, gpointer user_data);
+
+#endif
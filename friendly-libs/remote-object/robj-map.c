@@ -1,62 +1,470 @@
 #include "robj-map.h"
+#include <string.h>
 
 typedef struct {
-  GMutex lock;
+  /* RObjPN by name, they are owned here */
   GHashTable *pns;
   GHashTable *sigs;
   gchar *name;
+  guint32 id;
 } RObjMapObject;
 
+struct _RObjMapTable {
+  guint size;
+  /* NULL if the id is free */
+  RObjPN *pns[];
+};
+
+#define ROBJ_MAP_MIN_SIZE 16
+
+/* The ids above are surely a mistake of the other side */
+#define ROBJ_MAP_MAX_ID (1 << 24)
+
+static RObjMapTable *
+robj_map_table_new (guint size) {
+  RObjMapTable *table;
+
+  table = g_malloc0 (sizeof (RObjMapTable) + size * sizeof (RObjPN *));
+  table->size = size;
+
+  return table;
+}
+
+/* Makes room for the id, and publishes the new table.
+ * NOTE: called with the map lock taken */
+static RObjMapTable *
+robj_map_table_grow (RObjMap *map, guint32 id) {
+  RObjMapTable *old = map->table;
+  RObjMapTable *table;
+  guint size = old->size;
+
+  while (size <= id)
+    size *= 2;
+
+  table = robj_map_table_new (size);
+  memcpy (table->pns, old->pns, old->size * sizeof (RObjPN *));
+  g_atomic_pointer_set (&map->table, table);
+
+  /* Somebody may still be reading it. They only double, so all the retired
+   * ones together are not bigger than the current one. */
+  map->retired = g_slist_prepend (map->retired, old);
+  g_atomic_int_set (&map->has_retired, 1);
+  return table;
+}
+
+/* The id of a removed PN is reused only once the PN is freed, because
+ * until then somebody may still look it up by that id.
+ * NOTE: called with the map lock taken */
+static guint32
+robj_map_table_free_id (RObjMap *map) {
+  while (map->free_ids->len) {
+    guint32 id = g_array_index (map->free_ids, guint32, map->free_ids->len - 1);
+
+    g_array_set_size (map->free_ids, map->free_ids->len - 1);
+    /* Could be taken by the other side meanwhile */
+    if (id < map->table->size && map->table->pns[id] == NULL)
+      return id;
+  }
+
+  return map->next_id;
+}
+
+/* NOTE: called with the map lock taken */
 static RObjMapObject *
-robj_map_peek_object (RObjMap *map, guint32 o_hash) {
-  RObjMapObject *obj = NULL;
+robj_map_get_object (RObjMap *map, guint32 o_id) {
+  if (o_id >= map->objects->len)
+    return NULL;
 
-  g_mutex_lock (&map->lock);
-  obj = (RObjMapObject *)
-      g_hash_table_lookup (map->objects, GUINT_TO_POINTER (o_hash));
-  g_mutex_unlock (&map->lock);
+  return g_ptr_array_index (map->objects, o_id);
+}
 
-  return obj;
+void
+robj_map_read_begin (RObjMap *map) {
+  /* Before looking anything up. Goes against the check of the writer in
+   * robj_map_reclaim (). */
+  g_atomic_int_inc (&map->readers);
 }
 
-static RObjPN *
-robj_map_peek_pn (RObjMapObject *obj, guint32 pn_hash) {
-  RObjPN *pn;
+RObjPN *
+robj_map_lookup_pn (RObjMap *map, guint32 id) {
+  RObjMapTable *table = g_atomic_pointer_get (&map->table);
 
-  g_mutex_lock (&obj->lock);
-  pn = (RObjPN *)
-      g_hash_table_lookup (obj->pns, GUINT_TO_POINTER (pn_hash));
-  g_mutex_unlock (&obj->lock);
+  if (G_UNLIKELY (id >= table->size))
+    return NULL;
 
-  return pn;
+  return g_atomic_pointer_get (&table->pns[id]);
 }
 
 RObjPN *
-robj_map_lookup_pn (RObjMap *map, guint32 o_hash, guint32 pn_hash) {
+robj_map_find_pn (RObjMap *map, guint32 o_id, const gchar *pname) {
   RObjMapObject *obj;
+  RObjPN *pn = NULL;
 
-  obj = robj_map_peek_object (map, o_hash);
-  if (G_UNLIKELY (obj == NULL)) {
-    g_critical ("Object with hash %u not found", o_hash);
-    return NULL;
+  g_mutex_lock (&map->lock);
+  obj = robj_map_get_object (map, o_id);
+  if (obj)
+    pn = g_hash_table_lookup (obj->pns, pname);
+  g_mutex_unlock (&map->lock);
+
+  return pn;
+}
+
+/* The value is copied in one go */
+static gboolean
+robj_map_is_fixed_size (GType type) {
+  switch (G_TYPE_FUNDAMENTAL (type)) {
+  case G_TYPE_CHAR:
+  case G_TYPE_UCHAR:
+  case G_TYPE_BOOLEAN:
+  case G_TYPE_INT:
+  case G_TYPE_UINT:
+  case G_TYPE_LONG:
+  case G_TYPE_ULONG:
+  case G_TYPE_INT64:
+  case G_TYPE_UINT64:
+  case G_TYPE_ENUM:
+  case G_TYPE_FLAGS:
+  case G_TYPE_FLOAT:
+  case G_TYPE_DOUBLE:
+    return TRUE;
+  default:
+    return FALSE;
+  }
+}
+
+/* Same as the transforms of robj-protocol.c give. 0 - has to be transformed */
+static guint8
+robj_map_scalar_size (GType type) {
+  switch (G_TYPE_FUNDAMENTAL (type)) {
+  case G_TYPE_BOOLEAN:
+  case G_TYPE_INT:
+  case G_TYPE_UINT:
+  case G_TYPE_ENUM:
+  case G_TYPE_FLOAT:
+    return 4;
+  case G_TYPE_INT64:
+  case G_TYPE_UINT64:
+  case G_TYPE_DOUBLE:
+    return 8;
+  case G_TYPE_LONG:
+  case G_TYPE_ULONG:
+    return sizeof (glong);
+  default:
+    return 0;
+  }
+}
+
+/* The version is taken and given to the PN at once, so whoever reads the
+ * version of the map under the same lock sees all the PNs that have it.
+ * NOTE: called with the map lock taken */
+static void
+robj_pn_bump_version_locked (RObjPN *pn) {
+  guint64 version = ++pn->map->version;
+
+  __atomic_store_n (&pn->version, version, __ATOMIC_RELEASE);
+}
+
+/* NOTE: called after the value is written, without the lock of the PN:
+ * foreach_changed reads the PNs with the map lock taken. */
+static void
+robj_pn_bump_version (RObjPN *pn) {
+  g_mutex_lock (&pn->map->lock);
+  robj_pn_bump_version_locked (pn);
+  g_mutex_unlock (&pn->map->lock);
+}
+
+guint64
+robj_map_get_version (RObjMap *map) {
+  guint64 version;
+
+  g_mutex_lock (&map->lock);
+  version = map->version;
+  g_mutex_unlock (&map->lock);
+
+  return version;
+}
+
+guint64
+robj_pn_get_version (RObjPN *pn) {
+  return __atomic_load_n (&pn->version, __ATOMIC_ACQUIRE);
+}
+
+/* Seqlock: retry if a writer was there in the meantime.
+ * Only for the fixed size types, that can be copied as is. */
+static void
+robj_pn_copy_fixed (RObjPN *pn, GValue *copy) {
+  gint seq;
+
+  for (;;) {
+    seq = g_atomic_int_get (&pn->seq);
+    if (seq & 1)
+      continue;
+
+    *copy = pn->pval;
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    if (seq == g_atomic_int_get (&pn->seq))
+      break;
   }
+}
+
+gboolean
+robj_pn_read_value (RObjPN *pn, GValue *dest) {
+  GValue copy;
+
+  if (!pn->fixed_size) {
+    gboolean ret;
+
+    g_mutex_lock (&pn->lock);
+    ret = g_value_transform (&pn->pval, dest);
+    g_mutex_unlock (&pn->lock);
+    return ret;
+  }
+
+  robj_pn_copy_fixed (pn, &copy);
+  return g_value_transform (&copy, dest);
+}
+
+void
+robj_pn_read_scalar (RObjPN *pn, guint8 *data) {
+  GValue copy;
+
+  g_return_if_fail (pn->scalar_size != 0);
+
+  robj_pn_copy_fixed (pn, &copy);
+
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (&copy))) {
+  case G_TYPE_BOOLEAN:{
+      gboolean v = g_value_get_boolean (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_INT:{
+      gint v = g_value_get_int (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_UINT:{
+      guint v = g_value_get_uint (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_ENUM:{
+      gint v = g_value_get_enum (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_FLOAT:{
+      gfloat v = g_value_get_float (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_INT64:{
+      gint64 v = g_value_get_int64 (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_UINT64:{
+      guint64 v = g_value_get_uint64 (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_DOUBLE:{
+      gdouble v = g_value_get_double (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_LONG:{
+      glong v = g_value_get_long (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  case G_TYPE_ULONG:{
+      gulong v = g_value_get_ulong (&copy);
+
+      memcpy (data, &v, sizeof (v));
+      break;
+    }
+  default:
+    g_assert_not_reached ();
+  }
+}
+
+void
+robj_pn_write_scalar (RObjPN *pn, const guint8 *data) {
+  g_return_if_fail (pn->scalar_size != 0);
+
+  g_mutex_lock (&pn->lock);
+  g_atomic_int_inc (&pn->seq);
+
+  switch (G_TYPE_FUNDAMENTAL (G_VALUE_TYPE (&pn->pval))) {
+  case G_TYPE_BOOLEAN:{
+      gboolean v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_boolean (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_INT:{
+      gint v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_int (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_UINT:{
+      guint v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_uint (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_ENUM:{
+      gint v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_enum (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_FLOAT:{
+      gfloat v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_float (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_INT64:{
+      gint64 v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_int64 (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_UINT64:{
+      guint64 v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_uint64 (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_DOUBLE:{
+      gdouble v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_double (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_LONG:{
+      glong v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_long (&pn->pval, v);
+      break;
+    }
+  case G_TYPE_ULONG:{
+      gulong v;
+
+      memcpy (&v, data, sizeof (v));
+      g_value_set_ulong (&pn->pval, v);
+      break;
+    }
+  default:
+    g_assert_not_reached ();
+  }
+
+  g_atomic_int_inc (&pn->seq);
+  g_mutex_unlock (&pn->lock);
+  robj_pn_bump_version (pn);
+}
+
+gboolean
+robj_pn_write_value (RObjPN *pn, const GValue *src) {
+  gboolean ret;
+
+  g_mutex_lock (&pn->lock);
+  /* Odd while writing */
+  g_atomic_int_inc (&pn->seq);
+  ret = g_value_transform (src, &pn->pval);
+  g_atomic_int_inc (&pn->seq);
+  g_mutex_unlock (&pn->lock);
+  robj_pn_bump_version (pn);
 
-  return robj_map_peek_pn (obj, pn_hash);
+  return ret;
 }
 
 RObjPN *
-robj_map_new_pn (RObjMap *map, guint32 o_hash, const gchar *pname,
+robj_map_new_pn (RObjMap *map, guint32 o_id, const gchar *pname,
                  const GValue *pval) {
-  gboolean didnt_exist;
+  return robj_map_new_pn_with_id (map, o_id, pname, pval, ROBJ_MAP_NO_ID);
+}
+
+static void
+robj_map_destroy_pn (gpointer data) {
+  RObjPN *pn = (RObjPN *) data;
+
+  g_return_if_fail (pn != NULL);
+  g_return_if_fail (pn->pname != NULL);
+
+  g_mutex_clear (&pn->lock);
+  g_free (pn->pname);
+  g_value_unset (&pn->pval);
+
+  g_free (pn);
+}
+
+RObjPN *
+robj_map_new_pn_with_id (RObjMap *map, guint32 o_id, const gchar *pname,
+                         const GValue *pval, guint32 id) {
   RObjPN *pn = NULL;
-  RObjMapObject *obj = robj_map_peek_object (map, o_hash);
+  RObjMapObject *obj;
+  RObjMapTable *table;
 
   g_return_val_if_fail (pname != NULL, NULL);
   g_return_val_if_fail (pval != NULL, NULL);
-  g_return_val_if_fail (NULL != obj, NULL);
+  g_return_val_if_fail (id == ROBJ_MAP_NO_ID || id < ROBJ_MAP_MAX_ID, NULL);
+
+  g_mutex_lock (&map->lock);
+  obj = robj_map_get_object (map, o_id);
+  if (G_UNLIKELY (obj == NULL)) {
+    g_critical ("Object with id %u not found", o_id);
+    goto done;
+  }
+
+  if (G_UNLIKELY (g_hash_table_contains (obj->pns, pname))) {
+    g_critical ("Property %s of %s is already there", pname, obj->name);
+    goto done;
+  }
+
+  if (id == ROBJ_MAP_NO_ID) {
+    id = robj_map_table_free_id (map);
+    if (G_UNLIKELY (id >= ROBJ_MAP_MAX_ID)) {
+      g_critical ("No more PN ids");
+      goto done;
+    }
+  }
+
+  table = map->table;
+  if (id >= table->size)
+    table = robj_map_table_grow (map, id);
+
+  if (G_UNLIKELY (table->pns[id] != NULL)) {
+    g_critical ("PN id %u is already taken by %s", id, table->pns[id]->pname);
+    goto done;
+  }
 
   pn = g_new (RObjPN, 1);
   g_mutex_init (&pn->lock);
+  pn->seq = 0;
+  pn->fixed_size = robj_map_is_fixed_size (G_VALUE_TYPE (pval));
+  pn->scalar_size = robj_map_scalar_size (G_VALUE_TYPE (pval));
   pn->pname = g_strdup (pname);
   pn->pval = (GValue) G_VALUE_INIT;
   g_value_init (&pn->pval, G_VALUE_TYPE (pval));
@@ -70,30 +478,56 @@ robj_map_new_pn (RObjMap *map, guint32 o_hash, const gchar *pname,
    * is not supposed to ever change. */
   g_value_copy (pval, &pn->pval);
 
-  pn->o_hash = o_hash;
-  pn->pn_hash = GUINT32_TO_BE (g_str_hash (pname));
+  pn->o_id = o_id;
+  pn->id = id;
+  /* A new PN is a change too, for the ones synced before it was there */
+  robj_pn_bump_version_locked (pn);
 
   /* Remember this PN in the map */
-  g_mutex_lock (&obj->lock);
-  didnt_exist = g_hash_table_insert (obj->pns, GUINT_TO_POINTER (pn->pn_hash), pn);
-  g_mutex_unlock (&obj->lock);
+  g_hash_table_insert (obj->pns, pn->pname, pn);
+  g_atomic_pointer_set (&table->pns[id], pn);
+  map->next_id = MAX (map->next_id, id + 1);
 
-  g_return_val_if_fail (didnt_exist, NULL);
+done:
+  g_mutex_unlock (&map->lock);
   return pn;
 }
 
+/* Frees what was retired, if nobody can be using it anymore.
+ * NOTE: called with the map lock taken */
 static void
-robj_map_destroy_pn (gpointer data) {
-  RObjPN *pn = (RObjPN *) data;
-
-  g_return_if_fail (pn != NULL);
-  g_return_if_fail (pn->pname != NULL);
-
-  g_mutex_clear (&pn->lock);
-  g_free (pn->pname);
-  g_value_unset (&pn->pval);
+robj_map_reclaim (RObjMap *map) {
+  GSList *l;
+
+  if (!g_atomic_int_get (&map->has_retired))
+    return;
+
+  /* It's not reachable anymore, so the readers that come now can't find it.
+   * The ones that could have found it are counted. */
+  __atomic_thread_fence (__ATOMIC_SEQ_CST);
+  if (g_atomic_int_get (&map->readers))
+    return;
+
+  for (l = map->retired_pns; l; l = l->next)
+    g_array_append_val (map->free_ids, ((RObjPN *) l->data)->id);
+
+  g_slist_free_full (map->retired, g_free);
+  g_slist_free_full (map->retired_pns, robj_map_destroy_pn);
+  map->retired = NULL;
+  map->retired_pns = NULL;
+  g_atomic_int_set (&map->has_retired, 0);
+}
 
-  g_free (pn);
+void
+robj_map_read_end (RObjMap *map) {
+  if (!g_atomic_int_dec_and_test (&map->readers))
+    return;
+
+  /* If the map is busy, the next one frees it */
+  if (g_atomic_int_get (&map->has_retired) && g_mutex_trylock (&map->lock)) {
+    robj_map_reclaim (map);
+    g_mutex_unlock (&map->lock);
+  }
 }
 
 static void
@@ -103,54 +537,150 @@ robj_map_destroy_obj (gpointer data) {
   g_return_if_fail (obj->name != NULL);
 
   g_hash_table_unref (obj->pns);
-  g_mutex_clear (&obj->lock);
   g_free (obj->name);
   g_free (obj);
 }
 
 guint32
 robj_map_add_object (RObjMap *map, const gchar *name) {
+  return robj_map_add_object_with_id (map, name, ROBJ_MAP_NO_ID);
+}
+
+guint32
+robj_map_add_object_with_id (RObjMap *map, const gchar *name, guint32 id) {
   RObjMapObject *obj;
-  G_GNUC_UNUSED gboolean didnt_exist;
-  guint32 ohash;
+  guint i;
+
+  g_return_val_if_fail (name != NULL, ROBJ_MAP_NO_ID);
+  g_return_val_if_fail (id == ROBJ_MAP_NO_ID || id < ROBJ_MAP_MAX_ID,
+                        ROBJ_MAP_NO_ID);
+
+  g_mutex_lock (&map->lock);
+  if (id == ROBJ_MAP_NO_ID) {
+    for (id = 0; id < map->objects->len; id++) {
+      if (g_ptr_array_index (map->objects, id) == NULL)
+        break;
+    }
+  }
+
+  if (id >= map->objects->len)
+    g_ptr_array_set_size (map->objects, id + 1);
+
+  if (G_UNLIKELY (g_ptr_array_index (map->objects, id) != NULL)) {
+    g_mutex_unlock (&map->lock);
+    g_critical ("Object id %u is already taken", id);
+    return ROBJ_MAP_NO_ID;
+  }
 
-  g_return_val_if_fail (name != NULL, 0);
+  for (i = 0; i < map->objects->len; i++) {
+    obj = g_ptr_array_index (map->objects, i);
+
+    if (G_UNLIKELY (obj && g_str_equal (obj->name, name))) {
+      g_mutex_unlock (&map->lock);
+      g_critical ("Object %s is already there", name);
+      return ROBJ_MAP_NO_ID;
+    }
+  }
 
-  ohash = GUINT32_TO_BE (g_str_hash (name));
   obj = g_new (RObjMapObject, 1);
   obj->name = g_strdup (name);
-  obj->pns = g_hash_table_new_full (NULL, NULL, NULL, robj_map_destroy_pn);
-  g_mutex_init (&obj->lock);
+  obj->id = id;
+  /* The keys are the names of the PNs */
+  obj->pns = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                    robj_map_destroy_pn);
 
   // obj->sigs = TODO
 
-  g_mutex_lock (&map->lock);
-  didnt_exist = g_hash_table_insert (map->objects, GUINT_TO_POINTER (ohash), obj);
+  g_ptr_array_index (map->objects, id) = obj;
   g_mutex_unlock (&map->lock);
 
-  g_return_val_if_fail (didnt_exist, 0);
-  return ohash;
+  return id;
 }
 
 void
-robj_map_remove_object (RObjMap *map, guint32 ohash) {
-  G_GNUC_UNUSED gboolean found;
+robj_map_remove_object (RObjMap *map, guint32 o_id) {
+  RObjMapObject *obj;
+  GHashTableIter iter;
+  gpointer pn;
 
   g_mutex_lock (&map->lock);
-  found = g_hash_table_remove (map->objects, GUINT_TO_POINTER (ohash));
+  obj = robj_map_get_object (map, o_id);
+  if (obj) {
+    /* Somebody may still be using them: the lookups are lock-free, and
+     * the PNs are also kept outside of the map. So they are retired as
+     * the tables are. */
+    g_hash_table_iter_init (&iter, obj->pns);
+    while (g_hash_table_iter_next (&iter, NULL, &pn)) {
+      g_atomic_pointer_set (&map->table->pns[((RObjPN *) pn)->id], NULL);
+      map->retired_pns = g_slist_prepend (map->retired_pns, pn);
+      g_hash_table_iter_steal (&iter);
+    }
+    g_atomic_int_set (&map->has_retired, 1);
+
+    g_ptr_array_index (map->objects, o_id) = NULL;
+    robj_map_destroy_obj (obj);
+    robj_map_reclaim (map);
+  }
   g_mutex_unlock (&map->lock);
 
-  g_warn_if_fail (found);
+  g_warn_if_fail (obj != NULL);
+}
+
+guint
+robj_map_foreach_changed (RObjMap *map, guint32 o_id, guint64 since,
+                          RObjPNFunc func, gpointer user_data,
+                          guint64 *version) {
+  guint32 id;
+  guint n = 0;
+
+  g_return_val_if_fail (func != NULL, 0);
+
+  g_mutex_lock (&map->lock);
+  if (version)
+    *version = map->version;
+  for (id = 0; id < map->table->size; id++) {
+    RObjPN *pn = map->table->pns[id];
+
+    if (pn && pn->o_id == o_id && robj_pn_get_version (pn) > since) {
+      func (pn, user_data);
+      n++;
+    }
+  }
+  g_mutex_unlock (&map->lock);
+
+  return n;
 }
 
 void
 robj_map_init (RObjMap *map) {
   g_mutex_init (&map->lock);
-  map->objects = g_hash_table_new_full (NULL, NULL, NULL, robj_map_destroy_obj);
+  map->objects = g_ptr_array_new ();
+  map->table = robj_map_table_new (ROBJ_MAP_MIN_SIZE);
+  map->retired = NULL;
+  map->retired_pns = NULL;
+  map->has_retired = 0;
+  map->readers = 0;
+  map->free_ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+  map->next_id = 0;
+  map->epoch = ((guint64) g_random_int () << 32) | g_random_int ();
+  map->version = 0;
 }
 
 void
 robj_map_clear (RObjMap *map) {
+  guint i;
+
+  for (i = 0; i < map->objects->len; i++) {
+    RObjMapObject *obj = g_ptr_array_index (map->objects, i);
+
+    if (obj)
+      robj_map_destroy_obj (obj);
+  }
+
   g_mutex_clear (&map->lock);
-  g_hash_table_unref (map->objects);
+  g_ptr_array_unref (map->objects);
+  g_free (map->table);
+  g_slist_free_full (map->retired, g_free);
+  g_slist_free_full (map->retired_pns, robj_map_destroy_pn);
+  g_array_unref (map->free_ids);
 }
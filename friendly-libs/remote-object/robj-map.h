@@ -3,9 +3,38 @@
 
 #  include <glib-object.h>
 
+/* The objects and the PNs are identified by small integers, that are given
+ * by the source side in the dump, so the messages can carry them as varints
+ * and the receiver can index arrays with them. */
+#  define ROBJ_MAP_NO_ID G_MAXUINT32
+
+typedef struct _RObjMapTable RObjMapTable;
+
 typedef struct {
+  /* Taken by the changes of the map, the lookups don't need it */
   GMutex lock;
-  GHashTable *objects;
+  /* RObjMapObject by id, NULL if the id is free */
+  GPtrArray *objects;
+
+  /* All the PNs by id, read without locking.
+   * The tables replaced by bigger ones, and the PNs of the removed objects,
+   * are retired: freed as soon as there are no readers, see
+   * robj_map_read_begin (), or with the map. */
+  RObjMapTable *table;
+  GSList *retired;
+  GSList *retired_pns;
+  gint has_retired;
+  gint readers;
+  /* The ids of the PNs that were freed, to reuse */
+  GArray *free_ids;
+  /* Above all the ids taken so far */
+  guint32 next_id;
+
+  /* Each write of a PN value takes the next version, so the changes since
+   * some point can be found. The versions only mean something within the
+   * same epoch, that is random for each map. Taken under the lock. */
+  guint64 epoch;
+  guint64 version;
 } RObjMap;
 
 void robj_map_init (RObjMap * map);
@@ -15,26 +44,81 @@ void robj_map_clear (RObjMap * map);
 typedef struct {
   RObjMap *map;
 
+  /* Taken by the writers of the value. For the fixed size types the readers
+   * only check that the sequence didn't change while they were copying */
   GMutex lock;
+  gint seq;
+  gboolean fixed_size;
+  /* Size of the value on the wire if it's a scalar, that is encoded in place
+   * without the transforms. 0 for the rest */
+  guint8 scalar_size;
   /* Property name */
   gchar *pname;
   /* Current value of the property */
   GValue pval;
-  /* Hash of the object name (BE). */
-  guint32 o_hash;
-  /* Hash of the property name (BE). */
-  guint32 pn_hash;
+  /* Id of the object */
+  guint32 o_id;
+  /* Id of the PN, unique in the map */
+  guint32 id;
+  /* Version of the map when the value was written last time */
+  guint64 version;
 } RObjPN;
 
-/* transfer-none */
-RObjPN *robj_map_lookup_pn (RObjMap * map, guint32 o_hash, guint32 pn_hash);
+/* The lock-free readers. The PNs looked up between these two stay valid
+ * until the end, even if their object is removed in the meantime. Outside,
+ * a PN is valid as long as its object is in the map.
+ * They nest. The last reader to leave frees what was retired meanwhile, so
+ * if there are always readers inside, it waits until the map is cleared. */
+void robj_map_read_begin (RObjMap * map);
+void robj_map_read_end (RObjMap * map);
+
+/* transfer-none. Lock-free, see robj_map_read_begin (). */
+RObjPN *robj_map_lookup_pn (RObjMap * map, guint32 id);
+
+/* transfer-none. For the negotiation, takes the lock.
+ * See robj_map_read_begin () for how long the PN is valid. */
+RObjPN *robj_map_find_pn (RObjMap * map, guint32 o_id, const gchar * pname);
 
 /* returns transfer-none */
-RObjPN *robj_map_new_pn (RObjMap * map, guint32 o_hash, const gchar * pname,
+RObjPN *robj_map_new_pn (RObjMap * map, guint32 o_id, const gchar * pname,
                          const GValue * pval);
 
+/* With the id given by the other side, or ROBJ_MAP_NO_ID to take a free one */
+RObjPN *robj_map_new_pn_with_id (RObjMap * map, guint32 o_id,
+                                 const gchar * pname, const GValue * pval,
+                                 guint32 id);
+
+/* Transforms the value of the PN into @dest, that must be initialized */
+gboolean robj_pn_read_value (RObjPN * pn, GValue * dest);
+/* Sets the value of the PN from @src, transforming it if needed */
+gboolean robj_pn_write_value (RObjPN * pn, const GValue * src);
+
+/* The fast path for the scalars: the value in the ROBJ transport, that is
+ * pn->scalar_size bytes in the host order, is copied straight from/to @data */
+void robj_pn_read_scalar (RObjPN * pn, guint8 * data);
+void robj_pn_write_scalar (RObjPN * pn, const guint8 * data);
+
+/* The last version given to a write, 0 if nothing was written yet */
+guint64 robj_map_get_version (RObjMap * map);
+guint64 robj_pn_get_version (RObjPN * pn);
+
+typedef void (*RObjPNFunc) (RObjPN * pn, gpointer user_data);
+
+/* Calls @func for the PNs of the object that were written after the
+ * version @since, in the order of their ids. 0 - for all of them.
+ * @version, if not NULL, gets the version of the map at that moment: every
+ * write up to it is seen by @func, the later ones get a bigger version.
+ * Returns the number of PNs. Takes the lock, so the map can't be changed
+ * from @func. */
+guint robj_map_foreach_changed (RObjMap * map, guint32 o_id, guint64 since,
+                                RObjPNFunc func, gpointer user_data,
+                                guint64 * version);
+
+/* Returns the id of the object, or ROBJ_MAP_NO_ID */
 guint32 robj_map_add_object (RObjMap * map, const gchar * name);
+guint32 robj_map_add_object_with_id (RObjMap * map, const gchar * name,
+                                     guint32 id);
 
-void robj_map_remove_object (RObjMap * map, guint32 ohash);
+void robj_map_remove_object (RObjMap * map, guint32 o_id);
 
 #endif
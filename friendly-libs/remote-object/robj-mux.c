@@ -0,0 +1,578 @@
+#define _GNU_SOURCE
+#include "robj-mux.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/* [message size] - 4 bytes, BE */
+#define ROBJ_MUX_HEADER_LEN 4
+/* Messages per send, each one takes 2 iovecs */
+#define ROBJ_MUX_BATCH 64
+#define ROBJ_MUX_MAX_EVENTS 64
+#define ROBJ_MUX_READ_SIZE (64 * 1024)
+/* Bigger incoming messages are surely a mistake of the other side */
+#define ROBJ_MUX_MAX_MESSAGE (64 * 1024 * 1024)
+#define ROBJ_MUX_MIN_QUEUE 16
+
+typedef struct {
+  GBytes *msg;
+  guint32 size_be;
+} RObjMuxEntry;
+
+struct _RObjMuxClient {
+  gint fd;
+  /* Position in mux->clients */
+  guint index;
+  gboolean closed;
+  /* Is in mux->pending */
+  gboolean pending;
+  /* Is waiting for EPOLLOUT */
+  gboolean want_write;
+  /* Some messages were dropped */
+  gboolean overflowed;
+
+  /* Ring of the queued messages, the size is a power of 2 */
+  RObjMuxEntry *queue;
+  guint queue_size;
+  guint queue_head;
+  guint queue_len;
+  /* Bytes of the first message that are already sent, with its header */
+  gsize sent;
+  /* Bytes of all the queued messages, with their headers */
+  gsize queued;
+
+  /* What was read, and is not a complete message yet */
+  GByteArray *in;
+};
+
+struct _RObjMux {
+  gint epfd;
+  gint listen_fd;
+  gsize max_queue;
+
+  RObjMuxEventFunc event;
+  RObjMuxMessageFunc message;
+  gpointer user_data;
+
+  GPtrArray *clients;
+  /* The clients that have something to write */
+  GPtrArray *pending;
+  /* The closed clients. They are freed after the dispatch, where
+   * somebody can still have a pointer on them */
+  GPtrArray *dead;
+  guint dispatching;
+};
+
+static gboolean
+robj_mux_set_error (GError **err, const gchar *what) {
+  int errsv = errno;
+
+  g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errsv),
+               "%s: %s", what, g_strerror (errsv));
+  return FALSE;
+}
+
+static void
+robj_mux_client_free (gpointer data) {
+  RObjMuxClient *client = (RObjMuxClient *) data;
+
+  g_free (client->queue);
+  g_byte_array_unref (client->in);
+  g_free (client);
+}
+
+static void
+robj_mux_client_drop_queue (RObjMuxClient *client) {
+  while (client->queue_len > 0) {
+    g_bytes_unref (client->queue[client->queue_head].msg);
+    client->queue_head = (client->queue_head + 1) & (client->queue_size - 1);
+    client->queue_len--;
+  }
+
+  client->sent = 0;
+  client->queued = 0;
+}
+
+static void
+robj_mux_close_client_full (RObjMux *mux, RObjMuxClient *client,
+                            gboolean notify) {
+  RObjMuxClient *last;
+
+  if (client->closed)
+    return;
+
+  client->closed = TRUE;
+  epoll_ctl (mux->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+  close (client->fd);
+  client->fd = -1;
+
+  robj_mux_client_drop_queue (client);
+
+  /* Swap with the last one */
+  last = g_ptr_array_index (mux->clients, mux->clients->len - 1);
+  g_ptr_array_index (mux->clients, client->index) = last;
+  last->index = client->index;
+  g_ptr_array_set_size (mux->clients, mux->clients->len - 1);
+
+  g_ptr_array_add (mux->dead, client);
+
+  if (notify && mux->event)
+    mux->event (mux, client, ROBJ_MUX_EVENT_CLOSED, mux->user_data);
+}
+
+void
+robj_mux_close_client (RObjMux *mux, RObjMuxClient *client) {
+  g_return_if_fail (mux != NULL);
+  g_return_if_fail (client != NULL);
+
+  robj_mux_close_client_full (mux, client, TRUE);
+}
+
+RObjMux *
+robj_mux_new (gsize max_queue, RObjMuxEventFunc event,
+              RObjMuxMessageFunc message, gpointer user_data, GError **err) {
+  RObjMux *mux;
+  gint epfd;
+
+  epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (epfd < 0) {
+    robj_mux_set_error (err, "epoll_create1");
+    return NULL;
+  }
+
+  mux = g_new0 (RObjMux, 1);
+  mux->epfd = epfd;
+  mux->listen_fd = -1;
+  mux->max_queue = max_queue;
+  mux->event = event;
+  mux->message = message;
+  mux->user_data = user_data;
+
+  mux->clients = g_ptr_array_new ();
+  mux->pending = g_ptr_array_new ();
+  mux->dead = g_ptr_array_new_with_free_func (robj_mux_client_free);
+
+  return mux;
+}
+
+void
+robj_mux_free (RObjMux *mux) {
+  g_return_if_fail (mux != NULL);
+  g_return_if_fail (mux->dispatching == 0);
+
+  /* Nobody is interested in them anymore */
+  while (mux->clients->len > 0)
+    robj_mux_close_client_full (mux, g_ptr_array_index (mux->clients, 0),
+                                FALSE);
+
+  if (mux->listen_fd >= 0)
+    epoll_ctl (mux->epfd, EPOLL_CTL_DEL, mux->listen_fd, NULL);
+  close (mux->epfd);
+
+  g_ptr_array_unref (mux->clients);
+  g_ptr_array_unref (mux->pending);
+  g_ptr_array_unref (mux->dead);
+  g_free (mux);
+}
+
+static gboolean
+robj_mux_set_nonblocking (gint fd, GError **err) {
+  gint flags = fcntl (fd, F_GETFL);
+
+  if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    return robj_mux_set_error (err, "fcntl");
+
+  return TRUE;
+}
+
+RObjMuxClient *
+robj_mux_add_client (RObjMux *mux, gint fd, GError **err) {
+  RObjMuxClient *client;
+  struct epoll_event ev = { 0 };
+  gint one = 1;
+
+  g_return_val_if_fail (mux != NULL, NULL);
+  g_return_val_if_fail (fd >= 0, NULL);
+
+  if (!robj_mux_set_nonblocking (fd, err)) {
+    close (fd);
+    return NULL;
+  }
+
+  /* The messages are already batched here. Fails on unix sockets, that
+   * don't need it. */
+  setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+  client = g_new0 (RObjMuxClient, 1);
+  client->fd = fd;
+  client->queue_size = ROBJ_MUX_MIN_QUEUE;
+  client->queue = g_new (RObjMuxEntry, client->queue_size);
+  client->in = g_byte_array_new ();
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = client;
+  if (epoll_ctl (mux->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    robj_mux_set_error (err, "epoll_ctl");
+    close (fd);
+    robj_mux_client_free (client);
+    return NULL;
+  }
+
+  client->index = mux->clients->len;
+  g_ptr_array_add (mux->clients, client);
+
+  if (mux->event)
+    mux->event (mux, client, ROBJ_MUX_EVENT_CONNECTED, mux->user_data);
+
+  /* The callback may have closed it already */
+  return client->closed ? NULL : client;
+}
+
+gboolean
+robj_mux_listen (RObjMux *mux, gint fd, GError **err) {
+  struct epoll_event ev = { 0 };
+
+  g_return_val_if_fail (mux != NULL, FALSE);
+  g_return_val_if_fail (mux->listen_fd < 0, FALSE);
+
+  /* All the pending connections are accepted at once, until EAGAIN */
+  if (!robj_mux_set_nonblocking (fd, err))
+    return FALSE;
+
+  /* NULL is the listener */
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl (mux->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    return robj_mux_set_error (err, "epoll_ctl");
+
+  mux->listen_fd = fd;
+  return TRUE;
+}
+
+static void
+robj_mux_accept (RObjMux *mux) {
+  GError *err = NULL;
+  gint fd;
+
+  for (;;) {
+    fd = accept4 (mux->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+
+      /* EMFILE and the like are retried on the next dispatch */
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        g_warning ("accept: %s", g_strerror (errno));
+      return;
+    }
+
+    if (!robj_mux_add_client (mux, fd, &err)) {
+      g_warning ("Couldn't add the client: %s", err ? err->message : "");
+      g_clear_error (&err);
+    }
+  }
+}
+
+guint
+robj_mux_get_n_clients (RObjMux *mux) {
+  return mux->clients->len;
+}
+
+gsize
+robj_mux_client_get_queued (RObjMuxClient *client) {
+  return client->queued;
+}
+
+gint
+robj_mux_get_fd (RObjMux *mux) {
+  return mux->epfd;
+}
+
+static void
+robj_mux_client_want_write (RObjMux *mux, RObjMuxClient *client,
+                            gboolean want) {
+  struct epoll_event ev = { 0 };
+
+  if (client->want_write == want)
+    return;
+
+  client->want_write = want;
+  ev.events = want ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  ev.data.ptr = client;
+  if (epoll_ctl (mux->epfd, EPOLL_CTL_MOD, client->fd, &ev) < 0)
+    g_warning ("epoll_ctl: %s", g_strerror (errno));
+}
+
+gboolean
+robj_mux_send (RObjMux *mux, RObjMuxClient *client, GBytes *msg) {
+  RObjMuxEntry *entry;
+  gsize size;
+
+  g_return_val_if_fail (mux != NULL, FALSE);
+  g_return_val_if_fail (client != NULL, FALSE);
+  g_return_val_if_fail (msg != NULL, FALSE);
+
+  size = g_bytes_get_size (msg);
+  g_return_val_if_fail (size <= G_MAXUINT32, FALSE);
+
+  if (client->closed)
+    return FALSE;
+
+  /* The next messages would make no sense after a gap, so they are dropped
+   * too until the client gets the whole state again. But a message that
+   * is bigger than the limit can still go alone. */
+  if (client->overflowed || (mux->max_queue && client->queue_len > 0
+                             && client->queued + ROBJ_MUX_HEADER_LEN + size >
+                             mux->max_queue)) {
+    client->overflowed = TRUE;
+    return FALSE;
+  }
+
+  if (client->queue_len == client->queue_size) {
+    RObjMuxEntry *queue = g_new (RObjMuxEntry, client->queue_size * 2);
+    guint i;
+
+    for (i = 0; i < client->queue_len; i++)
+      queue[i] = client->queue[(client->queue_head + i)
+                               & (client->queue_size - 1)];
+
+    g_free (client->queue);
+    client->queue = queue;
+    client->queue_size *= 2;
+    client->queue_head = 0;
+  }
+
+  entry = &client->queue[(client->queue_head + client->queue_len)
+                         & (client->queue_size - 1)];
+  entry->msg = g_bytes_ref (msg);
+  entry->size_be = GUINT32_TO_BE ((guint32) size);
+  client->queue_len++;
+  client->queued += ROBJ_MUX_HEADER_LEN + size;
+
+  /* If it waits for EPOLLOUT, dispatch writes it */
+  if (!client->pending && !client->want_write) {
+    client->pending = TRUE;
+    g_ptr_array_add (mux->pending, client);
+  }
+
+  return TRUE;
+}
+
+guint
+robj_mux_broadcast (RObjMux *mux, GBytes *msg) {
+  guint i;
+  guint n = 0;
+
+  g_return_val_if_fail (mux != NULL, 0);
+
+  for (i = 0; i < mux->clients->len; i++) {
+    if (robj_mux_send (mux, g_ptr_array_index (mux->clients, i), msg))
+      n++;
+  }
+
+  return n;
+}
+
+/* Forgets the messages that are completely written */
+static void
+robj_mux_client_consume (RObjMuxClient *client, gsize written) {
+  client->queued -= written;
+  written += client->sent;
+
+  while (client->queue_len > 0) {
+    RObjMuxEntry *entry = &client->queue[client->queue_head];
+    gsize total = ROBJ_MUX_HEADER_LEN + g_bytes_get_size (entry->msg);
+
+    if (written < total)
+      break;
+
+    written -= total;
+    g_bytes_unref (entry->msg);
+    client->queue_head = (client->queue_head + 1) & (client->queue_size - 1);
+    client->queue_len--;
+  }
+
+  client->sent = written;
+}
+
+static void
+robj_mux_client_write (RObjMux *mux, RObjMuxClient *client) {
+  while (client->queue_len > 0) {
+    struct iovec iov[ROBJ_MUX_BATCH * 2];
+    struct msghdr mh = { 0 };
+    gsize skip = client->sent;
+    guint n_iov = 0;
+    guint i;
+    gssize written;
+
+    for (i = 0; i < client->queue_len && i < ROBJ_MUX_BATCH; i++) {
+      RObjMuxEntry *entry = &client->queue[(client->queue_head + i)
+                                           & (client->queue_size - 1)];
+      gsize size;
+      gconstpointer data = g_bytes_get_data (entry->msg, &size);
+
+      /* Only the first one can be sent partially */
+      if (skip < ROBJ_MUX_HEADER_LEN) {
+        iov[n_iov].iov_base = (guint8 *) & entry->size_be + skip;
+        iov[n_iov].iov_len = ROBJ_MUX_HEADER_LEN - skip;
+        n_iov++;
+        skip = 0;
+      } else {
+        skip -= ROBJ_MUX_HEADER_LEN;
+      }
+
+      if (size > skip) {
+        iov[n_iov].iov_base = (guint8 *) data + skip;
+        iov[n_iov].iov_len = size - skip;
+        n_iov++;
+      }
+      skip = 0;
+    }
+
+    mh.msg_iov = iov;
+    mh.msg_iovlen = n_iov;
+
+    /* Same as writev, but a closed connection is not a SIGPIPE */
+    written = sendmsg (client->fd, &mh, MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        robj_mux_client_want_write (mux, client, TRUE);
+        return;
+      }
+
+      robj_mux_close_client (mux, client);
+      return;
+    }
+
+    robj_mux_client_consume (client, written);
+  }
+
+  robj_mux_client_want_write (mux, client, FALSE);
+
+  if (client->overflowed) {
+    client->overflowed = FALSE;
+    if (mux->event)
+      mux->event (mux, client, ROBJ_MUX_EVENT_RESYNC, mux->user_data);
+  }
+}
+
+void
+robj_mux_flush (RObjMux *mux) {
+  g_return_if_fail (mux != NULL);
+
+  /* The callbacks can add more */
+  while (mux->pending->len > 0) {
+    RObjMuxClient *client =
+        g_ptr_array_index (mux->pending, mux->pending->len - 1);
+
+    g_ptr_array_set_size (mux->pending, mux->pending->len - 1);
+    client->pending = FALSE;
+    if (!client->closed)
+      robj_mux_client_write (mux, client);
+  }
+
+  if (mux->dispatching == 0)
+    g_ptr_array_set_size (mux->dead, 0);
+}
+
+static void
+robj_mux_client_read (RObjMux *mux, RObjMuxClient *client) {
+  GByteArray *in = client->in;
+  guint len = in->len;
+  guint offset = 0;
+  gssize r;
+
+  /* One read per event, so one busy client doesn't hold the others */
+  g_byte_array_set_size (in, len + ROBJ_MUX_READ_SIZE);
+  r = read (client->fd, in->data + len, ROBJ_MUX_READ_SIZE);
+  if (r <= 0) {
+    g_byte_array_set_size (in, len);
+    if (r < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+
+    robj_mux_close_client (mux, client);
+    return;
+  }
+
+  g_byte_array_set_size (in, len + r);
+
+  while (in->len - offset >= ROBJ_MUX_HEADER_LEN) {
+    guint32 size;
+
+    memcpy (&size, in->data + offset, ROBJ_MUX_HEADER_LEN);
+    size = GUINT32_FROM_BE (size);
+
+    if (G_UNLIKELY (size > ROBJ_MUX_MAX_MESSAGE)) {
+      g_warning ("Message of %u bytes from a client, closing it", size);
+      robj_mux_close_client (mux, client);
+      return;
+    }
+
+    if (in->len - offset - ROBJ_MUX_HEADER_LEN < size)
+      break;
+
+    if (mux->message)
+      mux->message (mux, client, in->data + offset + ROBJ_MUX_HEADER_LEN,
+                    size, mux->user_data);
+
+    /* By the callback */
+    if (client->closed)
+      return;
+
+    offset += ROBJ_MUX_HEADER_LEN + size;
+  }
+
+  g_byte_array_remove_range (in, 0, offset);
+}
+
+gint
+robj_mux_dispatch (RObjMux *mux, gint timeout) {
+  struct epoll_event events[ROBJ_MUX_MAX_EVENTS];
+  gint n;
+  gint i;
+
+  g_return_val_if_fail (mux != NULL, -1);
+
+  n = epoll_wait (mux->epfd, events, ROBJ_MUX_MAX_EVENTS, timeout);
+  if (n < 0) {
+    if (errno != EINTR) {
+      g_warning ("epoll_wait: %s", g_strerror (errno));
+      return -1;
+    }
+    n = 0;
+  }
+
+  mux->dispatching++;
+  for (i = 0; i < n; i++) {
+    RObjMuxClient *client = events[i].data.ptr;
+
+    if (client == NULL) {
+      robj_mux_accept (mux);
+      continue;
+    }
+
+    /* By a previous event */
+    if (client->closed)
+      continue;
+
+    /* The errors and the hangups are found out by the read */
+    if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+      robj_mux_client_read (mux, client);
+
+    if (!client->closed && (events[i].events & EPOLLOUT))
+      robj_mux_client_write (mux, client);
+  }
+  mux->dispatching--;
+
+  robj_mux_flush (mux);
+  return n;
+}
@@ -0,0 +1,70 @@
+#ifndef _ROBJ_MUX_H
+#  define _ROBJ_MUX_H
+
+#  include <glib-object.h>
+
+/* Serves many stream connections from one thread, with an epoll set of
+ * non-blocking sockets. The messages to each client wait in its own queue,
+ * and are written in batches with one vectored send. The same message is
+ * queued to all the clients without copying.
+ *
+ * On the wire each message is prefixed with its size, 4 bytes BE. */
+
+typedef struct _RObjMux RObjMux;
+typedef struct _RObjMuxClient RObjMuxClient;
+
+typedef enum {
+  /* A new connection, accepted or added */
+  ROBJ_MUX_EVENT_CONNECTED,
+  /* The queue of the client was full, so the messages were dropped since
+   * then. Now it's empty again, and the client needs the whole state. */
+  ROBJ_MUX_EVENT_RESYNC,
+  /* The client is gone, it can't be used after this */
+  ROBJ_MUX_EVENT_CLOSED,
+} RObjMuxEvent;
+
+typedef void (*RObjMuxEventFunc) (RObjMux * mux, RObjMuxClient * client,
+                                  RObjMuxEvent event, gpointer user_data);
+
+/* A message from the client, valid only during the call */
+typedef void (*RObjMuxMessageFunc) (RObjMux * mux, RObjMuxClient * client,
+                                    const guint8 * msg, gsize size,
+                                    gpointer user_data);
+
+/* @max_queue - how many bytes can wait for a client. 0 - no limit */
+RObjMux *robj_mux_new (gsize max_queue, RObjMuxEventFunc event,
+                       RObjMuxMessageFunc message, gpointer user_data,
+                       GError ** err);
+void robj_mux_free (RObjMux * mux);
+
+/* Accepts the connections of the listening socket. The fd stays owned by
+ * the caller, and has to stay open while the mux is alive. */
+gboolean robj_mux_listen (RObjMux * mux, gint fd, GError ** err);
+
+/* Serves a connected socket, f.e. one end of a socketpair. Takes the fd. */
+RObjMuxClient *robj_mux_add_client (RObjMux * mux, gint fd, GError ** err);
+void robj_mux_close_client (RObjMux * mux, RObjMuxClient * client);
+
+guint robj_mux_get_n_clients (RObjMux * mux);
+gsize robj_mux_client_get_queued (RObjMuxClient * client);
+
+/* Readable when there's something to dispatch, to watch it from a main
+ * loop, f.e. with g_unix_fd_add () */
+gint robj_mux_get_fd (RObjMux * mux);
+
+/* Waits for up to @timeout ms, -1 forever, and handles all that's ready,
+ * then flushes. Returns the number of the events, or -1 on error. */
+gint robj_mux_dispatch (RObjMux * mux, gint timeout);
+
+/* Queues the message, it's written on the next flush. Returns FALSE if it
+ * was dropped because the queue of the client is full. */
+gboolean robj_mux_send (RObjMux * mux, RObjMuxClient * client, GBytes * msg);
+
+/* Queues the message to all the clients. Returns how many got it. */
+guint robj_mux_broadcast (RObjMux * mux, GBytes * msg);
+
+/* Writes what's queued, as much as the sockets take now. The rest is
+ * written by dispatch when they are writable again. */
+void robj_mux_flush (RObjMux * mux);
+
+#endif
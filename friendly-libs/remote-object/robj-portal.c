@@ -27,100 +27,154 @@
 
 #include "bombolla/lba-plugin-system.h"
 #include "bombolla/lba-log.h"
-#include "bombolla/base/lba-byte-stream.h"
+#include "robj-mux.h"
+#include "robj-protocol.h"
+#include "robj-snapshot.h"
+#include <gio/gio.h>
+#include <glib-unix.h>
 #include <string.h>
 
+/* Serves the source object to the clients that connect to the TCP port.
+ * Each one gets the dump first, and then the property notifies and the
+ * signals, as they happen. The values come in a snapshot, when the client
+ * asks for them with the version it has, so a client that reconnects only
+ * gets what changed meanwhile. All the clients are served from the main
+ * context, with one RObjMux. */
+
+#define LBA_ROBJ_PORTAL_DEFAULT_MAX_QUEUE (4 * 1024 * 1024)
+
+typedef enum {
+  PROP_SOURCE = 1,
+  PROP_ADDRESS,
+  PROP_PORT,
+  PROP_MAX_QUEUE,
+  PROP_N_CLIENTS,
+  N_PROPERTIES
+} LbaRemoteObjectPortalProperty;
+
 enum {
   SIGNAL_START,
-  SIGNAL_ADD_WATCH,
-  SIGNAL_HAVE_MESSAGE,
-  SIGNAL_SEND_MESSAGE,
   LAST_SIGNAL
 };
 
+static GParamSpec *obj_properties[N_PROPERTIES] = { NULL, };
 static guint lba_robj_portal_signals[LAST_SIGNAL] = { 0 };
 
 typedef struct _LbaRemoteObjectPortal {
   GObject parent;
 
-  GList *watches;
+  GRecMutex lock;
+  GObject *source;
+  gchar *address;
+  /* 0 - any free one, until started */
+  guint port;
+  guint max_queue;
+
+  GSocket *listener;
+  RObjMux *mux;
+  GSource *mux_source;
+  /* Writes what the notifies queued, once per main loop iteration */
+  GSource *flush_source;
+
+  /* LbaRemoteObjectPortalClient by RObjMuxClient */
+  GHashTable *clients;
+
+  /* The values of the source, in the order the clients get them */
+  RObjMap map;
+  guint32 o_id;
 } LbaRemoteObjectPortal;
 
+typedef struct {
+  /* The version of the last snapshot it got */
+  guint64 version;
+  /* It asked for the state at least once */
+  gboolean synced;
+} LbaRemoteObjectPortalClient;
+
 typedef struct _LbaRemoteObjectPortalClass {
   GObjectClass parent;
 
   /* Actions */
   void (*start) (LbaRemoteObjectPortal *);
-  void (*send_message) (LbaRemoteObjectPortal *, GBytes *);
-
-  /* Events */
-  void (*have_message) (LbaRemoteObjectPortal *, GBytes *);
-
 } LbaRemoteObjectPortalClass;
 
 G_DEFINE_TYPE (LbaRemoteObjectPortal, lba_robj_portal, G_TYPE_OBJECT);
 
-static GBytes *
-lba_robj_portal_value2bytes (const GValue *src_val) {
-  GBytes *ret = NULL;
-  GValue dst_val = G_VALUE_INIT;
-
-  if (G_VALUE_TYPE (src_val) == G_TYPE_BYTES) {
-    ret = g_value_get_boxed (src_val);
-    return ret ? g_bytes_ref (ret) : NULL;
-  }
-
-  if (!g_value_type_transformable (G_VALUE_TYPE (src_val), G_TYPE_BYTES)) {
-    g_warning ("Type %s can't be transformed to bytes",
-               g_type_name (G_VALUE_TYPE (src_val)));
-    goto exit;
-  }
+static gboolean
+lba_robj_portal_flush (gpointer ptr) {
+  LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) ptr;
 
-  g_value_init (&dst_val, G_TYPE_BYTES);
+  LBA_LOCK (self);
+  if (self->mux)
+    robj_mux_flush (self->mux);
+  g_clear_pointer (&self->flush_source, g_source_unref);
+  LBA_UNLOCK (self);
 
-  if (!g_value_transform (src_val, &dst_val)) {
-    g_warning ("Couldn't transform");
-    goto exit;
-  }
+  return G_SOURCE_REMOVE;
+}
 
-  ret = g_value_get_boxed (&dst_val);
+/* NOTE: called with the lock taken */
+static void
+lba_robj_portal_schedule_flush (LbaRemoteObjectPortal *self) {
+  if (self->flush_source)
+    return;
 
-  if (ret) {
-    g_bytes_ref (ret);
-  }
-exit:
-  g_value_unset (&dst_val);
-  return ret;
+  self->flush_source = g_idle_source_new ();
+  g_source_set_callback (self->flush_source, lba_robj_portal_flush, self, NULL);
+  g_source_attach (self->flush_source,
+                   /* lba-core main context */
+                   NULL);
 }
 
-void
+static void
 lba_robj_portal_property_notify (GObject *gobject,
                                  GParamSpec *pspec, gpointer user_data) {
   LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) user_data;
+  GValue value = G_VALUE_INIT;
+  GBytes *message;
+  RObjPN *pn;
+
+  /* lba_robj_portal_stop () can remove the object meanwhile */
+  robj_map_read_begin (&self->map);
+  pn = robj_map_find_pn (&self->map, self->o_id, pspec->name);
+  if (G_UNLIKELY (pn == NULL)) {
+    robj_map_read_end (&self->map);
+    return;
+  }
 
-  /* FIXME: lock mutex */
+  g_value_init (&value, pspec->value_type);
+  g_object_get_property (gobject, pspec->name, &value);
 
-  message = robj_protocol_property_notify (pspec);
+  /* The value of the PN and the queues change together, so a client that
+   * connects now gets either the old value in the dump and then this
+   * notify, or the new one in the dump */
+  LBA_LOCK (self);
+  robj_pn_write_value (pn, &value);
+  message = robj_protocol_pn_to_message (pn);
   if (G_UNLIKELY (!message)) {
-    g_warning ("Could not trensform the property");
-    /* Disconnect notify?? */
+    g_warning ("Could not transform the property %s", pspec->name);
+  } else if (self->mux) {
+    robj_mux_broadcast (self->mux, message);
+    lba_robj_portal_schedule_flush (self);
   }
+  LBA_UNLOCK (self);
+  robj_map_read_end (&self->map);
 
-  LBA_LOG ("Sending message of %u bytes", msg_size);
-  g_signal_emit_by_name (self, "have-message", message);
-  g_bytes_unref (message);
+  g_clear_pointer (&message, g_bytes_unref);
+  g_value_unset (&value);
 }
 
-static gboolean
-lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
-  GError *err = NULL;
+/* The description of the source, that doesn't change while it's served.
+ * NOTE: called with the lock taken */
+static GBytes *
+lba_robj_portal_make_dump (LbaRemoteObjectPortal *self) {
   GType t,
     ti;
   GByteArray *msg;
-  GBytes *msg_bytes;
   guchar magic[4] = { 'd', 'u', 'm', 'p' };
   guint8 class_name_size;
   guint8 num_signals = 0;
+  guint signal_index = 0;
 
   t = G_OBJECT_TYPE (self->source);
 
@@ -143,7 +197,7 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
    * for each signal:
    *   [signal name size] - 1 byte
    *   [signal name] - zero-terminated string
-   *   [signal id] - 4 bytes
+   *   [signal id] - varint, the index of the signal in this dump
    *   [signal flags] - 4 bytes
    *   [gtype name size] - 1 byte
    *   [gtype name] - name of return type
@@ -154,15 +208,17 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
    *     [gtype name] - zero-terminated string
    *
    *  [number of properties] - 1 byte
-   *  for each property:
+   *  for each property that can be sent:
+   *    [property id] - varint, the id of its PN in the messages
    *    [property name size] - 1 byte
    *    [property name] - zero-terminated string
    *    [gtype name size] - 1 byte
    *    [gtype name] - zero-terminated string
-   *    [current value size] - 4 bytes
-   *    [current value] - bytes
    *
    *    FIXME: min/max ? flags? default value?
+   *
+   * The values are not in the dump, the client asks for them with [sync],
+   * see lba_robj_portal_mux_message ().
    */
 
   /* [dump] */
@@ -216,8 +272,7 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
       guint8 signal_name_size,
         gtype_size,
         params_num;
-      guint32 signal_id,
-        signal_flags,
+      guint32 signal_flags,
         p;
 
       g_signal_query (signals[s], &query);
@@ -237,9 +292,9 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
       /* [signal name] - string */
       g_byte_array_append (msg, (guchar *) query.signal_name, signal_name_size);
 
-      /* [signal id] - 4 bytes */
-      signal_id = GUINT32_TO_BE (query.signal_id);
-      g_byte_array_append (msg, (guchar *) & signal_id, 4);
+      /* [signal id] - varint. The GLib ids are different in each process,
+       * so the signals are known by the order they are connected in start */
+      robj_protocol_write_varint (msg, signal_index++);
 
       /* [signal flags] - 4 bytes */
       signal_flags = GUINT32_TO_BE (query.signal_flags);
@@ -277,29 +332,38 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
     guint n_properties,
       p;
     GObjectClass *klass;
-    guint8 props_num;
+    guint8 props_num = 0;
 
     klass = g_type_class_peek (t);
 
     properties = g_object_class_list_properties (klass, &n_properties);
 
-    LBA_LOG ("Properties in dump %u", n_properties);
+    /* Only the ones that have a PN, see lba_robj_portal_make_map () */
+    for (p = 0; p < n_properties; p++) {
+      if (robj_map_lookup_pn (&self->map, p))
+        props_num++;
+    }
+
+    LBA_LOG ("Properties in dump %u", props_num);
 
     /* [number of properties] - 1 byte */
-    props_num = n_properties;
     g_byte_array_append (msg, &props_num, 1);
 
     /* for each property: */
     for (p = 0; p < n_properties; p++) {
       guint8 type_name_size,
         prop_name_size;
-      GValue value = G_VALUE_INIT;
-      GBytes *value_bytes;
-      guint32 value_bytes_size_be;
+
+      if (robj_map_lookup_pn (&self->map, p) == NULL)
+        continue;
 
       LBA_LOG ("Dumping property [%s %s]", g_type_name (properties[p]->value_type),
                properties[p]->name);
 
+      /* [property id] - varint. The properties are listed in the same order
+       * on each dump, so the index is stable for the life of the source */
+      robj_protocol_write_varint (msg, p);
+
       /* [property name size] - 1 byte */
       prop_name_size = strlen (properties[p]->name) + 1;
       g_byte_array_append (msg, &prop_name_size, 1);
@@ -314,43 +378,58 @@ lba_robj_portal_send_source_header (LbaRemoteObjectPortal *self) {
       /* [gtype name] - zero-terminated string */
       g_byte_array_append (msg, (guchar *) g_type_name (properties[p]->value_type),
                            type_name_size);
-
-      /* We also should dump current value */
-      g_object_get_property (self->source, properties[p]->name, &value);
-      value_bytes = lba_robj_portal_value2bytes (&value);
-      g_assert (value_bytes);   /* FIXME: we definitelly should just skip untransformable properties and signals in future */
-
-      /* [current value size] */
-      value_bytes_size_be = GUINT32_TO_BE (g_bytes_get_size (value_bytes));
-      g_byte_array_append (msg, (guchar *) & value_bytes_size_be, 4);
-
-      /* [current value] */
-      g_byte_array_append (msg, g_bytes_get_data (value_bytes, NULL),
-                           g_bytes_get_size (value_bytes));
-
-      g_bytes_unref (value_bytes);
-      g_value_unset (&value);
     }
 
     g_free (properties);
   }
 
-  msg_bytes = g_byte_array_free_to_bytes (msg);
-  g_assert (msg_bytes);
+  LBA_LOG ("Dump of %u bytes", msg->len);
+  return g_byte_array_free_to_bytes (msg);
+}
+
+/* One PN per property that can be sent, with the id of its index in the
+ * class, as in the dump.
+ * NOTE: called with the lock taken */
+static gboolean
+lba_robj_portal_make_map (LbaRemoteObjectPortal *self) {
+  GParamSpec **properties;
+  guint n_properties,
+    p;
+
+  self->o_id = robj_map_add_object (&self->map, G_OBJECT_TYPE_NAME (self->source));
+  if (self->o_id == ROBJ_MAP_NO_ID)
+    return FALSE;
+
+  properties =
+      g_object_class_list_properties (G_OBJECT_GET_CLASS (self->source),
+                                      &n_properties);
+
+  for (p = 0; p < n_properties; p++) {
+    GValue value = G_VALUE_INIT;
+
+    if (!(properties[p]->flags & G_PARAM_READABLE)
+        || !g_value_type_transformable (properties[p]->value_type,
+                                        ROBJ_TRANSPORT_TYPE)) {
+      LBA_LOG ("Property %s can't be sent", properties[p]->name);
+      continue;
+    }
 
-  /* Now we finally write the dump */
-  LBA_LOG ("Writing %" G_GSIZE_FORMAT " bytes", g_bytes_get_size (msg_bytes));
-  if (!lba_byte_stream_write_gbytes (self->output_stream, msg_bytes, &err)) {
-    g_critical ("Couldn't write object dump: [%s]", err ? err->message : "");
-    g_error_free (err);
+    g_value_init (&value, properties[p]->value_type);
+    g_object_get_property (self->source, properties[p]->name, &value);
+    robj_map_new_pn_with_id (&self->map, self->o_id, properties[p]->name,
+                             &value, p);
+    g_value_unset (&value);
   }
 
+  g_free (properties);
   return TRUE;
 }
 
 typedef struct _LbaRemoteObjectPortalSignalCtx {
   LbaRemoteObjectPortal *self;
   GSignalQuery signal_query;
+  /* [signal id] of the dump */
+  guint index;
 } LbaRemoteObjectPortalSignalCtx;
 
 static void
@@ -374,20 +453,19 @@ lba_robj_portal_signal_cb (GClosure *closure,
 
   LBA_LOG ("Signal %s", signal_ctx->signal_query.signal_name);
 
-  /* FIXME: we need to receive the return value, so byte stream has to be a
-   * "connection". Maybe we need an LbaConnection object, that would have various
-   * bytestreams inside.. */
+  /* FIXME: we need to receive the return value, but the clients don't send
+   * anything yet */
 
   {
     /* The protocol message is:
        [sign] - message magic of "signal", 4 bytes
-       [number of params] - number of parameters, 1 byte
-       [signal id] - 4 bytes
+       [number of params] - number of parameters, without the instance, 1 byte
+       [signal id] - varint, as in the dump
 
        .. then for each param. GTypes are already known from the dump sent on start.
 
        [param value size] - 4 bytes
-       [param value] - bytes
+       [param value] - value of ROBJ transport
 
        FIXME: we actually don't need to write size for int types etc
      */
@@ -395,9 +473,7 @@ lba_robj_portal_signal_cb (GClosure *closure,
     GByteArray *msg = NULL;
     GBytes *msg_bytes = NULL;
     guchar sign_magic[4] = { 's', 'i', 'g', 'n' };
-    guint8 msg_number_of_params = n_param_values;
-    GError *err = NULL;
-    guint32 sig_id;
+    guint8 msg_number_of_params = n_param_values - 1;
 
     msg = g_byte_array_new ();
 
@@ -407,18 +483,25 @@ lba_robj_portal_signal_cb (GClosure *closure,
     g_byte_array_append (msg, &msg_number_of_params, 1);
 
     /* [signal id] */
-    sig_id = GUINT32_TO_BE (signal_ctx->signal_query.signal_id);
-    g_byte_array_append (msg, (guchar *) & sig_id, 2);
+    robj_protocol_write_varint (msg, signal_ctx->index);
 
     /* We skip the first parameter because it is an object of the source */
     for (p = 1; p < n_param_values; p++) {
+      GValue tval = G_VALUE_INIT;
       GBytes *bytes;
       guint32 bytes_size,
         bytes_size_be;
 
-      bytes = lba_robj_portal_value2bytes (&param_values[p]);
-      g_assert (bytes);
+      g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+      if (!g_value_transform (&param_values[p], &tval)) {
+        g_warning ("Can't send the parameter %d of %s", p,
+                   signal_ctx->signal_query.signal_name);
+        g_value_unset (&tval);
+        g_byte_array_unref (msg);
+        return;
+      }
 
+      bytes = g_value_get_boxed (&tval);
       bytes_size = g_bytes_get_size (bytes);
       bytes_size_be = GUINT32_TO_BE (bytes_size);
 
@@ -426,16 +509,20 @@ lba_robj_portal_signal_cb (GClosure *closure,
       g_byte_array_append (msg, (guint8 *) & bytes_size_be, 4);
       /* [param value] */
       g_byte_array_append (msg, g_bytes_get_data (bytes, NULL), bytes_size);
+      g_value_unset (&tval);
     }
 
     msg_bytes = g_byte_array_free_to_bytes (msg);
 
-    /* Finally, write the bytes */
-    LBA_LOG ("Writing %" G_GSIZE_FORMAT " bytes", g_bytes_get_size (msg_bytes));
-    if (!lba_byte_stream_write_gbytes (self->output_stream, msg_bytes, &err)) {
-      g_critical ("Couldn't write signal message: [%s]", err ? err->message : "");
-      g_error_free (err);
+    /* Finally, queue the bytes to everybody */
+    LBA_LOG ("Sending %" G_GSIZE_FORMAT " bytes", g_bytes_get_size (msg_bytes));
+    LBA_LOCK (self);
+    if (self->mux) {
+      robj_mux_broadcast (self->mux, msg_bytes);
+      lba_robj_portal_schedule_flush (self);
     }
+    LBA_UNLOCK (self);
+    g_bytes_unref (msg_bytes);
   }
 }
 
@@ -464,28 +551,237 @@ lba_robj_passthrough_marshal (GClosure *closure,
             n_param_values, param_values, invocation_hint, marshal_data);
 }
 
-/* FIXME: should return gboolean ?? */
+/* Sends the values that changed after @since, 0 - all of them.
+ * NOTE: called with the lock taken */
+static void
+lba_robj_portal_send_snapshot (LbaRemoteObjectPortal *self,
+                               RObjMuxClient *client, guint64 since) {
+  LbaRemoteObjectPortalClient *state;
+  GByteArray *buf = g_byte_array_new ();
+  GBytes *snapshot;
+  guint64 version;
+
+  /* Nothing is written meanwhile, the notifies take the lock too, so the
+   * client gets the notifies right after the snapshot */
+  version = robj_snapshot_write (&self->map, self->o_id, since, buf);
+  snapshot = g_byte_array_free_to_bytes (buf);
+
+  LBA_LOG ("Snapshot of %" G_GSIZE_FORMAT " bytes for %p, versions %"
+           G_GUINT64_FORMAT "..%" G_GUINT64_FORMAT, g_bytes_get_size (snapshot),
+           client, since, version);
+
+  /* If it's dropped, the same goes again on the resync */
+  state = g_hash_table_lookup (self->clients, client);
+  state->synced = TRUE;
+  if (robj_mux_send (self->mux, client, snapshot))
+    state->version = version;
+  g_bytes_unref (snapshot);
+}
+
+static void
+lba_robj_portal_mux_event (RObjMux *mux, RObjMuxClient *client,
+                           RObjMuxEvent event, gpointer user_data) {
+  LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) user_data;
+  LbaRemoteObjectPortalClient *state;
+  GBytes *dump;
+
+  switch (event) {
+  case ROBJ_MUX_EVENT_CONNECTED:
+    LBA_LOG ("New client %p", client);
+    g_hash_table_insert (self->clients, client,
+                         g_new0 (LbaRemoteObjectPortalClient, 1));
+    dump = lba_robj_portal_make_dump (self);
+    robj_mux_send (mux, client, dump);
+    g_bytes_unref (dump);
+    break;
+  case ROBJ_MUX_EVENT_RESYNC:
+    /* Some notifies were dropped, but it had all that was before its last
+     * snapshot, so it only needs what changed since then */
+    state = g_hash_table_lookup (self->clients, client);
+    LBA_LOG ("Resyncing client %p", client);
+    if (state->synced)
+      lba_robj_portal_send_snapshot (self, client, state->version);
+    break;
+  case ROBJ_MUX_EVENT_CLOSED:
+    LBA_LOG ("Client %p is gone", client);
+    g_hash_table_remove (self->clients, client);
+    break;
+  }
+}
+
+/* The clients send:
+   [sync] - magic, 4 bytes
+   [epoch] - 8 bytes BE, of the snapshot the client has
+   [version] - varint, of the snapshot the client has, 0 if none
+
+   and get a snapshot with the values that changed after that version, or
+   all of them if the client has nothing, or the epoch is from another
+   source. See robj-snapshot.c for the format. */
+static void
+lba_robj_portal_mux_message (RObjMux *mux, RObjMuxClient *client,
+                             const guint8 *msg, gsize size, gpointer user_data) {
+  LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) user_data;
+  const guint8 *ptr;
+  guint64 epoch_be;
+  guint64 version;
+
+  if (size < 12 || memcmp (msg, "sync", 4))
+    goto ignore;
+
+  ptr = msg + 12;
+  if (!robj_protocol_read_varint (&ptr, msg + size, &version))
+    goto ignore;
+
+  memcpy (&epoch_be, msg + 4, 8);
+  if (GUINT64_FROM_BE (epoch_be) != self->map.epoch
+      || version > robj_map_get_version (&self->map)) {
+    LBA_LOG ("Client %p has the state of another source", client);
+    version = 0;
+  }
+
+  lba_robj_portal_send_snapshot (self, client, version);
+  return;
+
+ignore:
+  LBA_LOG ("Ignoring %" G_GSIZE_FORMAT " bytes from %p", size, client);
+}
+
+static gboolean
+lba_robj_portal_dispatch (gint fd, GIOCondition condition, gpointer ptr) {
+  LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) ptr;
+
+  LBA_LOCK (self);
+  /* Everything that is ready, without waiting */
+  robj_mux_dispatch (self->mux, 0);
+  LBA_UNLOCK (self);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* NOTE: called with the lock taken */
+static void
+lba_robj_portal_stop (LbaRemoteObjectPortal *self) {
+  if (self->mux_source) {
+    g_source_destroy (self->mux_source);
+    g_clear_pointer (&self->mux_source, g_source_unref);
+  }
+
+  if (self->flush_source) {
+    g_source_destroy (self->flush_source);
+    g_clear_pointer (&self->flush_source, g_source_unref);
+  }
+
+  g_clear_pointer (&self->mux, robj_mux_free);
+  g_clear_pointer (&self->clients, g_hash_table_unref);
+
+  if (self->listener) {
+    g_socket_close (self->listener, NULL);
+    g_clear_object (&self->listener);
+  }
+
+  if (self->o_id != ROBJ_MAP_NO_ID) {
+    robj_map_remove_object (&self->map, self->o_id);
+    self->o_id = ROBJ_MAP_NO_ID;
+  }
+}
+
+/* NOTE: called with the lock taken */
+static gboolean
+lba_robj_portal_listen (LbaRemoteObjectPortal *self, GError **err) {
+  GInetAddress *inet;
+  GSocketAddress *addr;
+  gboolean ret = FALSE;
+
+  inet = g_inet_address_new_from_string (self->address);
+  if (!inet) {
+    g_set_error (err, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                 "Bad address %s", self->address);
+    return FALSE;
+  }
+
+  addr = g_inet_socket_address_new (inet, self->port);
+  self->listener = g_socket_new (g_inet_address_get_family (inet),
+                                 G_SOCKET_TYPE_STREAM,
+                                 G_SOCKET_PROTOCOL_TCP, err);
+  if (!self->listener)
+    goto done;
+
+  /* Many clients can come at once */
+  g_socket_set_listen_backlog (self->listener, 1024);
+  g_socket_set_blocking (self->listener, FALSE);
+
+  if (!g_socket_bind (self->listener, addr, TRUE, err)
+      || !g_socket_listen (self->listener, err))
+    goto done;
+
+  /* The one that was chosen, if it was 0 */
+  if (self->port == 0) {
+    GSocketAddress *local = g_socket_get_local_address (self->listener, err);
+
+    if (!local)
+      goto done;
+
+    self->port =
+        g_inet_socket_address_get_port ((GInetSocketAddress *) local);
+    g_object_unref (local);
+  }
+
+  ret = TRUE;
+done:
+  g_object_unref (addr);
+  g_object_unref (inet);
+  return ret;
+}
+
 static void
 lba_robj_portal_start (LbaRemoteObjectPortal *self) {
   GError *err = NULL;
   GType t;
-  static volatile gboolean once;
 
   LBA_LOG ("Starting server");
 
-  /* FIXME: lock mutex */
+  LBA_LOCK (self);
+  if (self->mux) {
+    g_warning ("The portal is already started");
+    goto done;
+  }
 
-  /* Now we introspect the source object and send it's description.
-   * Note: for connection-type streams this should be sent each time new connection
-   * is opened. */
-  if (!lba_robj_portal_send_source_header (self)) {
-    return;
+  if (!self->source) {
+    g_warning ("The portal has no source");
+    goto done;
+  }
+
+  /* Now we introspect the source object, and each client gets its
+   * description when it connects */
+  if (!lba_robj_portal_make_map (self)) {
+    g_warning ("Couldn't map the source");
+    goto done;
   }
 
+  self->clients = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  self->mux = robj_mux_new (self->max_queue, lba_robj_portal_mux_event,
+                            lba_robj_portal_mux_message, self, &err);
+  if (!self->mux || !lba_robj_portal_listen (self, &err)
+      || !robj_mux_listen (self->mux, g_socket_get_fd (self->listener), &err)) {
+    g_warning ("Couldn't start the portal: %s", err ? err->message : "");
+    g_clear_error (&err);
+    lba_robj_portal_stop (self);
+    goto done;
+  }
+
+  LBA_INFO ("Listening on %s:%u", self->address, self->port);
+
+  self->mux_source = g_unix_fd_source_new (robj_mux_get_fd (self->mux), G_IO_IN);
+  g_source_set_callback (self->mux_source, (GSourceFunc) lba_robj_portal_dispatch,
+                         self, NULL);
+  g_source_attach (self->mux_source,
+                   /* lba-core main context */
+                   NULL);
+
   t = G_OBJECT_TYPE (self->source);
 
   /* Now we connect to all the signals and notifications, so each time
-   * source notifies, we will send notification to the bytestream*/
+   * source notifies, we will send notification to the clients */
   {
     GParamSpec **properties;
     guint n_properties,
@@ -493,17 +789,21 @@ lba_robj_portal_start (LbaRemoteObjectPortal *self) {
     guint *signals,
       s,
       n_signals;
+    guint signal_index = 0;
     GObjectClass *klass;
 
     klass = g_type_class_peek (t);
 
     properties = g_object_class_list_properties (klass, &n_properties);
 
-    /* Connect to notify::property  */
+    /* Connect to notify::property of the ones in the dump */
     for (p = 0; p < n_properties; p++) {
       GParamSpec *prop;
       gchar *prop_notify_str;
 
+      if (!robj_map_lookup_pn (&self->map, p))
+        continue;
+
       prop = properties[p];
       prop_notify_str = g_strdup_printf ("notify::%s", g_param_spec_get_name (prop));
 
@@ -549,6 +849,7 @@ lba_robj_portal_start (LbaRemoteObjectPortal *self) {
           signal_ctx = g_new0 (LbaRemoteObjectPortalSignalCtx, 1);
           signal_ctx->signal_query = query;
           signal_ctx->self = self;
+          signal_ctx->index = signal_index++;
 
           closure =
               g_cclosure_new (G_CALLBACK (lba_robj_portal_signal_cb),
@@ -575,6 +876,10 @@ lba_robj_portal_start (LbaRemoteObjectPortal *self) {
       }
     }
   }
+
+done:
+  LBA_UNLOCK (self);
+  g_object_notify_by_pspec (G_OBJECT (self), obj_properties[PROP_PORT]);
 }
 
 static void
@@ -583,47 +888,34 @@ lba_robj_portal_set_property (GObject *object,
                               GParamSpec *pspec) {
   LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) object;
 
+  LBA_LOCK (self);
   switch ((LbaRemoteObjectPortalProperty) property_id) {
-  case PROP_OUTPUT_STREAM:
-
-    {
-      GObject *obj;
-
-      obj = g_value_get_object (value);
-
-      if (!LBA_IS_BYTE_STREAM (obj)) {
-        /* Fixme: write it's own param_spec ?? */
-        g_warning ("Object is not an LbaByteStream");
-        break;
-      }
-
-      /* Changing the output on fly is not supported yet */
-      g_assert (!self->output_stream);
-
-      self->output_stream = (LbaByteStream *) obj;
-
-      if (self->output_stream) {
-        g_object_ref (self->output_stream);
-      }
-    }
-    break;
-
   case PROP_SOURCE:
     /* Changing the source on fly is not supported yet */
-    g_assert (!self->source);
-
-    self->source = g_value_get_object (value);
-
-    if (self->source) {
-      g_object_ref (self->source);
+    if (self->mux) {
+      g_warning ("Can't change the source of a started portal");
+      break;
     }
 
+    g_clear_object (&self->source);
+    self->source = g_value_dup_object (value);
+    break;
+  case PROP_ADDRESS:
+    g_free (self->address);
+    self->address = g_value_dup_string (value);
+    break;
+  case PROP_PORT:
+    self->port = g_value_get_uint (value);
+    break;
+  case PROP_MAX_QUEUE:
+    self->max_queue = g_value_get_uint (value);
     break;
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
   }
+  LBA_UNLOCK (self);
 }
 
 static void
@@ -631,72 +923,116 @@ lba_robj_portal_get_property (GObject *object,
                               guint property_id, GValue *value, GParamSpec *pspec) {
   LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) object;
 
+  LBA_LOCK (self);
   switch ((LbaRemoteObjectPortalProperty) property_id) {
-
-  case PROP_OUTPUT_STREAM:
-    g_value_set_object (value, self->output_stream);
-    break;
   case PROP_SOURCE:
     g_value_set_object (value, self->source);
     break;
+  case PROP_ADDRESS:
+    g_value_set_string (value, self->address);
+    break;
+  case PROP_PORT:
+    g_value_set_uint (value, self->port);
+    break;
+  case PROP_MAX_QUEUE:
+    g_value_set_uint (value, self->max_queue);
+    break;
+  case PROP_N_CLIENTS:
+    g_value_set_uint (value, self->mux ? robj_mux_get_n_clients (self->mux) : 0);
+    break;
   default:
     /* We don't have any other property... */
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
   }
+  LBA_UNLOCK (self);
 }
 
 static void
 lba_robj_portal_init (LbaRemoteObjectPortal *self) {
+  g_rec_mutex_init (&self->lock);
+  robj_map_init (&self->map);
+  self->o_id = ROBJ_MAP_NO_ID;
 }
 
 static void
 lba_robj_portal_dispose (GObject *gobject) {
   LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) gobject;
 
-  /* FIXME: lock mutex */
-
-  if (self->source) {
+  if (self->source)
     g_signal_handlers_disconnect_by_data (self->source, self);
-    g_object_unref (self->source);
-  }
 
-  if (self->output_stream) {
-    /* FIXME should we stop here?? */
-    lba_byte_stream_close (self->output_stream);
-    g_object_unref (self->output_stream);
-  }
+  LBA_LOCK (self);
+  lba_robj_portal_stop (self);
+  g_clear_object (&self->source);
+  LBA_UNLOCK (self);
 
   G_OBJECT_CLASS (lba_robj_portal_parent_class)->dispose (gobject);
 }
 
+static void
+lba_robj_portal_finalize (GObject *gobject) {
+  LbaRemoteObjectPortal *self = (LbaRemoteObjectPortal *) gobject;
+
+  robj_map_clear (&self->map);
+  g_free (self->address);
+  g_rec_mutex_clear (&self->lock);
+
+  G_OBJECT_CLASS (lba_robj_portal_parent_class)->finalize (gobject);
+}
+
 static void
 lba_robj_portal_class_init (LbaRemoteObjectPortalClass *klass) {
   GObjectClass *object_class = (GObjectClass *) klass;
 
+  robj_protocol_init ();
+
   klass->start = lba_robj_portal_start;
 
   object_class->set_property = lba_robj_portal_set_property;
   object_class->get_property = lba_robj_portal_get_property;
   object_class->dispose = lba_robj_portal_dispose;
-
-  g_object_class_install_property (object_class,
-                                   PROP_SOURCE,
-                                   g_param_spec_object ("source",
-                                                        "Source",
-                                                        "Source object we bind in remote",
-                                                        G_TYPE_OBJECT,
-                                                        G_PARAM_STATIC_STRINGS |
-                                                        G_PARAM_READWRITE));
-
-  g_object_class_install_property (object_class,
-                                   PROP_OUTPUT_STREAM,
-                                   g_param_spec_object ("output-stream",
-                                                        "Output Stream",
-                                                        "Stream for data output",
-                                                        G_TYPE_OBJECT,
-                                                        G_PARAM_STATIC_STRINGS |
-                                                        G_PARAM_READWRITE));
+  object_class->finalize = lba_robj_portal_finalize;
+
+  obj_properties[PROP_SOURCE] =
+      g_param_spec_object ("source",
+                           "Source",
+                           "Source object we bind in remote",
+                           G_TYPE_OBJECT,
+                           G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE);
+
+  obj_properties[PROP_ADDRESS] =
+      g_param_spec_string ("address",
+                           "Address",
+                           "Address to listen on",
+                           "127.0.0.1",
+                           G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+                           G_PARAM_CONSTRUCT);
+
+  obj_properties[PROP_PORT] =
+      g_param_spec_uint ("port",
+                         "Port",
+                         "TCP port to listen on. 0 - any free one, that is "
+                         "known once started", 0, G_MAXUINT16, 0,
+                         G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE);
+
+  obj_properties[PROP_MAX_QUEUE] =
+      g_param_spec_uint ("max-queue",
+                         "MaxQueue",
+                         "Bytes that can wait for a slow client, then it "
+                         "misses the messages and is resynced (0 = no limit)",
+                         0, G_MAXUINT, LBA_ROBJ_PORTAL_DEFAULT_MAX_QUEUE,
+                         G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE |
+                         G_PARAM_CONSTRUCT);
+
+  obj_properties[PROP_N_CLIENTS] =
+      g_param_spec_uint ("n-clients",
+                         "NClients",
+                         "How many clients are connected",
+                         0, G_MAXUINT, 0,
+                         G_PARAM_STATIC_STRINGS | G_PARAM_READABLE);
+
+  g_object_class_install_properties (object_class, N_PROPERTIES, obj_properties);
 
   /* FIXME: should be aligned to the base LbaObject, that would have states */
   lba_robj_portal_signals[SIGNAL_START] =
@@ -1,4 +1,5 @@
 #include "robj-protocol.h"
+#include <string.h>
 
 #define ROBJ_TRANSPORT_DEFINE_SIMPLE_TRANSFORMS(T)                      \
   static void                                                           \
@@ -127,46 +128,103 @@ robj_protocol_init (void) {
   }
 }
 
+/* The ids are written as varints: 7 bits per byte, the lowest first, the
+ * highest bit is set if there are more bytes. */
+void
+robj_protocol_write_varint (GByteArray *buf, guint64 val) {
+  guint8 bytes[ROBJ_PROTOCOL_VARINT_MAX];
+
+  g_byte_array_append (buf, bytes, robj_protocol_put_varint (bytes, val));
+}
+
+guint
+robj_protocol_put_varint (guint8 *ptr, guint64 val) {
+  guint n = 0;
+
+  while (val >= 0x80) {
+    ptr[n++] = (val & 0x7f) | 0x80;
+    val >>= 7;
+  }
+  ptr[n++] = val;
+
+  return n;
+}
+
+gboolean
+robj_protocol_read_varint (const guint8 **ptr, const guint8 *end, guint64 *val) {
+  const guint8 *p = *ptr;
+  guint shift = 0;
+
+  *val = 0;
+  while (p < end && shift < 64) {
+    *val |= (guint64) (*p & 0x7f) << shift;
+    if (!(*p++ & 0x80)) {
+      *ptr = p;
+      return TRUE;
+    }
+    shift += 7;
+  }
+
+  return FALSE;
+}
+
 /* The protocol message is:
    PN header.
    ----------------------------------
    [pn] - message magic of "property notify", 2 bytes
-   [object name hash] - 4 bytes
-   [property name hash] - 4 bytes
+   [property id] - varint, from the negotiation
    ----------------------------------
    [val] - value of ROBJ transport, size is already known beforehand, from the
    negotiation.
 */
-const guint ROBJ_PROTOCOL_PN_HEADER_LEN = 2 + 4 + 4;
+#define ROBJ_PROTOCOL_PN_MAGIC_LEN 2
 
-RObjPN *
-robj_protocol_message_to_pn (RObjMap *map, GBytes *msg) {
+/* NOTE: called in a read section of the map */
+static RObjPN *
+robj_protocol_apply_message (RObjMap *map, GBytes *msg) {
   gsize msg_size;
-  gchar *msg_data;
+  const guint8 *msg_data;
+  const guint8 *ptr;
   RObjPN *pn;
   GValue transport_value = G_VALUE_INIT;
-  guint32 ohash;
-  guint32 pnhash;
+  guint64 id;
+  gsize header_len;
 
-  msg_data = (gchar *) g_bytes_get_data (msg, &msg_size);
+  msg_data = (const guint8 *) g_bytes_get_data (msg, &msg_size);
 
   g_return_val_if_fail (msg_data != NULL, NULL);
-  g_return_val_if_fail (msg_size > ROBJ_PROTOCOL_PN_HEADER_LEN, NULL);
+  g_return_val_if_fail (msg_size > ROBJ_PROTOCOL_PN_MAGIC_LEN, NULL);
   g_return_val_if_fail (msg_data[0] == 'p', NULL);
   g_return_val_if_fail (msg_data[1] == 'n', NULL);
 
-  msg_data += 2;
+  ptr = msg_data + ROBJ_PROTOCOL_PN_MAGIC_LEN;
+  if (G_UNLIKELY (!robj_protocol_read_varint (&ptr, msg_data + msg_size, &id)
+                  || id > G_MAXUINT32)) {
+    g_critical ("Broken PN message");
+    return NULL;
+  }
 
-  ohash = ((guint32 *) msg_data)[0];
-  pnhash = ((guint32 *) msg_data)[1];
+  header_len = ptr - msg_data;
+  g_return_val_if_fail (msg_size > header_len, NULL);
 
-  pn = robj_map_lookup_pn (map, ohash, pnhash);
+  pn = robj_map_lookup_pn (map, id);
 
   if (G_UNLIKELY (pn == NULL)) {
-    g_critical ("PN (%u, %u) not found!", ohash, pnhash);
+    g_critical ("PN %" G_GUINT64_FORMAT " not found!", id);
     return NULL;
   }
 
+  if (pn->scalar_size) {
+    /* Straight from the message into the GValue */
+    if (G_UNLIKELY (msg_size - header_len != pn->scalar_size)) {
+      g_critical ("Wrong size of %s", pn->pname);
+      return NULL;
+    }
+
+    robj_pn_write_scalar (pn, ptr);
+    return pn;
+  }
+
   /* So we already update the value in the property. There might be a race
    * condition when at this moment some other code reads or sets the property,
    * but hey, if it happens this RC is in fact the same as a race condition
@@ -188,16 +246,14 @@ robj_protocol_message_to_pn (RObjMap *map, GBytes *msg) {
                        * Take that, C++ (kekeke). */
                       g_bytes_new_from_bytes (msg,
                                               /* FIXME: make sure there's enough size to parse the value */
-                                              ROBJ_PROTOCOL_PN_HEADER_LEN,
-                                              msg_size -
-                                              ROBJ_PROTOCOL_PN_HEADER_LEN));
-  g_mutex_lock (&pn->lock);
+                                              header_len,
+                                              msg_size - header_len));
   /* At this line the object's property value that it remembers is updated.
    * Caller is going to set this value to the ghost or real object.
    * Ghost object also remembers the value in the same map, so there's
    * no problem. Real object remembers it where it remembers, so it's
    * a bit redundant.... */
-  if (!g_value_transform (&transport_value, &pn->pval)) {
+  if (!robj_pn_write_value (pn, &transport_value)) {
     /* Should never happen since the types are already negotiated */
     g_critical ("Could not transform %s", pn->pname);
     /* Let the caller know something went wrong */
@@ -205,16 +261,39 @@ robj_protocol_message_to_pn (RObjMap *map, GBytes *msg) {
   }
 
   g_value_unset (&transport_value);
-  g_mutex_unlock (&pn->lock);
   return pn;
 }
 
+RObjPN *
+robj_protocol_message_to_pn (RObjMap *map, GBytes *msg) {
+  RObjPN *pn;
+
+  robj_map_read_begin (map);
+  pn = robj_protocol_apply_message (map, msg);
+  robj_map_read_end (map);
+
+  return pn;
+}
+
+/* Returns the size of the header, the value goes right after it */
+static guint
+robj_protocol_put_pn_header (guint8 *ptr, const RObjPN *pn) {
+  /* Magic: 2 bytes */
+  ptr[0] = 'p';
+  ptr[1] = 'n';
+  /* Property id */
+  return ROBJ_PROTOCOL_PN_MAGIC_LEN
+      + robj_protocol_put_varint (ptr + ROBJ_PROTOCOL_PN_MAGIC_LEN, pn->id);
+}
+
 /* returns transfer-full, takes transfer-full */
 static GBytes *
 robj_wrap_tvalue_to_pn (GValue *tval, const RObjPN *pn) {
   GBytes *bval;
   gsize vsize;
   gconstpointer vdata;
+  guint8 header[ROBJ_PROTOCOL_PN_MAGIC_LEN + ROBJ_PROTOCOL_VARINT_MAX];
+  guint header_len;
   guint msg_size;
   gchar *ptr;
 
@@ -224,47 +303,74 @@ robj_wrap_tvalue_to_pn (GValue *tval, const RObjPN *pn) {
   /* This is a good question */
   g_return_val_if_fail (NULL != vdata, NULL);
 
-  msg_size = ROBJ_PROTOCOL_PN_HEADER_LEN + vsize;
-  ptr = (gchar *) malloc (msg_size);
   /* Write the pn header. */
-  /* Magic: 2 bytes */
-  ptr[0] = 'p';
-  ptr[1] = 'n';
-  /* Object name hash: 4 bytes */
-  *((guint32 *) (ptr + 2)) = pn->o_hash;
-  /* Property name hash: 4 bytes */
-  *((guint32 *) (ptr + 2 + 4)) = pn->pn_hash;
+  header_len = robj_protocol_put_pn_header (header, pn);
 
   /* We don't allow empty NULL bytes in the transport value.
    * Otherwise it complifies much the protocol for signal handling. */
   g_return_val_if_fail (vdata != NULL, NULL);
   g_return_val_if_fail (vsize != 0, NULL);
 
-  memcpy (ptr + ROBJ_PROTOCOL_PN_HEADER_LEN, vdata, vsize);
+  msg_size = header_len + vsize;
+  ptr = (gchar *) malloc (msg_size);
+  memcpy (ptr, header, header_len);
+  memcpy (ptr + header_len, vdata, vsize);
   /* eat the input value, we already copied the data */
   g_value_unset (tval);
   return g_bytes_new_take (ptr, msg_size);
 }
 
+gboolean
+robj_protocol_write_pn (RObjPN *pn, GByteArray *buf) {
+  GBytes *msg;
+  guint len;
+
+  if (pn->scalar_size) {
+    len = buf->len;
+
+    /* The header and the value are written right in the end of @buf */
+    g_byte_array_set_size (buf, len + ROBJ_PROTOCOL_PN_MAGIC_LEN
+                           + ROBJ_PROTOCOL_VARINT_MAX + pn->scalar_size);
+    len += robj_protocol_put_pn_header (buf->data + len, pn);
+    robj_pn_read_scalar (pn, buf->data + len);
+    g_byte_array_set_size (buf, len + pn->scalar_size);
+    return TRUE;
+  }
+
+  msg = robj_protocol_pn_to_message (pn);
+  if (msg == NULL)
+    return FALSE;
+
+  g_byte_array_append (buf, g_bytes_get_data (msg, NULL),
+                       g_bytes_get_size (msg));
+  g_bytes_unref (msg);
+  return TRUE;
+}
+
 /* returns transfer-full */
 GBytes *
 robj_protocol_pn_to_message (RObjPN *pn) {
   gboolean could_transform;
   GValue val_tval = G_VALUE_INIT;
 
+  if (pn->scalar_size) {
+    guint8 *ptr = g_malloc (ROBJ_PROTOCOL_PN_MAGIC_LEN
+                            + ROBJ_PROTOCOL_VARINT_MAX + pn->scalar_size);
+    guint len = robj_protocol_put_pn_header (ptr, pn);
+
+    /* No transport value in between */
+    robj_pn_read_scalar (pn, ptr + len);
+    return g_bytes_new_take (ptr, len + pn->scalar_size);
+  }
+
   /* This transport value holds the value in the ROBJ protocol */
   g_value_init (&val_tval, ROBJ_TRANSPORT_TYPE);
 
   /* Here the magic happens and the property value is tranformed into
    * the ROBJ transport that will travel through whatever.
-   * This magic could be better if we knew the size of the message
-   * before writing it to bytes. Then we could avoid one memcopy and
-   * some allocs. But extending the API and complifying the code
-   * only for that looks redundant. I hope nobody is going to send
-   * raw images as is. */
-  g_mutex_lock (&pn->lock);
-  could_transform = g_value_transform (&pn->pval, &val_tval);
-  g_mutex_unlock (&pn->lock);
+   * The scalars don't get here, they are written in place above, so
+   * this is only for the strings and the custom types. */
+  could_transform = robj_pn_read_value (pn, &val_tval);
 
   /* Should never happen since the types are already negotiated */
   g_return_val_if_fail (could_transform, NULL);
@@ -3,13 +3,26 @@
 
 #  include "robj-map.h"
 
+/* Writes the value of the message into its PN, and returns the PN, that
+ * is valid as long as its object is in the map, see robj_map_read_begin () */
 RObjPN *robj_protocol_message_to_pn (RObjMap * map, GBytes * msg);
 GBytes *robj_protocol_pn_to_message (RObjPN * pn);
+/* Appends the message to @buf, without the intermediate copies for the
+ * scalars */
+gboolean robj_protocol_write_pn (RObjPN * pn, GByteArray * buf);
 
 //GBytes *robj_protocol_get_negotiate (GObject *obj);
 
 void robj_protocol_init (void);
 
+/* Variable length integers, for the ids */
+#  define ROBJ_PROTOCOL_VARINT_MAX 10
+void robj_protocol_write_varint (GByteArray * buf, guint64 val);
+/* Returns the number of bytes written */
+guint robj_protocol_put_varint (guint8 * ptr, guint64 val);
+gboolean robj_protocol_read_varint (const guint8 ** ptr, const guint8 * end,
+                                    guint64 * val);
+
 /* Can be used to register transform functions for custom types */
 #  define ROBJ_TRANSPORT_TYPE (robj_transport_get_type ())
 GType robj_transport_get_type (void);
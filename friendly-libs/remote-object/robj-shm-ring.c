@@ -0,0 +1,546 @@
+#define _GNU_SOURCE
+#include "robj-shm-ring.h"
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+/* The memfd is:
+   ----------------------------------
+   [header] - RObjShmHeader, the positions of each side in own cache lines
+   [blob slots] - RObjShmBlobSlot * n_blobs
+   [ring] - 'size' bytes of messages
+   [blobs] - 'blob size' * n_blobs, page aligned
+   ----------------------------------
+   Each message in the ring is:
+   [message size] - 4 bytes, or ROBJ_SHM_WRAP if the next one is at the
+   beginning of the ring
+   [padding] - 4 bytes
+   [message] - padded to 8 bytes.
+   The positions are free running counters, so the used size of the ring is
+   always head - tail.
+*/
+#define ROBJ_SHM_MAGIC 0x4f424a53
+#define ROBJ_SHM_CACHE_LINE 64
+#define ROBJ_SHM_PAGE 4096
+#define ROBJ_SHM_RECORD_HEADER 8
+#define ROBJ_SHM_WRAP 0xffffffff
+
+#define ROBJ_SHM_ALIGN(x, a) (((x) + (a) - 1) & ~((gsize) (a) - 1))
+
+typedef struct {
+  guint32 magic;
+  guint32 size;
+  guint32 n_blobs;
+  guint32 blob_size;
+  guint8 pad0[ROBJ_SHM_CACHE_LINE - 16];
+
+  /* Written by the producer */
+  gint head;
+  gint consumer_waiting;
+  guint8 pad1[ROBJ_SHM_CACHE_LINE - 8];
+
+  /* Written by the consumer */
+  gint tail;
+  gint producer_waiting;
+  guint8 pad2[ROBJ_SHM_CACHE_LINE - 8];
+} RObjShmHeader;
+
+typedef struct {
+  /* 1 from alloc by the producer to release by the consumer */
+  gint used;
+  guint32 size;
+} RObjShmBlobSlot;
+
+struct _RObjShmRing {
+  gint ref_count;
+
+  gint memfd;
+  gint data_fd;
+  gint space_fd;
+
+  guint8 *map;
+  gsize map_size;
+
+  RObjShmHeader *header;
+  RObjShmBlobSlot *slots;
+  guint8 *data;
+  guint8 *blobs;
+  guint32 size;
+  guint32 n_blobs;
+  gsize blob_size;
+
+  /* Producer: where the reserved message starts, and where it ends */
+  guint32 reserved;
+  guint32 head;
+  guint next_blob;
+
+  /* Consumer: size in the ring of the message peeked */
+  guint32 peeked;
+};
+
+static gsize
+robj_shm_ring_layout (guint32 size, guint32 n_blobs, gsize blob_size,
+                      gsize *data_offset, gsize *blobs_offset) {
+  gsize offt = sizeof (RObjShmHeader) + n_blobs * sizeof (RObjShmBlobSlot);
+
+  *data_offset = ROBJ_SHM_ALIGN (offt, ROBJ_SHM_CACHE_LINE);
+  *blobs_offset = ROBJ_SHM_ALIGN (*data_offset + size, ROBJ_SHM_PAGE);
+
+  return *blobs_offset + n_blobs * ROBJ_SHM_ALIGN (blob_size, ROBJ_SHM_PAGE);
+}
+
+static gboolean
+robj_shm_ring_set_error (GError **err, const gchar *what) {
+  int errsv = errno;
+
+  g_set_error (err, G_FILE_ERROR, g_file_error_from_errno (errsv),
+               "%s: %s", what, g_strerror (errsv));
+  return FALSE;
+}
+
+/* Maps the memfd and takes the fds */
+static RObjShmRing *
+robj_shm_ring_map (gint memfd, gint data_fd, gint space_fd, gsize map_size,
+                   GError **err) {
+  RObjShmRing *ring;
+  gsize data_offset,
+    blobs_offset;
+  guint8 *map;
+
+  map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (map == MAP_FAILED) {
+    robj_shm_ring_set_error (err, "mmap");
+    return NULL;
+  }
+
+  ring = g_new0 (RObjShmRing, 1);
+  ring->ref_count = 1;
+  ring->memfd = memfd;
+  ring->data_fd = data_fd;
+  ring->space_fd = space_fd;
+  ring->map = map;
+  ring->map_size = map_size;
+  ring->header = (RObjShmHeader *) map;
+
+  ring->size = ring->header->size;
+  ring->n_blobs = ring->header->n_blobs;
+  ring->blob_size = ring->header->blob_size;
+  robj_shm_ring_layout (ring->size, ring->n_blobs, ring->blob_size,
+                        &data_offset, &blobs_offset);
+
+  ring->slots = (RObjShmBlobSlot *) (map + sizeof (RObjShmHeader));
+  ring->data = map + data_offset;
+  ring->blobs = map + blobs_offset;
+
+  ring->head = g_atomic_int_get (&ring->header->head);
+  return ring;
+}
+
+RObjShmRing *
+robj_shm_ring_new (gsize size, guint n_blobs, gsize blob_size, GError **err) {
+  RObjShmHeader header = { 0 };
+  RObjShmRing *ring;
+  gsize data_offset,
+    blobs_offset,
+    map_size;
+  gint memfd,
+    data_fd = -1,
+    space_fd = -1;
+
+  g_return_val_if_fail (size >= 2 * ROBJ_SHM_RECORD_HEADER, NULL);
+  g_return_val_if_fail (size <= G_MAXINT32 / 2 + 1, NULL);
+  g_return_val_if_fail (blob_size <= G_MAXUINT32, NULL);
+
+  header.magic = ROBJ_SHM_MAGIC;
+  header.size = 1u << g_bit_storage (size - 1);
+  header.n_blobs = n_blobs;
+  header.blob_size = blob_size;
+  map_size = robj_shm_ring_layout (header.size, n_blobs, blob_size,
+                                   &data_offset, &blobs_offset);
+
+  memfd = memfd_create ("robj-shm-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0) {
+    robj_shm_ring_set_error (err, "memfd_create");
+    return NULL;
+  }
+
+  /* The other side can't make it shorter under our feet */
+  if (ftruncate (memfd, map_size) < 0
+      || fcntl (memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0
+      || pwrite (memfd, &header, sizeof (header), 0) != sizeof (header)) {
+    robj_shm_ring_set_error (err, "memfd");
+    goto fail;
+  }
+
+  data_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  space_fd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (data_fd < 0 || space_fd < 0) {
+    robj_shm_ring_set_error (err, "eventfd");
+    goto fail;
+  }
+
+  ring = robj_shm_ring_map (memfd, data_fd, space_fd, map_size, err);
+  if (ring)
+    return ring;
+
+fail:
+  close (memfd);
+  if (data_fd >= 0)
+    close (data_fd);
+  if (space_fd >= 0)
+    close (space_fd);
+  return NULL;
+}
+
+RObjShmRing *
+robj_shm_ring_new_from_fds (gint memfd, gint data_fd, gint space_fd,
+                            GError **err) {
+  RObjShmHeader header;
+  gsize data_offset,
+    blobs_offset,
+    map_size;
+  struct stat st;
+
+  if (pread (memfd, &header, sizeof (header), 0) != sizeof (header)
+      || fstat (memfd, &st) < 0) {
+    robj_shm_ring_set_error (err, "memfd");
+    return NULL;
+  }
+
+  map_size = robj_shm_ring_layout (header.size, header.n_blobs,
+                                   header.blob_size, &data_offset,
+                                   &blobs_offset);
+
+  if (header.magic != ROBJ_SHM_MAGIC || header.size == 0
+      || (header.size & (header.size - 1)) || st.st_size < map_size) {
+    g_set_error (err, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                 "Not a shared memory ring");
+    return NULL;
+  }
+
+  return robj_shm_ring_map (memfd, data_fd, space_fd, map_size, err);
+}
+
+void
+robj_shm_ring_get_fds (RObjShmRing *ring, gint *memfd, gint *data_fd,
+                       gint *space_fd) {
+  if (memfd)
+    *memfd = ring->memfd;
+  if (data_fd)
+    *data_fd = ring->data_fd;
+  if (space_fd)
+    *space_fd = ring->space_fd;
+}
+
+RObjShmRing *
+robj_shm_ring_ref (RObjShmRing *ring) {
+  g_atomic_int_inc (&ring->ref_count);
+  return ring;
+}
+
+void
+robj_shm_ring_unref (RObjShmRing *ring) {
+  if (!g_atomic_int_dec_and_test (&ring->ref_count))
+    return;
+
+  munmap (ring->map, ring->map_size);
+  close (ring->memfd);
+  close (ring->data_fd);
+  close (ring->space_fd);
+  g_free (ring);
+}
+
+gsize
+robj_shm_ring_get_max_message_size (RObjShmRing *ring) {
+  return ring->size / 2 - ROBJ_SHM_RECORD_HEADER;
+}
+
+static void
+robj_shm_ring_signal (gint fd) {
+  guint64 one = 1;
+
+  /* Can only fail if the counter is about to overflow, then the other side
+   * is going to wake up anyway */
+  if (write (fd, &one, sizeof (one)) < 0 && errno != EAGAIN)
+    g_warning ("Couldn't signal the eventfd: %s", g_strerror (errno));
+}
+
+/* Waits for the fd to be signalled. Returns FALSE on timeout. */
+static gboolean
+robj_shm_ring_wait (gint fd, gint64 timeout) {
+  struct pollfd pfd = { fd, POLLIN, 0 };
+  guint64 val;
+  int ret;
+
+  do {
+    ret = poll (&pfd, 1, timeout < 0 ? -1 : (timeout + 999) / 1000);
+  } while (ret < 0 && errno == EINTR);
+
+  if (ret <= 0)
+    return FALSE;
+
+  /* Clear it */
+  if (read (fd, &val, sizeof (val)) < 0 && errno != EAGAIN)
+    g_warning ("Couldn't read the eventfd: %s", g_strerror (errno));
+
+  return TRUE;
+}
+
+guint8 *
+robj_shm_ring_reserve (RObjShmRing *ring, gsize size, gint64 timeout) {
+  RObjShmHeader *header = ring->header;
+  guint32 need = ROBJ_SHM_ALIGN (ROBJ_SHM_RECORD_HEADER + size, 8);
+  guint32 offset = ring->head & (ring->size - 1);
+  guint32 required = need;
+  gint64 deadline = -1;
+
+  g_return_val_if_fail (size <= robj_shm_ring_get_max_message_size (ring),
+                        NULL);
+
+  /* Doesn't fit until the end, so it goes to the beginning */
+  if (offset + need > ring->size)
+    required += ring->size - offset;
+
+  if (timeout > 0)
+    deadline = g_get_monotonic_time () + timeout;
+
+  while (ring->size - (ring->head - (guint32) g_atomic_int_get (&header->tail))
+         < required) {
+    gint64 left = timeout;
+
+    if (timeout == 0)
+      return NULL;
+
+    /* The consumer is going to signal as soon as it reads something.
+     * Setting the flag and checking the tail again goes against setting the
+     * tail and checking the flag on the other side, so one of them is going
+     * to see the other. */
+    g_atomic_int_set (&header->producer_waiting, 1);
+    if (ring->size - (ring->head - (guint32) g_atomic_int_get (&header->tail))
+        >= required) {
+      g_atomic_int_set (&header->producer_waiting, 0);
+      break;
+    }
+
+    if (deadline >= 0) {
+      left = deadline - g_get_monotonic_time ();
+      if (left <= 0) {
+        g_atomic_int_set (&header->producer_waiting, 0);
+        return NULL;
+      }
+    }
+
+    robj_shm_ring_wait (ring->space_fd, left);
+    g_atomic_int_set (&header->producer_waiting, 0);
+  }
+
+  if (required != need) {
+    guint32 wrap = ROBJ_SHM_WRAP;
+
+    memcpy (ring->data + offset, &wrap, 4);
+    ring->head += ring->size - offset;
+    offset = 0;
+  }
+
+  ring->reserved = ring->head;
+  ring->head += need;
+
+  return ring->data + offset + ROBJ_SHM_RECORD_HEADER;
+}
+
+void
+robj_shm_ring_commit (RObjShmRing *ring, gsize size) {
+  RObjShmHeader *header = ring->header;
+  guint32 offset = ring->reserved & (ring->size - 1);
+  guint32 size32 = size;
+
+  g_return_if_fail (ROBJ_SHM_ALIGN (ROBJ_SHM_RECORD_HEADER + size, 8)
+                    <= ring->head - ring->reserved);
+
+  /* Give back what wasn't used */
+  ring->head = ring->reserved + ROBJ_SHM_ALIGN (ROBJ_SHM_RECORD_HEADER + size, 8);
+  memcpy (ring->data + offset, &size32, 4);
+
+  g_atomic_int_set (&header->head, ring->head);
+  if (g_atomic_int_get (&header->consumer_waiting))
+    robj_shm_ring_signal (ring->data_fd);
+}
+
+gboolean
+robj_shm_ring_write (RObjShmRing *ring, const guint8 *data, gsize size,
+                     gint64 timeout) {
+  guint8 *ptr = robj_shm_ring_reserve (ring, size, timeout);
+
+  if (ptr == NULL)
+    return FALSE;
+
+  memcpy (ptr, data, size);
+  robj_shm_ring_commit (ring, size);
+  return TRUE;
+}
+
+gboolean
+robj_shm_ring_prepare_wait (RObjShmRing *ring) {
+  RObjShmHeader *header = ring->header;
+  guint32 tail = g_atomic_int_get (&header->tail);
+
+  g_atomic_int_set (&header->consumer_waiting, 1);
+  if ((guint32) g_atomic_int_get (&header->head) != tail) {
+    g_atomic_int_set (&header->consumer_waiting, 0);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+const guint8 *
+robj_shm_ring_peek (RObjShmRing *ring, gsize *size, gint64 timeout) {
+  RObjShmHeader *header = ring->header;
+  guint32 tail = g_atomic_int_get (&header->tail);
+  gint64 deadline = -1;
+
+  if (timeout > 0)
+    deadline = g_get_monotonic_time () + timeout;
+
+  for (;;) {
+    guint32 head = g_atomic_int_get (&header->head);
+    guint32 offset = tail & (ring->size - 1);
+    guint32 msg_size;
+
+    if (head != tail) {
+      memcpy (&msg_size, ring->data + offset, 4);
+
+      if (msg_size == ROBJ_SHM_WRAP) {
+        tail += ring->size - offset;
+        g_atomic_int_set (&header->tail, tail);
+        continue;
+      }
+
+      /* The other process could have written anything */
+      if (G_UNLIKELY ((gsize) msg_size + ROBJ_SHM_RECORD_HEADER > head - tail
+                      || (gsize) offset + ROBJ_SHM_RECORD_HEADER + msg_size
+                      > ring->size)) {
+        g_critical ("Broken message of %u bytes in the ring", msg_size);
+        return NULL;
+      }
+
+      ring->peeked = ROBJ_SHM_ALIGN (ROBJ_SHM_RECORD_HEADER + msg_size, 8);
+      *size = msg_size;
+      return ring->data + offset + ROBJ_SHM_RECORD_HEADER;
+    }
+
+    if (timeout == 0)
+      return NULL;
+
+    if (!robj_shm_ring_prepare_wait (ring))
+      continue;
+
+    if (deadline >= 0 && deadline <= g_get_monotonic_time ()) {
+      g_atomic_int_set (&header->consumer_waiting, 0);
+      return NULL;
+    }
+
+    robj_shm_ring_wait (ring->data_fd,
+                        deadline < 0 ? -1 : deadline - g_get_monotonic_time ());
+    g_atomic_int_set (&header->consumer_waiting, 0);
+  }
+}
+
+void
+robj_shm_ring_consume (RObjShmRing *ring) {
+  RObjShmHeader *header = ring->header;
+
+  g_return_if_fail (ring->peeked != 0);
+
+  g_atomic_int_add (&header->tail, ring->peeked);
+  ring->peeked = 0;
+
+  if (g_atomic_int_get (&header->producer_waiting))
+    robj_shm_ring_signal (ring->space_fd);
+}
+
+guint8 *
+robj_shm_ring_blob_alloc (RObjShmRing *ring, gsize size, guint *blob_id) {
+  guint i;
+
+  g_return_val_if_fail (blob_id != NULL, NULL);
+
+  if (size > ring->blob_size)
+    return NULL;
+
+  /* Only the producer sets them, so no need to compare-and-swap */
+  for (i = 0; i < ring->n_blobs; i++) {
+    guint id = (ring->next_blob + i) % ring->n_blobs;
+
+    if (g_atomic_int_get (&ring->slots[id].used))
+      continue;
+
+    ring->slots[id].size = size;
+    g_atomic_int_set (&ring->slots[id].used, 1);
+    ring->next_blob = id + 1;
+
+    *blob_id = id;
+    return ring->blobs + id * ROBJ_SHM_ALIGN (ring->blob_size, ROBJ_SHM_PAGE);
+  }
+
+  return NULL;
+}
+
+const guint8 *
+robj_shm_ring_blob_get (RObjShmRing *ring, guint blob_id, gsize *size) {
+  g_return_val_if_fail (blob_id < ring->n_blobs, NULL);
+
+  if (!g_atomic_int_get (&ring->slots[blob_id].used)) {
+    g_critical ("Blob %u is not in use", blob_id);
+    return NULL;
+  }
+
+  if (size)
+    *size = MIN (ring->slots[blob_id].size, ring->blob_size);
+
+  return ring->blobs + blob_id * ROBJ_SHM_ALIGN (ring->blob_size, ROBJ_SHM_PAGE);
+}
+
+void
+robj_shm_ring_blob_release (RObjShmRing *ring, guint blob_id) {
+  g_return_if_fail (blob_id < ring->n_blobs);
+
+  g_atomic_int_set (&ring->slots[blob_id].used, 0);
+}
+
+typedef struct {
+  RObjShmRing *ring;
+  guint blob_id;
+} RObjShmBlobRef;
+
+static void
+robj_shm_ring_blob_ref_free (gpointer data) {
+  RObjShmBlobRef *ref = (RObjShmBlobRef *) data;
+
+  robj_shm_ring_blob_release (ref->ring, ref->blob_id);
+  robj_shm_ring_unref (ref->ring);
+  g_free (ref);
+}
+
+GBytes *
+robj_shm_ring_blob_to_bytes (RObjShmRing *ring, guint blob_id) {
+  RObjShmBlobRef *ref;
+  const guint8 *data;
+  gsize size;
+
+  data = robj_shm_ring_blob_get (ring, blob_id, &size);
+  if (data == NULL)
+    return NULL;
+
+  ref = g_new (RObjShmBlobRef, 1);
+  ref->ring = robj_shm_ring_ref (ring);
+  ref->blob_id = blob_id;
+
+  return g_bytes_new_with_free_func (data, size, robj_shm_ring_blob_ref_free,
+                                     ref);
+}
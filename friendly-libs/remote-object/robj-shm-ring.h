@@ -0,0 +1,71 @@
+#ifndef _ROBJ_SHM_RING_H
+#  define _ROBJ_SHM_RING_H
+
+#  include <glib-object.h>
+
+/* Transport for the processes of the same host.
+ * A single producer, single consumer ring of messages in a memfd, with an
+ * eventfd to wake up each side. The messages are copied only once, into the
+ * ring, and read in place. Big values, such as picture frames, go in the
+ * "blobs" of the same memfd, and the messages only carry their ids.
+ *
+ * One side creates the ring and passes the 3 fds to the other one, f.e. with
+ * SCM_RIGHTS, or to a child process. */
+
+typedef struct _RObjShmRing RObjShmRing;
+
+/* @size is rounded up to a power of 2 */
+RObjShmRing *robj_shm_ring_new (gsize size, guint n_blobs, gsize blob_size,
+                                GError ** err);
+
+/* Takes the ownership of the fds */
+RObjShmRing *robj_shm_ring_new_from_fds (gint memfd, gint data_fd,
+                                         gint space_fd, GError ** err);
+
+/* transfer-none */
+void robj_shm_ring_get_fds (RObjShmRing * ring, gint * memfd, gint * data_fd,
+                            gint * space_fd);
+
+RObjShmRing *robj_shm_ring_ref (RObjShmRing * ring);
+void robj_shm_ring_unref (RObjShmRing * ring);
+
+/* The biggest message that fits */
+gsize robj_shm_ring_get_max_message_size (RObjShmRing * ring);
+
+/* Producer side.
+ * The timeouts are in microseconds, -1 to wait forever, 0 to not wait at all.
+ * Returns where to write the message, or NULL if it didn't fit in time.
+ * Nothing is sent until commit. */
+guint8 *robj_shm_ring_reserve (RObjShmRing * ring, gsize size,
+                               gint64 timeout);
+/* @size can be smaller than the reserved one */
+void robj_shm_ring_commit (RObjShmRing * ring, gsize size);
+
+gboolean robj_shm_ring_write (RObjShmRing * ring, const guint8 * data,
+                              gsize size, gint64 timeout);
+
+/* Returns a free blob to write to, or NULL if all of them are in use.
+ * It belongs to the consumer once its id is sent. */
+guint8 *robj_shm_ring_blob_alloc (RObjShmRing * ring, gsize size,
+                                  guint * blob_id);
+
+/* Consumer side.
+ * Returns the next message, that stays valid until consume, or NULL. */
+const guint8 *robj_shm_ring_peek (RObjShmRing * ring, gsize * size,
+                                  gint64 timeout);
+void robj_shm_ring_consume (RObjShmRing * ring);
+
+/* Asks the producer to signal the data fd on the next message, to wait for
+ * it in a main loop. Returns FALSE if there's something to read already.
+ * The fd must be read to be cleared. */
+gboolean robj_shm_ring_prepare_wait (RObjShmRing * ring);
+
+/* Returns the blob until it's released, or NULL */
+const guint8 *robj_shm_ring_blob_get (RObjShmRing * ring, guint blob_id,
+                                      gsize * size);
+void robj_shm_ring_blob_release (RObjShmRing * ring, guint blob_id);
+
+/* The blob is released when the bytes are freed */
+GBytes *robj_shm_ring_blob_to_bytes (RObjShmRing * ring, guint blob_id);
+
+#endif
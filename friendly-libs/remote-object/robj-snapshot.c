@@ -0,0 +1,210 @@
+#include "robj-snapshot.h"
+#include <string.h>
+
+/* The snapshot is:
+   [snap] - magic, 4 bytes
+   [epoch] - 8 bytes BE, the versions are only comparable in the same one
+   [since] - varint, 0 if it has all the PNs
+   [version] - varint, the state is up to this version
+   [count] - varint, number of the PNs
+
+   for each PN, in the order of the ids:
+     [id delta] - varint, the id minus the id of the previous PN, or the id
+     for the first one
+     [value size] - varint, only if the PN is not a scalar
+     [value] - the same as in the PN message
+*/
+#define ROBJ_SNAPSHOT_MAGIC_LEN 4
+
+typedef struct {
+  GByteArray *buf;
+  guint32 prev_id;
+} RObjSnapshotWriter;
+
+static void
+robj_snapshot_write_pn (RObjPN *pn, gpointer user_data) {
+  RObjSnapshotWriter *writer = (RObjSnapshotWriter *) user_data;
+  GByteArray *buf = writer->buf;
+
+  robj_protocol_write_varint (buf, pn->id - writer->prev_id);
+  writer->prev_id = pn->id;
+
+  if (pn->scalar_size) {
+    guint len = buf->len;
+
+    g_byte_array_set_size (buf, len + pn->scalar_size);
+    robj_pn_read_scalar (pn, buf->data + len);
+  } else {
+    GValue tval = G_VALUE_INIT;
+    GBytes *bytes;
+    gsize size;
+    gconstpointer data;
+
+    g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+    if (G_UNLIKELY (!robj_pn_read_value (pn, &tval))) {
+      /* Should never happen since the types are already negotiated */
+      g_critical ("Could not transform %s", pn->pname);
+      robj_protocol_write_varint (buf, 0);
+      g_value_unset (&tval);
+      return;
+    }
+
+    bytes = g_value_get_boxed (&tval);
+    data = g_bytes_get_data (bytes, &size);
+    robj_protocol_write_varint (buf, size);
+    g_byte_array_append (buf, data, size);
+    g_value_unset (&tval);
+  }
+}
+
+guint64
+robj_snapshot_write (RObjMap *map, guint32 o_id, guint64 since,
+                     GByteArray *buf) {
+  RObjSnapshotWriter writer = {.buf = buf };
+  GByteArray *body;
+  guint64 version;
+  guint64 epoch_be;
+  guint n;
+
+  g_return_val_if_fail (map != NULL, 0);
+  g_return_val_if_fail (buf != NULL, 0);
+
+  /* The count is known only in the end. The version is taken under the
+   * same lock as the PNs are looked at, so the writes that miss this
+   * snapshot are all after it and are sent the next time. */
+  body = g_byte_array_new ();
+  writer.buf = body;
+  n = robj_map_foreach_changed (map, o_id, since, robj_snapshot_write_pn,
+                                &writer, &version);
+
+  g_byte_array_append (buf, (const guint8 *) "snap", ROBJ_SNAPSHOT_MAGIC_LEN);
+  epoch_be = GUINT64_TO_BE (map->epoch);
+  g_byte_array_append (buf, (const guint8 *) &epoch_be, 8);
+  robj_protocol_write_varint (buf, since);
+  robj_protocol_write_varint (buf, version);
+  robj_protocol_write_varint (buf, n);
+  g_byte_array_append (buf, body->data, body->len);
+  g_byte_array_unref (body);
+
+  return version;
+}
+
+static gboolean
+robj_snapshot_read_header (const guint8 **ptr, const guint8 *end,
+                           guint64 *epoch, guint64 *since, guint64 *version,
+                           guint64 *count) {
+  guint64 epoch_be;
+
+  if (end - *ptr < ROBJ_SNAPSHOT_MAGIC_LEN + 8
+      || memcmp (*ptr, "snap", ROBJ_SNAPSHOT_MAGIC_LEN))
+    return FALSE;
+
+  memcpy (&epoch_be, *ptr + ROBJ_SNAPSHOT_MAGIC_LEN, 8);
+  *epoch = GUINT64_FROM_BE (epoch_be);
+  *ptr += ROBJ_SNAPSHOT_MAGIC_LEN + 8;
+
+  return robj_protocol_read_varint (ptr, end, since)
+      && robj_protocol_read_varint (ptr, end, version)
+      && robj_protocol_read_varint (ptr, end, count);
+}
+
+gboolean
+robj_snapshot_parse_header (const guint8 *data, gsize size, guint64 *epoch,
+                            guint64 *since, guint64 *version) {
+  guint64 count;
+
+  g_return_val_if_fail (data != NULL, FALSE);
+
+  return robj_snapshot_read_header (&data, data + size, epoch, since, version,
+                                    &count);
+}
+
+/* NOTE: called in a read section of the map */
+static gint
+robj_snapshot_read_entries (RObjMap *map, const guint8 *data, gsize size,
+                            RObjPNFunc func, gpointer user_data) {
+  const guint8 *ptr = data;
+  const guint8 *end = data + size;
+  guint64 epoch,
+    since,
+    version,
+    count,
+    i;
+  guint64 id = 0;
+
+  g_return_val_if_fail (map != NULL, -1);
+  g_return_val_if_fail (data != NULL, -1);
+
+  if (!robj_snapshot_read_header (&ptr, end, &epoch, &since, &version, &count)) {
+    g_warning ("Broken snapshot header");
+    return -1;
+  }
+
+  for (i = 0; i < count; i++) {
+    guint64 delta;
+    RObjPN *pn;
+
+    if (!robj_protocol_read_varint (&ptr, end, &delta)
+        || (id += delta) > G_MAXUINT32)
+      goto broken;
+
+    pn = robj_map_lookup_pn (map, id);
+    if (G_UNLIKELY (pn == NULL)) {
+      g_warning ("PN %" G_GUINT64_FORMAT " of the snapshot not found", id);
+      return -1;
+    }
+
+    if (pn->scalar_size) {
+      if (end - ptr < pn->scalar_size)
+        goto broken;
+
+      robj_pn_write_scalar (pn, ptr);
+      ptr += pn->scalar_size;
+    } else {
+      GValue tval = G_VALUE_INIT;
+      guint64 vsize;
+
+      if (!robj_protocol_read_varint (&ptr, end, &vsize) || end - ptr < vsize)
+        goto broken;
+
+      /* The PNs that couldn't be transformed on the other side */
+      if (vsize == 0)
+        continue;
+
+      g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+      g_value_take_boxed (&tval, g_bytes_new (ptr, vsize));
+      ptr += vsize;
+      if (!robj_pn_write_value (pn, &tval)) {
+        g_warning ("Could not transform %s", pn->pname);
+        g_value_unset (&tval);
+        return -1;
+      }
+      g_value_unset (&tval);
+    }
+
+    if (func)
+      func (pn, user_data);
+  }
+
+  if (ptr != end)
+    goto broken;
+
+  return count;
+
+broken:
+  g_warning ("Broken snapshot");
+  return -1;
+}
+
+gint
+robj_snapshot_read (RObjMap *map, const guint8 *data, gsize size,
+                    RObjPNFunc func, gpointer user_data) {
+  gint ret;
+
+  /* The PNs can't be freed under our feet, and @func can use them */
+  robj_map_read_begin (map);
+  ret = robj_snapshot_read_entries (map, data, size, func, user_data);
+  robj_map_read_end (map);
+
+  return ret;
+}
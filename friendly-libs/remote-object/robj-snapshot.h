@@ -0,0 +1,29 @@
+#ifndef _ROBJ_SNAPSHOT_H
+#  define _ROBJ_SNAPSHOT_H
+
+#  include "robj-protocol.h"
+
+/* The values of the PNs of an object, all of them for a cold start, or only
+ * the ones that changed since some version, for a client that had the
+ * state already and reconnects. It's the same thing a client can save, and
+ * then load on the next start, to ask only for what it missed. */
+
+/* Appends the snapshot to @buf. The PNs written after @since, 0 - all.
+ * Returns the version the snapshot is up to, the client asks for the
+ * changes since it the next time. */
+guint64 robj_snapshot_write (RObjMap * map, guint32 o_id, guint64 since,
+                             GByteArray * buf);
+
+/* Reads the header, without applying anything. Returns FALSE if it's
+ * not a snapshot. */
+gboolean robj_snapshot_parse_header (const guint8 * data, gsize size,
+                                     guint64 * epoch, guint64 * since,
+                                     guint64 * version);
+
+/* Updates the values of the PNs in the snapshot, and calls @func for each
+ * one, if it's not NULL. Returns the number of PNs updated, or -1 if the
+ * snapshot is broken. */
+gint robj_snapshot_read (RObjMap * map, const guint8 * data, gsize size,
+                         RObjPNFunc func, gpointer user_data);
+
+#endif
@@ -0,0 +1,167 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Sends a number of integer properties of an object that change every
+ * round, one message per PN and in batches, and prints how many PNs per
+ * second go through the encoder and the decoder, and how many bytes each
+ * one takes.
+ *
+ * Usage: robj-bench-batch [rounds] [properties] */
+
+#include "../robj-protocol.h"
+#include "../robj-batch.h"
+#include <stdlib.h>
+
+typedef struct {
+  RObjMap *map;
+  RObjBatchReader reader;
+  guint64 bytes;
+} BenchReceiver;
+
+static void
+bench_flush_cb (const guint8 *frame, gsize size, gpointer user_data) {
+  BenchReceiver *recv = (BenchReceiver *) user_data;
+
+  recv->bytes += size;
+  robj_batch_reader_parse (&recv->reader, recv->map, frame, size, NULL, NULL);
+}
+
+static void
+bench_change (RObjPN **pns, guint n_props, guint round) {
+  guint i;
+
+  /* Like a scene: a few things move a little, the rest stays */
+  for (i = 0; i < n_props; i += 4) {
+    GValue pval = G_VALUE_INIT;
+
+    g_value_init (&pval, G_TYPE_INT);
+    robj_pn_read_value (pns[i], &pval);
+    g_value_set_int (&pval, g_value_get_int (&pval) + round % 7);
+    robj_pn_write_value (pns[i], &pval);
+  }
+}
+
+static void
+bench_report (const gchar *name, guint64 n_pns, guint64 bytes, gint64 elapsed) {
+  g_print ("%-16s %12.0f PN/s %8.2f bytes/PN\n", name,
+           n_pns * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1),
+           bytes / (gdouble) n_pns);
+}
+
+static void
+bench_single (RObjMap *recv_map, RObjPN **pns, guint n_props, guint rounds) {
+  guint64 bytes = 0;
+  gint64 start;
+  guint r,
+    i;
+
+  start = g_get_monotonic_time ();
+  for (r = 0; r < rounds; r++) {
+    bench_change (pns, n_props, r);
+
+    for (i = 0; i < n_props; i++) {
+      GBytes *msg = robj_protocol_pn_to_message (pns[i]);
+
+      bytes += g_bytes_get_size (msg);
+      robj_protocol_message_to_pn (recv_map, msg);
+      g_bytes_unref (msg);
+    }
+  }
+
+  bench_report ("single", (guint64) rounds * n_props, bytes,
+                g_get_monotonic_time () - start);
+}
+
+static void
+bench_batch (const gchar *name, RObjBatchFlags flags, RObjMap *recv_map,
+             RObjPN **pns, guint n_props, guint rounds) {
+  RObjBatchWriter writer;
+  BenchReceiver recv = {.map = recv_map };
+  gint64 start;
+  guint r,
+    i;
+
+  robj_batch_reader_init (&recv.reader);
+  robj_batch_writer_init (&writer, flags, 1400, 0, bench_flush_cb, &recv);
+
+  start = g_get_monotonic_time ();
+  for (r = 0; r < rounds; r++) {
+    bench_change (pns, n_props, r);
+
+    for (i = 0; i < n_props; i++)
+      robj_batch_writer_add (&writer, pns[i]);
+    robj_batch_writer_flush (&writer);
+  }
+
+  bench_report (name, (guint64) rounds * n_props, recv.bytes,
+                g_get_monotonic_time () - start);
+
+  robj_batch_writer_clear (&writer);
+  robj_batch_reader_clear (&recv.reader);
+}
+
+int
+main (int argc, char *argv[]) {
+  guint rounds = argc > 1 ? atoi (argv[1]) : 20000;
+  guint n_props = argc > 2 ? atoi (argv[2]) : 32;
+  RObjMap send_map,
+    recv_map;
+  RObjPN **pns;
+  guint32 o_id;
+  guint i;
+
+  robj_protocol_init ();
+  robj_map_init (&send_map);
+  robj_map_init (&recv_map);
+  o_id = robj_map_add_object (&send_map, "foo");
+  robj_map_add_object (&recv_map, "foo");
+
+  pns = g_new (RObjPN *, n_props);
+  for (i = 0; i < n_props; i++) {
+    GValue pval = G_VALUE_INIT;
+    gchar *name = g_strdup_printf ("prop-%u", i);
+
+    g_value_init (&pval, G_TYPE_INT);
+    g_value_set_int (&pval, i * 1000);
+    pns[i] = robj_map_new_pn (&send_map, o_id, name, &pval);
+    robj_map_new_pn (&recv_map, o_id, name, &pval);
+
+    g_value_unset (&pval);
+    g_free (name);
+  }
+
+  g_print ("rounds: %u properties: %u\n", rounds, n_props);
+  bench_single (&recv_map, pns, n_props, rounds);
+  bench_batch ("batch", 0, &recv_map, pns, n_props, rounds);
+  bench_batch ("batch-delta", ROBJ_BATCH_DELTA | ROBJ_BATCH_SKIP_UNCHANGED,
+               &recv_map, pns, n_props, rounds);
+
+  g_free (pns);
+  robj_map_clear (&send_map);
+  robj_map_clear (&recv_map);
+  return 0;
+}
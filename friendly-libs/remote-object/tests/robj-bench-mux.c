@@ -0,0 +1,339 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Broadcasts to many clients on the loopback, with the mux, and with a
+ * blocking write of each message to each socket, like a byte stream does.
+ * One thread reads all the clients and checks the order of the messages.
+ *
+ * Usage: robj-bench-mux [clients] [messages] [message size] */
+
+#include "../robj-mux.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/* Flushed every this many messages, like a burst of notifies */
+#define BENCH_BURST 32
+/* The producer waits when the queues get this big */
+#define BENCH_HIGH_WATER (1 << 20)
+
+typedef struct {
+  guint n_clients;
+  guint n;
+  gsize size;
+  gint *fds;
+  GPtrArray *clients;
+} Bench;
+
+typedef struct {
+  guint8 *buf;
+  gsize len;
+  guint32 next;
+} BenchReader;
+
+static gpointer
+bench_reader (gpointer data) {
+  Bench *bench = (Bench *) data;
+  BenchReader *readers = g_new0 (BenchReader, bench->n_clients);
+  gsize buf_size = 1 << 16;
+  guint done = 0;
+  gint epfd;
+  guint i;
+
+  epfd = epoll_create1 (EPOLL_CLOEXEC);
+  for (i = 0; i < bench->n_clients; i++) {
+    struct epoll_event ev = {.events = EPOLLIN,.data.u32 = i };
+
+    readers[i].buf = g_malloc (buf_size);
+    epoll_ctl (epfd, EPOLL_CTL_ADD, bench->fds[i], &ev);
+  }
+
+  while (done < bench->n_clients) {
+    struct epoll_event evs[64];
+    gint n = epoll_wait (epfd, evs, G_N_ELEMENTS (evs), 5000);
+    gint k;
+
+    if (n <= 0)
+      g_error ("The clients got stuck");
+
+    for (k = 0; k < n; k++) {
+      BenchReader *r = &readers[evs[k].data.u32];
+      gsize off = 0;
+      gssize ret;
+
+      ret = read (bench->fds[evs[k].data.u32], r->buf + r->len,
+                  buf_size - r->len);
+      if (ret <= 0)
+        g_error ("Couldn't read from the client");
+      r->len += ret;
+
+      while (r->len - off >= 4) {
+        guint32 size;
+        guint32 seq;
+
+        memcpy (&size, r->buf + off, 4);
+        size = GUINT32_FROM_BE (size);
+        if (size != bench->size)
+          g_error ("Wrong message size %u", size);
+        if (r->len - off - 4 < size)
+          break;
+
+        memcpy (&seq, r->buf + off + 4, 4);
+        if (seq != r->next)
+          g_error ("Message %u came instead of %u", seq, r->next);
+        r->next++;
+        if (r->next == bench->n)
+          done++;
+        off += 4 + size;
+      }
+
+      memmove (r->buf, r->buf + off, r->len - off);
+      r->len -= off;
+    }
+  }
+
+  for (i = 0; i < bench->n_clients; i++)
+    g_free (readers[i].buf);
+  g_free (readers);
+  close (epfd);
+
+  return NULL;
+}
+
+static void
+bench_report (const gchar *name, Bench *bench, gint64 elapsed) {
+  gdouble total = bench->n_clients * (gdouble) bench->n;
+
+  elapsed = MAX (elapsed, 1);
+  g_print ("%-22s %12.0f msg/s %10.1f MB/s\n", name,
+           total * G_USEC_PER_SEC / elapsed,
+           total * (bench->size + 4) / elapsed);
+}
+
+static void
+bench_event (RObjMux *mux, RObjMuxClient *client, RObjMuxEvent event,
+             gpointer user_data) {
+  Bench *bench = (Bench *) user_data;
+
+  switch (event) {
+  case ROBJ_MUX_EVENT_CONNECTED:
+    g_ptr_array_add (bench->clients, client);
+    break;
+  case ROBJ_MUX_EVENT_RESYNC:
+    g_error ("The bench is not supposed to drop messages");
+    break;
+  case ROBJ_MUX_EVENT_CLOSED:
+    g_ptr_array_remove_fast (bench->clients, client);
+    break;
+  }
+}
+
+static gint
+bench_listen (struct sockaddr_in *addr) {
+  socklen_t len = sizeof (*addr);
+  gint fd;
+
+  memset (addr, 0, sizeof (*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  fd = socket (AF_INET, SOCK_STREAM, 0);
+  if (fd < 0 || bind (fd, (struct sockaddr *) addr, len) < 0
+      || listen (fd, 1024) < 0
+      || getsockname (fd, (struct sockaddr *) addr, &len) < 0)
+    g_error ("Couldn't listen on the loopback");
+
+  return fd;
+}
+
+static void
+bench_connect (Bench *bench, struct sockaddr_in *addr) {
+  guint i;
+
+  for (i = 0; i < bench->n_clients; i++) {
+    bench->fds[i] = socket (AF_INET, SOCK_STREAM, 0);
+    if (connect (bench->fds[i], (struct sockaddr *) addr, sizeof (*addr)) < 0)
+      g_error ("Couldn't connect");
+  }
+}
+
+static void
+bench_disconnect (Bench *bench) {
+  guint i;
+
+  for (i = 0; i < bench->n_clients; i++)
+    close (bench->fds[i]);
+}
+
+static void
+bench_mux (Bench *bench) {
+  struct sockaddr_in addr;
+  guint8 *msg = g_malloc0 (bench->size);
+  GError *err = NULL;
+  GThread *thread;
+  RObjMux *mux;
+  gint64 start;
+  gint lfd;
+  guint i;
+
+  mux = robj_mux_new (0, bench_event, NULL, bench, &err);
+  if (!mux)
+    g_error ("Couldn't create the mux: %s", err->message);
+
+  lfd = bench_listen (&addr);
+  if (!robj_mux_listen (mux, lfd, &err))
+    g_error ("Couldn't listen: %s", err->message);
+
+  bench_connect (bench, &addr);
+  while (bench->clients->len < bench->n_clients)
+    robj_mux_dispatch (mux, 100);
+
+  thread = g_thread_new ("reader", bench_reader, bench);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < bench->n; i++) {
+    GBytes *bytes;
+
+    memcpy (msg, &i, 4);
+    bytes = g_bytes_new (msg, bench->size);
+    robj_mux_broadcast (mux, bytes);
+    g_bytes_unref (bytes);
+
+    if (i % BENCH_BURST != BENCH_BURST - 1 && i != bench->n - 1)
+      continue;
+
+    robj_mux_flush (mux);
+    for (;;) {
+      gsize max_queued = 0;
+      guint k;
+
+      for (k = 0; k < bench->clients->len; k++)
+        max_queued = MAX (max_queued,
+                          robj_mux_client_get_queued
+                          (bench->clients->pdata[k]));
+
+      if (max_queued < BENCH_HIGH_WATER)
+        break;
+      robj_mux_dispatch (mux, 10);
+    }
+  }
+
+  /* The last of it goes out while the reader is still reading */
+  for (;;) {
+    gsize queued = 0;
+    guint k;
+
+    for (k = 0; k < bench->clients->len; k++)
+      queued += robj_mux_client_get_queued (bench->clients->pdata[k]);
+    if (!queued)
+      break;
+    robj_mux_dispatch (mux, 10);
+  }
+  g_thread_join (thread);
+  bench_report ("mux", bench, g_get_monotonic_time () - start);
+
+  robj_mux_free (mux);
+  g_ptr_array_set_size (bench->clients, 0);
+  bench_disconnect (bench);
+  close (lfd);
+  g_free (msg);
+}
+
+static void
+bench_blocking (Bench *bench) {
+  struct sockaddr_in addr;
+  guint8 *msg = g_malloc0 (4 + bench->size);
+  guint32 size_be = GUINT32_TO_BE (bench->size);
+  gint *server_fds = g_new (gint, bench->n_clients);
+  GThread *thread;
+  gint64 start;
+  gint lfd;
+  guint i;
+
+  lfd = bench_listen (&addr);
+  bench_connect (bench, &addr);
+  for (i = 0; i < bench->n_clients; i++) {
+    server_fds[i] = accept (lfd, NULL, NULL);
+    if (server_fds[i] < 0)
+      g_error ("Couldn't accept");
+  }
+
+  memcpy (msg, &size_be, 4);
+  thread = g_thread_new ("reader", bench_reader, bench);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < bench->n; i++) {
+    guint k;
+
+    memcpy (msg + 4, &i, 4);
+    for (k = 0; k < bench->n_clients; k++) {
+      gsize off = 0;
+
+      while (off < 4 + bench->size) {
+        gssize ret = write (server_fds[k], msg + off, 4 + bench->size - off);
+
+        if (ret <= 0)
+          g_error ("Couldn't write to the client");
+        off += ret;
+      }
+    }
+  }
+  g_thread_join (thread);
+  bench_report ("blocking write", bench, g_get_monotonic_time () - start);
+
+  for (i = 0; i < bench->n_clients; i++)
+    close (server_fds[i]);
+  bench_disconnect (bench);
+  close (lfd);
+  g_free (server_fds);
+  g_free (msg);
+}
+
+int
+main (int argc, char *argv[]) {
+  Bench bench = { 0 };
+
+  bench.n_clients = argc > 1 ? atoi (argv[1]) : 128;
+  bench.n = argc > 2 ? atoi (argv[2]) : 20000;
+  bench.size = argc > 3 ? atoi (argv[3]) : 64;
+  /* The sequence number goes in the message */
+  bench.size = MAX (bench.size, 4);
+  bench.fds = g_new (gint, bench.n_clients);
+  bench.clients = g_ptr_array_new ();
+
+  g_print ("%u clients, messages: %u of %" G_GSIZE_FORMAT " bytes\n",
+           bench.n_clients, bench.n, bench.size);
+  bench_mux (&bench);
+  bench_blocking (&bench);
+
+  g_ptr_array_unref (bench.clients);
+  g_free (bench.fds);
+
+  return 0;
+}
@@ -0,0 +1,182 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Encodes and decodes property notifies of different types in one thread,
+ * and prints how many messages per second a core gets through. The scalars
+ * go in place, the "transform" rows do the same through the ROBJ transport
+ * GBytes, as every type did before, for the comparison.
+ *
+ * Usage: robj-bench-pn [messages] */
+
+#include "../robj-protocol.h"
+#include <stdlib.h>
+
+static void
+bench_report (const gchar *name, guint n, gint64 elapsed) {
+  g_print ("%-24s %12.0f msg/s\n", name,
+           n * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1));
+}
+
+static void
+bench_messages (const gchar *name, RObjMap *recv_map, RObjPN *pn, guint n) {
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++) {
+    GBytes *msg = robj_protocol_pn_to_message (pn);
+
+    robj_protocol_message_to_pn (recv_map, msg);
+    g_bytes_unref (msg);
+  }
+
+  bench_report (name, n, g_get_monotonic_time () - start);
+}
+
+/* Many messages in one buffer, like on a stream */
+static void
+bench_buffer (const gchar *name, RObjMap *recv_map, RObjPN *pn, guint n) {
+  GByteArray *buf = g_byte_array_sized_new (64 * 1024);
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++) {
+    guint len = buf->len;
+    GBytes *msg;
+
+    robj_protocol_write_pn (pn, buf);
+
+    msg = g_bytes_new_static (buf->data + len, buf->len - len);
+    robj_protocol_message_to_pn (recv_map, msg);
+    g_bytes_unref (msg);
+
+    if (buf->len > 60 * 1024)
+      g_byte_array_set_size (buf, 0);
+  }
+
+  bench_report (name, n, g_get_monotonic_time () - start);
+  g_byte_array_unref (buf);
+}
+
+/* What the scalars did before: the value goes through the transport GBytes
+ * on both sides */
+static void
+bench_transform (const gchar *name, RObjPN *send_pn, RObjPN *recv_pn, guint n) {
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++) {
+    GValue tval = G_VALUE_INIT;
+    GBytes *bval;
+    GBytes *msg;
+    GByteArray *arr;
+    guint8 header[2 + ROBJ_PROTOCOL_VARINT_MAX] = { 'p', 'n' };
+    guint header_len;
+
+    g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+    robj_pn_read_value (send_pn, &tval);
+    bval = g_value_get_boxed (&tval);
+
+    header_len = 2 + robj_protocol_put_varint (header + 2, send_pn->id);
+    arr = g_byte_array_sized_new (header_len + g_bytes_get_size (bval));
+    g_byte_array_append (arr, header, header_len);
+    g_byte_array_append (arr, g_bytes_get_data (bval, NULL),
+                         g_bytes_get_size (bval));
+    g_value_unset (&tval);
+    msg = g_byte_array_free_to_bytes (arr);
+
+    g_value_init (&tval, ROBJ_TRANSPORT_TYPE);
+    g_value_take_boxed (&tval, g_bytes_new_from_bytes (msg, header_len,
+                                                       g_bytes_get_size (msg) -
+                                                       header_len));
+    robj_pn_write_value (recv_pn, &tval);
+    g_value_unset (&tval);
+    g_bytes_unref (msg);
+  }
+
+  bench_report (name, n, g_get_monotonic_time () - start);
+}
+
+int
+main (int argc, char *argv[]) {
+  guint n = argc > 1 ? atoi (argv[1]) : 2000000;
+  RObjMap send_map,
+    recv_map;
+  guint32 o_id;
+  struct {
+    const gchar *name;
+    GType type;
+    RObjPN *send_pn;
+    RObjPN *recv_pn;
+  } props[] = {
+    { "boolean", G_TYPE_BOOLEAN },
+    { "int", G_TYPE_INT },
+    { "uint64", G_TYPE_UINT64 },
+    { "double", G_TYPE_DOUBLE },
+    { "string", G_TYPE_STRING },
+  };
+  guint i;
+
+  robj_protocol_init ();
+  robj_map_init (&send_map);
+  robj_map_init (&recv_map);
+  o_id = robj_map_add_object (&send_map, "foo");
+  robj_map_add_object (&recv_map, "foo");
+
+  for (i = 0; i < G_N_ELEMENTS (props); i++) {
+    GValue pval = G_VALUE_INIT;
+
+    g_value_init (&pval, props[i].type);
+    if (props[i].type == G_TYPE_STRING)
+      g_value_set_static_string (&pval, "some label of a button");
+
+    props[i].send_pn = robj_map_new_pn (&send_map, o_id, props[i].name, &pval);
+    props[i].recv_pn = robj_map_new_pn (&recv_map, o_id, props[i].name, &pval);
+    g_value_unset (&pval);
+  }
+
+  g_print ("messages: %u, one thread\n", n);
+  for (i = 0; i < G_N_ELEMENTS (props); i++) {
+    gchar *name;
+
+    bench_messages (props[i].name, &recv_map, props[i].send_pn, n);
+
+    name = g_strdup_printf ("%s buffer", props[i].name);
+    bench_buffer (name, &recv_map, props[i].send_pn, n);
+    g_free (name);
+
+    name = g_strdup_printf ("%s transform", props[i].name);
+    bench_transform (name, props[i].send_pn, props[i].recv_pn, n);
+    g_free (name);
+  }
+
+  robj_map_clear (&send_map);
+  robj_map_clear (&recv_map);
+  return 0;
+}
@@ -0,0 +1,377 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Compares the shared memory ring with a Unix socket, between two threads.
+ * Prints the message rate, the round trip time of a ping-pong, and the rate
+ * of big frames, that go by reference in the ring and are copied through
+ * the socket.
+ *
+ * Usage: robj-bench-shm [messages] [message size] */
+
+#include "../robj-shm-ring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#define BENCH_RING_SIZE (1 << 20)
+#define BENCH_FRAME_SIZE (1920 * 1080 * 4)
+#define BENCH_N_FRAMES 200
+#define BENCH_N_PINGS 100000
+
+typedef struct {
+  RObjShmRing *ring;
+  gint fd;
+  guint n;
+  gsize size;
+} BenchPeer;
+
+static gboolean
+bench_read_all (gint fd, guint8 *buf, gsize size) {
+  while (size) {
+    gssize ret = read (fd, buf, size);
+
+    if (ret <= 0)
+      return FALSE;
+    buf += ret;
+    size -= ret;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+bench_write_all (gint fd, const guint8 *buf, gsize size) {
+  while (size) {
+    gssize ret = write (fd, buf, size);
+
+    if (ret <= 0)
+      return FALSE;
+    buf += ret;
+    size -= ret;
+  }
+
+  return TRUE;
+}
+
+/* Size prefixed messages, one write each, like a byte stream does */
+static void
+bench_socket_send (gint fd, const guint8 *msg, gsize size) {
+  guint8 *buf = g_malloc (4 + size);
+  guint32 size32 = size;
+
+  memcpy (buf, &size32, 4);
+  memcpy (buf + 4, msg, size);
+  if (!bench_write_all (fd, buf, 4 + size))
+    g_error ("Couldn't write to the socket");
+  g_free (buf);
+}
+
+static guint8 *
+bench_socket_recv (gint fd, gsize *size) {
+  guint32 size32;
+  guint8 *buf;
+
+  if (!bench_read_all (fd, (guint8 *) & size32, 4))
+    g_error ("Couldn't read from the socket");
+
+  buf = g_malloc (size32);
+  if (!bench_read_all (fd, buf, size32))
+    g_error ("Couldn't read from the socket");
+
+  *size = size32;
+  return buf;
+}
+
+static gpointer
+bench_ring_consumer (gpointer data) {
+  BenchPeer *peer = (BenchPeer *) data;
+  guint i;
+
+  for (i = 0; i < peer->n; i++) {
+    gsize size;
+
+    robj_shm_ring_peek (peer->ring, &size, -1);
+    robj_shm_ring_consume (peer->ring);
+  }
+
+  return NULL;
+}
+
+static gpointer
+bench_socket_consumer (gpointer data) {
+  BenchPeer *peer = (BenchPeer *) data;
+  guint i;
+
+  for (i = 0; i < peer->n; i++) {
+    gsize size;
+
+    g_free (bench_socket_recv (peer->fd, &size));
+  }
+
+  return NULL;
+}
+
+static void
+bench_report_rate (const gchar *name, guint n, gint64 elapsed) {
+  g_print ("%-22s %12.0f msg/s\n", name,
+           n * (gdouble) G_USEC_PER_SEC / MAX (elapsed, 1));
+}
+
+static RObjShmRing *
+bench_ring_pair (RObjShmRing **other, gsize blob_size) {
+  RObjShmRing *ring;
+  GError *err = NULL;
+  gint memfd,
+    data_fd,
+    space_fd;
+
+  ring = robj_shm_ring_new (BENCH_RING_SIZE, blob_size ? 4 : 0, blob_size, &err);
+  if (!ring)
+    g_error ("Couldn't create the ring: %s", err->message);
+
+  /* As if they were passed to another process */
+  robj_shm_ring_get_fds (ring, &memfd, &data_fd, &space_fd);
+  *other = robj_shm_ring_new_from_fds (dup (memfd), dup (data_fd),
+                                       dup (space_fd), &err);
+  if (!*other)
+    g_error ("Couldn't open the ring: %s", err->message);
+
+  return ring;
+}
+
+static void
+bench_rate (guint n, gsize size) {
+  RObjShmRing *producer;
+  BenchPeer peer = {.n = n,.size = size };
+  guint8 *msg = g_malloc0 (size);
+  GThread *thread;
+  gint64 start;
+  gint fds[2];
+  guint i;
+
+  producer = bench_ring_pair (&peer.ring, 0);
+  thread = g_thread_new ("consumer", bench_ring_consumer, &peer);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++)
+    robj_shm_ring_write (producer, msg, size, -1);
+  g_thread_join (thread);
+  bench_report_rate ("shm ring", n, g_get_monotonic_time () - start);
+  robj_shm_ring_unref (producer);
+  robj_shm_ring_unref (peer.ring);
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    g_error ("socketpair failed");
+
+  peer.fd = fds[1];
+  thread = g_thread_new ("consumer", bench_socket_consumer, &peer);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < n; i++)
+    bench_socket_send (fds[0], msg, size);
+  g_thread_join (thread);
+  bench_report_rate ("unix socket", n, g_get_monotonic_time () - start);
+  close (fds[0]);
+  close (fds[1]);
+
+  g_free (msg);
+}
+
+static gpointer
+bench_ring_ponger (gpointer data) {
+  RObjShmRing **rings = (RObjShmRing **) data;
+  guint i;
+
+  for (i = 0; i < BENCH_N_PINGS; i++) {
+    const guint8 *msg;
+    gsize size;
+
+    msg = robj_shm_ring_peek (rings[0], &size, -1);
+    robj_shm_ring_write (rings[1], msg, size, -1);
+    robj_shm_ring_consume (rings[0]);
+  }
+
+  return NULL;
+}
+
+static gpointer
+bench_socket_ponger (gpointer data) {
+  gint fd = GPOINTER_TO_INT (data);
+  guint i;
+
+  for (i = 0; i < BENCH_N_PINGS; i++) {
+    guint8 *msg;
+    gsize size;
+
+    msg = bench_socket_recv (fd, &size);
+    bench_socket_send (fd, msg, size);
+    g_free (msg);
+  }
+
+  return NULL;
+}
+
+static void
+bench_report_latency (const gchar *name, gint64 elapsed) {
+  g_print ("%-22s %12.2f us round trip\n", name,
+           elapsed / (gdouble) BENCH_N_PINGS);
+}
+
+static void
+bench_latency (gsize size) {
+  RObjShmRing *ping,
+   *pong,
+   *rings[2];
+  guint8 *msg = g_malloc0 (size);
+  GThread *thread;
+  gint64 start;
+  gint fds[2];
+  guint i;
+
+  ping = bench_ring_pair (&rings[0], 0);
+  pong = bench_ring_pair (&rings[1], 0);
+  thread = g_thread_new ("ponger", bench_ring_ponger, rings);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_N_PINGS; i++) {
+    gsize pong_size;
+
+    robj_shm_ring_write (ping, msg, size, -1);
+    robj_shm_ring_peek (pong, &pong_size, -1);
+    robj_shm_ring_consume (pong);
+  }
+  g_thread_join (thread);
+  bench_report_latency ("shm ring", g_get_monotonic_time () - start);
+  robj_shm_ring_unref (ping);
+  robj_shm_ring_unref (pong);
+  robj_shm_ring_unref (rings[0]);
+  robj_shm_ring_unref (rings[1]);
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    g_error ("socketpair failed");
+
+  thread = g_thread_new ("ponger", bench_socket_ponger, GINT_TO_POINTER (fds[1]));
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_N_PINGS; i++) {
+    gsize pong_size;
+
+    bench_socket_send (fds[0], msg, size);
+    g_free (bench_socket_recv (fds[0], &pong_size));
+  }
+  g_thread_join (thread);
+  bench_report_latency ("unix socket", g_get_monotonic_time () - start);
+  close (fds[0]);
+  close (fds[1]);
+
+  g_free (msg);
+}
+
+static gpointer
+bench_blob_consumer (gpointer data) {
+  BenchPeer *peer = (BenchPeer *) data;
+  guint i;
+
+  for (i = 0; i < peer->n; i++) {
+    const guint8 *msg;
+    guint32 blob_id;
+    gsize size;
+    GBytes *frame;
+
+    msg = robj_shm_ring_peek (peer->ring, &size, -1);
+    memcpy (&blob_id, msg, 4);
+    robj_shm_ring_consume (peer->ring);
+
+    /* The frame is in use until the bytes are freed */
+    frame = robj_shm_ring_blob_to_bytes (peer->ring, blob_id);
+    g_bytes_unref (frame);
+  }
+
+  return NULL;
+}
+
+static void
+bench_frames (void) {
+  RObjShmRing *producer;
+  BenchPeer peer = {.n = BENCH_N_FRAMES };
+  guint8 *frame = g_malloc0 (BENCH_FRAME_SIZE);
+  GThread *thread;
+  gint64 start;
+  gint fds[2];
+  guint i;
+
+  producer = bench_ring_pair (&peer.ring, BENCH_FRAME_SIZE);
+  thread = g_thread_new ("consumer", bench_blob_consumer, &peer);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_N_FRAMES; i++) {
+    guint8 *blob;
+    guint blob_id;
+    guint32 id32;
+
+    /* Rendered straight into the shared memory */
+    while (!(blob = robj_shm_ring_blob_alloc (producer, BENCH_FRAME_SIZE,
+                                              &blob_id)))
+      g_thread_yield ();
+    blob[0] = i;
+
+    id32 = blob_id;
+    robj_shm_ring_write (producer, (guint8 *) & id32, 4, -1);
+  }
+  g_thread_join (thread);
+  bench_report_rate ("shm ring frames", BENCH_N_FRAMES,
+                     g_get_monotonic_time () - start);
+  robj_shm_ring_unref (producer);
+  robj_shm_ring_unref (peer.ring);
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    g_error ("socketpair failed");
+
+  peer.fd = fds[1];
+  thread = g_thread_new ("consumer", bench_socket_consumer, &peer);
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_N_FRAMES; i++) {
+    frame[0] = i;
+    bench_socket_send (fds[0], frame, BENCH_FRAME_SIZE);
+  }
+  g_thread_join (thread);
+  bench_report_rate ("unix socket frames", BENCH_N_FRAMES,
+                     g_get_monotonic_time () - start);
+  close (fds[0]);
+  close (fds[1]);
+
+  g_free (frame);
+}
+
+int
+main (int argc, char *argv[]) {
+  guint n = argc > 1 ? atoi (argv[1]) : 1000000;
+  gsize size = argc > 2 ? atoi (argv[2]) : 64;
+
+  g_print ("messages: %u of %" G_GSIZE_FORMAT " bytes\n", n, size);
+  bench_rate (n, size);
+  bench_latency (size);
+  bench_frames ();
+
+  return 0;
+}
@@ -0,0 +1,118 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* A source with many properties: the snapshot of all of them, for a cold
+ * start, against the one a client gets when it reconnects after a few of
+ * them changed. Prints the size and the time of each.
+ *
+ * Usage: robj-bench-snapshot [properties] [changed] */
+
+#include "../robj-snapshot.h"
+#include <stdlib.h>
+
+#define BENCH_ROUNDS 100
+
+static void
+bench_report (const gchar *name, gsize size, gint64 elapsed) {
+  g_print ("%-22s %10" G_GSIZE_FORMAT " bytes %10.1f us\n", name, size,
+           elapsed / (gdouble) BENCH_ROUNDS);
+}
+
+static void
+bench_snapshot (const gchar *name, RObjMap *send_map, RObjMap *recv_map,
+                guint32 o_id, guint64 since) {
+  GByteArray *buf = g_byte_array_new ();
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    g_byte_array_set_size (buf, 0);
+    robj_snapshot_write (send_map, o_id, since, buf);
+    if (robj_snapshot_read (recv_map, buf->data, buf->len, NULL, NULL) < 0)
+      g_error ("Broken snapshot");
+  }
+
+  bench_report (name, buf->len, g_get_monotonic_time () - start);
+  g_byte_array_unref (buf);
+}
+
+int
+main (int argc, char *argv[]) {
+  guint n = argc > 1 ? atoi (argv[1]) : 10000;
+  guint changed = argc > 2 ? atoi (argv[2]) : n / 100;
+  RObjMap send_map,
+    recv_map;
+  RObjPN **pns = g_new (RObjPN *, n);
+  GValue pval = G_VALUE_INIT;
+  guint64 synced;
+  guint32 o_id;
+  guint i;
+
+  robj_protocol_init ();
+  robj_map_init (&send_map);
+  robj_map_init (&recv_map);
+  o_id = robj_map_add_object (&send_map, "foo");
+  robj_map_add_object_with_id (&recv_map, "foo", o_id);
+
+  for (i = 0; i < n; i++) {
+    gchar *name = g_strdup_printf ("prop-%u", i);
+
+    /* Every 10th is a string, the rest are the numbers */
+    g_value_init (&pval, i % 10 ? G_TYPE_INT : G_TYPE_STRING);
+    if (i % 10 == 0)
+      g_value_set_static_string (&pval, "some label of a button");
+    pns[i] = robj_map_new_pn (&send_map, o_id, name, &pval);
+    robj_map_new_pn_with_id (&recv_map, o_id, name, &pval, pns[i]->id);
+    g_value_unset (&pval);
+    g_free (name);
+  }
+
+  g_print ("properties: %u, changed: %u\n", n, changed);
+  bench_snapshot ("cold start", &send_map, &recv_map, o_id, 0);
+
+  synced = robj_map_get_version (&send_map);
+  g_value_init (&pval, G_TYPE_INT);
+  g_value_set_int (&pval, 42);
+  for (i = 0; i < changed; i++) {
+    /* Spread over the object, and only the numbers */
+    guint p = (i * 7919) % n;
+
+    if (p % 10 == 0)
+      p++;
+    if (p < n)
+      robj_pn_write_value (pns[p], &pval);
+  }
+  g_value_unset (&pval);
+
+  bench_snapshot ("reconnect", &send_map, &recv_map, o_id, synced);
+
+  robj_map_clear (&send_map);
+  robj_map_clear (&recv_map);
+  g_free (pns);
+  return 0;
+}
@@ -0,0 +1,166 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../robj-mux.h"
+
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+typedef struct {
+  gint n_connected;
+  gint n_resync;
+  gint n_closed;
+  gint n_msgs;
+} MuxCounters;
+
+static void
+mux_event (RObjMux *mux, RObjMuxClient *client, RObjMuxEvent event,
+           gpointer user_data) {
+  MuxCounters *cnt = (MuxCounters *) user_data;
+
+  switch (event) {
+  case ROBJ_MUX_EVENT_CONNECTED:
+    cnt->n_connected++;
+    break;
+  case ROBJ_MUX_EVENT_RESYNC:
+    cnt->n_resync++;
+    break;
+  case ROBJ_MUX_EVENT_CLOSED:
+    cnt->n_closed++;
+    break;
+  }
+}
+
+static void
+mux_message (RObjMux *mux, RObjMuxClient *client, const guint8 *msg,
+             gsize size, gpointer user_data) {
+  MuxCounters *cnt = (MuxCounters *) user_data;
+
+  g_assert_cmpuint (size, ==, 5);
+  g_assert_cmpmem (msg, size, "hello", 5);
+  cnt->n_msgs++;
+}
+
+static gsize
+mux_drain (gint fd, gint timeout) {
+  struct pollfd p = {.fd = fd,.events = POLLIN };
+  guint8 buf[16384];
+  gsize got = 0;
+  gssize ret;
+
+  while (poll (&p, 1, timeout) > 0) {
+    ret = read (fd, buf, sizeof (buf));
+    if (ret <= 0)
+      break;
+    got += ret;
+  }
+
+  return got;
+}
+
+static void
+test_mux (void) {
+  const guint8 hello[] = { 0, 0, 0, 5, 'h', 'e', 'l', 'l', 'o' };
+  MuxCounters cnt = { 0 };
+  GError *err = NULL;
+  RObjMuxClient *client;
+  RObjMux *mux;
+  guint8 big[1000];
+  GBytes *msg;
+  gint sv[2];
+  gint size = 4096;
+  gint sent = 0;
+  gint dropped = 0;
+  gsize got = 0;
+  gint i;
+
+  g_assert_cmpint (socketpair (AF_UNIX, SOCK_STREAM, 0, sv), ==, 0);
+  /* Small buffers, so the queue fills up quickly */
+  setsockopt (sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof (size));
+  setsockopt (sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof (size));
+
+  mux = robj_mux_new (20000, mux_event, mux_message, &cnt, &err);
+  g_assert_no_error (err);
+  client = robj_mux_add_client (mux, sv[0], &err);
+  g_assert_no_error (err);
+  g_assert_nonnull (client);
+  g_assert_cmpint (cnt.n_connected, ==, 1);
+  g_assert_cmpuint (robj_mux_get_n_clients (mux), ==, 1);
+
+  /* Nobody reads the other end, so at some point the messages are dropped */
+  memset (big, 7, sizeof (big));
+  msg = g_bytes_new (big, sizeof (big));
+  for (i = 0; i < 500; i++) {
+    if (robj_mux_send (mux, client, msg))
+      sent++;
+    else
+      dropped++;
+
+    if (i % 10 == 0)
+      robj_mux_flush (mux);
+  }
+  g_assert_cmpint (dropped, >, 0);
+
+  /* Once the queue is drained the client asks for the whole state */
+  while (cnt.n_resync == 0) {
+    got += mux_drain (sv[1], 0);
+    robj_mux_dispatch (mux, 1);
+  }
+  got += mux_drain (sv[1], 10);
+  g_assert_cmpuint (got, ==, sent * (sizeof (big) + 4));
+  g_assert_cmpint (cnt.n_resync, ==, 1);
+  g_assert_cmpuint (robj_mux_client_get_queued (client), ==, 0);
+  g_assert_true (robj_mux_send (mux, client, msg));
+  robj_mux_flush (mux);
+  g_bytes_unref (msg);
+
+  /* Incoming messages, one of them split in two */
+  g_assert_cmpint (write (sv[1], hello, sizeof (hello)), ==, sizeof (hello));
+  g_assert_cmpint (write (sv[1], hello, 4), ==, 4);
+  robj_mux_dispatch (mux, 100);
+  g_assert_cmpint (write (sv[1], hello + 4, 5), ==, 5);
+  while (cnt.n_msgs < 2)
+    robj_mux_dispatch (mux, 100);
+  g_assert_cmpint (cnt.n_msgs, ==, 2);
+
+  close (sv[1]);
+  while (cnt.n_closed == 0)
+    robj_mux_dispatch (mux, 100);
+  g_assert_cmpuint (robj_mux_get_n_clients (mux), ==, 0);
+
+  robj_mux_free (mux);
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/robj/test-mux", test_mux);
+  return g_test_run ();
+}
@@ -26,9 +26,11 @@
  */
 
 #include "../robj-protocol.h"
+#include "../robj-batch.h"
+#include "../robj-snapshot.h"
 
 typedef struct {
-  guint32 ohash;
+  guint32 o_id;
   RObjMap recv_map;
   RObjMap send_map;
 } Fixture;
@@ -38,7 +40,7 @@ fixture_set_up (Fixture *fixture, gconstpointer user_data) {
   robj_protocol_init ();
 
   robj_map_init (&fixture->recv_map);
-  fixture->ohash = robj_map_add_object (&fixture->recv_map, "foo");
+  fixture->o_id = robj_map_add_object (&fixture->recv_map, "foo");
 
   robj_map_init (&fixture->send_map);
   robj_map_add_object (&fixture->send_map, "foo");
@@ -56,9 +58,9 @@ send (GValue *val, Fixture *fixture) {
   RObjPN *pn_send;
   RObjPN *pn_recv;
 
-  pn_send = robj_map_new_pn (&fixture->send_map, fixture->ohash, "some-name", val);
+  pn_send = robj_map_new_pn (&fixture->send_map, fixture->o_id, "some-name", val);
   g_assert_nonnull (pn_send);
-  pn_recv = robj_map_new_pn (&fixture->recv_map, fixture->ohash, "some-name", val);
+  pn_recv = robj_map_new_pn (&fixture->recv_map, fixture->o_id, "some-name", val);
   g_assert_nonnull (pn_recv);
 
   msg = robj_protocol_pn_to_message (pn_send);
@@ -123,6 +125,69 @@ test_uint64_pn (Fixture *fixture, gconstpointer user_data) {
   g_assert (u64 == recvi);
 }
 
+static void
+test_double_pn (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  gdouble d = g_random_double ();
+  RObjPN *rpn;
+
+  g_value_init (&pval, G_TYPE_DOUBLE);
+  g_value_set_double (&pval, d);
+
+  rpn = recv (send (&pval, fixture), fixture);
+  g_assert_true (d == g_value_get_double (&rpn->pval));
+}
+
+static void
+test_write_pn (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  GByteArray *buf = g_byte_array_new ();
+  GBytes *msg;
+  RObjPN *flag;
+  RObjPN *label;
+  guint flag_size;
+
+  g_value_init (&pval, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&pval, TRUE);
+  flag = robj_map_new_pn (&fixture->send_map, fixture->o_id, "flag", &pval);
+  g_value_unset (&pval);
+  g_assert_cmpuint (flag->scalar_size, ==, sizeof (gboolean));
+
+  g_value_init (&pval, G_TYPE_STRING);
+  g_value_set_string (&pval, "hi");
+  label = robj_map_new_pn (&fixture->send_map, fixture->o_id, "label", &pval);
+  g_value_unset (&pval);
+  g_assert_cmpuint (label->scalar_size, ==, 0);
+
+  /* The scalar is written in place, the string is transformed, both are the
+   * same messages as the standalone ones */
+  g_assert_true (robj_protocol_write_pn (flag, buf));
+  flag_size = buf->len;
+  g_assert_true (robj_protocol_write_pn (label, buf));
+
+  msg = robj_protocol_pn_to_message (flag);
+  g_assert_cmpmem (buf->data, flag_size, g_bytes_get_data (msg, NULL),
+                   g_bytes_get_size (msg));
+  g_bytes_unref (msg);
+
+  msg = robj_protocol_pn_to_message (label);
+  g_assert_cmpmem (buf->data + flag_size, buf->len - flag_size,
+                   g_bytes_get_data (msg, NULL), g_bytes_get_size (msg));
+  g_bytes_unref (msg);
+
+  /* And the scalar is read back straight into the GValue */
+  g_value_init (&pval, G_TYPE_BOOLEAN);
+  robj_pn_write_value (flag, &pval);
+  g_value_unset (&pval);
+
+  msg = g_bytes_new (buf->data, flag_size);
+  g_assert_true (robj_protocol_message_to_pn (&fixture->send_map, msg) == flag);
+  g_assert_true (g_value_get_boolean (&flag->pval));
+  g_bytes_unref (msg);
+
+  g_byte_array_unref (buf);
+}
+
 static void
 test_string_pn (Fixture *fixture, gconstpointer user_data) {
   GValue pval = G_VALUE_INIT;
@@ -139,6 +204,436 @@ test_string_pn (Fixture *fixture, gconstpointer user_data) {
   g_assert_cmpstr (str, ==, recv_str);
 }
 
+static void
+batch_flush_cb (const guint8 *frame, gsize size, gpointer user_data) {
+  GByteArray *out = (GByteArray *) user_data;
+
+  g_byte_array_set_size (out, 0);
+  g_byte_array_append (out, frame, size);
+}
+
+static void
+batch_pn_cb (RObjPN *pn, gpointer user_data) {
+  (*(guint *) user_data)++;
+}
+
+static void
+batch_set_int (RObjPN *pn, gint val) {
+  GValue pval = G_VALUE_INIT;
+
+  g_value_init (&pval, G_TYPE_INT);
+  g_value_set_int (&pval, val);
+  robj_pn_write_value (pn, &pval);
+  g_value_unset (&pval);
+}
+
+static void
+test_batch (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  RObjBatchWriter writer;
+  RObjBatchReader reader;
+  GByteArray *frame = g_byte_array_new ();
+  RObjPN *send_pn[3];
+  RObjPN *recv_pn[3];
+  const gchar *names[] = { "x", "y", "label" };
+  guint full_size;
+  guint n_updated = 0;
+  gint i;
+
+  robj_batch_writer_init (&writer,
+                          ROBJ_BATCH_DELTA | ROBJ_BATCH_SKIP_UNCHANGED, 0, 0,
+                          batch_flush_cb, frame);
+  robj_batch_reader_init (&reader);
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++) {
+    if (i < 2) {
+      g_value_init (&pval, G_TYPE_INT);
+      g_value_set_int (&pval, 1000000 * (i + 1));
+    } else {
+      g_value_init (&pval, G_TYPE_STRING);
+      g_value_set_string (&pval, "hello");
+    }
+
+    send_pn[i] = robj_map_new_pn (&fixture->send_map, fixture->o_id,
+                                  names[i], &pval);
+    g_value_reset (&pval);
+    recv_pn[i] = robj_map_new_pn (&fixture->recv_map, fixture->o_id,
+                                  names[i], &pval);
+    g_value_unset (&pval);
+  }
+
+  /* The first frame has all the values in full */
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    g_assert_false (robj_batch_writer_add (&writer, send_pn[i]));
+  g_assert_true (robj_batch_writer_flush (&writer));
+  full_size = frame->len;
+
+  g_assert_cmpint (robj_batch_reader_parse (&reader, &fixture->recv_map,
+                                            frame->data, frame->len,
+                                            batch_pn_cb, &n_updated), ==, 3);
+  g_assert_cmpuint (n_updated, ==, 3);
+  g_assert_cmpint (g_value_get_int (&recv_pn[0]->pval), ==, 1000000);
+  g_assert_cmpint (g_value_get_int (&recv_pn[1]->pval), ==, 2000000);
+  g_assert_cmpstr (g_value_get_string (&recv_pn[2]->pval), ==, "hello");
+
+  /* Then small deltas, and the string is not sent again */
+  batch_set_int (send_pn[0], 1000003);
+  batch_set_int (send_pn[1], 1999990);
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    robj_batch_writer_add (&writer, send_pn[i]);
+  g_assert_true (robj_batch_writer_flush (&writer));
+  g_assert_cmpuint (frame->len, <, full_size);
+
+  g_assert_cmpint (robj_batch_reader_parse (&reader, &fixture->recv_map,
+                                            frame->data, frame->len,
+                                            NULL, NULL), ==, 2);
+  g_assert_cmpint (g_value_get_int (&recv_pn[0]->pval), ==, 1000003);
+  g_assert_cmpint (g_value_get_int (&recv_pn[1]->pval), ==, 1999990);
+
+  /* Nothing changed, nothing to send */
+  for (i = 0; i < G_N_ELEMENTS (names); i++)
+    robj_batch_writer_add (&writer, send_pn[i]);
+  g_assert_false (robj_batch_writer_flush (&writer));
+
+  /* The size limit flushes by itself */
+  robj_batch_writer_clear (&writer);
+  robj_batch_writer_init (&writer, 0, 1, 0, batch_flush_cb, frame);
+  g_assert_true (robj_batch_writer_add (&writer, send_pn[2]));
+  robj_batch_writer_clear (&writer);
+
+  robj_batch_reader_clear (&reader);
+  g_byte_array_unref (frame);
+}
+
+/* The receiver doesn't have one of the PNs, but still gets its deltas */
+static void
+test_batch_unknown_pn (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  RObjBatchWriter writer;
+  RObjBatchReader reader;
+  GByteArray *frame = g_byte_array_new ();
+  RObjPN *send_pn[2];
+  RObjPN *recv_pn;
+  gint i;
+
+  robj_batch_writer_init (&writer, ROBJ_BATCH_DELTA, 0, 0, batch_flush_cb,
+                          frame);
+  robj_batch_reader_init (&reader);
+
+  g_value_init (&pval, G_TYPE_INT);
+  send_pn[0] = robj_map_new_pn (&fixture->send_map, fixture->o_id, "x", &pval);
+  send_pn[1] = robj_map_new_pn (&fixture->send_map, fixture->o_id, "y", &pval);
+  recv_pn = robj_map_new_pn_with_id (&fixture->recv_map, fixture->o_id, "y",
+                                     &pval, send_pn[1]->id);
+  g_value_unset (&pval);
+
+  for (i = 0; i < 2; i++) {
+    batch_set_int (send_pn[0], 1000 + i);
+    batch_set_int (send_pn[1], 2000 + i);
+    robj_batch_writer_add (&writer, send_pn[0]);
+    robj_batch_writer_add (&writer, send_pn[1]);
+    g_assert_true (robj_batch_writer_flush (&writer));
+
+    /* The first frame has the values, the second one the deltas */
+    g_test_expect_message (NULL, G_LOG_LEVEL_CRITICAL, "PN * not found!");
+    g_assert_cmpint (robj_batch_reader_parse (&reader, &fixture->recv_map,
+                                              frame->data, frame->len,
+                                              NULL, NULL), ==, 1);
+    g_test_assert_expected_messages ();
+    g_assert_cmpint (g_value_get_int (&recv_pn->pval), ==, 2000 + i);
+  }
+
+  robj_batch_writer_clear (&writer);
+  robj_batch_reader_clear (&reader);
+  g_byte_array_unref (frame);
+}
+
+static void
+test_map (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  RObjPN *pns[500];
+  RObjPN *pn;
+  guint32 o_ids[5];
+  guint32 id;
+  gint i;
+
+  g_value_init (&pval, G_TYPE_INT);
+
+  /* Enough to make the table grow a few times */
+  for (i = 0; i < G_N_ELEMENTS (o_ids); i++) {
+    gchar *name = g_strdup_printf ("obj%d", i);
+
+    o_ids[i] = robj_map_add_object (&fixture->recv_map, name);
+    g_assert_cmpuint (o_ids[i], !=, ROBJ_MAP_NO_ID);
+    g_free (name);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (pns); i++) {
+    gchar *name = g_strdup_printf ("prop%d", i / 5);
+
+    g_value_set_int (&pval, i);
+    pns[i] = robj_map_new_pn (&fixture->recv_map, o_ids[i % 5], name, &pval);
+    g_assert_nonnull (pns[i]);
+    g_free (name);
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (pns); i++) {
+    g_assert_true (robj_map_lookup_pn (&fixture->recv_map, pns[i]->id)
+                   == pns[i]);
+  }
+
+  g_assert_true (robj_map_find_pn (&fixture->recv_map, o_ids[1], "prop0")
+                 == pns[1]);
+
+  id = pns[0]->id;
+  robj_map_read_begin (&fixture->recv_map);
+  robj_map_remove_object (&fixture->recv_map, o_ids[0]);
+  g_assert_null (robj_map_lookup_pn (&fixture->recv_map, id));
+  g_assert_null (robj_map_find_pn (&fixture->recv_map, o_ids[0], "prop0"));
+  /* A reader that has looked it up before can still use it */
+  g_assert_cmpstr (pns[0]->pname, ==, "prop0");
+  g_assert_cmpint (g_value_get_int (&pns[0]->pval), ==, 0);
+
+  for (i = 1; i < 5; i++) {
+    g_assert_true (robj_map_lookup_pn (&fixture->recv_map, pns[i]->id)
+                   == pns[i]);
+  }
+
+  /* Comes back, but the old ids are not free while the reader is there */
+  o_ids[0] = robj_map_add_object (&fixture->recv_map, "obj0");
+  g_value_set_int (&pval, 42);
+  pns[0] = robj_map_new_pn (&fixture->recv_map, o_ids[0], "prop0", &pval);
+  g_assert_true (robj_map_lookup_pn (&fixture->recv_map, pns[0]->id)
+                 == pns[0]);
+  g_assert_cmpuint (pns[0]->id, ==, G_N_ELEMENTS (pns));
+  robj_map_read_end (&fixture->recv_map);
+
+  /* The last reader has freed them, so the ids can be taken again */
+  pn = robj_map_new_pn (&fixture->recv_map, o_ids[0], "reused", &pval);
+  g_assert_cmpuint (pn->id, <, G_N_ELEMENTS (pns));
+  g_assert_cmpuint (pn->id % 5, ==, 0);
+
+  /* Ids given by the other side */
+  g_assert_nonnull (robj_map_new_pn_with_id (&fixture->recv_map, o_ids[1],
+                                             "far", &pval, 100000));
+  g_assert_cmpstr (robj_map_lookup_pn (&fixture->recv_map, 100000)->pname,
+                   ==, "far");
+
+  g_value_unset (&pval);
+}
+
+static void
+test_map_collision (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  RObjPN *ez;
+  RObjPN *fy;
+  guint32 o_ez;
+  guint32 o_fy;
+
+  /* These two have the same g_str_hash (), that was the id before */
+  g_assert_cmpuint (g_str_hash ("Ez"), ==, g_str_hash ("FY"));
+
+  o_ez = robj_map_add_object (&fixture->recv_map, "Ez");
+  o_fy = robj_map_add_object (&fixture->recv_map, "FY");
+  g_assert_cmpuint (o_ez, !=, ROBJ_MAP_NO_ID);
+  g_assert_cmpuint (o_fy, !=, ROBJ_MAP_NO_ID);
+  g_assert_cmpuint (o_ez, !=, o_fy);
+
+  g_value_init (&pval, G_TYPE_INT);
+  ez = robj_map_new_pn (&fixture->recv_map, o_ez, "Ez", &pval);
+  fy = robj_map_new_pn (&fixture->recv_map, o_ez, "FY", &pval);
+  g_assert_nonnull (ez);
+  g_assert_nonnull (fy);
+  g_assert_cmpuint (ez->id, !=, fy->id);
+  g_assert_true (robj_map_lookup_pn (&fixture->recv_map, ez->id) == ez);
+  g_assert_true (robj_map_lookup_pn (&fixture->recv_map, fy->id) == fy);
+  g_value_unset (&pval);
+}
+
+static gpointer
+seqlock_writer (gpointer data) {
+  RObjPN *pn = (RObjPN *) data;
+  GValue pval = G_VALUE_INIT;
+  guint64 i;
+
+  g_value_init (&pval, G_TYPE_UINT64);
+  for (i = 1; i <= 200000; i++) {
+    /* Both halves are always the same */
+    g_value_set_uint64 (&pval, (i << 32) | i);
+    robj_pn_write_value (pn, &pval);
+  }
+  g_value_unset (&pval);
+
+  return NULL;
+}
+
+static void
+test_seqlock (Fixture *fixture, gconstpointer user_data) {
+  GValue pval = G_VALUE_INIT;
+  GThread *writer;
+  RObjPN *pn;
+  guint64 val = 0;
+
+  g_value_init (&pval, G_TYPE_UINT64);
+  pn = robj_map_new_pn (&fixture->recv_map, fixture->o_id, "counter", &pval);
+  g_assert_nonnull (pn);
+
+  writer = g_thread_new ("writer", seqlock_writer, pn);
+  while (val != ((200000ull << 32) | 200000)) {
+    g_assert_true (robj_pn_read_value (pn, &pval));
+    val = g_value_get_uint64 (&pval);
+    g_assert_cmphex (val >> 32, ==, val & 0xffffffff);
+  }
+  g_thread_join (writer);
+
+  g_value_unset (&pval);
+}
+
+static void
+test_snapshot (Fixture *fixture, gconstpointer user_data) {
+  const gchar *names[] = { "width", "label", "scale" };
+  GType types[] = { G_TYPE_INT, G_TYPE_STRING, G_TYPE_DOUBLE };
+  RObjPN *send_pns[G_N_ELEMENTS (names)];
+  RObjPN *recv_pns[G_N_ELEMENTS (names)];
+  GValue pval = G_VALUE_INIT;
+  GByteArray *buf = g_byte_array_new ();
+  guint64 epoch,
+    since,
+    version,
+    synced;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (names); i++) {
+    g_value_init (&pval, types[i]);
+    send_pns[i] = robj_map_new_pn (&fixture->send_map, fixture->o_id, names[i],
+                                   &pval);
+    recv_pns[i] = robj_map_new_pn_with_id (&fixture->recv_map, fixture->o_id,
+                                           names[i], &pval, send_pns[i]->id);
+    g_assert_nonnull (recv_pns[i]);
+    g_value_unset (&pval);
+  }
+
+  g_value_init (&pval, G_TYPE_INT);
+  g_value_set_int (&pval, 640);
+  robj_pn_write_value (send_pns[0], &pval);
+  g_value_unset (&pval);
+
+  g_value_init (&pval, G_TYPE_STRING);
+  g_value_set_static_string (&pval, "hello");
+  robj_pn_write_value (send_pns[1], &pval);
+  g_value_unset (&pval);
+
+  /* Cold start: everything */
+  synced = robj_snapshot_write (&fixture->send_map, fixture->o_id, 0, buf);
+  g_assert_cmpuint (synced, ==, robj_map_get_version (&fixture->send_map));
+  g_assert_true (robj_snapshot_parse_header (buf->data, buf->len, &epoch,
+                                             &since, &version));
+  g_assert_cmphex (epoch, ==, fixture->send_map.epoch);
+  g_assert_cmpuint (since, ==, 0);
+  g_assert_cmpuint (version, ==, synced);
+  g_assert_cmpint (robj_snapshot_read (&fixture->recv_map, buf->data, buf->len,
+                                       NULL, NULL), ==, 3);
+
+  g_value_init (&pval, G_TYPE_INT);
+  robj_pn_read_value (recv_pns[0], &pval);
+  g_assert_cmpint (g_value_get_int (&pval), ==, 640);
+  g_value_unset (&pval);
+
+  g_value_init (&pval, G_TYPE_STRING);
+  robj_pn_read_value (recv_pns[1], &pval);
+  g_assert_cmpstr (g_value_get_string (&pval), ==, "hello");
+  g_value_unset (&pval);
+
+  /* Nothing changed, nothing to send */
+  g_byte_array_set_size (buf, 0);
+  robj_snapshot_write (&fixture->send_map, fixture->o_id, synced, buf);
+  g_assert_cmpint (robj_snapshot_read (&fixture->recv_map, buf->data, buf->len,
+                                       NULL, NULL), ==, 0);
+
+  /* Reconnect: only what changed */
+  g_value_init (&pval, G_TYPE_DOUBLE);
+  g_value_set_double (&pval, 1.5);
+  robj_pn_write_value (send_pns[2], &pval);
+  g_value_unset (&pval);
+  g_assert_cmpuint (robj_pn_get_version (send_pns[2]), >, synced);
+
+  g_byte_array_set_size (buf, 0);
+  version = robj_snapshot_write (&fixture->send_map, fixture->o_id, synced, buf);
+  g_assert_cmpuint (version, >, synced);
+  g_assert_cmpint (robj_snapshot_read (&fixture->recv_map, buf->data, buf->len,
+                                       NULL, NULL), ==, 1);
+
+  g_value_init (&pval, G_TYPE_DOUBLE);
+  robj_pn_read_value (recv_pns[2], &pval);
+  g_assert_cmpfloat (g_value_get_double (&pval), ==, 1.5);
+  g_value_unset (&pval);
+
+  g_assert_false (robj_snapshot_parse_header ((const guint8 *) "pn\x01", 3,
+                                              &epoch, &since, &version));
+  g_byte_array_unref (buf);
+}
+
+typedef struct {
+  RObjPN *pn;
+  gint done;
+} SnapshotWriter;
+
+static gpointer
+snapshot_writer (gpointer data) {
+  SnapshotWriter *writer = (SnapshotWriter *) data;
+  GValue pval = G_VALUE_INIT;
+  gint i;
+
+  g_value_init (&pval, G_TYPE_INT);
+  for (i = 1; i <= 100000; i++) {
+    g_value_set_int (&pval, i);
+    robj_pn_write_value (writer->pn, &pval);
+  }
+  g_value_unset (&pval);
+  g_atomic_int_set (&writer->done, 1);
+
+  return NULL;
+}
+
+static void
+test_snapshot_concurrent (Fixture *fixture, gconstpointer user_data) {
+  SnapshotWriter writer = { 0 };
+  GValue pval = G_VALUE_INIT;
+  GByteArray *buf = g_byte_array_new ();
+  GThread *thread;
+  RObjPN *recv_pn;
+  guint64 synced = 0;
+  gboolean done;
+
+  g_value_init (&pval, G_TYPE_INT);
+  writer.pn = robj_map_new_pn (&fixture->send_map, fixture->o_id, "counter",
+                               &pval);
+  recv_pn = robj_map_new_pn_with_id (&fixture->recv_map, fixture->o_id,
+                                     "counter", &pval, writer.pn->id);
+  g_assert_nonnull (recv_pn);
+
+  /* Sync on top of the last snapshot while the value changes. A write
+   * must never get a version that a snapshot without it has reported. */
+  thread = g_thread_new ("writer", snapshot_writer, &writer);
+  do {
+    done = g_atomic_int_get (&writer.done);
+
+    g_byte_array_set_size (buf, 0);
+    synced = robj_snapshot_write (&fixture->send_map, fixture->o_id, synced,
+                                  buf);
+    g_assert_cmpint (robj_snapshot_read (&fixture->recv_map, buf->data,
+                                         buf->len, NULL, NULL), >=, 0);
+  } while (!done);
+  g_thread_join (thread);
+
+  robj_pn_read_value (recv_pn, &pval);
+  g_assert_cmpint (g_value_get_int (&pval), ==, 100000);
+  g_assert_cmpuint (synced, ==, robj_map_get_version (&fixture->send_map));
+
+  g_value_unset (&pval);
+  g_byte_array_unref (buf);
+}
+
 int
 main (int argc, char *argv[]) {
   g_test_init (&argc, &argv, NULL);
@@ -161,5 +656,31 @@ main (int argc, char *argv[]) {
 
   g_test_add ("/robj/test-uint64-pn", Fixture, NULL,
               fixture_set_up, test_uint64_pn, fixture_tear_down);
+
+  g_test_add ("/robj/test-double-pn", Fixture, NULL,
+              fixture_set_up, test_double_pn, fixture_tear_down);
+
+  g_test_add ("/robj/test-write-pn", Fixture, NULL,
+              fixture_set_up, test_write_pn, fixture_tear_down);
+
+  g_test_add ("/robj/test-batch", Fixture, NULL,
+              fixture_set_up, test_batch, fixture_tear_down);
+  g_test_add ("/robj/test-batch-unknown-pn", Fixture, NULL,
+              fixture_set_up, test_batch_unknown_pn, fixture_tear_down);
+
+  g_test_add ("/robj/test-map", Fixture, NULL,
+              fixture_set_up, test_map, fixture_tear_down);
+
+  g_test_add ("/robj/test-map-collision", Fixture, NULL,
+              fixture_set_up, test_map_collision, fixture_tear_down);
+
+  g_test_add ("/robj/test-seqlock", Fixture, NULL,
+              fixture_set_up, test_seqlock, fixture_tear_down);
+
+  g_test_add ("/robj/test-snapshot", Fixture, NULL,
+              fixture_set_up, test_snapshot, fixture_tear_down);
+
+  g_test_add ("/robj/test-snapshot-concurrent", Fixture, NULL,
+              fixture_set_up, test_snapshot_concurrent, fixture_tear_down);
   return g_test_run ();
 }
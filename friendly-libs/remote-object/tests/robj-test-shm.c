@@ -0,0 +1,297 @@
+/* Remote GObject
+ *
+ * Copyright (c) 2025, Alexander Slobodeniuk <aleksandr.slobodeniuk@gmx.es>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice, this
+ *   list of conditions and the following disclaimer in the documentation and/or
+ *   other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ * ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../robj-shm-ring.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+/* 2 messages of the biggest size fill it */
+#define TEST_RING_SIZE 64
+#define TEST_MAX_MESSAGE (TEST_RING_SIZE / 2 - 8)
+/* Microseconds */
+#define TEST_TIMEOUT 10000
+
+typedef struct {
+  /* Both sides of the same ring, as if they were two processes */
+  RObjShmRing *producer;
+  RObjShmRing *consumer;
+} Fixture;
+
+static void
+fixture_set_up (Fixture *fixture, gconstpointer user_data) {
+  gint memfd,
+    data_fd,
+    space_fd;
+
+  fixture->producer = robj_shm_ring_new (TEST_RING_SIZE, 2, 100, NULL);
+  g_assert_nonnull (fixture->producer);
+
+  robj_shm_ring_get_fds (fixture->producer, &memfd, &data_fd, &space_fd);
+  fixture->consumer = robj_shm_ring_new_from_fds (dup (memfd), dup (data_fd),
+                                                  dup (space_fd), NULL);
+  g_assert_nonnull (fixture->consumer);
+}
+
+static void
+fixture_tear_down (Fixture *fixture, gconstpointer user_data) {
+  robj_shm_ring_unref (fixture->consumer);
+  robj_shm_ring_unref (fixture->producer);
+}
+
+/* Peeks the next message, checks it and consumes it.
+ * Returns where it was, in the mapping of the consumer. */
+static const guint8 *
+shm_expect (Fixture *fixture, const gchar *expected, gsize expected_size) {
+  const guint8 *msg;
+  gsize size = 0;
+
+  msg = robj_shm_ring_peek (fixture->consumer, &size, 0);
+  g_assert_nonnull (msg);
+  g_assert_cmpmem (msg, size, expected, expected_size);
+  robj_shm_ring_consume (fixture->consumer);
+
+  return msg;
+}
+
+static void
+test_shm_wrap (Fixture *fixture, gconstpointer user_data) {
+  const gchar big[TEST_MAX_MESSAGE] = "0123456789abcdefghijklm";
+  const guint8 *first;
+  const guint8 *msg;
+  guint8 *ptr;
+  gsize size;
+
+  g_assert_cmpuint (robj_shm_ring_get_max_message_size (fixture->producer),
+                    ==, TEST_MAX_MESSAGE);
+
+  /* 32 bytes in the ring, then 16 */
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      20, 0));
+  first = shm_expect (fixture, big, 20);
+  g_assert_true (robj_shm_ring_write (fixture->producer,
+                                      (const guint8 *) "bbbb", 4, 0));
+  msg = shm_expect (fixture, "bbbb", 4);
+  g_assert_true (msg == first + 32);
+
+  /* Only 16 bytes left until the end: the producer puts the WRAP marker
+   * there, and the consumer skips it and finds the message at the start */
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      TEST_MAX_MESSAGE, 0));
+  msg = shm_expect (fixture, big, TEST_MAX_MESSAGE);
+  g_assert_true (msg == first);
+  g_assert_null (robj_shm_ring_peek (fixture->consumer, &size, 0));
+
+  /* Committing less than was reserved gives the rest back */
+  ptr = robj_shm_ring_reserve (fixture->producer, TEST_MAX_MESSAGE, 0);
+  g_assert_nonnull (ptr);
+  memcpy (ptr, "ccc", 3);
+  robj_shm_ring_commit (fixture->producer, 3);
+  g_assert_true (robj_shm_ring_write (fixture->producer,
+                                      (const guint8 *) "d", 1, 0));
+
+  msg = shm_expect (fixture, "ccc", 3);
+  g_assert_true (msg == first + 32);
+  msg = shm_expect (fixture, "d", 1);
+  g_assert_true (msg == first + 32 + 16);
+
+  /* The next one wraps while the one before it is still not read */
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      20, 0));
+  shm_expect (fixture, big, 20);
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      4, 0));
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      20, 0));
+  msg = shm_expect (fixture, big, 4);
+  g_assert_true (msg == first + 32);
+  msg = shm_expect (fixture, big, 20);
+  g_assert_true (msg == first);
+  g_assert_null (robj_shm_ring_peek (fixture->consumer, &size, 0));
+}
+
+static void
+test_shm_timeout (Fixture *fixture, gconstpointer user_data) {
+  const gchar big[TEST_MAX_MESSAGE] = { 0 };
+  gint64 start;
+  gsize size;
+
+  /* Nothing to read */
+  start = g_get_monotonic_time ();
+  g_assert_null (robj_shm_ring_peek (fixture->consumer, &size, TEST_TIMEOUT));
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, TEST_TIMEOUT);
+
+  /* No space to write */
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      TEST_MAX_MESSAGE, 0));
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      TEST_MAX_MESSAGE, 0));
+  g_assert_null (robj_shm_ring_reserve (fixture->producer, 1, 0));
+
+  start = g_get_monotonic_time ();
+  g_assert_null (robj_shm_ring_reserve (fixture->producer, 1, TEST_TIMEOUT));
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, TEST_TIMEOUT);
+}
+
+static gpointer
+shm_consumer_thread (gpointer data) {
+  Fixture *fixture = (Fixture *) data;
+  const guint8 *msg;
+  gsize size = 0;
+
+  /* Forever, only the data fd can wake it up */
+  msg = robj_shm_ring_peek (fixture->consumer, &size, -1);
+  g_assert_nonnull (msg);
+  g_assert_cmpmem (msg, size, "wake", 4);
+  robj_shm_ring_consume (fixture->consumer);
+
+  return NULL;
+}
+
+static gpointer
+shm_producer_thread (gpointer data) {
+  Fixture *fixture = (Fixture *) data;
+  const gchar late[TEST_MAX_MESSAGE] = "late";
+
+  /* Forever, only the space fd can wake it up */
+  return GINT_TO_POINTER (robj_shm_ring_write (fixture->producer,
+                                               (const guint8 *) late,
+                                               TEST_MAX_MESSAGE, -1));
+}
+
+static void
+test_shm_wakeup (Fixture *fixture, gconstpointer user_data) {
+  const gchar big[TEST_MAX_MESSAGE] = { 0 };
+  const gchar late[TEST_MAX_MESSAGE] = "late";
+  struct pollfd pfd = {.events = POLLIN };
+  GThread *thread;
+  guint64 val;
+  gsize size;
+
+  /* The consumer sleeps until the producer signals the data fd */
+  thread = g_thread_new ("consumer", shm_consumer_thread, fixture);
+  g_usleep (TEST_TIMEOUT);
+  g_assert_true (robj_shm_ring_write (fixture->producer,
+                                      (const guint8 *) "wake", 4, 0));
+  g_thread_join (thread);
+
+  /* The producer sleeps until the consumer frees some space. After this one
+   * the next doesn't fit before the end, and there's no room to wrap */
+  g_assert_true (robj_shm_ring_write (fixture->producer, (const guint8 *) big,
+                                      TEST_MAX_MESSAGE, 0));
+  g_assert_null (robj_shm_ring_reserve (fixture->producer, TEST_MAX_MESSAGE,
+                                        0));
+  thread = g_thread_new ("producer", shm_producer_thread, fixture);
+  g_usleep (TEST_TIMEOUT);
+  shm_expect (fixture, big, TEST_MAX_MESSAGE);
+  g_assert_true (GPOINTER_TO_INT (g_thread_join (thread)));
+  shm_expect (fixture, late, TEST_MAX_MESSAGE);
+
+  /* Waiting in a main loop: the data fd gets readable on the next message.
+   * A signal that came when the consumer was not waiting anymore can still
+   * be there, so it's cleared first. */
+  robj_shm_ring_get_fds (fixture->consumer, NULL, &pfd.fd, NULL);
+  if (read (pfd.fd, &val, sizeof (val)) < 0)
+    g_assert_cmpint (errno, ==, EAGAIN);
+  g_assert_true (robj_shm_ring_prepare_wait (fixture->consumer));
+  g_assert_cmpint (poll (&pfd, 1, 0), ==, 0);
+  g_assert_true (robj_shm_ring_write (fixture->producer,
+                                      (const guint8 *) "loop", 4, 0));
+  g_assert_cmpint (poll (&pfd, 1, 1000), ==, 1);
+  g_assert_cmpint (read (pfd.fd, &val, sizeof (val)), ==, sizeof (val));
+
+  /* Nothing to wait for, there's a message already */
+  g_assert_false (robj_shm_ring_prepare_wait (fixture->consumer));
+  shm_expect (fixture, "loop", 4);
+  g_assert_null (robj_shm_ring_peek (fixture->consumer, &size, 0));
+}
+
+static void
+test_shm_blob (Fixture *fixture, gconstpointer user_data) {
+  guint8 *blob;
+  const guint8 *data;
+  guint id[2];
+  guint id3;
+  guint id4;
+  GBytes *bytes;
+  gsize size;
+
+  /* Bigger than the blobs */
+  g_assert_null (robj_shm_ring_blob_alloc (fixture->producer, 101, &id3));
+
+  blob = robj_shm_ring_blob_alloc (fixture->producer, 5, &id[0]);
+  g_assert_nonnull (blob);
+  memcpy (blob, "first", 5);
+  blob = robj_shm_ring_blob_alloc (fixture->producer, 6, &id[1]);
+  g_assert_nonnull (blob);
+  memcpy (blob, "second", 6);
+  g_assert_cmpuint (id[0], !=, id[1]);
+
+  /* All of them are in use */
+  g_assert_null (robj_shm_ring_blob_alloc (fixture->producer, 1, &id3));
+
+  data = robj_shm_ring_blob_get (fixture->consumer, id[0], &size);
+  g_assert_cmpmem (data, size, "first", 5);
+  robj_shm_ring_blob_release (fixture->consumer, id[0]);
+
+  blob = robj_shm_ring_blob_alloc (fixture->producer, 5, &id3);
+  g_assert_nonnull (blob);
+  g_assert_cmpuint (id3, ==, id[0]);
+  robj_shm_ring_blob_release (fixture->consumer, id3);
+
+  /* Released when the bytes are freed */
+  bytes = robj_shm_ring_blob_to_bytes (fixture->consumer, id[1]);
+  g_assert_nonnull (bytes);
+  g_assert_cmpmem (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes),
+                   "second", 6);
+
+  g_assert_nonnull (robj_shm_ring_blob_alloc (fixture->producer, 1, &id3));
+  g_assert_cmpuint (id3, ==, id[0]);
+  g_assert_null (robj_shm_ring_blob_alloc (fixture->producer, 1, &id4));
+
+  g_bytes_unref (bytes);
+  g_assert_nonnull (robj_shm_ring_blob_alloc (fixture->producer, 1, &id4));
+  g_assert_cmpuint (id4, ==, id[1]);
+}
+
+int
+main (int argc, char *argv[]) {
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/robj/test-shm-wrap", Fixture, NULL,
+              fixture_set_up, test_shm_wrap, fixture_tear_down);
+  g_test_add ("/robj/test-shm-timeout", Fixture, NULL,
+              fixture_set_up, test_shm_timeout, fixture_tear_down);
+  g_test_add ("/robj/test-shm-wakeup", Fixture, NULL,
+              fixture_set_up, test_shm_wakeup, fixture_tear_down);
+  g_test_add ("/robj/test-shm-blob", Fixture, NULL,
+              fixture_set_up, test_shm_blob, fixture_tear_down);
+
+  return g_test_run ();
+}